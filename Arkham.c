@@ -2,6 +2,8 @@
 * @Fitxer: Arkham.c
 * @Descripció: Logger basat exclusivament en file descriptors.
 * Llegeix per stdin (redirigit per pipe) i escriu en fitxer de log.
+* Gotham hi envia les línies per lots: cada lectura es processa sencera i s'escriu amb writev.
+* Les línies d'esdeveniment (@EVENT) van al registre binari (EventLog) en lloc del text.
 ************************************************/
 
 #include <unistd.h>
@@ -11,52 +13,120 @@
 #include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <stdio.h>
 
+#include "FrameUtils/FrameUtils.h"
+#include "EventLog/EventLog.h"
+
 #define LOG_FILE "logs.txt"
-#define BUFFER_SIZE 512
+#define BUFFER_SIZE 65536
+#define BATCH_LINES 512  // Línies per writev (dos segments cadascuna)
+
+// Marca de temps de l'última línia: només es torna a formatar quan canvia el segon
+typedef struct {
+    time_t second;
+    char text[32];
+    size_t length;
+} Timestamp;
 
-// Escriu missatge amb timestamp a file descriptor
-void write_log_entry(int fd_log, const char *message) {
-    char log_entry[BUFFER_SIZE + 128];
-    char timestamp[64];
+static const char *marcaTemps(Timestamp *timestamp, size_t *length) {
     time_t now = time(NULL);
-    struct tm tm_info;
+    if (now != timestamp->second || timestamp->length == 0) {
+        struct tm tm_info;
+        localtime_r(&now, &tm_info);
+        timestamp->length = strftime(timestamp->text, sizeof(timestamp->text), "[%Y-%m-%d %H:%M:%S] ", &tm_info);
+        timestamp->second = now;
+    }
+    *length = timestamp->length;
+    return timestamp->text;
+}
+
+// Escriu cada línia completa de buffer precedida de la marca de temps. Retorna els bytes consumits.
+static size_t escriureLinies(int fd_log, EventLogWriter *events, char *buffer, size_t length, Timestamp *timestamp) {
+    struct iovec iov[BATCH_LINES * 2];
+    EventRecord batch[BATCH_LINES];
+    int count = 0;
+    int eventCount = 0;
+    size_t consumed = 0;
+    size_t stampLength;
+    const char *stamp = marcaTemps(timestamp, &stampLength);
+
+    while (consumed < length) {
+        char *line = buffer + consumed;
+        char *newline = memchr(line, '\n', length - consumed);
+        if (!newline) {
+            break; // Línia incompleta: s'acabarà de llegir a la propera lectura
+        }
+        size_t lineLength = (size_t)(newline - line) + 1;
+        consumed += lineLength;
 
-    localtime_r(&now, &tm_info);
-    strftime(timestamp, sizeof(timestamp), "[%Y-%m-%d %H:%M:%S]", &tm_info);
+        if (event_log_parse(line, lineLength - 1, &batch[eventCount]) == 0) {
+            if (++eventCount == BATCH_LINES) {
+                event_log_append(events, batch, eventCount);
+                eventCount = 0;
+            }
+            continue;
+        }
+
+        iov[count].iov_base = (void *)stamp;
+        iov[count].iov_len = stampLength;
+        iov[count + 1].iov_base = line;
+        iov[count + 1].iov_len = lineLength;
+        count += 2;
 
-    // Compose log message
-    int len = snprintf(log_entry, sizeof(log_entry), "%s %s\n", timestamp, message);
-    if (len > 0) {
-        write(fd_log, log_entry, len);
+        if (count == BATCH_LINES * 2) {
+            writev_full(fd_log, iov, count);
+            count = 0;
+        }
+    }
+    if (count > 0) {
+        writev_full(fd_log, iov, count);
     }
+    if (eventCount > 0) {
+        event_log_append(events, batch, eventCount);
+    }
+    return consumed;
 }
 
 int main() {
     char buffer[BUFFER_SIZE];
+    size_t pending = 0;
     ssize_t bytes_read;
-    char *newline;
+    Timestamp timestamp = {0};
+    EventLogWriter events;
 
     // Obre fitxer de log en mode append, amb permisos rw-r--r--
     int fd_log = open(LOG_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
     if (fd_log < 0) {
         _exit(EXIT_FAILURE);
     }
+    event_log_open(&events); // Sense directori d'esdeveniments el text es continua escrivint
 
     // Llegeix de stdin (pipe del pare)
-    while ((bytes_read = read(STDIN_FILENO, buffer, sizeof(buffer) - 1)) > 0) {
-        buffer[bytes_read] = '\0';
+    while ((bytes_read = read(STDIN_FILENO, buffer + pending, sizeof(buffer) - pending)) > 0) {
+        pending += (size_t)bytes_read;
 
-        // Elimina possible salt de línia
-        newline = strchr(buffer, '\n');
-        if (newline) {
-            *newline = '\0';
+        size_t consumed = escriureLinies(fd_log, &events, buffer, pending, &timestamp);
+        if (consumed == 0 && pending == sizeof(buffer)) {
+            // Línia més llarga que el buffer: s'escriu el tros llegit i continua a la següent lectura
+            size_t stampLength;
+            const char *stamp = marcaTemps(&timestamp, &stampLength);
+            struct iovec iov[2] = {{(void *)stamp, stampLength}, {buffer, pending}};
+            writev_full(fd_log, iov, 2);
+            consumed = pending;
         }
+        pending -= consumed;
+        memmove(buffer, buffer + consumed, pending);
+    }
 
-        write_log_entry(fd_log, buffer);
+    // Última línia sense salt de línia
+    if (pending > 0 && pending < sizeof(buffer)) {
+        buffer[pending++] = '\n';
+        escriureLinies(fd_log, &events, buffer, pending, &timestamp);
     }
 
+    event_log_close(&events);
     close(fd_log);
     return 0;
-}
\ No newline at end of file
+}
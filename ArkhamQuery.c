@@ -0,0 +1,255 @@
+/***********************************************
+* @Fitxer: ArkhamQuery.c
+* @Descripció: Consulta del registre binari d'esdeveniments que escriu Arkham.
+* Projecta cada segment, salta per cerca binària fins a l'inici de l'interval demanat i agrega:
+* esdeveniments per tipus i, per worker, distorsions assignades, acabades, bytes i latència (p50/p95/p99).
+* Ús: ./arkham_query [-d directori] [-h hores]
+************************************************/
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "DataConversion/DataConversion.h"
+#include "EventLog/EventLog.h"
+
+typedef struct {
+    uint32_t ip;
+    uint16_t port;
+    uint8_t workerType;
+    uint64_t counts[EVENT_TYPE_COUNT];
+    uint64_t bytes;
+    uint32_t *durations;    // Durades de les distorsions acabades
+    size_t durationCount;
+    size_t durationCapacity;
+} WorkerStats;
+
+typedef struct {
+    WorkerStats *workers;
+    int workerCount;
+    int workerCapacity;
+    uint64_t counts[EVENT_TYPE_COUNT];
+    uint64_t total;
+    uint64_t firstMs;
+    uint64_t lastMs;
+} QueryResult;
+
+static int compararSequencia(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int compararDurada(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static WorkerStats *statsWorker(QueryResult *result, const EventRecord *event) {
+    for (int i = 0; i < result->workerCount; i++) {
+        if (result->workers[i].ip == event->workerIp && result->workers[i].port == event->workerPort) {
+            return &result->workers[i];
+        }
+    }
+    if (result->workerCount == result->workerCapacity) {
+        int capacity = result->workerCapacity ? result->workerCapacity * 2 : 16;
+        WorkerStats *workers = realloc(result->workers, sizeof(WorkerStats) * capacity);
+        if (!workers) return NULL;
+        result->workers = workers;
+        result->workerCapacity = capacity;
+    }
+    WorkerStats *stats = &result->workers[result->workerCount++];
+    memset(stats, 0, sizeof(*stats));
+    stats->ip = event->workerIp;
+    stats->port = event->workerPort;
+    stats->workerType = event->workerType;
+    return stats;
+}
+
+static void acumular(QueryResult *result, const EventRecord *event) {
+    if (event->type >= EVENT_TYPE_COUNT) return;
+
+    result->counts[event->type]++;
+    result->total++;
+    if (result->firstMs == 0 || event->timeMs < result->firstMs) result->firstMs = event->timeMs;
+    if (event->timeMs > result->lastMs) result->lastMs = event->timeMs;
+
+    WorkerStats *stats = statsWorker(result, event);
+    if (!stats) return;
+    stats->counts[event->type]++;
+    if (event->type != EVENT_DISTORT_DONE) return;
+
+    stats->bytes += event->bytes;
+    if (stats->durationCount == stats->durationCapacity) {
+        size_t capacity = stats->durationCapacity ? stats->durationCapacity * 2 : 1024;
+        uint32_t *durations = realloc(stats->durations, sizeof(uint32_t) * capacity);
+        if (!durations) return;
+        stats->durations = durations;
+        stats->durationCapacity = capacity;
+    }
+    stats->durations[stats->durationCount++] = event->durationMs;
+}
+
+// Primer registre amb timeMs >= since (els segments s'escriuen en ordre de temps)
+static size_t primerDesDe(const EventRecord *records, size_t count, uint64_t since) {
+    size_t low = 0, high = count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (records[middle].timeMs < since) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static int llegirSegment(const char *path, uint64_t since, QueryResult *result) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(EventSegmentHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const EventSegmentHeader *header = (const EventSegmentHeader *)map;
+    if (memcmp(header->magic, EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC)) != 0 || header->recordSize != sizeof(EventRecord)) {
+        customPrintf("[WARNING]: %s no és un segment d'esdeveniments vàlid.\n", path);
+        munmap(map, info.st_size);
+        return -1;
+    }
+
+    const EventRecord *records = (const EventRecord *)((const char *)map + sizeof(EventSegmentHeader));
+    size_t count = ((size_t)info.st_size - sizeof(EventSegmentHeader)) / sizeof(EventRecord);
+    if (count > 0 && records[count - 1].timeMs >= since) {
+        size_t first = primerDesDe(records, count, since);
+        madvise((void *)&records[first], (count - first) * sizeof(EventRecord), MADV_SEQUENTIAL);
+        for (size_t i = first; i < count; i++) {
+            acumular(result, &records[i]);
+        }
+    }
+
+    munmap(map, info.st_size);
+    return 0;
+}
+
+static uint32_t percentil(const WorkerStats *stats, double fraction) {
+    if (stats->durationCount == 0) return 0;
+    size_t rank = (size_t)(fraction * stats->durationCount + 0.999999);
+    if (rank == 0) rank = 1;
+    if (rank > stats->durationCount) rank = stats->durationCount;
+    return stats->durations[rank - 1];
+}
+
+static void formatarData(uint64_t ms, char *text, size_t size) {
+    time_t seconds = (time_t)(ms / 1000);
+    struct tm tm_info;
+    localtime_r(&seconds, &tm_info);
+    strftime(text, size, "%Y-%m-%d %H:%M:%S", &tm_info);
+}
+
+static void mostrarResultat(QueryResult *result, int segments) {
+    char from[32] = "-", to[32] = "-";
+    if (result->total > 0) {
+        formatarData(result->firstMs, from, sizeof(from));
+        formatarData(result->lastMs, to, sizeof(to));
+    }
+    customPrintf("Segments: %d, esdeveniments: %llu (%s - %s)\n\n", segments, (unsigned long long)result->total, from, to);
+
+    customPrintf("Per tipus:\n");
+    for (int type = 1; type < EVENT_TYPE_COUNT; type++) {
+        customPrintf("  %-20s %llu\n", event_log_type_name(type), (unsigned long long)result->counts[type]);
+    }
+
+    customPrintf("\nPer worker:\n");
+    customPrintf("  %-22s %-6s %9s %9s %9s %12s %8s %8s %8s %8s\n", "Worker", "Tipus", "Assign.", "Reassig.",
+                 "Acabades", "Bytes", "p50 ms", "p95 ms", "p99 ms", "max ms");
+    for (int i = 0; i < result->workerCount; i++) {
+        WorkerStats *stats = &result->workers[i];
+        qsort(stats->durations, stats->durationCount, sizeof(uint32_t), compararDurada);
+
+        char address[16] = "?";
+        struct in_addr ip = { .s_addr = stats->ip };
+        inet_ntop(AF_INET, &ip, address, sizeof(address));
+        char worker[32];
+        snprintf(worker, sizeof(worker), "%s:%u", address, stats->port);
+
+        const char *type = stats->workerType == EVENT_WORKER_TEXT ? "TEXT" : stats->workerType == EVENT_WORKER_MEDIA ? "MEDIA" : "-";
+        customPrintf("  %-22s %-6s %9llu %9llu %9llu %12llu %8u %8u %8u %8u\n", worker, type,
+                     (unsigned long long)stats->counts[EVENT_DISTORT_ROUTED],
+                     (unsigned long long)stats->counts[EVENT_DISTORT_REASSIGNED],
+                     (unsigned long long)stats->counts[EVENT_DISTORT_DONE], (unsigned long long)stats->bytes,
+                     percentil(stats, 0.50), percentil(stats, 0.95), percentil(stats, 0.99), percentil(stats, 1.0));
+        free(stats->durations);
+    }
+    free(result->workers);
+}
+
+int main(int argc, char *argv[]) {
+    const char *directory = EVENT_LOG_DIR;
+    double hours = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "d:h:")) != -1) {
+        if (option == 'd') {
+            directory = optarg;
+        } else if (option == 'h') {
+            hours = atof(optarg);
+        } else {
+            customPrintf("Ús: %s [-d directori] [-h hores]\n", argv[0]);
+            return 1;
+        }
+    }
+    uint64_t since = hours > 0 ? event_log_now_ms() - (uint64_t)(hours * 3600000.0) : 0;
+
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        customPrintf("[ERROR]: No es pot obrir el directori d'esdeveniments %s.\n", directory);
+        return 1;
+    }
+
+    uint32_t *sequences = NULL;
+    size_t count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned sequence;
+        if (sscanf(entry->d_name, "events.%u.bin", &sequence) != 1) continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            uint32_t *grown = realloc(sequences, sizeof(uint32_t) * capacity);
+            if (!grown) break;
+            sequences = grown;
+        }
+        sequences[count++] = sequence;
+    }
+    closedir(dir);
+    qsort(sequences, count, sizeof(uint32_t), compararSequencia);
+
+    QueryResult result = {0};
+    int segments = 0;
+    for (size_t i = 0; i < count; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/events.%06u.bin", directory, sequences[i]);
+        if (llegirSegment(path, since, &result) == 0) {
+            segments++;
+        }
+    }
+    free(sequences);
+
+    mostrarResultat(&result, segments);
+    return 0;
+}
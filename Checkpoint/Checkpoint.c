@@ -0,0 +1,24 @@
+#include "Checkpoint.h"
+
+#include "../TimerWheel/TimerWheel.h"
+
+// El progrés inicial ja és a la memòria compartida (desat en acceptar la transferència)
+void checkpoint_start(Checkpoint *checkpoint, uint64_t progress) {
+    checkpoint_saved(checkpoint, progress);
+}
+
+// 1 si el progrés ha avançat prou (en bytes o en temps) des de l'últim desament
+int checkpoint_due(const Checkpoint *checkpoint, uint64_t progress) {
+    if (progress == checkpoint->saved) {
+        return 0;
+    }
+    if (progress < checkpoint->saved || progress - checkpoint->saved >= CHECKPOINT_BYTES) {
+        return 1;
+    }
+    return timer_wheel_now_ms() - checkpoint->savedAtMs >= CHECKPOINT_INTERVAL_MS;
+}
+
+void checkpoint_saved(Checkpoint *checkpoint, uint64_t progress) {
+    checkpoint->saved = progress;
+    checkpoint->savedAtMs = timer_wheel_now_ms();
+}
@@ -0,0 +1,28 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+
+// Cada quants bytes es desa el progrés d'una transferència a la memòria compartida (0 = a cada trama)
+#ifndef CHECKPOINT_BYTES
+#define CHECKPOINT_BYTES (1024 * 1024)
+#endif
+
+// Temps màxim (ms) que el progrés desat pot anar per darrere del real
+#ifndef CHECKPOINT_INTERVAL_MS
+#define CHECKPOINT_INTERVAL_MS 250
+#endif
+
+// Progrés d'una transferència: el fil que la porta l'actualitza en memòria a cada trama
+// i només passa per la memòria compartida (i el seu semàfor) quan checkpoint_due ho indica.
+// Cada ranura té un sol escriptor, així que no necessita cap bloqueig.
+typedef struct {
+    uint64_t saved;       // Últim progrés desat
+    uint64_t savedAtMs;   // Quan es va desar (ms monotònics)
+} Checkpoint;
+
+void checkpoint_start(Checkpoint *checkpoint, uint64_t progress);
+int checkpoint_due(const Checkpoint *checkpoint, uint64_t progress);
+void checkpoint_saved(Checkpoint *checkpoint, uint64_t progress);
+
+#endif
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <stdio.h> // Para vsnprintf
 #include "DataConversion.h"
+#include "../Logging/Logging.h"
 
 // Función para convertir un entero en una cadena de texto
 char *intToStr(int num) {
@@ -17,33 +18,15 @@ char *intToStr(int num) {
     return str;
 }
 
-// Función para imprimir texto sin usar printf (dinámico)
+// Función para imprimir texto sin usar printf: se formatea una sola vez en el buffer del hilo
+// y el hilo de consola lo escribe, sin malloc ni write en quien llama
 void customPrintf(const char *format, ...) {
-    va_list args;
-    va_start(args, format);
-
-    // Obtener el tamaño necesario
-    int size = vsnprintf(NULL, 0, format, args);
-    va_end(args);
-
-    if (size < 0) {
-        return; // Error en el formato
+    if (!log_enabled(log_level_of(format))) {
+        return; // Nivel filtrado: ni siquiera se formatea
     }
 
-    // Reservar memoria para el mensaje
-    char *buffer = (char *)malloc(size + 1);
-    if (!buffer) {
-        return; // Error de asignación
-    }
-
-    // Escribir el formato en el buffer
+    va_list args;
     va_start(args, format);
-    vsnprintf(buffer, size + 1, format, args);
+    log_console_vprintf(format, args);
     va_end(args);
-
-    // Escribir en stdout
-    write(STDOUT_FILENO, buffer, size);
-
-    // Liberar memoria
-    free(buffer);
 }
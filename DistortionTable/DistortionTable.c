@@ -0,0 +1,345 @@
+#include "DistortionTable.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../DataConversion/DataConversion.h"
+
+#define BUCKET_MASK (DISTORTION_TABLE_BUCKETS - 1)
+
+static uint32_t hashNom(const char *fileName) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)fileName; *c; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static DistortionTable *taula(SharedMemory *sm) {
+    if (!sm || !sm->shmaddr || sm->shmaddr == (void *)-1) {
+        return NULL;
+    }
+    return (DistortionTable *)sm->shmaddr;
+}
+
+// Un escriptor que ja no existeix (SIGKILL o caiguda a mitja escriptura) no alliberarà mai la ranura
+static int escriptorMort(int32_t writer) {
+    return writer != 0 && kill(writer, 0) == -1 && errno == ESRCH;
+}
+
+// Escriptor del seqlock: writer fa d'exclusió entre processos i seq passa a senar mentre dura l'escriptura.
+// Si el que la tenia ha mort, se li pren: seq pot haver quedat senar i es continua des d'aquí.
+static void bloquejarRanura(DistortionSlot *slot) {
+    int32_t self = (int32_t)getpid();
+    for (;;) {
+        int32_t writer = __atomic_load_n(&slot->writer, __ATOMIC_RELAXED);
+        if ((writer == 0 || escriptorMort(writer)) &&
+            __atomic_compare_exchange_n(&slot->writer, &writer, self, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+        sched_yield();
+    }
+
+    if (!(__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) & 1)) {
+        __atomic_add_fetch(&slot->seq, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void desbloquejarRanura(DistortionSlot *slot) {
+    __atomic_add_fetch(&slot->seq, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&slot->writer, 0, __ATOMIC_RELEASE);
+}
+
+// Lector del seqlock: copia la ranura sencera fins que la còpia és coherent. Si l'escriptor
+// ha mort amb seq senar, es pren la ranura i s'allibera perquè no quedi bloquejada per sempre.
+static void llegirRanura(DistortionSlot *slot, DistortionSlot *copy) {
+    for (;;) {
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (!(seq & 1)) {
+            memcpy(copy, slot, sizeof(*copy));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+                return;
+            }
+        } else if (escriptorMort(__atomic_load_n(&slot->writer, __ATOMIC_RELAXED))) {
+            bloquejarRanura(slot);
+            desbloquejarRanura(slot);
+            continue;
+        }
+        sched_yield();
+    }
+}
+
+// Retorna bloquejada la ranura de (fileName, userName). Sense el semàfor, si la cadena canvia
+// mentre es recorre la cerca pot fallar: el cridant ho torna a provar amb el semàfor agafat.
+static DistortionSlot *bloquejarEntrada(DistortionTable *table, uint32_t hash, const char *fileName, const char *userName) {
+    uint32_t index = __atomic_load_n(&table->buckets[hash & BUCKET_MASK], __ATOMIC_ACQUIRE);
+
+    for (int steps = 0; index != 0 && steps < DISTORTION_TABLE_CAPACITY; steps++) {
+        DistortionSlot *slot = &table->slots[index - 1];
+        if (__atomic_load_n(&slot->hash, __ATOMIC_RELAXED) == hash) {
+            bloquejarRanura(slot);
+            if (slot->inUse && slot->hash == hash && strcmp(slot->record.fileName, fileName) == 0 &&
+                strcmp(slot->record.userName, userName) == 0) {
+                return slot;
+            }
+            desbloquejarRanura(slot);
+        }
+        index = __atomic_load_n(&slot->next, __ATOMIC_ACQUIRE);
+    }
+    return NULL;
+}
+
+// Amb el semàfor agafat: treu una ranura de la llista lliure i la publica a la seva cubeta (bloquejada)
+static DistortionSlot *afegirEntrada(DistortionTable *table, uint32_t hash, const char *fileName, const char *userName) {
+    uint32_t index;
+    if (table->freeHead != 0) {
+        index = table->freeHead;
+        table->freeHead = table->slots[index - 1].next;
+    } else if (table->unused < DISTORTION_TABLE_CAPACITY) {
+        index = ++table->unused;
+    } else {
+        return NULL;
+    }
+
+    DistortionSlot *slot = &table->slots[index - 1];
+    uint32_t *bucket = &table->buckets[hash & BUCKET_MASK];
+
+    bloquejarRanura(slot);
+    memset(&slot->record, 0, sizeof(slot->record));
+    snprintf(slot->record.fileName, sizeof(slot->record.fileName), "%s", fileName);
+    snprintf(slot->record.userName, sizeof(slot->record.userName), "%s", userName);
+    md5_init(&slot->record.hashState);
+    slot->inUse = 1;
+    __atomic_store_n(&slot->hash, hash, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->next, *bucket, __ATOMIC_RELEASE);
+    __atomic_store_n(bucket, index, __ATOMIC_RELEASE);
+    table->count++;
+    return slot;
+}
+
+// Amb el semàfor agafat: desenllaça la ranura (ja marcada lliure) i la torna a la llista lliure
+static void treureEntrada(DistortionTable *table, uint32_t index) {
+    DistortionSlot *slot = &table->slots[index - 1];
+    uint32_t *link = &table->buckets[slot->hash & BUCKET_MASK];
+
+    while (*link != 0 && *link != index) {
+        link = &table->slots[*link - 1].next;
+    }
+    if (*link == index) {
+        __atomic_store_n(link, slot->next, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&slot->next, table->freeHead, __ATOMIC_RELEASE);
+    table->freeHead = index;
+    table->count--;
+}
+
+// Busca una recepció PENDING del mateix arxiu i contingut (de qualsevol usuari)
+static int buscarPendent(DistortionTable *table, uint32_t hash, const char *fileName, const char *md5Sum, DistortionRecord *record) {
+    DistortionSlot copy;
+    uint32_t index = __atomic_load_n(&table->buckets[hash & BUCKET_MASK], __ATOMIC_ACQUIRE);
+
+    for (int steps = 0; index != 0 && steps < DISTORTION_TABLE_CAPACITY; steps++) {
+        llegirRanura(&table->slots[index - 1], &copy);
+        if (copy.inUse && copy.hash == hash && copy.record.status == STATUS_PENDING &&
+            strcmp(copy.record.fileName, fileName) == 0 && strcmp(copy.record.md5Sum, md5Sum) == 0) {
+            *record = copy.record;
+            return 0;
+        }
+        index = copy.next;
+    }
+    return -1;
+}
+
+// Crea (o s'hi connecta) el segment i el semàfor d'aquest tipus de worker
+int distortion_table_attach(SharedMemory *sm, key_t key) {
+    if (!sm) return -1;
+
+    sm->shmid = shmget(key, sizeof(DistortionTable), IPC_CREAT | 0666);
+    if (sm->shmid < 0) {
+        perror("Error creando memoria compartida");
+        return -1;
+    }
+
+    sm->shmaddr = shmat(sm->shmid, NULL, 0);
+    if (sm->shmaddr == (void *)-1) {
+        perror("Error asociando memoria compartida");
+        return -1;
+    }
+
+    if (SEM_constructor_with_name(&sm->sem, key) < 0) {
+        perror("Error creando semáforo");
+        return -1;
+    }
+    if (SEM_init(&sm->sem, 1) < 0) {
+        perror("Error inicializando semáforo");
+        return -1;
+    }
+
+    DistortionTable *table = taula(sm);
+    lock_shared_memory(sm);
+    if (table->capacity == 0) {
+        table->capacity = DISTORTION_TABLE_CAPACITY;
+    }
+    uint32_t capacity = table->capacity;
+    unlock_shared_memory(sm);
+
+    if (capacity != DISTORTION_TABLE_CAPACITY) {
+        customPrintf("[ERROR] ❌ La memoria compartida tiene otro formato (capacidad %u).\n", capacity);
+        return -1;
+    }
+    return 0;
+}
+
+// Guarda l'estat d'una distorsió, afegint-la si encara no hi és
+int distortion_table_save(SharedMemory *sm, const char *fileName, const char *userName, size_t currentByte,
+                          int factor, const char *md5Sum, int fleckSocketFD, int status) {
+    DistortionTable *table = taula(sm);
+    if (!table) {
+        customPrintf("[ERROR] ❌ Memoria compartida no inicializada antes de guardar estado.\n");
+        return -1;
+    }
+
+    uint32_t hash = hashNom(fileName);
+    DistortionSlot *slot = bloquejarEntrada(table, hash, fileName, userName);
+    if (!slot) {
+        lock_shared_memory(sm);
+        slot = bloquejarEntrada(table, hash, fileName, userName);
+        if (!slot) {
+            slot = afegirEntrada(table, hash, fileName, userName);
+        }
+        unlock_shared_memory(sm);
+    }
+    if (!slot) {
+        customPrintf("[ERROR] ❌ No se pueden agregar más distorsiones, memoria llena.\n");
+        return -1;
+    }
+
+    slot->record.currentByte = currentByte;
+    slot->record.factor = factor;
+    snprintf(slot->record.md5Sum, sizeof(slot->record.md5Sum), "%s", md5Sum);
+    slot->record.fleckSocketFD = fleckSocketFD;
+    slot->record.status = status;
+    if (currentByte == 0) {
+        md5_init(&slot->record.hashState); // Nova recepció des del principi
+    }
+    desbloquejarRanura(slot);
+    return 0;
+}
+
+// Actualitza la posició de recepció i l'MD5 parcial d'una distorsió ja registrada (sense el semàfor)
+int distortion_table_save_progress(SharedMemory *sm, const char *fileName, const char *userName,
+                                   size_t currentByte, const Md5Context *hashState) {
+    DistortionTable *table = taula(sm);
+    if (!table || !hashState) {
+        customPrintf("[ERROR] ❌ Memoria compartida no inicializada antes de guardar estado.\n");
+        return -1;
+    }
+
+    uint32_t hash = hashNom(fileName);
+    DistortionSlot *slot = bloquejarEntrada(table, hash, fileName, userName);
+    if (!slot) {
+        lock_shared_memory(sm);
+        slot = bloquejarEntrada(table, hash, fileName, userName);
+        unlock_shared_memory(sm);
+    }
+    if (!slot) {
+        return -1;
+    }
+
+    slot->record.currentByte = currentByte;
+    slot->record.hashState = *hashState;
+    desbloquejarRanura(slot);
+    return 0;
+}
+
+int distortion_table_find_pending(SharedMemory *sm, const char *fileName, const char *md5Sum, DistortionRecord *record) {
+    DistortionTable *table = taula(sm);
+    if (!table || !fileName || !md5Sum || !record) {
+        return -1;
+    }
+
+    uint32_t hash = hashNom(fileName);
+    if (buscarPendent(table, hash, fileName, md5Sum, record) == 0) {
+        return 0;
+    }
+
+    lock_shared_memory(sm);
+    int result = buscarPendent(table, hash, fileName, md5Sum, record);
+    unlock_shared_memory(sm);
+    return result;
+}
+
+// Primera distorsió PENDING que accept (el worker) es queda, copiada a record
+int distortion_table_claim_pending(SharedMemory *sm, int (*accept)(const DistortionRecord *record, void *arg), void *arg,
+                                    DistortionRecord *record) {
+    DistortionTable *table = taula(sm);
+    if (!table || !accept || !record) {
+        return -1;
+    }
+
+    DistortionSlot copy;
+    uint32_t used = __atomic_load_n(&table->unused, __ATOMIC_ACQUIRE);
+
+    for (uint32_t i = 0; i < used && i < DISTORTION_TABLE_CAPACITY; i++) {
+        llegirRanura(&table->slots[i], &copy);
+        if (copy.inUse && copy.record.status == STATUS_PENDING && accept(&copy.record, arg)) {
+            *record = copy.record;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Copia totes les distorsions registrades (com a molt DISTORTION_TABLE_CAPACITY)
+int distortion_table_load(SharedMemory *sm, DistortionRecord *records, int *count) {
+    DistortionTable *table = taula(sm);
+    if (!table) {
+        customPrintf("[ERROR] Memoria compartida no inicializada antes de recuperar estado.\n");
+        return -1;
+    }
+
+    DistortionSlot copy;
+    uint32_t used = __atomic_load_n(&table->unused, __ATOMIC_ACQUIRE);
+
+    *count = 0;
+    for (uint32_t i = 0; i < used && i < DISTORTION_TABLE_CAPACITY; i++) {
+        llegirRanura(&table->slots[i], &copy);
+        if (copy.inUse && (copy.record.status == STATUS_PENDING || copy.record.status == STATUS_IN_PROGRESS ||
+                           copy.record.status == STATUS_DONE)) {
+            records[(*count)++] = copy.record;
+        }
+    }
+    return (*count > 0) ? 0 : -1;
+}
+
+// Allibera les ranures de les distorsions acabades (STATUS_DONE): tornen a la llista lliure
+int distortion_table_remove_done(SharedMemory *sm) {
+    DistortionTable *table = taula(sm);
+    if (!table) {
+        customPrintf("[ERROR] ❌ Memoria compartida no inicializada antes de eliminar distorsiones completadas.\n");
+        return -1;
+    }
+
+    lock_shared_memory(sm);
+    for (uint32_t i = 0; i < table->unused; i++) {
+        DistortionSlot *slot = &table->slots[i];
+        bloquejarRanura(slot);
+        int done = slot->inUse && slot->record.status == STATUS_DONE;
+        if (done) {
+            slot->inUse = 0;
+        }
+        desbloquejarRanura(slot);
+        if (done) {
+            treureEntrada(table, i + 1);
+        }
+    }
+    unlock_shared_memory(sm);
+    return 0;
+}
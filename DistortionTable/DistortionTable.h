@@ -0,0 +1,67 @@
+#ifndef DISTORTION_TABLE_H
+#define DISTORTION_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../MD5SUM/md5Sum.h"
+#include "../Shared_Memory/Shared_memory.h"
+
+// Distorsions que es poden registrar a la memòria compartida d'un tipus de worker
+#ifndef DISTORTION_TABLE_CAPACITY
+#define DISTORTION_TABLE_CAPACITY 256
+#endif
+
+#define DISTORTION_TABLE_BUCKETS 512  // Potència de 2, com a mínim el doble de la capacitat
+
+#define STATUS_PENDING 1
+#define STATUS_IN_PROGRESS 2
+#define STATUS_DONE 3
+
+// Estat d'una distorsió tal com el veuen els workers (Enigma deixa userName buit)
+typedef struct {
+    char userName[64];
+    char fileName[256];   // Nombre del archivo en proceso
+    char md5Sum[33];      // MD5 del archivo en proceso
+    size_t currentByte;   // Posición actual del archivo
+    int factor;           // Factor de compresión
+    int fleckSocketFD;    // Socket del fleck que envia la distorsió
+    int status;           // Estado de la distorsión (1 -> PENDING, 2 -> IN PROGRESS, 3 -> DONE)
+    Md5Context hashState; // MD5 parcial dels bytes rebuts (vàlid si hashState.length == currentByte)
+} DistortionRecord;
+
+// Ranura de la taula. seq és un seqlock: senar mentre algú l'escriu; els lectors copien i
+// tornen a llegir si ha canviat. Així el progrés s'actualitza sense el semàfor de la taula.
+// writer és el pid de qui l'escriu: si el procés mor a mitja escriptura, un altre se la queda.
+typedef struct {
+    uint32_t seq;
+    int32_t writer;       // 0 = lliure
+    uint32_t next;        // Següent ranura de la cubeta o de la llista lliure (índex + 1, 0 = final)
+    uint32_t hash;        // Hash del nom de l'arxiu
+    uint32_t inUse;
+    DistortionRecord record;
+} DistortionSlot;
+
+// Taula de la memòria compartida. Un segment nou és tot zeros, que ja és una taula buida.
+// El semàfor només protegeix els canvis d'estructura (afegir i treure ranures).
+typedef struct {
+    uint32_t capacity;    // 0 fins que s'hi connecta el primer procés
+    uint32_t count;
+    uint32_t freeHead;    // Ranures alliberades (índex + 1)
+    uint32_t unused;      // Ranures que encara no s'han fet servir mai
+    uint32_t buckets[DISTORTION_TABLE_BUCKETS];
+    DistortionSlot slots[DISTORTION_TABLE_CAPACITY];
+} DistortionTable;
+
+int distortion_table_attach(SharedMemory *sm, key_t key);
+int distortion_table_save(SharedMemory *sm, const char *fileName, const char *userName, size_t currentByte,
+                          int factor, const char *md5Sum, int fleckSocketFD, int status);
+int distortion_table_save_progress(SharedMemory *sm, const char *fileName, const char *userName,
+                                   size_t currentByte, const Md5Context *hashState);
+int distortion_table_find_pending(SharedMemory *sm, const char *fileName, const char *md5Sum, DistortionRecord *record);
+int distortion_table_claim_pending(SharedMemory *sm, int (*accept)(const DistortionRecord *record, void *arg), void *arg,
+                                    DistortionRecord *record);
+int distortion_table_load(SharedMemory *sm, DistortionRecord *records, int *count);
+int distortion_table_remove_done(SharedMemory *sm);
+
+#endif
@@ -19,23 +19,31 @@
 #include "DataConversion/DataConversion.h"
 #include "FrameUtils/FrameUtils.h"
 #include "FrameUtilsBinary/FrameUtilsBinary.h"
+#include "FlowControl/FlowControl.h"
+#include "WorkerLoad/WorkerLoad.h"
+#include "TimerWheel/TimerWheel.h"
 #include "Logging/Logging.h"
 #include "MD5SUM/md5Sum.h"
 #include "File_transfer/file_transfer.h"
 #include "Compression/so_compression.h"
 #include "EnigmaCompress/EnigmaCompress.h"
 #include "EnigmaSync/EnigmaSync.h"
+#include "WorkerJobs/WorkerJobs.h"
+#include "ResultCache/ResultCache.h"
 
 #define ENIGMA_PATH_FILES "enigma_directory/"
 #define ENIGMA_TYPE "TEXT"
 
 void *handleFleckFrames(void *arg);
 void processReceivedFrame(int gothamSocket, const Frame *response);
-void processBinaryFrameFromFleck(BinaryFrame *binaryFrame, size_t expectedFileSize, size_t *currentFileSize, int clientSocket);
-void enviaTramaArxiuDistorsionat(int clientSocket, const char *fileSizeCompressed, const char *compressedMD5, const char *compressedFilePath, size_t offset);
+// data == NULL: la DATA (còpia zero) encara és al lector/socket i es mou directament al fitxer
+void processBinaryFrameFromFleck(WorkerJob *job, const char *data, size_t dataLength, FrameReader *reader);
+// job == NULL: reenviament d'una distorsió recuperada sense connexió de Fleck associada
+void enviaTramaArxiuDistorsionat(WorkerJob *job, int clientSocket, const char *fileName, const char *factor, const char *originalMD5, const char *fileSizeCompressed, const char *compressedMD5, const char *compressedFilePath, size_t offset, uint32_t bulkChunkSize, uint32_t creditWindow, uint32_t zeroCopy);
 void send_frame_with_error(int clientSocket, const char *errorMessage);
-void send_frame_with_ok(int clientSocket);
+void send_frame_with_ok(int clientSocket, const char *acceptedOptions);
 void sendMD5Response(int clientSocket, const char *status);
+static void completarRecepcio(WorkerJob *job);
 
 EnigmaConfig *globalenigmaConfig = NULL;
 SharedMemory harleySharedMemory; //LINKEDLIST PER TENIR ARRAY AMB DESCÀRREGUES
@@ -44,9 +52,12 @@ SharedMemory harleySharedMemory; //LINKEDLIST PER TENIR ARRAY AMB DESCÀRREGUES
 int gothamSocket = -1;
 float resultStatus;
 
-int lastFleckSocket = -1;
+WorkerJobTable enigmaJobs; // Distorsions en curs, una per connexió de Fleck
+ResultCache enigmaCache;   // Textos ja distorsionats, per (MD5, factor, tipus)
 
 volatile sig_atomic_t stop = 0;
+volatile sig_atomic_t sigintRebut = 0; // El posa signalHandler; el fil principal fa el tancament
+static int fleckListenSocket = -1;     // Socket d'escolta de Fleck (el senyal el talla per despertar l'accept)
 
 // Variable para almacenar el último tiempo de recepción del HEARTBEAT
 volatile time_t lastHeartbeat = 0;
@@ -70,12 +81,35 @@ typedef struct {
     off_t fileSize;
     char *compressedPath; // Ruta del archivo comprimido
     size_t offset; //Byte per continuar l'enviament
+    uint32_t bulkChunkSize; // 0 = trames 0x05 de 247 bytes
+    uint32_t creditWindow;  // 0 = sense crèdits (espaiat fix per a Flecks antics)
+    uint32_t zeroCopy;      // 1 = DATA enviada amb sendfile(2)
+    WorkerJob *job;         // Feina de la connexió (amb referència pròpia) o NULL
+    char fileName[256];
+    char originalMD5[33];
+    char factor[20];
 } SendCompressedFileArgs;
 
-char receivedFileName[256] = {0}; // Nombre del archivo recibido
-int tempFileDescriptor = -1;      // Descriptor del archivo temporal
-char expectedMD5[33];
-char receivedFactor[20];
+// Distorsió en mode STREAM: el fil de recepció filtra cada trama 0x05 cap a l'arxiu de sortida
+// i el fil d'enviament la retorna a Fleck a mesura que creix. Els dos fils en tenen una referència.
+typedef struct {
+    TextFilterStream filter;
+    int outputFd;
+    int sourceFd;                 // Còpia sense nom del text rebut, per a la memòria cau (-1: no se'n fa)
+    off_t produced;               // Bytes filtrats disponibles a l'arxiu de sortida
+    int finished;                 // Entrada completa: verdict ja té el resultat de l'MD5
+    int failed;                   // Connexió perduda o error del filtre
+    char verdict[16];             // CHECK_OK / CHECK_KO de l'arxiu rebut
+    int refs;
+    pthread_mutex_t mutex;
+    pthread_cond_t progress;
+    pthread_mutex_t sendMutex;    // Escriptures al socket de Fleck des dels dos fils (crèdits i dades)
+} EnigmaStream;
+
+typedef struct {
+    WorkerJob *job;
+    EnigmaStream *stream;
+} StreamSendArgs;
 
 void sendDisconnectFrameToGotham(const char *mediaType)
 {
@@ -102,60 +136,65 @@ void sendDisconnectFrameToGotham(const char *mediaType)
     }
 }
 
-// Función para manejar señales como SIGINT
+// SIGINT: dins del senyal només es marca el tancament i es desperta el fil principal, que fa tancarEnigma
 void signalHandler(int sig) {
-    static int already_exiting = 0; // Variable estática para evitar múltiples señales
-
-    if (sig == SIGINT) {
-        if (already_exiting) {
-            return; // Si ya se está ejecutando, ignorar la segunda señal
-        }
-        already_exiting = 1;
-
-        if (lastFleckSocket >= 0) {
-            shutdown(lastFleckSocket, SHUT_RDWR); // Cierra lectura y escritura
-            close(lastFleckSocket);
-            lastFleckSocket = -1;
-        }
-        
-        stop = 1;
+    if (sig != SIGINT || sigintRebut) {
+        return; // Si ya se está cerrando, ignorar la segunda señal
+    }
+    sigintRebut = 1;
+    worker_jobs_request_stop(&enigmaJobs); // worker_jobs_acquire deixa d'esperar plaça
+    if (fleckListenSocket >= 0) {
+        shutdown(fleckListenSocket, SHUT_RDWR); // L'accept del fil principal torna amb error
+    }
+}
 
-        sendDisconnectFrameToGotham(ENIGMA_TYPE);
+// Tancament ordenat des del fil principal (aquí ja es pot imprimir i agafar mutex)
+static void tancarEnigma(void) {
+    ResultCacheStats cacheStats;
+    result_cache_get_stats(&enigmaCache, &cacheStats);
+    customPrintf("\nCaché de resultats: %llu encerts, %llu fallades, %d entrades (%llu bytes), %llu desallotjades, %llu pujades estalviades.\n",
+                 (unsigned long long)cacheStats.hits, (unsigned long long)cacheStats.misses, cacheStats.entries,
+                 (unsigned long long)cacheStats.bytes, (unsigned long long)cacheStats.evictions,
+                 (unsigned long long)cacheStats.sourceHits);
+
+    // Talla les connexions de Fleck en curs (lectura i escriptura) i, quan els fils les han deixat,
+    // tanca els arxius que s'estaven rebent
+    if (worker_jobs_wait_idle(&enigmaJobs, WORKER_JOBS_STOP_TIMEOUT_MS) != 0) {
+        logWarning("[WARNING]: Alguna distorsión no ha terminado a tiempo; se cierra igualmente.");
+    }
+    worker_jobs_close_all(&enigmaJobs);
+    
+    stop = 1;
 
-        if (gothamSocket > 0) {
-            close(gothamSocket);
-            gothamSocket = -1;
-        }
+    sendDisconnectFrameToGotham(ENIGMA_TYPE);
 
-        if (tempFileDescriptor >= 0) {
-            close(tempFileDescriptor);
-            tempFileDescriptor = -1;
-        }
+    if (gothamSocket > 0) {
+        close(gothamSocket);
+        gothamSocket = -1;
+    }
 
-        if (globalenigmaConfig) {
-            free(globalenigmaConfig->workerType);
-            free(globalenigmaConfig->ipFleck);
-            free(globalenigmaConfig->ipGotham);
-            free(globalenigmaConfig);
-            globalenigmaConfig = NULL;
-        }
+    if (globalenigmaConfig) {
+        free(globalenigmaConfig->workerType);
+        free(globalenigmaConfig->ipFleck);
+        free(globalenigmaConfig->ipGotham);
+        free(globalenigmaConfig);
+        globalenigmaConfig = NULL;
+    }
 
-        // Cerrar todos los descriptores de archivo abiertos
-        //int maxFD = getdtablesize(); 
-        //for (int fd = 3; fd < maxFD; fd++) {
-           //close(fd);
-        //}
-        
-         //Alliberar memoria compartida
-         if (harleySharedMemory.shmaddr != (void*) -1) {
-            shmdt(harleySharedMemory.shmaddr); //Desconecta el segmento de memoria compartida ubicado en la dirección especificada del espacio de direcciones del proceso que realiza la llamada
-            shmctl(harleySharedMemory.shmid, IPC_RMID, NULL); //Destruye realmente la zona de memoria compartida
-        }
+    // Cerrar todos los descriptores de archivo abiertos
+    //int maxFD = getdtablesize(); 
+    //for (int fd = 3; fd < maxFD; fd++) {
+       //close(fd);
+    //}
+    
+     //Alliberar memoria compartida
+     if (harleySharedMemory.shmaddr != (void*) -1) {
+        shmdt(harleySharedMemory.shmaddr); //Desconecta el segmento de memoria compartida ubicado en la dirección especificada del espacio de direcciones del proceso que realiza la llamada
+        shmctl(harleySharedMemory.shmid, IPC_RMID, NULL); //Destruye realmente la zona de memoria compartida
+    }
 
-        if (harleySharedMemory.sem.shmid >= 0) {
-            SEM_destructor(&(harleySharedMemory.sem));
-        }      
-        exit(0);
+    if (harleySharedMemory.sem.shmid >= 0) {
+        SEM_destructor(&(harleySharedMemory.sem));
     }
 }
 
@@ -182,166 +221,665 @@ void *handleGothamFrames(void *arg)
     pthread_exit(NULL);
 }
 
-void *handleFleckFrames(void *arg){
-    int clientSocket = *(int *)arg;
-    free(arg);
+// Obre l'arxiu de recepció i retorna els bytes que ja en tenim (HAVE), o -1.
+// Amb offerHave es reaprofita l'original desat a la memòria cau o una recepció interrompuda del mateix contingut;
+// si no, l'arxiu es comença de zero (abans s'hi afegia al final d'un arxiu anterior amb el mateix nom).
+static off_t prepararRecepcio(WorkerJob *job, const char *filePath, int offerHave) {
+    off_t have = 0;
+    int fromSource = 0;
+    size_t progress = 0;
+    Md5Context hashState;
+    md5_init(&hashState);
+
+    if (offerHave) {
+        char sourceMD5[33];
+        off_t sourceSize = 0;
+        if (result_cache_lookup(&enigmaCache, job->expectedMD5, RESULT_CACHE_SOURCE, result_cache_type(job->fileName),
+                                filePath, sourceMD5, &sourceSize) == 0 && (size_t)sourceSize == job->expectedFileSize) {
+            have = sourceSize;
+            fromSource = 1;
+        } else if (find_enigma_receive_progress(&harleySharedMemory, job->fileName, job->expectedMD5, &progress, &hashState) == 0 &&
+                   progress <= job->expectedFileSize) {
+            have = (off_t)progress;
+        }
+    }
 
-    size_t expectedFileSize = 0;   // Tamaño esperado del archivo (de la trama 0x03)
-    size_t currentFileSize = 0;    // Tamaño recibido hasta el momento
+    // Sense O_APPEND: splice(2) no hi pot escriure. S'escriu a partir de 'have'.
+    job->tempFileDescriptor = open(filePath, O_RDWR | O_CREAT | (have == 0 ? O_TRUNC : 0), 0666);
+    if (job->tempFileDescriptor < 0) {
+        return -1;
+    }
 
-    //Buscar si hi ha distorsions pending
-    EnigmaDistortionEntry recoveredDistortion;
-    EnigmaDistortionState *state = (EnigmaDistortionState *) harleySharedMemory.shmaddr;
-    int found = 0;
+    struct stat st;
+    if (have > 0 && (fstat(job->tempFileDescriptor, &st) != 0 || st.st_size < have)) {
+        have = 0; // L'arxiu ja no conserva els bytes anotats: es rep sencer
+        fromSource = 0;
+    }
+    // Descarta el que s'hagués escrit després de l'últim progrés anotat
+    if (ftruncate(job->tempFileDescriptor, have) != 0 || lseek(job->tempFileDescriptor, have, SEEK_SET) < 0) {
+        close(job->tempFileDescriptor);
+        job->tempFileDescriptor = -1;
+        return -1;
+    }
+
+    md5_init(&job->receivedHash);
+    if (fromSource) {
+        job->receivedHashValid = 0; // La còpia es comprova rellegint-la
+    } else if (hashState.length == (uint64_t)have) {
+        job->receivedHash = hashState;
+        job->receivedHashValid = 1;
+    } else {
+        job->receivedHashValid = md5_update_fd_range(&job->receivedHash, job->tempFileDescriptor, 0, (size_t)have) == 0;
+    }
+    job->currentFileSize = (size_t)have;
+    return have;
+}
+
+// Trama 0x03 amb el resultat a la memòria cau: es respon amb CACHE=1 i s'envia sense esperar l'arxiu
+static int servirDesDeCache(WorkerJob *job, TransferOptions *options) {
+    char *finalFilePath;
+    if (asprintf(&finalFilePath, "%s%s", ENIGMA_PATH_FILES, job->fileName) == -1) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
+        return -1;
+    }
+
+    char resultMD5[33] = {0};
+    off_t resultSize = 0;
+    if (result_cache_lookup(&enigmaCache, job->expectedMD5, atoi(job->factor), result_cache_type(job->fileName),
+                            finalFilePath, resultMD5, &resultSize) != 0) {
+        free(finalFilePath);
+        return -1;
+    }
+
+    char acceptedOptions[TRANSFER_OPTIONS_SIZE];
+    options->stream = 0;
+    format_transfer_options(options, acceptedOptions, sizeof(acceptedOptions));
+    job->bulkChunkSize = options->bulkChunkSize;
+    job->creditWindow = options->creditWindow;
+    job->zeroCopy = options->bulkChunkSize > 0 ? options->zeroCopy : 0;
+    send_frame_with_ok(job->clientSocket, acceptedOptions);
+    customPrintf("[INFO]: Resultado en caché: se envía sin recibir el archivo.\n");
+
+    char fileSizeStr[20];
+    snprintf(fileSizeStr, sizeof(fileSizeStr), "%lld", (long long)resultSize);
+    save_enigma_distortion_state(&harleySharedMemory, job->fileName, 0, atoi(job->factor), resultMD5, job->clientSocket, STATUS_DONE);
+    enviaTramaArxiuDistorsionat(job, job->clientSocket, job->fileName, job->factor, job->expectedMD5, fileSizeStr, resultMD5,
+                                finalFilePath, 0, job->bulkChunkSize, job->creditWindow, job->zeroCopy);
+    free(finalFilePath);
+    return 0;
+}
+
+// Deixa l'estat del mode STREAM; l'últim fil l'allibera
+static void alliberarStream(EnigmaStream *stream) {
+    pthread_mutex_lock(&stream->mutex);
+    int refs = --stream->refs;
+    pthread_mutex_unlock(&stream->mutex);
+    if (refs > 0) {
+        return;
+    }
+
+    text_stream_destroy(&stream->filter);
+    close(stream->outputFd);
+    if (stream->sourceFd >= 0) {
+        close(stream->sourceFd);
+    }
+    pthread_mutex_destroy(&stream->mutex);
+    pthread_cond_destroy(&stream->progress);
+    pthread_mutex_destroy(&stream->sendMutex);
+    free(stream);
+}
+
+// Publica la sortida nova per al fil d'enviament
+static void avisarStream(EnigmaStream *stream, int finished, int failed, const char *verdict) {
+    pthread_mutex_lock(&stream->mutex);
+    stream->produced = (off_t)stream->filter.total;
+    if (failed) {
+        stream->failed = 1;
+    }
+    if (finished) {
+        stream->finished = 1;
+        snprintf(stream->verdict, sizeof(stream->verdict), "%s", verdict);
+    }
+    pthread_cond_broadcast(&stream->progress);
+    pthread_mutex_unlock(&stream->mutex);
+}
+
+// La recepció s'ha acabat (o tallat): el fil d'enviament ja no rebrà més sortida
+static void tancarStreamRecepcio(WorkerJob *job) {
+    EnigmaStream *stream = (EnigmaStream *)job->stream;
+    if (!stream) {
+        return;
+    }
+
+    pthread_mutex_lock(&stream->mutex);
+    if (!stream->finished) {
+        stream->failed = 1;
+        pthread_cond_broadcast(&stream->progress);
+    }
+    pthread_mutex_unlock(&stream->mutex);
+    job->stream = NULL;
+    alliberarStream(stream);
+}
+
+static void enviarCreditsAFleck(WorkerJob *job, int credits) {
+    EnigmaStream *stream = (EnigmaStream *)job->stream;
+    if (stream) {
+        pthread_mutex_lock(&stream->sendMutex);
+    }
+    enviarTramaCredit(job->clientSocket, credits);
+    if (stream) {
+        pthread_mutex_unlock(&stream->sendMutex);
+    }
+}
+
+static int enviarFinalStream(int clientSocket, off_t size, const char *md5) {
+    Frame frame = {0};
+    frame.type = FRAME_STREAM_END_TYPE;
+    snprintf(frame.data, sizeof(frame.data), "%lld&%s", (long long)size, md5);
+    frame.data_length = strlen(frame.data);
+    frame.timestamp = (uint32_t)time(NULL);
+    frame.checksum = calculate_checksum(frame.data, frame.data_length, 1);
+
+    return escribirTrama(clientSocket, &frame) < 0 ? -1 : 0;
+}
+
+// Fil d'enviament del mode STREAM: retorna la sortida del filtre a mesura que es produeix.
+// En acabar l'entrada envia el veredicte (0x06) i, si és correcte, la mida i l'MD5 del resultat (0x16).
+static void *enviarSortidaStream(void *arg) {
+    StreamSendArgs *sendArgs = (StreamSendArgs *)arg;
+    WorkerJob *job = sendArgs->job;
+    EnigmaStream *stream = sendArgs->stream;
+    free(sendArgs);
+
+    int clientSocket = job->clientSocket;
+    size_t chunkSize = job->bulkChunkSize > 0 ? job->bulkChunkSize : DATA_BINARY_MAX_SIZE;
+    char *buffer = malloc(chunkSize);
+    if (!buffer) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para el buffer de envío.");
+        alliberarStream(stream);
+        worker_job_release(&enigmaJobs, job);
+        return NULL;
+    }
+
+    Md5Context outputHash;
+    md5_init(&outputHash);
+    off_t sent = 0;
+    int completed = 0;
+    char verdict[16] = {0};
+
+    while (1) {
+        // Trames plenes mentre arriba l'entrada; la resta quan ja és completa
+        pthread_mutex_lock(&stream->mutex);
+        while (!stream->finished && !stream->failed && stream->produced - sent < (off_t)chunkSize) {
+            pthread_cond_wait(&stream->progress, &stream->mutex);
+        }
+        off_t available = stream->produced - sent;
+        int finished = stream->finished;
+        int failed = stream->failed;
+        snprintf(verdict, sizeof(verdict), "%s", stream->verdict);
+        pthread_mutex_unlock(&stream->mutex);
+
+        if (failed) {
+            customPrintf("[ERROR]: Distorsión en streaming interrumpida.");
+            break;
+        }
+        if (available == 0 && finished) {
+            completed = 1;
+            break;
+        }
+
+        size_t length = available < (off_t)chunkSize ? (size_t)available : chunkSize;
+        if (job->creditWindow > 0 && flow_control_acquire(&job->downloadFlow) != 0) {
+            customPrintf("[ERROR]: Fleck no ha concedit crèdits per continuar l'enviament.");
+            break;
+        }
 
-    for (int i = 0; i < state->count; i++) {
-        if (state->distortions[i].status == STATUS_PENDING) {
-            recoveredDistortion = state->distortions[i];
-            found = 1;
+        ssize_t bytesRead = pread(stream->outputFd, buffer, length, sent);
+        if (bytesRead != (ssize_t)length) {
+            customPrintf("[ERROR]: Fallo al leer la salida del filtro.");
+            break;
+        }
+        md5_update(&outputHash, buffer, length);
+
+        int bytesSent;
+        pthread_mutex_lock(&stream->sendMutex);
+        if (job->bulkChunkSize > 0) {
+            bytesSent = escribirTramaBulk(clientSocket, buffer, (uint32_t)length);
+        } else {
+            BinaryFrame frame = {0};
+            frame.type = 0x05;
+            frame.data_length = length;
+            memcpy(frame.data, buffer, length);
+            frame.timestamp = (uint32_t)time(NULL);
+            frame.checksum = calculate_checksum_binary(frame.data, frame.data_length, 1);
+            bytesSent = escribirTramaBinaria(clientSocket, &frame);
+        }
+        pthread_mutex_unlock(&stream->sendMutex);
+
+        if (bytesSent < 0) {
+            customPrintf("[ERROR]: Fallo al enviar trama 0x05.");
             break;
         }
+        sent += length;
     }
+    free(buffer);
+
+    if (completed) {
+        char outputMD5[33] = {0};
+        md5_final_hex(&outputHash, outputMD5);
+
+        pthread_mutex_lock(&stream->sendMutex);
+        sendMD5Response(clientSocket, verdict);
+        if (strcmp(verdict, "CHECK_OK") == 0 && enviarFinalStream(clientSocket, sent, outputMD5) == 0) {
+            customPrintf("[SUCCESS]: Distorsión en streaming enviada (%lld bytes, md5 %s).\n", (long long)sent, outputMD5);
+        }
+        pthread_mutex_unlock(&stream->sendMutex);
+
+        char *outputPath;
+        if (strcmp(verdict, "CHECK_OK") == 0 && asprintf(&outputPath, "%s%s", ENIGMA_PATH_FILES, job->fileName) != -1) {
+            result_cache_store(&enigmaCache, job->expectedMD5, atoi(job->factor), result_cache_type(job->fileName), outputPath, outputMD5);
+            free(outputPath);
+        }
+    }
+
+    alliberarStream(stream);
+    worker_job_release(&enigmaJobs, job);
+    return NULL;
+}
+
+// Mode STREAM: el text filtrat va a ENIGMA_PATH_FILES i un altre fil el retorna a Fleck mentre es rep
+static int iniciarStream(WorkerJob *job) {
+    char *outputPath;
+    if (asprintf(&outputPath, "%s%s", ENIGMA_PATH_FILES, job->fileName) == -1) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
+        return -1;
+    }
+
+    EnigmaStream *stream = calloc(1, sizeof(EnigmaStream));
+    if (!stream) {
+        customPrintf("[ERROR]: Fallo de memoria.");
+        free(outputPath);
+        return -1;
+    }
+
+    stream->outputFd = open(outputPath, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    free(outputPath);
+    if (stream->outputFd < 0) {
+        customPrintf("[ERROR]: No se pudo crear el archivo de salida.");
+        free(stream);
+        return -1;
+    }
+
+    if (text_stream_init(&stream->filter, atoi(job->factor), stream->outputFd) != 0) {
+        close(stream->outputFd);
+        free(stream);
+        return -1;
+    }
+
+    // L'original no passa pel disc: se'n guarda una còpia perquè una altra distorsió no l'hagi de tornar a pujar
+    stream->sourceFd = enigmaCache.maxBytes > 0 ? open(ENIGMA_PATH_FILES, O_TMPFILE | O_RDWR, 0600) : -1;
+
+    stream->refs = 1;
+    pthread_mutex_init(&stream->mutex, NULL);
+    pthread_cond_init(&stream->progress, NULL);
+    pthread_mutex_init(&stream->sendMutex, NULL);
+    job->stream = stream;
+    return 0;
+}
+
+// Engega el fil d'enviament un cop Fleck ja té la resposta a la trama 0x03
+static int engegarEnviamentStream(WorkerJob *job) {
+    EnigmaStream *stream = (EnigmaStream *)job->stream;
+
+    StreamSendArgs *args = malloc(sizeof(StreamSendArgs));
+    if (!args) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para los argumentos del hilo de envío.");
+        return -1;
+    }
+    args->job = job;
+    args->stream = stream;
+
+    flow_control_reset(&job->downloadFlow, job->creditWindow);
+    pthread_mutex_lock(&stream->mutex);
+    stream->refs++;
+    pthread_mutex_unlock(&stream->mutex);
+    worker_job_retain(&enigmaJobs, job); // El fil d'enviament manté viva la connexió
+
+    pthread_t sendThread;
+    if (pthread_create(&sendThread, NULL, enviarSortidaStream, args) != 0) {
+        customPrintf("[ERROR]: No se pudo crear el hilo para enviar el archivo comprimido.");
+        free(args);
+        alliberarStream(stream);
+        worker_job_release(&enigmaJobs, job);
+        return -1;
+    }
+    pthread_detach(sendThread);
+    return 0;
+}
+
+// Trama 0x05 en mode STREAM: MD5 incremental i filtre directament sobre la DATA rebuda
+static void processarTramaStream(WorkerJob *job, const char *data, size_t dataLength) {
+    EnigmaStream *stream = (EnigmaStream *)job->stream;
+
+    if (job->currentFileSize >= job->expectedFileSize) {
+        logWarning("[WARNING]: Trama de datos recibida después del final del archivo.");
+        return;
+    }
+    if (!data) {
+        customPrintf("[ERROR]: Trama de còpia zero no admesa en mode STREAM.");
+        avisarStream(stream, 0, 1, NULL);
+        return;
+    }
+
+    if (!job->distortionLogged) {
+        customPrintf("Distorting...\n");
+        job->distortionLogged = 1;
+    }
+
+    md5_update(&job->receivedHash, data, dataLength);
+    job->currentFileSize += dataLength;
+    if (stream->sourceFd >= 0 && write_full(stream->sourceFd, data, dataLength) != 0) {
+        close(stream->sourceFd); // Sense còpia de l'original; la distorsió continua igualment
+        stream->sourceFd = -1;
+    }
+
+    int result = text_stream_feed(&stream->filter, data, dataLength);
+    if (job->currentFileSize < job->expectedFileSize) {
+        avisarStream(stream, 0, result != 0, NULL);
+        return;
+    }
+
+    customPrintf("\nARCHIVO COMPLETO RECIBIDO DE FLECK\n");
+    if (result == 0) {
+        result = text_stream_finish(&stream->filter);
+    }
+
+    char calculatedMD5[33] = {0};
+    md5_final_hex(&job->receivedHash, calculatedMD5);
+    int valid = job->currentFileSize == job->expectedFileSize && strcmp(job->expectedMD5, calculatedMD5) == 0;
+    if (!valid) {
+        customPrintf("[ERROR]: El MD5 no coincide. Archivo recibido está corrupto.");
+    }
+    job->distortionLogged = 0;
+    avisarStream(stream, 1, result != 0, valid ? "CHECK_OK" : "CHECK_KO");
+
+    if (valid && stream->sourceFd >= 0) {
+        result_cache_store_fd(&enigmaCache, job->expectedMD5, RESULT_CACHE_SOURCE, result_cache_type(job->fileName), stream->sourceFd, job->expectedMD5);
+    }
+}
+
+// Una recepció pendent es pot reprendre si cap feina d'aquest worker no té el mateix arxiu
+static int reclamarPendent(const EnigmaDistortionEntry *entry, void *arg) {
+    return worker_job_claim(&enigmaJobs, (WorkerJob *)arg, entry->fileName) == 0;
+}
+
+void *handleFleckFrames(void *arg){
+    WorkerJob *job = (WorkerJob *)arg;
+    int clientSocket = job->clientSocket;
+
+    FrameReader reader;            // Lector amb buffer del socket de Fleck
+    int consumedFrames = 0;        // Trames de dades pendents de retornar com a crèdit
+
+    //Buscar si hi ha distorsions pending (d'un Enigma caigut: les de les feines actives d'aquest no compten)
+    EnigmaDistortionEntry recoveredDistortion;
+    int found = claim_enigma_pending_distortion(&harleySharedMemory, reclamarPendent, job, &recoveredDistortion) == 0;
 
     if (found) {
-        expectedFileSize = recoveredDistortion.currentByte; // Tamaño que ya se ha recibido
-        strncpy(receivedFileName, recoveredDistortion.fileName, sizeof(receivedFileName) - 1);
-        strncpy(expectedMD5, recoveredDistortion.md5Sum, sizeof(expectedMD5) - 1);
-        snprintf(receivedFactor, sizeof(receivedFactor), "%d", recoveredDistortion.factor);
+        job->expectedFileSize = recoveredDistortion.currentByte; // Tamaño que ya se ha recibido
+        strncpy(job->expectedMD5, recoveredDistortion.md5Sum, sizeof(job->expectedMD5) - 1);
+        snprintf(job->factor, sizeof(job->factor), "%d", recoveredDistortion.factor);
 
         char *finalFilePath;
-        if (asprintf(&finalFilePath, "%s%s", ENIGMA_PATH_FILES, receivedFileName) == -1) {
+        if (asprintf(&finalFilePath, "%s%s", ENIGMA_PATH_FILES, job->fileName) == -1) {
             customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
+            worker_job_release(&enigmaJobs, job);
             return NULL;
         }
 
-        tempFileDescriptor = open(finalFilePath, O_WRONLY | O_CREAT, 0666);
+        job->tempFileDescriptor = open(finalFilePath, O_RDWR | O_CREAT, 0666);
 
-        if (tempFileDescriptor < 0) {
+        if (job->tempFileDescriptor < 0) {
             customPrintf("[ERROR]: No se pudo abrir el archivo para continuar la recepción.");
             free(finalFilePath);
+            worker_job_release(&enigmaJobs, job);
             return NULL;
         }
-        customPrintf("%d\n\n", expectedFileSize);
-        // Posicionarse exactamente donde se quedó la recepción
-        if (lseek(tempFileDescriptor, expectedFileSize, SEEK_SET) < 0) {
+        // Posicionarse exactamente donde se quedó la recepción (mida final desconeguda: sense projecció)
+        if (mapped_file_init(&job->receiveFile, job->tempFileDescriptor, 0, job->expectedFileSize) != 0) {
             customPrintf("[ERROR]: No se pudo posicionar en el offset de continuación.");
-            close(tempFileDescriptor);
-            tempFileDescriptor = -1;
             free(finalFilePath);
+            worker_job_release(&enigmaJobs, job);
             return NULL;
         }
+
+        // Reprendre l'MD5 parcial guardat; si no quadra amb els bytes rebuts, es recalcula del fitxer
+        if (recoveredDistortion.hashState.length == recoveredDistortion.currentByte) {
+            job->receivedHash = recoveredDistortion.hashState;
+            job->receivedHashValid = 1;
+        } else {
+            md5_init(&job->receivedHash);
+            job->receivedHashValid = md5_update_fd_range(&job->receivedHash, job->tempFileDescriptor, 0, recoveredDistortion.currentByte) == 0;
+        }
+        checkpoint_start(&job->receiveCheckpoint, recoveredDistortion.currentByte);
+        free(finalFilePath);
     }
 
-    while (1) {
-        uint8_t type; //Llegir només primer byte
-        ssize_t bytesRead = recv(clientSocket, &type, 1, MSG_PEEK);
+    if (iniciarLectorTramas(&reader, clientSocket) != 0) {
+        customPrintf("[ERROR]: No se pudo crear el lector de tramas.");
+        worker_job_release(&enigmaJobs, job);
+        return NULL;
+    }
 
-        if (bytesRead <= 0) {
-            customPrintf("[ERROR]: Error al leer el socket de Fleck. Posible desconexión.\n");
-            close(clientSocket);
-            return NULL;
+    uint64_t loadBytes = 0; // Bytes d'aquesta distorsió comptats a l'informe de càrrega
+    uint64_t loadStartMs = 0;
+
+    while (1) {
+        FrameView view;
+        if (leerSiguienteTrama(&reader, &view) != 0) {
+            if (reader.closed) {
+                customPrintf("[ERROR]: Error al leer el socket de Fleck. Posible desconexión.\n");
+                flow_control_close(&job->downloadFlow);
+                tancarStreamRecepcio(job);
+                if (loadBytes > 0) {
+                    worker_load_end(loadBytes);
+                }
+                cerrarLectorTramas(&reader);
+                worker_job_release(&enigmaJobs, job); // El socket el tanca l'última referència
+                return NULL;
+            }
+            customPrintf("[ERROR]: Error al recibir trama de Fleck.");
+            break;
         }
-        
-        //TODO MIRAR QUE ENTRI BÉ AQUÍ
-        // Procesar trama binaria 0x05
-        if (type == 0x05) {
-            BinaryFrame binaryFrame;
-            if (leerTramaBinaria(clientSocket, &binaryFrame) == 0) {
-                processBinaryFrameFromFleck(&binaryFrame, expectedFileSize, &currentFileSize, clientSocket);
-            } else {
-                customPrintf("[ERROR]: Error al recibir trama binaria.");
-                break;
+
+        // Procesar trama 0x05 (clàssica o BULK)
+        if (view.kind == FRAME_VIEW_BINARY || view.kind == FRAME_VIEW_BULK) {
+            int grant = flow_control_consume(&consumedFrames, job->creditWindow);
+            if (grant > 0) {
+                enviarCreditsAFleck(job, grant);
             }
+            processBinaryFrameFromFleck(job, view.data, view.data_length, &reader);
         } else { // Procesar tramas no binarias
-            Frame request;
-            if (leerTrama(clientSocket, &request) == 0) {
-                // Procesar trama 0x03
-                if (request.type == 0x03) {
-                    char userName[64], fileName[256], fileSizeStr[20], md5Sum[33], factor[20];
-                    if (sscanf(request.data, "%63[^&]&%255[^&]&%19[^&]&%32[^&]&%19s",
-                            userName, fileName, fileSizeStr, md5Sum, factor) != 5) {
-                        customPrintf("[ERROR]: Formato inválido en solicitud DISTORT FILE.");
-                        send_frame_with_error(clientSocket, "CON_KO");
-                        break;
-                    }
+            Frame request = view.frame;
+            // Procesar trama 0x03
+            if (request.type == 0x03) {
+                char userName[64], fileName[256], fileSizeStr[20], md5Sum[33], factor[20];
+                char requestedOptions[TRANSFER_OPTIONS_SIZE] = {0};
+                if (sscanf(request.data, "%63[^&]&%255[^&]&%19[^&]&%32[^&]&%19[^&]&%63s",
+                        userName, fileName, fileSizeStr, md5Sum, factor, requestedOptions) < 5) {
+                    customPrintf("[ERROR]: Formato inválido en solicitud DISTORT FILE.");
+                    send_frame_with_error(clientSocket, "CON_KO");
+                    break;
+                }
 
-                    // Mostrar mensajes personalizados
-                    char *logMessage = NULL;
-                    asprintf(&logMessage, "\nNew user connected: %s.\n\n", userName);
-                    customPrintf(logMessage);
-                    free(logMessage);
+                // Mostrar mensajes personalizados
+                char *logMessage = NULL;
+                asprintf(&logMessage, "\nNew user connected: %s.\n\n", userName);
+                customPrintf(logMessage);
+                free(logMessage);
 
-                    asprintf(&logMessage, "New request - %s wants to distort some media, with factor %s.", userName, factor);
-                    customPrintf(logMessage);
-                    free(logMessage);
+                asprintf(&logMessage, "New request - %s wants to distort some media, with factor %s.", userName, factor);
+                customPrintf(logMessage);
+                free(logMessage);
 
-                    customPrintf("\nReceiving original text…\n");
+                customPrintf("\nReceiving original text…\n");
 
-                    //Guardar variables
-                    strncpy(receivedFileName, fileName, sizeof(receivedFileName) - 1);
-                    strncpy(expectedMD5, md5Sum, sizeof(expectedMD5) - 1);
-                    strncpy(receivedFactor, factor, sizeof(receivedFactor) - 1);
+                // L'arxiu es desa a ENIGMA_PATH_FILES pel nom: no es pot rebre en dues connexions alhora
+                if (worker_job_claim(&enigmaJobs, job, fileName) != 0) {
+                    logWarning("[WARNING]: Ya se está distorsionando este archivo en otra conexión.");
+                    send_frame_with_error(clientSocket, "CON_KO");
+                    break;
+                }
+
+                //Guardar variables
+                strncpy(job->expectedMD5, md5Sum, sizeof(job->expectedMD5) - 1);
+                strncpy(job->factor, factor, sizeof(job->factor) - 1);
+                job->distortionLogged = 0;
+                if (job->tempFileDescriptor >= 0) {
+                    mapped_file_finish(&job->receiveFile);
+                    close(job->tempFileDescriptor); // Recepció recuperada que Fleck ha reiniciat
+                    job->tempFileDescriptor = -1;
+                }
+
+                // Validar tamaño del archivo
+                job->expectedFileSize = strtoull(fileSizeStr, NULL, 10);
+                
+                if (job->expectedFileSize == 0) {
+                    customPrintf("[ERROR]: Tamaño del archivo inválido.");
+                    send_frame_with_error(clientSocket, "CON_KO");
+                    break;
+                }
+                // Acceptar les opcions de transferència sol·licitades (Fleck antic: cap)
+                TransferOptions transferOptions;
+                char acceptedOptions[TRANSFER_OPTIONS_SIZE];
+                parse_transfer_options(requestedOptions, &transferOptions);
+                tancarStreamRecepcio(job); // Fleck ha reiniciat una distorsió en streaming
+
+                // Text ja distorsionat amb aquest factor: no cal ni rebre'l
+                if (transferOptions.cached && servirDesDeCache(job, &transferOptions) == 0) {
+                    continue;
+                }
+                transferOptions.cached = 0;
+
+                char *finalFilePath;
+                if (asprintf(&finalFilePath, "%s%s", ENIGMA_PATH_FILES, job->fileName) == -1) {
+                    customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
+                    break;
+                }
 
-                    // Validar tamaño del archivo
-                    expectedFileSize = strtoull(fileSizeStr, NULL, 10);
-                    
-                    if (expectedFileSize == 0) {
-                        customPrintf("[ERROR]: Tamaño del archivo inválido.");
+                // Bytes que ja tenim d'aquest contingut (Fleck antic no entén HAVE: l'arxiu es rep sencer de nou).
+                // El filtre en streaming necessita tot el text: si ja en tenim una part, es fa pel camí clàssic.
+                off_t have = prepararRecepcio(job, finalFilePath, transferOptions.have > 0);
+                free(finalFilePath);
+                if (have < 0) {
+                    customPrintf("[ERROR]: No se pudo abrir el archivo para continuar la recepción.");
+                    break;
+                }
+                transferOptions.have = (uint64_t)have;
+                if (have > 0) {
+                    transferOptions.stream = 0;
+                }
+
+                if (transferOptions.stream) {
+                    // El filtre treballa sobre la DATA en memòria: sense còpia zero
+                    transferOptions.zeroCopy = 0;
+                    close(job->tempFileDescriptor); // El text no passa pel disc: només la sortida
+                    job->tempFileDescriptor = -1;
+                    if (iniciarStream(job) != 0) {
                         send_frame_with_error(clientSocket, "CON_KO");
                         break;
                     }
-                    char *finalFilePath;
-                    if (asprintf(&finalFilePath, "%s%s", ENIGMA_PATH_FILES, receivedFileName) == -1) {
-                        customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
+                    job->currentFileSize = 0;
+                    md5_init(&job->receivedHash);
+                    job->receivedHashValid = 1;
+                } else {
+                    // Preassigna l'arxiu sencer i el projecta: cada trama 0x05 s'hi copia directament
+                    if (mapped_file_init(&job->receiveFile, job->tempFileDescriptor, job->expectedFileSize, (size_t)have) != 0) {
+                        customPrintf("[ERROR]: No se pudo preparar el archivo para la recepción.");
                         break;
                     }
+                    save_enigma_distortion_state(&harleySharedMemory, job->fileName, (size_t)have, atoi(job->factor), job->expectedMD5, clientSocket, STATUS_PENDING);
+                    save_enigma_receive_progress(&harleySharedMemory, job->fileName, (size_t)have, &job->receivedHash);
+                    checkpoint_start(&job->receiveCheckpoint, (uint64_t)have);
+                }
 
-                    tempFileDescriptor = open(finalFilePath, O_WRONLY | O_CREAT | O_APPEND, 0666);
-
-                    if (tempFileDescriptor < 0) {
-                        customPrintf("[ERROR]: No se pudo abrir el archivo para continuar la recepción.");
-                        free(finalFilePath);
-                        break;
-                    }
+                format_transfer_options(&transferOptions, acceptedOptions, sizeof(acceptedOptions));
+                job->bulkChunkSize = transferOptions.bulkChunkSize;
+                job->creditWindow = transferOptions.creditWindow;
+                job->zeroCopy = transferOptions.bulkChunkSize > 0 ? transferOptions.zeroCopy : 0;
+                consumedFrames = 0;
 
-                    save_enigma_distortion_state(&harleySharedMemory, receivedFileName, 0, atoi(receivedFactor), expectedMD5, clientSocket, STATUS_PENDING);
+                send_frame_with_ok(clientSocket, acceptedOptions);
+                if (job->stream && engegarEnviamentStream(job) != 0) {
+                    break;
+                }
+                if (have > 0) {
+                    customPrintf("[INFO]: Ya se tienen %lld de %zu bytes del archivo; Fleck solo envía el resto.\n", (long long)have, job->expectedFileSize);
+                }
+                if ((size_t)have == job->expectedFileSize) {
+                    completarRecepcio(job); // No arribarà cap trama de dades
+                }
 
-                    send_frame_with_ok(clientSocket);
+                // Informar Gotham de la nova feina perquè reparteixi les següents
+                if (loadBytes > 0) {
+                    worker_load_end(loadBytes);
                 }
-                else if (request.type == 0x06) {
-                    // Procesar respuesta MD5 recibida desde Fleck
-                    if (strcmp(request.data, "CHECK_OK") == 0) {
-                        customPrintf("[INFO]: Fleck ha confirmado correctamente el MD5 del archivo comprimido (CHECK_OK).");
-                        remove_completed_distortions(&harleySharedMemory); // Limpieza tras éxito
-                    } else if (strcmp(request.data, "CHECK_KO") == 0) {
-                        customPrintf("[ERROR]: Fleck ha reportado un error en la comprobación MD5 del archivo comprimido (CHECK_KO).");
-                        // Opcionalmente, gestionar retransmisión o error aquí.
-                    } else {
-                        logWarning("[WARNING]: Fleck ha enviado una respuesta MD5 desconocida.");
+                loadBytes = job->expectedFileSize;
+                loadStartMs = timer_wheel_now_ms();
+                worker_load_begin(loadBytes);
+            }
+            else if (request.type == FRAME_CREDIT_TYPE) {
+                // Fleck ha consumit trames del fitxer distorsionat
+                flow_control_grant(&job->downloadFlow, atoi(request.data));
+            }
+            else if (request.type == 0x06) {
+                // Procesar respuesta MD5 recibida desde Fleck
+                if (strcmp(request.data, "CHECK_OK") == 0) {
+                    customPrintf("[INFO]: Fleck ha confirmado correctamente el MD5 del archivo comprimido (CHECK_OK).");
+                    remove_completed_distortions(&harleySharedMemory); // Limpieza tras éxito
+                    if (loadBytes > 0) {
+                        worker_load_done(loadBytes, (uint32_t)(timer_wheel_now_ms() - loadStartMs));
+                        loadBytes = 0;
                     }
+                } else if (strcmp(request.data, "CHECK_KO") == 0) {
+                    customPrintf("[ERROR]: Fleck ha reportado un error en la comprobación MD5 del archivo comprimido (CHECK_KO).");
+                    // Opcionalmente, gestionar retransmisión o error aquí.
+                } else {
+                    logWarning("[WARNING]: Fleck ha enviado una respuesta MD5 desconocida.");
                 }
-            }  else {
-                logWarning("[WARNING]: Error al recibir trama estándar.");
-                break;
             }
         }
     }
 
+    flow_control_close(&job->downloadFlow);
+    tancarStreamRecepcio(job);
+    if (loadBytes > 0) {
+        worker_load_end(loadBytes);
+    }
+    cerrarLectorTramas(&reader);
+    worker_job_release(&enigmaJobs, job);
     return NULL;
 }
 
-// Función para enviar el archivo comprimido en tramas binarias
-void *sendCompressedFileToFleck(void *args) {
-    SendCompressedFileArgs *sendArgs = (SendCompressedFileArgs *)args;
+// Envia l'arxiu comprimit en trames binàries (allibera sendArgs)
+static void enviarArxiuComprimit(SendCompressedFileArgs *sendArgs) {
+    WorkerJob *job = sendArgs->job;
     int clientSocket = sendArgs->clientSocket;
     size_t offset = sendArgs->offset;
+    uint32_t bulkChunkSize = sendArgs->bulkChunkSize;
+    uint32_t creditWindow = sendArgs->creditWindow;
+    uint32_t zeroCopy = sendArgs->zeroCopy;
+
+    char fileName[256], originalMD5[33], factor[20];
+    snprintf(fileName, sizeof(fileName), "%s", sendArgs->fileName);
+    snprintf(originalMD5, sizeof(originalMD5), "%s", sendArgs->originalMD5);
+    snprintf(factor, sizeof(factor), "%s", sendArgs->factor);
 
     // Duplicar filePath antes de liberar sendArgs
     char *filePath = strdup(sendArgs->filePath);
     if (!filePath) {
         customPrintf("[ERROR]: No se pudo duplicar filePath.");
         free(sendArgs);
-        return NULL;
+        return;
     }
 
     free(sendArgs); // Liberar memoria de los argumentos
@@ -349,7 +887,7 @@ void *sendCompressedFileToFleck(void *args) {
     if (access(filePath, F_OK) != 0) {
         customPrintf("[ERROR]: El archivo comprimido no existe. Verifica el proceso de compresión.");
         free(filePath);
-        return NULL;
+        return;
     }
 
     customPrintf("\n[INFO]: El archivo comprimido se creó correctamente: %s\n", filePath);
@@ -358,7 +896,7 @@ void *sendCompressedFileToFleck(void *args) {
     if (fd < 0) {
         customPrintf("[ERROR]: No se pudo abrir el archivo comprimido.");
         free(filePath);
-        return NULL;
+        return;
     }
 
     off_t fileSize = lseek(fd, 0, SEEK_END);
@@ -366,7 +904,7 @@ void *sendCompressedFileToFleck(void *args) {
         customPrintf("[ERROR]: El archivo comprimido está vacío o no se pudo calcular su tamaño.");
         close(fd);
         free(filePath);
-        return NULL;
+        return;
     }
 
     customPrintf("On: %d", offset);
@@ -376,36 +914,76 @@ void *sendCompressedFileToFleck(void *args) {
         customPrintf("[ERROR]: No se pudo posicionar en el archivo comprimido.");
         close(fd);
         free(filePath);
-        return NULL;
+        return;
     }
 
     BinaryFrame frame = {0};
 
-    char buffer[247]; 
+    size_t chunkSize = bulkChunkSize > 0 ? bulkChunkSize : DATA_BINARY_MAX_SIZE;
+    char *buffer = zeroCopy ? NULL : malloc(chunkSize); // Amb còpia zero la DATA no passa per l'espai d'usuari
+    if (!zeroCopy && !buffer) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para el buffer de envío.");
+        close(fd);
+        free(filePath);
+        return;
+    }
     ssize_t bytesRead;
 
     int bytesAcum = 0;
+    Checkpoint sendCheckpoint; // L'offset de represa es desa per lots, no a cada trama
+    checkpoint_start(&sendCheckpoint, (uint64_t)bytesAcum);
 
-    while ((bytesRead = read(fd, buffer, sizeof(buffer))) > 0) {
+    while ((bytesRead = zeroCopy ? bulk_next_chunk_length(fd, chunkSize) : read(fd, buffer, chunkSize)) > 0) {
         customPrintf("\nbytesAcum: %d\n", bytesAcum);
-        frame.type = 0x05;
-        frame.data_length = bytesRead;
-        memcpy(frame.data, buffer, bytesRead);
-        frame.timestamp = (uint32_t)time(NULL);
-        frame.checksum = calculate_checksum_binary(frame.data, frame.data_length, 1);
+        // Esperar que Fleck tingui espai per a una altra trama
+        if (creditWindow > 0 && job && flow_control_acquire(&job->downloadFlow) != 0) {
+            customPrintf("[ERROR]: Fleck no ha concedit crèdits per continuar l'enviament.");
+            free(buffer);
+            close(fd);
+            free(filePath);
+            return;
+        }
 
-        if (escribirTramaBinaria(clientSocket, &frame) < 0) { //AQUÍ ENVIO A FLECK
+        int bytesSent;
+        if (zeroCopy) {
+            bytesSent = escribirTramaBulkDesdeFichero(clientSocket, fd, (uint32_t)bytesRead);
+        } else if (bulkChunkSize > 0) {
+            bytesSent = escribirTramaBulk(clientSocket, buffer, (uint32_t)bytesRead);
+        } else {
+            frame.type = 0x05;
+            frame.data_length = bytesRead;
+            memcpy(frame.data, buffer, bytesRead);
+            frame.timestamp = (uint32_t)time(NULL);
+            frame.checksum = calculate_checksum_binary(frame.data, frame.data_length, 1);
+
+            bytesSent = escribirTramaBinaria(clientSocket, &frame); //AQUÍ ENVIO A FLECK
+        }
+
+        if (bytesSent < 0) {
             customPrintf("[ERROR]: Fallo al enviar trama 0x05.");
+            free(buffer);
             close(fd);
             free(filePath);
-            return NULL;
+            return;
         }
 
         bytesAcum += bytesRead;
-        save_enigma_distortion_state(&harleySharedMemory, receivedFileName, bytesAcum, atoi(receivedFactor),
-                                    expectedMD5, clientSocket, STATUS_DONE);
+        if (checkpoint_due(&sendCheckpoint, (uint64_t)bytesAcum)) {
+            save_enigma_distortion_state(&harleySharedMemory, fileName, bytesAcum, atoi(factor),
+                                        originalMD5, clientSocket, STATUS_DONE);
+            checkpoint_saved(&sendCheckpoint, (uint64_t)bytesAcum);
+        }
+
+        // Amb BULK o crèdits no cal espaiar les trames (Flecks antics sí que ho necessiten)
+        if (bulkChunkSize == 0 && creditWindow == 0) {
+            usleep(3000);
+        }
+    }
+    free(buffer);
 
-        usleep(3000);
+    if ((uint64_t)bytesAcum != sendCheckpoint.saved) {
+        save_enigma_distortion_state(&harleySharedMemory, fileName, bytesAcum, atoi(factor),
+                                    originalMD5, clientSocket, STATUS_DONE);
     }
 
     if (bytesRead < 0) {
@@ -416,6 +994,15 @@ void *sendCompressedFileToFleck(void *args) {
 
     close(fd);
     free(filePath); // Liberar filePath al final
+}
+
+// Fil d'enviament: en acabar deixa la referència a la feina (l'última tanca el socket de Fleck)
+void *sendCompressedFileToFleck(void *args) {
+    SendCompressedFileArgs *sendArgs = (SendCompressedFileArgs *)args;
+    WorkerJob *job = sendArgs->job;
+
+    enviarArxiuComprimit(sendArgs);
+    worker_job_release(&enigmaJobs, job);
     return NULL;
 }
 
@@ -436,7 +1023,7 @@ void send_frame_with_error(int clientSocket, const char *errorMessage)
     }
 }
 
-void send_frame_with_ok(int clientSocket){
+void send_frame_with_ok(int clientSocket, const char *acceptedOptions){
     if (clientSocket < 0) {
         customPrintf("[ERROR][Harley] ❌ El socket de Fleck no es válido.");
         close(clientSocket);
@@ -445,7 +1032,8 @@ void send_frame_with_ok(int clientSocket){
 
     Frame okFrame = {0};
     okFrame.type = 0x03;
-    okFrame.data_length = 0;
+    strncpy(okFrame.data, acceptedOptions ? acceptedOptions : "", sizeof(okFrame.data) - 1);
+    okFrame.data_length = strlen(okFrame.data);
     okFrame.timestamp = (uint32_t)time(NULL);
     okFrame.checksum = calculate_checksum(okFrame.data, okFrame.data_length, 0);
 
@@ -456,139 +1044,178 @@ void send_frame_with_ok(int clientSocket){
     }
 }
 
-void processBinaryFrameFromFleck(BinaryFrame *binaryFrame, size_t expectedFileSize, size_t *currentFileSize, int clientSocket) {
-    if (!binaryFrame) {
-        customPrintf("[ERROR]: BinaryFrame recibido nulo.");
-        return;
-    }
+// Arxiu rebut sencer (o ja present, HAVE): comprova l'MD5 i, si quadra, el distorsiona
+static void completarRecepcio(WorkerJob *job) {
+    int clientSocket = job->clientSocket;
 
-    if (tempFileDescriptor < 0) {
-        customPrintf("[ERROR]: No hay un archivo temporal abierto para escribir.");
+    job->distortionLogged = 0;
+    save_enigma_distortion_state(&harleySharedMemory, job->fileName, job->currentFileSize, atoi(job->factor), job->expectedMD5, clientSocket, STATUS_IN_PROGRESS);
+    customPrintf("\nARCHIVO COMPLETO RECIBIDO DE FLECK\n");
+
+    // Cerrar el archivo temporal
+    mapped_file_finish(&job->receiveFile);
+    close(job->tempFileDescriptor);
+    job->tempFileDescriptor = -1;
+
+    char *finalFilePath;
+    if (asprintf(&finalFilePath, "%s%s", ENIGMA_PATH_FILES, job->fileName) == -1) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
         return;
     }
 
-    static int distortionLogged = 0;
-    if (!distortionLogged) {
-        customPrintf("Distorting...\n");
-        distortionLogged = 1;
+    // El veredicte surt de l'MD5 incremental; només es torna a llegir l'arxiu si no és vàlid
+    char calculatedMD5[33] = {0};
+    if (job->receivedHashValid && job->receivedHash.length == job->currentFileSize) {
+        md5_final_hex(&job->receivedHash, calculatedMD5);
+    } else {
+        calculate_md5(finalFilePath, calculatedMD5);
     }
+    job->receivedHashValid = 0;
 
-    // Escribir los datos en el archivo temporal
-    ssize_t writtenBytes = write(tempFileDescriptor, binaryFrame->data, binaryFrame->data_length);
-    if (writtenBytes == 0) {
-        customPrintf("[ERROR]: Error al escribir en el archivo temporal.");
-        close(tempFileDescriptor);
-        tempFileDescriptor = -1;
+    if (strcmp(calculatedMD5, "ERROR") == 0) {
+        customPrintf("[ERROR]: No se pudo calcular el MD5 del archivo recibido.");
+        send_frame_with_error(clientSocket, "CHECK_KO");
+        unlink(finalFilePath); // Eliminar el archivo en caso de error
+        free(finalFilePath);
         return;
     }
 
-    lseek(tempFileDescriptor, 0, SEEK_SET);
-    *currentFileSize = lseek(tempFileDescriptor, 0, SEEK_END);
-    save_enigma_distortion_state(&harleySharedMemory, receivedFileName, *currentFileSize, atoi(receivedFactor), expectedMD5, clientSocket, STATUS_PENDING);
+    if (strcmp(job->expectedMD5, calculatedMD5) == 0) {
+        sendMD5Response(clientSocket, "CHECK_OK");
 
-    // Verificar si se recibió el archivo completo
-    if (*currentFileSize == expectedFileSize) {
-        distortionLogged = 0;
-        save_enigma_distortion_state(&harleySharedMemory, receivedFileName, *currentFileSize, atoi(receivedFactor), expectedMD5, clientSocket, STATUS_IN_PROGRESS);
-        customPrintf("\nARCHIVO COMPLETO RECIBIDO DE FLECK\n");
+        // L'original es desa abans de filtrar-lo al seu lloc: una altra distorsió no l'haurà de tornar a pujar
+        result_cache_store(&enigmaCache, job->expectedMD5, RESULT_CACHE_SOURCE, result_cache_type(job->fileName), finalFilePath, job->expectedMD5);
+        
+        save_enigma_distortion_state(&harleySharedMemory, job->fileName, job->currentFileSize, atoi(job->factor), job->expectedMD5, clientSocket, STATUS_IN_PROGRESS);
+        
+        // Procesar la compresión
+        int result = compress_text_file(finalFilePath, atoi(job->factor));
+        if (result != 0) {
+            customPrintf("[ERROR]: Fallo en la compresión del archivo.");
+            free(finalFilePath);
+            return;
+        }
 
-        // Cerrar el archivo temporal
-        close(tempFileDescriptor);
-        tempFileDescriptor = -1;
+        // Crear la ruta del archivo comprimido dinámicamente
+        char *compressedFilePath = finalFilePath;
 
-        char *finalFilePath;
-        if (asprintf(&finalFilePath, "%s%s", ENIGMA_PATH_FILES, receivedFileName) == -1) {
-            customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
+        // Validar que el archivo comprimido existe
+        if (access(compressedFilePath, F_OK) != 0) {
+            customPrintf("[ERROR]: El archivo comprimido no se creó correctamente.");
+            unlink(finalFilePath);
+            free(finalFilePath);
             return;
         }
 
-        char calculatedMD5[33] = {0};
-        calculate_md5(finalFilePath, calculatedMD5);
+        // Calcular el MD5 del archivo comprimido
+        char compressedMD5[33] = {0};
+        calculate_md5(compressedFilePath, compressedMD5);
 
-        if (strcmp(calculatedMD5, "ERROR") == 0) {
-            customPrintf("[ERROR]: No se pudo calcular el MD5 del archivo recibido.");
-            send_frame_with_error(clientSocket, "CHECK_KO");
-            unlink(finalFilePath); // Eliminar el archivo en caso de error
+        if (strcmp(compressedMD5, "ERROR") == 0) {
+            customPrintf("[ERROR]: No se pudo calcular el MD5 del archivo comprimido.");
+            unlink(compressedFilePath); // Eliminar el archivo comprimido
             free(finalFilePath);
             return;
         }
 
-        if (strcmp(expectedMD5, calculatedMD5) == 0) {
-            sendMD5Response(clientSocket, "CHECK_OK");
-            
-            save_enigma_distortion_state(&harleySharedMemory, receivedFileName, *currentFileSize, atoi(receivedFactor), expectedMD5, clientSocket, STATUS_IN_PROGRESS);
-            
-            // Procesar la compresión
-            int result = compress_text_file(finalFilePath, atoi(receivedFactor));
-            if (result != 0) {
-                customPrintf("[ERROR]: Fallo en la compresión del archivo.");
-                free(finalFilePath);
-                return;
-            }
+        // Calcular el tamaño del archivo comprimido
+        int fd_text_compressed = open(compressedFilePath, O_RDONLY);
+        if (fd_text_compressed < 0) {
+            customPrintf("[ERROR]: No se pudo abrir el archivo especificado.");
+            free(finalFilePath);
+            return;
+        }
 
-            // Crear la ruta del archivo comprimido dinámicamente
-            char *compressedFilePath = finalFilePath;
+        off_t fileSizeCompressed = lseek(fd_text_compressed, 0, SEEK_END);
+        if (fileSizeCompressed < 0) {
+            customPrintf("[ERROR]: No se pudo calcular el tamaño del archivo.");
+            close(fd_text_compressed);
+            free(finalFilePath);
+            return;
+        }
+        close(fd_text_compressed);
 
-            // Validar que el archivo comprimido existe
-            if (access(compressedFilePath, F_OK) != 0) {
-                customPrintf("[ERROR]: El archivo comprimido no se creó correctamente.");
-                unlink(finalFilePath);
-                free(finalFilePath);
-                return;
-            }
+        // Convertir tamaño del archivo a string
+        char *fileSizeStrCompressed = NULL;
+        if (asprintf(&fileSizeStrCompressed, "%ld", fileSizeCompressed) == -1) {
+            customPrintf("[ERROR]: No se pudo asignar memoria para el tamaño del archivo.");
+            free(finalFilePath);
+            return;
+        }
 
-            // Calcular el MD5 del archivo comprimido
-            char compressedMD5[33] = {0};
-            calculate_md5(compressedFilePath, compressedMD5);
+        // 🛠 Guardar estado como `STATUS_DONE` porque la compresión ha finalizado y está listo para enviarse
+        save_enigma_distortion_state(&harleySharedMemory, job->fileName, job->currentFileSize, atoi(job->factor), compressedMD5, clientSocket, STATUS_DONE);
 
-            if (strcmp(compressedMD5, "ERROR") == 0) {
-                customPrintf("[ERROR]: No se pudo calcular el MD5 del archivo comprimido.");
-                unlink(compressedFilePath); // Eliminar el archivo comprimido
-                free(finalFilePath);
-                return;
-            }
+        // Enviar la trama del archivo distorsionado
+        enviaTramaArxiuDistorsionat(job, clientSocket, job->fileName, job->factor, job->expectedMD5, fileSizeStrCompressed, compressedMD5, compressedFilePath, 0, job->bulkChunkSize, job->creditWindow, job->zeroCopy);
+        remove_completed_distortions(&harleySharedMemory);            
+        result_cache_store(&enigmaCache, job->expectedMD5, atoi(job->factor), result_cache_type(job->fileName), compressedFilePath, compressedMD5);
+        
+        // Liberar memoria dinámica asignada
+        free(finalFilePath);
+        free(fileSizeStrCompressed);
+    } else {
+        customPrintf("[ERROR]: El MD5 no coincide. Archivo recibido está corrupto.");
+        sendMD5Response(clientSocket, "CHECK_KO");
+        unlink(finalFilePath); // Eliminar el archivo en caso de error
+        free(finalFilePath);
+    }
+}
 
-            // Calcular el tamaño del archivo comprimido
-            int fd_text_compressed = open(compressedFilePath, O_RDONLY);
-            if (fd_text_compressed < 0) {
-                customPrintf("[ERROR]: No se pudo abrir el archivo especificado.");
-                free(finalFilePath);
-                return;
-            }
+void processBinaryFrameFromFleck(WorkerJob *job, const char *data, size_t dataLength, FrameReader *reader) {
+    int clientSocket = job->clientSocket;
 
-            off_t fileSizeCompressed = lseek(fd_text_compressed, 0, SEEK_END);
-            if (fileSizeCompressed < 0) {
-                customPrintf("[ERROR]: No se pudo calcular el tamaño del archivo.");
-                close(fd_text_compressed);
-                free(finalFilePath);
-                return;
-            }
-            close(fd_text_compressed);
+    if (job->stream) {
+        processarTramaStream(job, data, dataLength);
+        return;
+    }
 
-            // Convertir tamaño del archivo a string
-            char *fileSizeStrCompressed = NULL;
-            if (asprintf(&fileSizeStrCompressed, "%ld", fileSizeCompressed) == -1) {
-                customPrintf("[ERROR]: No se pudo asignar memoria para el tamaño del archivo.");
-                free(finalFilePath);
-                return;
-            }
+    if (job->tempFileDescriptor < 0) {
+        customPrintf("[ERROR]: No hay un archivo temporal abierto para escribir.");
+        return;
+    }
 
-            // 🛠 Guardar estado como `STATUS_DONE` porque la compresión ha finalizado y está listo para enviarse
-            save_enigma_distortion_state(&harleySharedMemory, receivedFileName, *currentFileSize, atoi(receivedFactor), compressedMD5, clientSocket, STATUS_DONE);
+    if (!job->distortionLogged) {
+        customPrintf("Distorting...\n");
+        job->distortionLogged = 1;
+    }
 
-            // Enviar la trama del archivo distorsionado
-            enviaTramaArxiuDistorsionat(clientSocket, fileSizeStrCompressed, compressedMD5, compressedFilePath, 0);
-            remove_completed_distortions(&harleySharedMemory);            
-            
-            // Liberar memoria dinámica asignada
-            free(finalFilePath);
-            free(fileSizeStrCompressed);
+    // Copiar les dades a la projecció de l'arxiu (preassignat a la trama 0x03): la posició es porta en memòria
+    size_t chunkOffset = job->receiveFile.offset;
+    int stored = data ? mapped_file_write(&job->receiveFile, data, dataLength)
+                      : recibirDatosBulkLectorEnArxiu(reader, &job->receiveFile, dataLength);
+    if (stored != 0) {
+        customPrintf("[ERROR]: Error al escribir en el archivo temporal.");
+        mapped_file_finish(&job->receiveFile);
+        close(job->tempFileDescriptor);
+        job->tempFileDescriptor = -1;
+        return;
+    }
+
+    // MD5 incremental: de la DATA en memòria o de la projecció; sense projecció, rellegint la memòria cau del fitxer
+    if (job->receivedHashValid && (uint64_t)chunkOffset == job->receivedHash.length) {
+        const char *written = data ? data : mapped_file_data(&job->receiveFile, chunkOffset, dataLength);
+        if (written) {
+            md5_update(&job->receivedHash, written, dataLength);
         } else {
-            customPrintf("[ERROR]: El MD5 no coincide. Archivo recibido está corrupto.");
-            sendMD5Response(clientSocket, "CHECK_KO");
-            unlink(finalFilePath); // Eliminar el archivo en caso de error
-            free(finalFilePath);
+            job->receivedHashValid = md5_update_fd_range(&job->receivedHash, job->tempFileDescriptor, (off_t)chunkOffset, dataLength) == 0;
+        }
+    } else {
+        job->receivedHashValid = 0;
+    }
+
+    // El progrés (offset i MD5 parcial junts) només es desa a la memòria compartida per lots
+    job->currentFileSize = job->receiveFile.offset;
+    if (checkpoint_due(&job->receiveCheckpoint, job->currentFileSize)) {
+        if (save_enigma_receive_progress(&harleySharedMemory, job->fileName, job->currentFileSize, &job->receivedHash) != 0) {
+            save_enigma_distortion_state(&harleySharedMemory, job->fileName, job->currentFileSize, atoi(job->factor), job->expectedMD5, clientSocket, STATUS_PENDING);
         }
+        checkpoint_saved(&job->receiveCheckpoint, job->currentFileSize);
+    }
+
+    // Verificar si se recibió el archivo completo
+    if (job->currentFileSize == job->expectedFileSize) {
+        completarRecepcio(job);
     }
 }
 
@@ -609,7 +1236,7 @@ void sendMD5Response(int clientSocket, const char *status) {
 }
 
 // Función para enviar la trama del archivo distorsionado
-void enviaTramaArxiuDistorsionat(int clientSocket, const char *fileSizeCompressed, const char *compressedMD5, const char *compressedFilePath, size_t offset) {
+void enviaTramaArxiuDistorsionat(WorkerJob *job, int clientSocket, const char *fileName, const char *factor, const char *originalMD5, const char *fileSizeCompressed, const char *compressedMD5, const char *compressedFilePath, size_t offset, uint32_t bulkChunkSize, uint32_t creditWindow, uint32_t zeroCopy) {
     Frame frame = {0};
     frame.type = 0x04;
     snprintf(frame.data, sizeof(frame.data), "%s&%s", fileSizeCompressed, compressedMD5);
@@ -635,6 +1262,17 @@ void enviaTramaArxiuDistorsionat(int clientSocket, const char *fileSizeCompresse
     args->filePath = strdup(compressedFilePath);  // Duplicar la ruta
     args->fileSize = strtoull(fileSizeCompressed, NULL, 10);
     args->offset = offset;  
+    args->bulkChunkSize = bulkChunkSize;
+    args->creditWindow = creditWindow;
+    args->zeroCopy = zeroCopy;
+    args->job = job;
+    snprintf(args->fileName, sizeof(args->fileName), "%s", fileName);
+    snprintf(args->originalMD5, sizeof(args->originalMD5), "%s", originalMD5);
+    snprintf(args->factor, sizeof(args->factor), "%s", factor);
+    if (job) {
+        flow_control_reset(&job->downloadFlow, creditWindow);
+        worker_job_retain(&enigmaJobs, job); // El fil d'enviament manté viva la connexió
+    }
 
     customPrintf("md5 calculat comprimit: %s\n", compressedMD5);
 
@@ -642,6 +1280,7 @@ void enviaTramaArxiuDistorsionat(int clientSocket, const char *fileSizeCompresse
     pthread_t sendThread;
     if (pthread_create(&sendThread, NULL, sendCompressedFileToFleck, args) != 0) {
         customPrintf("[ERROR]: No se pudo crear el hilo para enviar el archivo comprimido.");
+        worker_job_release(&enigmaJobs, job);
         free(args->filePath);
         free(args);
         return;
@@ -756,7 +1395,10 @@ void *resume_distortion(void *arg) {
             return NULL;
         }
 
-        enviaTramaArxiuDistorsionat(args->clientSocket, fileSizeStrCompressed, compressedMD5, filePath, args->offset);
+        char factorStr[20];
+        snprintf(factorStr, sizeof(factorStr), "%d", args->factor);
+        enviaTramaArxiuDistorsionat(NULL, args->clientSocket, args->fileName, factorStr, args->md5Sum,
+                                    fileSizeStrCompressed, compressedMD5, filePath, args->offset, 0, 0, 0);
     }
     
     free(filePath);
@@ -800,6 +1442,7 @@ void processReceivedFrame(int gothamSocket, const Frame *response){
         pthread_mutex_lock(&heartbeatMutex); // Proteger acceso a la variable compartida
         lastHeartbeat = time(NULL);          // Actualizar el tiempo del último HEARTBEAT recibido
         pthread_mutex_unlock(&heartbeatMutex);
+        enviarTramaHeartbeat(gothamSocket);  // Sense resposta Gotham el dona per caigut
         break;
 
     default:
@@ -843,7 +1486,7 @@ int main(int argc, char *argv[]){
         return 1;
     }
 
-    if (init_shared_memory(&harleySharedMemory, 1234, sizeof(EnigmaDistortionState)) < 0) {
+    if (init_enigma_shared_memory(&harleySharedMemory) < 0) {
         customPrintf("[ERROR] ❌ No se pudo inicializar la memoria compartida.\n");
         return 1;
     }
@@ -859,10 +1502,11 @@ int main(int argc, char *argv[]){
 
     customPrintf("\n\nConnecting Enigma worker to the system..\n");
 
-    // Registro en Gotham
+    // Registro en Gotham: <type>&<IP>&<Port>&V2 per negociar el protocol binari
+    set_frame_protocol(gothamSocket, FRAME_PROTOCOL_V1);
     Frame frame = {.type = 0x02, .timestamp = time(NULL)};
-    snprintf(frame.data, sizeof(frame.data), "%s&%s&%d",
-        enigmaConfig->workerType, enigmaConfig->ipFleck, enigmaConfig->portFleck);
+    snprintf(frame.data, sizeof(frame.data), "%s&%s&%d&%s",
+             enigmaConfig->workerType, enigmaConfig->ipFleck, enigmaConfig->portFleck, FRAME_PROTOCOL_V2_TAG);
     frame.data_length = strlen(frame.data);
     frame.checksum = calculate_checksum(frame.data, frame.data_length, 1);
 
@@ -884,7 +1528,10 @@ int main(int argc, char *argv[]){
         return 1;
     }
 
-    if (response.type == 0x02 && response.data_length == 0){
+    if (response.type == 0x02 && (response.data_length == 0 || strcmp(response.data, FRAME_PROTOCOL_V2_TAG) == 0)){
+        if (response.data_length != 0) {
+            set_frame_protocol(gothamSocket, FRAME_PROTOCOL_V2);
+        }
         customPrintf("Connected to Mr. J System, ready to listen to Fleck petitions\n\n");
         customPrintf("Waiting for connections...\n");
     }
@@ -911,6 +1558,9 @@ int main(int argc, char *argv[]){
     }
     pthread_detach(gothamThread);
 
+    // Informes de càrrega (0x15) cap a Gotham per al repartiment de peticions
+    worker_load_init(&gothamSocket);
+
     int fleckSocket = startServer(enigmaConfig->ipFleck, enigmaConfig->portFleck);
     if (fleckSocket < 0){
         printColor(ANSI_COLOR_RED, "[ERROR]: No se pudo iniciar el servidor local de Harley.");
@@ -918,21 +1568,44 @@ int main(int argc, char *argv[]){
         return 1;
     }
 
-    // Bucle para manejar conexiones de Fleck
-    while (1) {
+    // Distorsions simultànies: com a molt una per entrada de recuperació de la memòria compartida
+    if (worker_jobs_init(&enigmaJobs, WORKER_MAX_JOBS, MAX_DISTORTIONS) != 0) {
+        close(fleckSocket);
+        free(enigmaConfig);
+        return 1;
+    }
+    customPrintf("Distorsions simultànies: %d\n", enigmaJobs.capacity);
+    result_cache_init(&enigmaCache, ENIGMA_PATH_FILES, RESULT_CACHE_MAX_BYTES);
+
+    // Bucle para manejar conexiones de Fleck (fins que arriba SIGINT)
+    fleckListenSocket = fleckSocket;
+    while (!sigintRebut) {
+        // Amb la taula plena no s'accepten més connexions fins que n'acabi una
+        WorkerJob *job = worker_jobs_acquire(&enigmaJobs);
+        if (!job) {
+            break; // Tancament demanat mentre s'esperava plaça
+        }
         int clientSocket = accept_connection(fleckSocket);
-        lastFleckSocket = clientSocket;
 
         if (clientSocket < 0) {
+            worker_job_release(&enigmaJobs, job);
+            if (sigintRebut) {
+                break; // El senyal ha tallat el socket d'escolta
+            }
             customPrintf("[ERROR]: No se pudo aceptar la conexión del Fleck.");
             continue;
         }
+        job->clientSocket = clientSocket;
 
         EnigmaDistortionEntry recoveredDistortions[MAX_DISTORTIONS];
         int distortionCount = 0;
 
         if (load_enigma_distortion_state(&harleySharedMemory, recoveredDistortions, &distortionCount) == 0) {
             for (int i = 0; i < distortionCount; i++) {
+                // Les que aquest mateix Enigma té en curs no s'han de reprendre
+                if (worker_jobs_is_active(&enigmaJobs, recoveredDistortions[i].fileName)) {
+                    continue;
+                }
                 if (recoveredDistortions[i].fleckSocketFD == clientSocket) {    
                     ResumeArgs *args = malloc(sizeof(ResumeArgs));
                     strncpy(args->fileName, recoveredDistortions[i].fileName, sizeof(args->fileName));
@@ -953,30 +1626,19 @@ int main(int argc, char *argv[]){
             }
         }
 
-        if (clientSocket >= 0) {
-            pthread_t fleckThread;
-            int *socketArg = malloc(sizeof(int));
-            if (!socketArg) {
-                customPrintf("[ERROR]: No se pudo asignar memoria para el socket del cliente.");
-                close(clientSocket); // Cierra el socket si hay un error
-                continue;
-            }
-            *socketArg = clientSocket;
-
-            if (pthread_create(&fleckThread, NULL, handleFleckFrames, socketArg) != 0) {
-                customPrintf("[ERROR]: No se pudo crear el hilo para manejar el cliente.");
-                close(clientSocket); // Cierra el socket si hay un error
-                free(socketArg);
-                continue;
-            }
-
-            pthread_detach(fleckThread);
+        pthread_t fleckThread;
+        if (pthread_create(&fleckThread, NULL, handleFleckFrames, job) != 0) {
+            customPrintf("[ERROR]: No se pudo crear el hilo para manejar el cliente.");
+            worker_job_release(&enigmaJobs, job); // Cierra el socket si hay un error
+            continue;
         }
+
+        pthread_detach(fleckThread);
     }
 
     // Limpieza y cierre
+    tancarEnigma();
+    fleckListenSocket = -1;
     close(fleckSocket);
-    close(gothamSocket);
-    free(enigmaConfig);
     return 0;
 }
\ No newline at end of file
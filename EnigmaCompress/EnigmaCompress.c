@@ -7,13 +7,273 @@
 #include <string.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
 
+#if !defined(ENIGMA_SCALAR_KERNEL) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+#include "EnigmaCompress.h"
 #include "../DataConversion/DataConversion.h"
+#include "../FrameUtils/FrameUtils.h"
+
+// Buffer de sortida: les paraules que es conserven s'escriuen en blocs grans
+typedef struct {
+    int fd;
+    off_t offset;                 // -1: write() seqüencial; si no, pwrite() a partir d'aquí
+    char *data;                   // NULL: només es compten els bytes (passada de prefixos)
+    size_t length;
+    size_t total;                 // Bytes de sortida produïts
+    int error;
+} OutputBuffer;
+
+// Tros del text que filtra un fil (comença just després d'un delimitador)
+typedef struct {
+    const char *text;
+    size_t length;
+    size_t threshold;
+    int fd;
+    size_t outputLength;          // Resultat de la passada de recompte
+    off_t outputOffset;           // On comença la seva sortida al fitxer
+    int error;
+} TextSegment;
 
 int is_delimiter(char c) {
     return c == ' ' || c == '\n' || c == '\t' || c == '\r';
 }
 
+static size_t seguent_delimitador_escalar(const char *text, size_t pos, size_t size) {
+    while (pos < size && !is_delimiter(text[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+// Posició del primer delimitador a partir de pos (size si no n'hi ha cap)
+static size_t seguent_delimitador(const char *text, size_t pos, size_t size) {
+#if !defined(ENIGMA_SCALAR_KERNEL) && defined(__AVX2__)
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i carriage = _mm256_set1_epi8('\r');
+    while (pos + 32 <= size) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(text + pos));
+        __m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(block, newline)),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(block, tab), _mm256_cmpeq_epi8(block, carriage)));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(match);
+        if (mask) {
+            return pos + __builtin_ctz(mask);
+        }
+        pos += 32;
+    }
+#elif !defined(ENIGMA_SCALAR_KERNEL) && defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i carriage = _mm_set1_epi8('\r');
+    while (pos + 16 <= size) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(text + pos));
+        __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, newline)),
+                                     _mm_or_si128(_mm_cmpeq_epi8(block, tab), _mm_cmpeq_epi8(block, carriage)));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(match);
+        if (mask) {
+            return pos + __builtin_ctz(mask);
+        }
+        pos += 16;
+    }
+#endif
+    // Cua del text (o nucli escalar)
+    return seguent_delimitador_escalar(text, pos, size);
+}
+
+static int escriure_sortida(OutputBuffer *out, const char *data, size_t length) {
+    if (out->offset < 0) {
+        return write_full(out->fd, data, length);
+    }
+    while (length > 0) {
+        ssize_t written = pwrite(out->fd, data, length, out->offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        length -= (size_t)written;
+        out->offset += written;
+    }
+    return 0;
+}
+
+static void buidar_sortida(OutputBuffer *out) {
+    if (out->length > 0 && !out->error) {
+        out->error = escriure_sortida(out, out->data, out->length) != 0;
+    }
+    out->length = 0;
+}
+
+static void afegir_sortida(OutputBuffer *out, const char *data, size_t length) {
+    out->total += length;
+    if (!out->data) {
+        return;
+    }
+    if (out->length + length > ENIGMA_OUTPUT_BUFFER) {
+        buidar_sortida(out);
+        if (length > ENIGMA_OUTPUT_BUFFER) {
+            // Paraula més gran que el buffer: directament des del text
+            if (!out->error) {
+                out->error = escriure_sortida(out, data, length) != 0;
+            }
+            return;
+        }
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+// Filtre sobre el text: conserva les paraules de threshold caràcters o més (amb el seu separador)
+// i els salts de línia. Les paraules no tenen límit de mida. Un tros que acaba just després d'un
+// delimitador es pot filtrar per separat: el resultat és el mateix que dins del text sencer.
+static void filtrar_text(const char *text, size_t size, size_t threshold, OutputBuffer *out) {
+    size_t pos = 0;
+
+    while (pos < size) {
+        size_t end = seguent_delimitador(text, pos, size);
+        size_t wordLength = end - pos;
+
+        if (end == size) {
+            // Paraula final sense separador
+            if (wordLength >= threshold) {
+                afegir_sortida(out, text + pos, wordLength);
+            }
+            break;
+        }
+
+        char c = text[end];
+        if (wordLength >= threshold) {
+            afegir_sortida(out, text + pos, wordLength + 1);  // conservar separador
+        } else if (c == '\n' || c == '\r') {
+            afegir_sortida(out, &c, 1);  // conservar saltos de línea
+        }
+        pos = end + 1;
+    }
+}
+
+// Passada de prefixos: només compta quants bytes deixarà el tros
+static void *comptar_segment(void *arg) {
+    TextSegment *segment = (TextSegment *)arg;
+
+    OutputBuffer counter = {.fd = -1, .offset = -1};
+    filtrar_text(segment->text, segment->length, segment->threshold, &counter);
+    segment->outputLength = counter.total;
+    return NULL;
+}
+
+// Segona passada: filtra el tros i l'escriu a partir del seu desplaçament
+static void *escriure_segment(void *arg) {
+    TextSegment *segment = (TextSegment *)arg;
+
+    OutputBuffer out = {.fd = segment->fd, .offset = segment->outputOffset};
+    out.data = malloc(ENIGMA_OUTPUT_BUFFER);
+    if (!out.data) {
+        segment->error = 1;
+        return NULL;
+    }
+    filtrar_text(segment->text, segment->length, segment->threshold, &out);
+    buidar_sortida(&out);
+    free(out.data);
+    segment->error = out.error;
+    return NULL;
+}
+
+// Executa fn sobre cada tros, un fil per tros (si no es pot crear el fil, el fa aquest mateix)
+static void executar_segments(TextSegment *segments, pthread_t *threads, int count, void *(*fn)(void *)) {
+    int *started = calloc(count, sizeof(int));
+
+    for (int i = 0; i < count; i++) {
+        if (started && pthread_create(&threads[i], NULL, fn, &segments[i]) == 0) {
+            started[i] = 1;
+        } else {
+            fn(&segments[i]);
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (started && started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    free(started);
+}
+
+// Nombre de trossos per a un text de size bytes (1 = filtre seqüencial)
+static int trossos_per_text(size_t size) {
+    if (size < ENIGMA_PARALLEL_MIN_SIZE) {
+        return 1;
+    }
+
+    int threads = ENIGMA_TEXT_THREADS;
+    if (threads <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (int)cores : 1;
+    }
+    size_t maxSegments = size / (ENIGMA_PARALLEL_MIN_SIZE / 2);
+    if ((size_t)threads > maxSegments) {
+        threads = (int)maxSegments;
+    }
+    return threads > 1 ? threads : 1;
+}
+
+// Filtra el text en paral·lel escrivint a fd; -1 si no s'ha pogut (el fitxer pot quedar a mitges)
+static int filtrar_text_paralel(const char *text, size_t size, size_t threshold, int fd, int count) {
+    TextSegment *segments = calloc(count, sizeof(TextSegment));
+    pthread_t *threads = calloc(count, sizeof(pthread_t));
+    if (!segments || !threads) {
+        customPrintf("[ERROR]: Fallo de memoria.");
+        free(segments);
+        free(threads);
+        return -1;
+    }
+
+    // Talls just després del primer delimitador a partir de cada fracció del text
+    size_t start = 0;
+    int used = 0;
+    for (int i = 0; i < count && start < size; i++) {
+        size_t end = size;
+        if (i < count - 1) {
+            size_t target = size / count * (i + 1);
+            end = seguent_delimitador(text, target > start ? target : start, size);
+            end = end < size ? end + 1 : size;
+        }
+        segments[used].text = text + start;
+        segments[used].length = end - start;
+        segments[used].threshold = threshold;
+        segments[used].fd = fd;
+        used++;
+        start = end;
+    }
+
+    executar_segments(segments, threads, used, comptar_segment);
+
+    // Suma de prefixos: la sortida de cada tros va just després de la dels anteriors
+    off_t offset = 0;
+    for (int i = 0; i < used; i++) {
+        segments[i].outputOffset = offset;
+        offset += (off_t)segments[i].outputLength;
+    }
+
+    executar_segments(segments, threads, used, escriure_segment);
+
+    int result = 0;
+    for (int i = 0; i < used; i++) {
+        if (segments[i].error) {
+            result = -1;
+        }
+    }
+
+    free(segments);
+    free(threads);
+    return result;
+}
+
 int compress_text_file(const char *filePath, int threshold) {
     if (!filePath || threshold <= 0) {
         customPrintf("[ERROR]: compress_text_file recibió parámetros inválidos.");
@@ -26,64 +286,72 @@ int compress_text_file(const char *filePath, int threshold) {
         return -1;
     }
 
+    struct stat st;
+    if (fstat(fd_in, &st) != 0) {
+        customPrintf("[ERROR]: No se pudo obtener el tamaño del archivo original.");
+        close(fd_in);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+
+    // Tot el text mapejat: el filtre no copia les paraules ni llegeix per blocs
+    char *text = NULL;
+    if (size > 0) {
+        text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd_in, 0);
+        if (text == MAP_FAILED) {
+            customPrintf("[ERROR]: No se pudo mapear el archivo original.");
+            close(fd_in);
+            return -1;
+        }
+        madvise(text, size, MADV_SEQUENTIAL);
+    }
+    close(fd_in);
+
     char *tempPath = NULL;
     if (asprintf(&tempPath, "%s.tmp", filePath) == -1) {
         customPrintf("[ERROR]: No se pudo generar el nombre del archivo temporal.");
-        close(fd_in);
+        if (text) munmap(text, size);
         return -1;
     }
 
-    int fd_out = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-    if (fd_out < 0) {
+    OutputBuffer out = {.offset = -1};
+    out.fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out.fd < 0) {
         customPrintf("[ERROR]: No se pudo crear el archivo temporal.");
-        close(fd_in);
+        if (text) munmap(text, size);
         free(tempPath);
         return -1;
     }
 
-    char *buffer = malloc(1024);
-    char *word = malloc(512);
-    if (!buffer || !word) {
+    out.data = malloc(ENIGMA_OUTPUT_BUFFER);
+    if (!out.data) {
         customPrintf("[ERROR]: Fallo de memoria.");
-        close(fd_in);
-        close(fd_out);
+        if (text) munmap(text, size);
+        close(out.fd);
+        unlink(tempPath);
         free(tempPath);
-        free(buffer);
-        free(word);
         return -1;
     }
 
-    ssize_t bytesRead;
-    ssize_t word_len = 0;
-
-    while ((bytesRead = read(fd_in, buffer, 1024)) > 0) {
-        for (ssize_t i = 0; i < bytesRead; ++i) {
-            char c = buffer[i];
-            if (!is_delimiter(c)) {
-                if (word_len < 511) {
-                    word[word_len++] = c;
-                }
-            } else {
-                if (word_len >= threshold) {
-                    write(fd_out, word, word_len);
-                    write(fd_out, &c, 1);  // conservar separador
-                } else if (c == '\n' || c == '\r') {
-                    write(fd_out, &c, 1);  // conservar saltos de línea
-                }
-                word_len = 0;
-            }
-        }
+    // Textos grans: trossos en paral·lel; la resta, d'una tirada
+    int segments = trossos_per_text(size);
+    if (text && segments > 1) {
+        out.error = filtrar_text_paralel(text, size, (size_t)threshold, out.fd, segments) != 0;
+    } else if (text) {
+        filtrar_text(text, size, (size_t)threshold, &out);
     }
+    if (text) munmap(text, size);
+    buidar_sortida(&out);
 
-    // Si hay una palabra final sin separador
-    if (word_len >= threshold) {
-        write(fd_out, word, word_len);
-    }
+    close(out.fd);
+    free(out.data);
 
-    close(fd_in);
-    close(fd_out);
-    free(buffer);
-    free(word);
+    if (out.error) {
+        customPrintf("[ERROR]: No se pudo escribir el archivo temporal.");
+        unlink(tempPath);
+        free(tempPath);
+        return -1;
+    }
 
     if (unlink(filePath) != 0 || rename(tempPath, filePath) != 0) {
         customPrintf("[ERROR]: No se pudo reemplazar el archivo original.");
@@ -96,3 +364,108 @@ int compress_text_file(const char *filePath, int threshold) {
     customPrintf("[SUCCESS]: Compresión de texto completada correctamente.");
     return 0;
 }
+
+int text_stream_init(TextFilterStream *stream, int threshold, int fd) {
+    if (!stream || threshold <= 0 || fd < 0) {
+        customPrintf("[ERROR]: text_stream_init recibió parámetros inválidos.");
+        return -1;
+    }
+
+    memset(stream, 0, sizeof(TextFilterStream));
+    stream->threshold = (size_t)threshold;
+    stream->fd = fd;
+    stream->buffer = malloc(ENIGMA_OUTPUT_BUFFER);
+    if (!stream->buffer) {
+        customPrintf("[ERROR]: Fallo de memoria.");
+        return -1;
+    }
+    return 0;
+}
+
+static int guardar_paraula(TextFilterStream *stream, const char *data, size_t length) {
+    if (length == 0) return 0;
+
+    if (stream->wordLength + length > stream->wordCapacity) {
+        size_t capacity = stream->wordCapacity > 0 ? stream->wordCapacity : 256;
+        while (capacity < stream->wordLength + length) {
+            capacity *= 2;
+        }
+        char *word = realloc(stream->word, capacity);
+        if (!word) {
+            customPrintf("[ERROR]: Fallo de memoria.");
+            return -1;
+        }
+        stream->word = word;
+        stream->wordCapacity = capacity;
+    }
+    memcpy(stream->word + stream->wordLength, data, length);
+    stream->wordLength += length;
+    return 0;
+}
+
+// Filtra un tros més del text; el resultat és el mateix que el de compress_text_file sobre el text sencer
+int text_stream_feed(TextFilterStream *stream, const char *data, size_t length) {
+    if (!stream || !stream->buffer || (!data && length > 0)) return -1;
+
+    OutputBuffer out = {.fd = stream->fd, .offset = -1, .data = stream->buffer};
+    size_t pos = 0;
+
+    // Acabar la paraula que havia quedat partida al tros anterior
+    if (stream->wordLength > 0) {
+        size_t end = seguent_delimitador(data, 0, length);
+        if (end == length) {
+            return guardar_paraula(stream, data, length);
+        }
+
+        char c = data[end];
+        if (stream->wordLength + end >= stream->threshold) {
+            afegir_sortida(&out, stream->word, stream->wordLength);
+            afegir_sortida(&out, data, end + 1);  // conservar separador
+        } else if (c == '\n' || c == '\r') {
+            afegir_sortida(&out, &c, 1);
+        }
+        stream->wordLength = 0;
+        pos = end + 1;
+    }
+
+    // Fins a l'últim delimitador es filtra ara; el que ve després pot continuar al tros següent
+    size_t last = length;
+    while (last > pos && !is_delimiter(data[last - 1])) {
+        last--;
+    }
+    filtrar_text(data + pos, last - pos, stream->threshold, &out);
+    buidar_sortida(&out);
+    stream->total += out.total;
+
+    if (out.error) {
+        customPrintf("[ERROR]: No se pudo escribir la salida del filtro.");
+        return -1;
+    }
+    return guardar_paraula(stream, data + last, length - last);
+}
+
+// Final del text: la paraula pendent no té separador
+int text_stream_finish(TextFilterStream *stream) {
+    if (!stream || !stream->buffer) return -1;
+
+    if (stream->wordLength >= stream->threshold) {
+        if (write_full(stream->fd, stream->word, stream->wordLength) != 0) {
+            customPrintf("[ERROR]: No se pudo escribir la salida del filtro.");
+            return -1;
+        }
+        stream->total += stream->wordLength;
+    }
+    stream->wordLength = 0;
+    return 0;
+}
+
+void text_stream_destroy(TextFilterStream *stream) {
+    if (!stream) return;
+
+    free(stream->buffer);
+    free(stream->word);
+    stream->buffer = NULL;
+    stream->word = NULL;
+    stream->wordLength = 0;
+    stream->wordCapacity = 0;
+}
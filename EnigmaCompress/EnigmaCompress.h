@@ -1,6 +1,41 @@
 #ifndef ENIGMA_COMPRESS_H
 #define ENIGMA_COMPRESS_H
 
+#include <stddef.h>
+
+// Mida del buffer de sortida del filtre de text
+#ifndef ENIGMA_OUTPUT_BUFFER
+#define ENIGMA_OUTPUT_BUFFER 65536
+#endif
+
+// Textos a partir d'aquesta mida es filtren a trossos en paral·lel
+#ifndef ENIGMA_PARALLEL_MIN_SIZE
+#define ENIGMA_PARALLEL_MIN_SIZE (8 * 1024 * 1024)
+#endif
+
+// Fils per al filtre en paral·lel. 0 = un per core.
+#ifndef ENIGMA_TEXT_THREADS
+#define ENIGMA_TEXT_THREADS 0
+#endif
+
+// Filtre incremental (mode STREAM): el text arriba a trossos i la sortida s'escriu a fd a mesura que es produeix.
+// La paraula partida entre dos trossos es guarda fins que arriba el seu delimitador.
+typedef struct {
+    size_t threshold;
+    int fd;                       // Sortida (write() seqüencial)
+    char *buffer;                 // Buffer de sortida (ENIGMA_OUTPUT_BUFFER)
+    char *word;                   // Paraula pendent del tros anterior
+    size_t wordLength;
+    size_t wordCapacity;
+    size_t total;                 // Bytes de sortida escrits
+} TextFilterStream;
+
+int is_delimiter(char c);
 int compress_text_file(const char *filePath, int threshold);
 
+int text_stream_init(TextFilterStream *stream, int threshold, int fd);
+int text_stream_feed(TextFilterStream *stream, const char *data, size_t length);
+int text_stream_finish(TextFilterStream *stream);
+void text_stream_destroy(TextFilterStream *stream);
+
 #endif
\ No newline at end of file
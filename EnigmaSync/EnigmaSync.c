@@ -1,109 +1,47 @@
 #include "EnigmaSync.h"
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
 #include "../Shared_Memory/Shared_memory.h"
 #include "../DataConversion/DataConversion.h"
+#include "../Logging/Logging.h"
 
-// Inicializa la memoria compartida para Enigma
-int init_shared_memory(SharedMemory *sm, key_t key, size_t size) {
-    if (!sm) return -1;
-
-    sm->shmid = shmget(key, size, IPC_CREAT | 0666);
-    if (sm->shmid < 0) {
-        perror("Error creando memoria compartida");
-        return -1;
-    }
-
-    sm->shmaddr = shmat(sm->shmid, NULL, 0);
-    if (sm->shmaddr == (void *)-1) {
-        perror("Error asociando memoria compartida");
-        return -1;
-    }
-
-    if (SEM_constructor_with_name(&sm->sem, key) < 0) {
-        perror("Error creando semáforo");
-        return -1;
-    }
-    if (SEM_init(&sm->sem, 1) < 0) {
-        perror("Error inicializando semáforo");
-        return -1;
-    }
-
-    return 0;
+// Distorsions d'Enigma: s'identifiquen només per arxiu (usuari buit a la taula)
+int init_enigma_shared_memory(SharedMemory *sm) {
+    return distortion_table_attach(sm, ENIGMA_SHARED_MEMORY_KEY);
 }
 
 // Guarda el estado exacto de la distorsión en curso
 int save_enigma_distortion_state(SharedMemory *sm, const char *fileName, size_t currentByte, 
     int factor, const char *md5Sum, int fleckSocketFD, int status) {
-    
-    if (!sm || !sm->shmaddr) {
-        customPrintf("[ERROR] ❌ Memoria compartida no inicializada antes de guardar estado.\n");
-        return -1;
-    }
-
-    lock_shared_memory(sm);
-    EnigmaDistortionState *state = (EnigmaDistortionState *)sm->shmaddr;
-
-    int found = 0;
-
-    for (int i = 0; i < state->count; i++) {
-        if (strcmp(state->distortions[i].fileName, fileName) == 0) {
-            // 📌 Actualizar distorsión existente
-            state->distortions[i].currentByte = currentByte;
-            state->distortions[i].factor = factor;
-            strncpy(state->distortions[i].md5Sum, md5Sum, sizeof(state->distortions[i].md5Sum));
-            state->distortions[i].fleckSocketFD = fleckSocketFD;
-            state->distortions[i].status = status; //Se asigna el estado correctamente
-            found = 1;
-            break;  //No necesitamos seguir buscando
-        }
-    }
+    return distortion_table_save(sm, fileName, "", currentByte, factor, md5Sum, fleckSocketFD, status);
+}
 
-    // 📌 Si no se encontró la distorsión, la agregamos
-    if (!found) {
-        if (state->count < MAX_DISTORTIONS) {
-            strncpy(state->distortions[state->count].fileName, fileName, sizeof(state->distortions[state->count].fileName) - 1);
-            strncpy(state->distortions[state->count].md5Sum, md5Sum, sizeof(state->distortions[state->count].md5Sum));
-            state->distortions[state->count].currentByte = currentByte;
-            state->distortions[state->count].factor = factor;
-            state->distortions[state->count].fleckSocketFD = fleckSocketFD;
-            state->distortions[state->count].status = status; // Se asigna el estado correctamente
+// Actualitza la posició de recepció i l'MD5 parcial d'una distorsió ja registrada
+int save_enigma_receive_progress(SharedMemory *sm, const char *fileName, size_t currentByte, const Md5Context *hashState) {
+    return distortion_table_save_progress(sm, fileName, "", currentByte, hashState);
+}
 
-            state->count++;
-        } else {
-            customPrintf("[ERROR] ❌ No se pueden agregar más distorsiones, memoria llena.\n");
-        }
+// Busca la recepció pendent d'aquest arxiu amb el mateix MD5
+int find_enigma_receive_progress(SharedMemory *sm, const char *fileName, const char *md5Sum, size_t *currentByte, Md5Context *hashState) {
+    EnigmaDistortionEntry entry;
+    if (!currentByte || !hashState || distortion_table_find_pending(sm, fileName, md5Sum, &entry) != 0) {
+        return -1;
     }
-
-    unlock_shared_memory(sm);
+    *currentByte = entry.currentByte;
+    *hashState = entry.hashState;
     return 0;
 }
 
+// Primera recepció interrompuda que el worker pot reprendre
+int claim_enigma_pending_distortion(SharedMemory *sm, int (*claim)(const EnigmaDistortionEntry *entry, void *arg), void *arg, EnigmaDistortionEntry *entry) {
+    return distortion_table_claim_pending(sm, claim, arg, entry);
+}
 
 // Recupera el estado de la distorsión en caso de caída
 int load_enigma_distortion_state(SharedMemory *sm, EnigmaDistortionEntry *entries, int *count) {
-    if (!sm || !sm->shmaddr) {
-        customPrintf("[ERROR] ❌ Memoria compartida no inicializada antes de recuperar estado.\n");
+    if (distortion_table_load(sm, entries, count) != 0) {
         return -1;
     }
 
-    lock_shared_memory(sm);
-    EnigmaDistortionState *state = (EnigmaDistortionState *)sm->shmaddr;
-
-    *count = 0;
-    for (int i = 0; i < state->count; i++) {
-        if (state->distortions[i].status == STATUS_IN_PROGRESS || 
-            state->distortions[i].status == STATUS_DONE || 
-            state->distortions[i].status == STATUS_PENDING) {
-
-            entries[*count] = state->distortions[i]; 
-            (*count)++;
-        }
-    }
-
     for (int i = 0; i < *count; i++) {
         const char *status_str = "UNKNOWN";
         switch (entries[i].status) {
@@ -112,38 +50,15 @@ int load_enigma_distortion_state(SharedMemory *sm, EnigmaDistortionEntry *entrie
             case STATUS_DONE:       status_str = "DONE"; break;
         }
 
-        customPrintf("[DEBUG] 📄 Archivo: %s | Byte actual: %ld | Estado: %s\n",
-                    entries[i].fileName,
-                    entries[i].currentByte,
-                    status_str);
+        LOG_DEBUGF("[DEBUG] 📄 Archivo: %s | Byte actual: %ld | Estado: %s\n",
+                   entries[i].fileName,
+                   entries[i].currentByte,
+                   status_str);
     }
-
-    unlock_shared_memory(sm);
-    return (*count > 0) ? 0 : -1;
+    return 0;
 }
 
 // Elimina todas las distorsiones con STATUS_DONE de la memoria compartida
 int remove_completed_distortions(SharedMemory *sm) {
-    if (!sm || !sm->shmaddr) {
-        customPrintf("[ERROR] ❌ Memoria compartida no inicializada antes de eliminar distorsiones completadas.\n");
-        return -1;
-    }
-
-    lock_shared_memory(sm);
-    EnigmaDistortionState *state = (EnigmaDistortionState *)sm->shmaddr;
-
-    int newCount = 0;
-    for (int i = 0; i < state->count; i++) {
-        if (state->distortions[i].status != STATUS_DONE) {
-            state->distortions[newCount] = state->distortions[i]; // Mover solo los que no estén completados
-            newCount++;
-        }
-    }
-
-    state->count = newCount; // Actualizar el número de distorsiones activas
-
-    unlock_shared_memory(sm);
-    return 0;
+    return distortion_table_remove_done(sm);
 }
-
-
@@ -3,36 +3,32 @@
 
 #include <stddef.h>
 #include "../Shared_Memory/Shared_memory.h"
+#include "../DistortionTable/DistortionTable.h"
+#include "../MD5SUM/md5Sum.h"
 
-#define MAX_DISTORTIONS 10  // Número máximo de distorsiones simultáneas
+// Cada tipus de worker té el seu segment i el seu semàfor: les taules no es barregen
+#define ENIGMA_SHARED_MEMORY_KEY 1235
 
-#define STATUS_PENDING 1
-#define STATUS_IN_PROGRESS 2
-#define STATUS_DONE 3
+#define MAX_DISTORTIONS DISTORTION_TABLE_CAPACITY  // Número máximo de distorsiones simultáneas
 
-// Estructura para almacenar el estado de una distorsión en Enigma
-typedef struct {
-    char fileName[256];   // Nombre del archivo en proceso
-    char md5Sum[33];      // MD5 del archivo en proceso
-    size_t currentByte;   // Posición actual del archivo
-    int factor;           // Factor de compresión
-    int fleckSocketFD;    //Socket del fleck que envia la distorsió
-    int status;      // Estado de la distorsión (1 -> PENDING, 2 -> IN PROGRESS, 3 -> DONE)
-} EnigmaDistortionEntry;
+typedef DistortionRecord EnigmaDistortionEntry;
 
-// Estructura que almacena todas las distorsiones en curso
-typedef struct {
-    int count;  // Número de distorsiones activas
-    EnigmaDistortionEntry distortions[MAX_DISTORTIONS];
-} EnigmaDistortionState;
-
-// Inicializa la memoria compartida para el estado de Enigma
-int init_shared_memory(SharedMemory *sm, key_t key, size_t size);
+// Connecta el worker a la taula de distorsions de la memòria compartida
+int init_enigma_shared_memory(SharedMemory *sm);
 
 // Guarda el estado actual de una distorsión en memoria compartida
 int save_enigma_distortion_state(SharedMemory *sm, const char *fileName, size_t currentByte, 
     int factor, const char *md5Sum, int fleckSocketFD, int status);
 
+// Guarda els bytes rebuts i l'MD5 parcial alhora, perquè una represa no hagi de tornar a calcular-lo
+int save_enigma_receive_progress(SharedMemory *sm, const char *fileName, size_t currentByte, const Md5Context *hashState);
+
+// Recepció interrompuda (PENDING) del mateix contingut: bytes ja rebuts i el seu MD5 parcial. 0 si n'hi ha.
+int find_enigma_receive_progress(SharedMemory *sm, const char *fileName, const char *md5Sum, size_t *currentByte, Md5Context *hashState);
+
+// Distorsió PENDING d'un worker caigut que claim accepta reprendre. 0 si n'hi ha.
+int claim_enigma_pending_distortion(SharedMemory *sm, int (*claim)(const EnigmaDistortionEntry *entry, void *arg), void *arg, EnigmaDistortionEntry *entry);
+
 // Recupera todas las distorsiones en curso
 int load_enigma_distortion_state(SharedMemory *sm, EnigmaDistortionEntry *entries, int *count);
 
@@ -0,0 +1,190 @@
+#include "EventLog.h"
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../FrameUtils/FrameUtils.h"
+
+uint64_t event_log_now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+const char *event_log_type_name(int type) {
+    switch (type) {
+        case EVENT_WORKER_CONNECT:     return "WORKER_CONNECT";
+        case EVENT_WORKER_DISCONNECT:  return "WORKER_DISCONNECT";
+        case EVENT_DISTORT_ROUTED:     return "DISTORT_ROUTED";
+        case EVENT_DISTORT_REASSIGNED: return "DISTORT_REASSIGNED";
+        case EVENT_MAIN_ASSIGNED:      return "MAIN_ASSIGNED";
+        case EVENT_DISTORT_DONE:       return "DISTORT_DONE";
+        default:                       return "UNKNOWN";
+    }
+}
+
+int event_log_worker_type(const char *type) {
+    if (type && strcasecmp(type, "TEXT") == 0) return EVENT_WORKER_TEXT;
+    if (type && strcasecmp(type, "MEDIA") == 0) return EVENT_WORKER_MEDIA;
+    return 0;
+}
+
+// "@EVENT <tipus> <ms> <tipus worker> <ip> <port> <bytes> <durada>": el temps el posa Gotham, no Arkham
+int event_log_format(char *line, size_t size, int type, const char *workerType, const char *ip, int port,
+                     uint64_t bytes, uint32_t durationMs) {
+    int length = snprintf(line, size, "%s%d %llu %d %s %d %llu %u", EVENT_LOG_LINE_TAG, type,
+                          (unsigned long long)event_log_now_ms(), event_log_worker_type(workerType),
+                          ip && *ip ? ip : "0.0.0.0", port, (unsigned long long)bytes, durationMs);
+    return (length > 0 && (size_t)length < size) ? 0 : -1;
+}
+
+// 0 si la línia (sense el salt de línia) és un esdeveniment vàlid
+int event_log_parse(const char *line, size_t length, EventRecord *event) {
+    size_t tagLength = strlen(EVENT_LOG_LINE_TAG);
+    char text[128];
+    if (length <= tagLength || length >= sizeof(text) || strncmp(line, EVENT_LOG_LINE_TAG, tagLength) != 0) {
+        return -1;
+    }
+    memcpy(text, line, length);
+    text[length] = '\0';
+
+    int type = 0, workerType = 0, port = 0;
+    unsigned long long timeMs = 0, bytes = 0;
+    unsigned durationMs = 0;
+    char ip[16] = {0};
+    if (sscanf(text + tagLength, "%d %llu %d %15s %d %llu %u", &type, &timeMs, &workerType, ip, &port, &bytes, &durationMs) != 7 ||
+        type <= 0 || type >= EVENT_TYPE_COUNT) {
+        return -1;
+    }
+
+    memset(event, 0, sizeof(*event));
+    struct in_addr address;
+    if (inet_pton(AF_INET, ip, &address) == 1) {
+        event->workerIp = address.s_addr;
+    }
+    event->timeMs = timeMs;
+    event->bytes = bytes;
+    event->durationMs = durationMs;
+    event->workerPort = (uint16_t)port;
+    event->type = (uint8_t)type;
+    event->workerType = (uint8_t)workerType;
+    return 0;
+}
+
+int event_log_segment_path(char *path, size_t size, uint32_t sequence) {
+    int length = snprintf(path, size, "%s/events.%06u.bin", EVENT_LOG_DIR, sequence);
+    return (length > 0 && (size_t)length < size) ? 0 : -1;
+}
+
+// Crea el segment sequence (buit, només capçalera)
+static int nouSegment(EventLogWriter *writer, uint32_t sequence) {
+    char path[256];
+    if (event_log_segment_path(path, sizeof(path), sequence) != 0) {
+        return -1;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    EventSegmentHeader header = {0};
+    memcpy(header.magic, EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC));
+    header.recordSize = sizeof(EventRecord);
+    header.createdMs = event_log_now_ms();
+    if (write_full(fd, &header, sizeof(header)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    writer->fd = fd;
+    writer->sequence = sequence;
+    writer->size = sizeof(header);
+    return 0;
+}
+
+// Continua l'últim segment (Arkham no esborra l'historial en arrencar) o en crea el primer
+int event_log_open(EventLogWriter *writer) {
+    writer->fd = -1;
+    if (mkdir(EVENT_LOG_DIR, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+
+    uint32_t last = 0;
+    DIR *dir = opendir(EVENT_LOG_DIR);
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            unsigned sequence;
+            if (sscanf(entry->d_name, "events.%u.bin", &sequence) == 1 && sequence > last) {
+                last = sequence;
+            }
+        }
+        closedir(dir);
+    }
+    if (last == 0) {
+        return nouSegment(writer, 1);
+    }
+
+    char path[256];
+    if (event_log_segment_path(path, sizeof(path), last) != 0) {
+        return -1;
+    }
+    int fd = open(path, O_WRONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || (uint64_t)info.st_size < sizeof(EventSegmentHeader)) {
+        if (fd >= 0) close(fd);
+        return nouSegment(writer, last + 1);
+    }
+
+    // Un registre a mitges (Arkham aturat mentre escrivia) es descarta
+    uint64_t size = sizeof(EventSegmentHeader) +
+                    ((uint64_t)info.st_size - sizeof(EventSegmentHeader)) / sizeof(EventRecord) * sizeof(EventRecord);
+    if (size != (uint64_t)info.st_size && ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return nouSegment(writer, last + 1);
+    }
+    lseek(fd, (off_t)size, SEEK_SET);
+
+    writer->fd = fd;
+    writer->sequence = last;
+    writer->size = size;
+    return 0;
+}
+
+// Afegeix un lot d'esdeveniments; si el segment passaria de la mida màxima, en comença un de nou
+int event_log_append(EventLogWriter *writer, const EventRecord *events, int count) {
+    if (!writer || writer->fd < 0 || count <= 0) {
+        return -1;
+    }
+
+    size_t length = (size_t)count * sizeof(EventRecord);
+    if (writer->size > sizeof(EventSegmentHeader) && writer->size + length > EVENT_LOG_SEGMENT_BYTES) {
+        close(writer->fd);
+        writer->fd = -1;
+        if (nouSegment(writer, writer->sequence + 1) != 0) {
+            return -1;
+        }
+    }
+
+    if (write_full(writer->fd, events, length) != 0) {
+        return -1;
+    }
+    writer->size += length;
+    return 0;
+}
+
+void event_log_close(EventLogWriter *writer) {
+    if (writer && writer->fd >= 0) {
+        close(writer->fd);
+        writer->fd = -1;
+    }
+}
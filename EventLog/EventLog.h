@@ -0,0 +1,72 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Registre binari d'esdeveniments de Gotham, escrit per Arkham a segments que roten per mida.
+// Cada segment és una capçalera i registres de mida fixa en ordre de temps: es pot projectar
+// i buscar-hi un interval de temps per cerca binària sense llegir-lo sencer.
+#ifndef EVENT_LOG_DIR
+#define EVENT_LOG_DIR "events"
+#endif
+
+#ifndef EVENT_LOG_SEGMENT_BYTES
+#define EVENT_LOG_SEGMENT_BYTES (64 * 1024 * 1024)
+#endif
+
+#define EVENT_LOG_MAGIC "ARKEVT1"
+#define EVENT_LOG_LINE_TAG "@EVENT "  // Línies de la pipe d'Arkham que porten un esdeveniment
+
+#define EVENT_WORKER_CONNECT 1
+#define EVENT_WORKER_DISCONNECT 2
+#define EVENT_DISTORT_ROUTED 3     // DISTORT (0x10) assignat a un worker
+#define EVENT_DISTORT_REASSIGNED 4 // Reassignació (0x11) després de la caiguda d'un worker
+#define EVENT_MAIN_ASSIGNED 5      // Nou worker principal (0x08)
+#define EVENT_DISTORT_DONE 6       // El worker ha acabat una distorsió (bytes i durada)
+#define EVENT_TYPE_COUNT 7
+
+#define EVENT_WORKER_TEXT 1
+#define EVENT_WORKER_MEDIA 2
+
+typedef struct {
+    uint64_t timeMs;      // ms des de l'epoch
+    uint64_t bytes;       // Bytes de l'arxiu (EVENT_DISTORT_DONE)
+    uint32_t durationMs;  // Durada de la distorsió al worker (EVENT_DISTORT_DONE)
+    uint32_t workerIp;    // IPv4 en ordre de xarxa
+    uint16_t workerPort;
+    uint8_t type;
+    uint8_t workerType;
+    uint32_t reserved;
+} EventRecord;
+
+typedef struct {
+    char magic[8];
+    uint32_t recordSize;
+    uint32_t reserved;
+    uint64_t createdMs;
+    uint64_t reserved2;
+} EventSegmentHeader;
+
+typedef struct {
+    int fd;
+    uint32_t sequence;    // Número del segment obert (events.<sequence>.bin)
+    uint64_t size;
+} EventLogWriter;
+
+uint64_t event_log_now_ms(void);
+const char *event_log_type_name(int type);
+int event_log_worker_type(const char *type);
+
+// Transport per la pipe de Gotham a Arkham (una línia de text per esdeveniment)
+int event_log_format(char *line, size_t size, int type, const char *workerType, const char *ip, int port,
+                     uint64_t bytes, uint32_t durationMs);
+int event_log_parse(const char *line, size_t length, EventRecord *event);
+
+int event_log_open(EventLogWriter *writer);
+int event_log_append(EventLogWriter *writer, const EventRecord *events, int count);
+void event_log_close(EventLogWriter *writer);
+
+int event_log_segment_path(char *path, size_t size, uint32_t sequence);
+
+#endif
@@ -9,7 +9,6 @@
 #include "FileReader.h"
 #include "StringUtils.h" //trim()
 
-#define printF(x) write(1, x, strlen(x))
 
 // Funció per llegir descripcions del fitxer fins a trobar un caràcter específic o el final del fitxer
 /***********************************************
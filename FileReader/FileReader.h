@@ -2,7 +2,7 @@
 #ifndef FILEREADER_H
 #define FILEREADER_H
 #define _GNU_SOURCE
-#define printF(x) write(1, x, strlen(x))
+#include "../Logging/Logging.h" // printF
 
 typedef struct {
     char *ipGotham;
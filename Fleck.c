@@ -21,9 +21,9 @@
 #include "Networking/Networking.h"
 #include "FrameUtils/FrameUtils.h"
 #include "FrameUtilsBinary/FrameUtilsBinary.h"
+#include "FlowControl/FlowControl.h"
 #include "Logging/Logging.h"
 #include "MD5SUM/md5Sum.h"
-#include "CleanFiles/CleanFiles.h"  // Incluir el módulo
 
 #define FRAME_SIZE 256
 #define CHECKSUM_MODULO 65536
@@ -32,71 +32,109 @@
 #define SEGONA_PART_ENVIAMENT 50
 #define MAX_FILES 100
 
-typedef struct {
-    int workerSocket;
-    const char *filePath;
-    off_t fileSize;
-} DistortRequestArgs;
+#define DISTORTION_RUNNING 0
+#define DISTORTION_DONE    1
+#define DISTORTION_FAILED  2
 
+// Una distorsió en curs o acabada. Cada una té el seu socket amb el Worker, els seus fils
+// d'enviament i d'escolta i el seu progrés; viu a distortions[] fins que CLEAR ALL la treu
 typedef struct {
     char mediaType[10];    // Tipo de archivo: "MEDIA" o "TEXT"
     char fileName[256];    // Nombre del archivo
-    char md5[33];          // MD5 del archivo
+    char md5[33];          // MD5 del archivo (es calcula al fil de la distorsió)
     char factor[10];       // Factor de distorsión
     const char *filePath;
-    off_t fileOffset;      // Posición actual en el archivo
     off_t fileSize;        // Tamaño total del archivo
     int workerSocket;      // Socket del Worker
+    char workerIp[16];     // Worker assignat per Gotham (0x10 o 0x11)
+    int workerPort;
+
+    char receivedMD5Sum[33];         // MD5 del fitxer distorsionat (trama 0x04 o 0x16)
+    off_t receivedFileSize;          // Mida del fitxer distorsionat (trama 0x04)
+    uint32_t negotiatedCreditWindow; // Crèdits a retornar al Worker mentre rebem el fitxer distorsionat
+    uint32_t negotiatedStream;       // 1 si Enigma ha acceptat el mode STREAM
+
+    // Mode STREAM: el fil d'escolta és l'únic lector del socket del Worker (els crèdits de pujada hi arriben)
+    // i hi escriu alhora que el fil d'enviament (crèdits de descàrrega): workerWriteMutex no barreja les trames
+    FlowControl streamUploadFlow;
+    pthread_mutex_t workerWriteMutex;
+
+    float progress;        // 0-50 pujada, 50-100 descàrrega del resultat
+    int result;            // DISTORTION_RUNNING, DISTORTION_DONE o DISTORTION_FAILED
+    int reassigning;       // 1 mentre s'espera la resposta 0x11 de Gotham
+    int refs;              // distortions[] i cada fil que la fa servir (progressMutex)
+    int listed;            // 1 mentre és a distortions[] (la referència que no és cap fil)
+    int *retiredSockets;   // Sockets de Workers anteriors: tallats, es tanquen quan cap fil no els pot usar
+    int retiredCount;
 } DistortionState;
 
-// Estructura para progreso de archivos
+typedef struct {
+    DistortionState *state;
+    off_t fileSize;
+    uint32_t bulkChunkSize; // Mida BULK acceptada pel Worker (0 = trames de 247 bytes)
+    uint32_t creditWindow;  // Finestra de crèdits acceptada pel Worker (0 = espaiat fix)
+    uint32_t zeroCopy;      // 1 = DATA enviada amb sendfile(2)
+    uint32_t stream;        // 1 = mode STREAM: el resultat arriba mentre encara s'envia l'arxiu
+    uint32_t cached;        // 1 = el Worker ja tenia el resultat: no cal enviar l'arxiu
+    off_t offset;           // Bytes que el Worker ja té (HAVE): la pujada comença aquí
+} DistortRequestArgs;
+
+// Estructura para progreso de archivos (còpia per a CHECK STATUS)
 typedef struct {
     char fileName[256]; // Nombre del archivo
     int progress;       // Progreso en porcentaje
+    int result;
 } FileProgress;
 
-// Lista global para progreso
-FileProgress fileProgressList[MAX_FILES];
-int fileProgressCount = 0;
+// Respostes de Gotham pendents d'un tipus (0x10 o 0x11). Gotham respon les peticions d'una
+// connexió en ordre, així que cada resposta és per a la distorsió més antiga de la cua
+typedef struct {
+    DistortionState *items[MAX_FILES];
+    int head;
+    int count;
+} PendingQueue;
+
+// Distorsions d'aquesta sessió
+DistortionState *distortions[MAX_FILES];
+int distortionCount = 0;
 pthread_mutex_t progressMutex = PTHREAD_MUTEX_INITIALIZER;
 
+PendingQueue pendingDistort;  // Esperen la resposta 0x10
+PendingQueue pendingReassign; // Esperen la resposta 0x11
+pthread_mutex_t gothamRequestMutex = PTHREAD_MUTEX_INITIALIZER; // Petició a la cua i trama a Gotham, en el mateix ordre
+
 int gothamSocket = -1; // Variable global para manejar el socket
-int workerSocket = -1;
-float statusResult;
-char distortedFileName[256] = {0};
-char receivedMD5Sum[33] = {0};
 
 void signalHandler(int sig);
 void processCommandWithGotham(const char *command);
 void listText(const char *directory);
 void listMedia(const char *directory);
-void processDistortFileCommand(const char *fileName, const char *factor, int gothamSocket);
+void processDistortFileCommand(const char *fileName, const char *factor);
 void alliberarMemoria(FleckConfig *fleckConfig);
-void sendFileToWorker(int workerSocket, const char *fileName);
 void *sendFileChunks(void *args);
-DistortRequestArgs* sendDistortFileRequest(int workerSocket, const char *fileName, off_t fileSize, const char *md5Sum, const char *factor);
+DistortRequestArgs* sendDistortFileRequest(DistortionState *state, int workerSocket);
 void sendDisconnectFrameToGotham(const char *userName);
 void sendDisconnectFrameToWorker(int workerSocket, const char *userName);
 void sendMD5Response(int clientSocket, const char *status);
 void processCommand(char *command, int gothamSocket);
-int solicitarReasignacionAWorker(DistortionState *globalState);
+int solicitarReasignacionAWorker(DistortionState *state);
+void *runDistortion(void *arg);
 void releaseResources();
 
 FleckConfig *globalFleckConfig = NULL;
-DistortionState *globalState = NULL;
 
 volatile sig_atomic_t stop = 0; // Controla si el programa debe detenerse
 volatile time_t lastHeartbeat = 0;
-volatile int distortionInProgress = 0; // 1 si hay distorsión en curso, 0 si no
+volatile int distortionsInProgress = 0; // Distorsions sense acabar
 
 pthread_mutex_t distortionMutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t distortionFinished = PTHREAD_COND_INITIALIZER;
 pthread_mutex_t heartbeatMutex = PTHREAD_MUTEX_INITIALIZER;
 
 void printColor(const char *color, const char *message) {
-    write(1, color, strlen(color));
-    write(1, message, strlen(message));
-    write(1, ANSI_COLOR_RESET, strlen(ANSI_COLOR_RESET));
+    printF(color);
+    printF(message);
+    printF(ANSI_COLOR_RESET);
 }
 
 // Función para listar los archivos de texto (.txt) en el directorio especificado
@@ -225,107 +263,217 @@ void listMedia(const char *directory) {
     }
 }
 
-void *listenToHarley() {
-    static int fileDescriptor = -1;
-    int fileComplete = 0;
-
-    int receivedChunks = 1;
-    int bytesRebuts = globalState->fileOffset;
+// Referència per a un fil nou: la distorsió no s'allibera mentre algú la fa servir
+static DistortionState *agafarDistorsio(DistortionState *state) {
+    pthread_mutex_lock(&progressMutex);
+    state->refs++;
+    pthread_mutex_unlock(&progressMutex);
+    return state;
+}
 
-    while (1) {
-        union {
-            Frame normal;
-            BinaryFrame binario;
-        } frame;
+// Reassignació (amb progressMutex): el socket anterior es talla perquè els seus fils fallin i surtin, però
+// no es tanca mentre el puguin usar; tancat, el número es podria reutilitzar en una altra connexió
+static void retirarSocket(DistortionState *state, int socket) {
+    shutdown(socket, SHUT_RDWR);
+    int *retired = realloc(state->retiredSockets, (size_t)(state->retiredCount + 1) * sizeof(int));
+    if (!retired) {
+        return; // Queda obert fins que acabi el procés
+    }
+    retired[state->retiredCount++] = socket;
+    state->retiredSockets = retired;
+}
 
-        int is_binary = -1;
-        
-        if (receive_any_frame(globalState->workerSocket, &frame, &is_binary) != 0) {
-            // Detectar socket cerrado
-            char tmp;
-            int ret = recv(globalState->workerSocket, &tmp, 1, MSG_PEEK);
-            if (ret == 0) {
-                customPrintf("Socket cerrado. Reasignando Harley...\n");
-        
-                if (!solicitarReasignacionAWorker(globalState)) {
-                    customPrintf("[ERROR]: No se pudo reasignar el Worker.\n");
-                    free(globalState);
-                    return NULL;
-                }
+static void tancarSocketsRetirats(DistortionState *state) {
+    for (int i = 0; i < state->retiredCount; i++) {
+        close(state->retiredSockets[i]);
+    }
+    free(state->retiredSockets);
+    state->retiredSockets = NULL;
+    state->retiredCount = 0;
+}
 
-                // Esperar hasta que el nuevo socket esté listo
-                while (workerSocket != globalState->workerSocket) {
-                    usleep(10000000);
-                    workerSocket = globalState->workerSocket;
-                }
+static void alliberarDistorsio(DistortionState *state) {
+    if (state->workerSocket >= 0) {
+        close(state->workerSocket);
+    }
+    tancarSocketsRetirats(state);
+    flow_control_destroy(&state->streamUploadFlow);
+    pthread_mutex_destroy(&state->workerWriteMutex);
+    free((char *)state->filePath);
+    free(state);
+}
 
-                return NULL;
+// Un fil deixa la distorsió. Sense fils es tanquen els sockets retirats i, si ha acabat, el del Worker;
+// si a més ja no és a distortions[] (CLEAR ALL), s'allibera
+static void deixarDistorsio(DistortionState *state) {
+    int lliure = 0;
 
-                continue; // volver al bucle y seguir recibiendo
-            } else {
-                break; // error fatal o socket válido pero con error
-            }
+    pthread_mutex_lock(&progressMutex);
+    state->refs--;
+    if (state->refs == 0) {
+        lliure = 1;
+    } else if (state->refs == state->listed) {
+        tancarSocketsRetirats(state);
+        if (state->result != DISTORTION_RUNNING && state->workerSocket >= 0) {
+            close(state->workerSocket);
+            state->workerSocket = -1;
         }
+    }
+    pthread_mutex_unlock(&progressMutex);
 
-        //Decidir qué hacer según el type
-        if (frame.normal.type == 0x05) {  // Trama binaria
-            BinaryFrame *binaryResponse = &frame.binario;
+    if (lliure) {
+        alliberarDistorsio(state);
+    }
+}
 
-            if (binaryResponse->data_length > DATA_SIZE) {
-                customPrintf("[ERROR]: Longitud de datos inválida en trama 0x05.");
-                continue;
+// Marca el final de la distorsió i avisa qui espera que no en quedi cap en curs
+static void acabarDistorsio(DistortionState *state, int result) {
+    pthread_mutex_lock(&progressMutex);
+    int enCurs = state->result == DISTORTION_RUNNING;
+    state->result = result;
+    if (result == DISTORTION_DONE) {
+        state->progress = 100.0;
+    }
+    pthread_mutex_unlock(&progressMutex);
+
+    if (enCurs) {
+        pthread_mutex_lock(&distortionMutex);
+        distortionsInProgress--;
+        pthread_cond_broadcast(&distortionFinished);
+        pthread_mutex_unlock(&distortionMutex);
+    }
+}
+
+// Progrés de la descàrrega (50-100%): el 100% només el posa acabarDistorsio
+static void actualitzarProgresDescarrega(DistortionState *state, off_t bytesReceived) {
+    off_t total = state->receivedFileSize > 0 ? state->receivedFileSize : state->fileSize;
+    float progress = total > 0 ? 50.0 + ((float)bytesReceived / (float)total) * 50.0 : 50.0;
+    state->progress = progress < 99.0 ? progress : 99.0;
+}
+
+void *listenToHarley(void *arg) {
+    DistortionState *state = (DistortionState *)arg;
+    int workerSocket = state->workerSocket; // Una reassignació el talla però no el tanca mentre el fil viu
+    int fileDescriptor = -1;
+    MappedFile download;           // Projecció de fileDescriptor
+    int fileComplete = 0;
+    FrameReader reader;            // Lector amb buffer del socket del Worker
+    Md5Context downloadHash;       // MD5 incremental del fitxer distorsionat
+    int downloadHashValid = 0;     // 1 si el fitxer s'ha obert (i truncat) en aquesta recepció
+    int consumedFrames = 0;
+    int result = DISTORTION_FAILED;
+
+    off_t bytesRebuts = 0;
+
+    if (iniciarLectorTramas(&reader, workerSocket) != 0) {
+        customPrintf("[ERROR]: No se pudo crear el lector de tramas.");
+        acabarDistorsio(state, DISTORTION_FAILED);
+        deixarDistorsio(state);
+        return NULL;
+    }
+
+    while (1) {
+        FrameView view;
+        
+        const char *chunkData = NULL; // DATA de la trama 0x05 (clàssica o BULK)
+        uint32_t chunkLength = 0;
+        int dataFrame = 0;
+        int bulkChunk = 0;
+        int payloadInSocket = 0;      // Còpia zero: la DATA es mou del socket al fitxer amb splice
+
+        if (leerSiguienteTrama(&reader, &view) != 0) {
+            // Detectar socket cerrado: un altre Harley tornarà a començar la distorsió
+            if (reader.closed) {
+                customPrintf("Socket cerrado. Reasignando Harley (%s)...\n", state->fileName);
+                if (solicitarReasignacionAWorker(state)) {
+                    result = DISTORTION_RUNNING;
+                }
             }
+            break;
+        } else if (view.kind == FRAME_VIEW_BINARY || view.kind == FRAME_VIEW_BULK) {  // Trama 0x05 (clàssica o BULK)
+            chunkData = view.data;
+            chunkLength = view.data_length;
+            dataFrame = 1;
+            bulkChunk = view.kind == FRAME_VIEW_BULK;
+            payloadInSocket = bulkChunk && (view.flags & BULK_FLAG_ZERO_COPY);
+        }
 
+        //Decidir qué hacer según el type
+        if (dataFrame) {  // Trama 0x05
             if (fileDescriptor == -1) {
-                fileDescriptor = open(globalState->filePath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0777);
+                fileDescriptor = open(state->filePath, O_RDWR | O_CREAT | O_TRUNC, 0777); // Sense O_APPEND per poder fer splice
                 if (fileDescriptor < 0) {
                     customPrintf("[ERROR]: No se pudo abrir el archivo para escribir.");
                     continue;
                 }
+                // Mida coneguda (trama 0x04): es preassigna i es projecta, i cada trama s'hi copia directament
+                mapped_file_init(&download, fileDescriptor, state->receivedFileSize > 0 ? (size_t)state->receivedFileSize : 0, 0);
+                md5_init(&downloadHash);
+                downloadHashValid = 1;
             }
 
-            if (write(fileDescriptor, binaryResponse->data, binaryResponse->data_length) != binaryResponse->data_length) {
+            size_t chunkOffset = download.offset;
+            int stored = payloadInSocket ? recibirDatosBulkLectorEnArxiu(&reader, &download, chunkLength)
+                                         : mapped_file_write(&download, chunkData, chunkLength);
+            if (stored != 0) {
                 customPrintf("[ERROR]: Fallo al escribir datos en el archivo.");
+                mapped_file_finish(&download);
                 close(fileDescriptor);
                 fileDescriptor = -1;
                 continue;
             }
 
-            receivedChunks++;
+            // MD5 incremental (la DATA de còpia zero es llegeix de la projecció o, sense, de la memòria cau del fitxer)
+            if (downloadHashValid && (uint64_t)chunkOffset == downloadHash.length) {
+                const char *written = payloadInSocket ? mapped_file_data(&download, chunkOffset, chunkLength) : chunkData;
+                if (written) {
+                    md5_update(&downloadHash, written, chunkLength);
+                } else {
+                    downloadHashValid = md5_update_fd_range(&downloadHash, fileDescriptor, (off_t)chunkOffset, chunkLength) == 0;
+                }
+            } else {
+                downloadHashValid = 0;
+            }
 
-            bytesRebuts += binaryResponse->data_length;
-            globalState->fileOffset = bytesRebuts;
+            int grant = flow_control_consume(&consumedFrames, state->negotiatedCreditWindow);
+            if (grant > 0) {
+                enviarTramaCredit(workerSocket, grant);
+            }
 
-            statusResult = 50.0 + ((float)bytesRebuts / (float)globalState->fileSize) * 50.0;
+            bytesRebuts += chunkLength;
+            actualitzarProgresDescarrega(state, bytesRebuts);
 
-            if (binaryResponse->data_length < DATA_SIZE) { 
+            // En mode BULK l'última trama no té per què ser curta: comptem bytes
+            int lastChunk = bulkChunk ? (state->receivedFileSize > 0 && bytesRebuts >= state->receivedFileSize) : chunkLength < DATA_SIZE;
+            if (lastChunk) { 
+                mapped_file_finish(&download);
                 close(fileDescriptor);
-                statusResult = 100.0;
                 fileDescriptor = -1;
-                customPrintf("\nArxiu rebut completament\n");
+                customPrintf("\nArxiu rebut completament (%s)\n", state->fileName);
                 fileComplete = 1;
-                pthread_mutex_lock(&distortionMutex);
-                distortionInProgress = 0;
-                pthread_cond_signal(&distortionFinished);
-                pthread_mutex_unlock(&distortionMutex);
             }
 
             if (fileComplete) {
                 char calculatedMD5[33] = {0};
-                calculate_md5(globalState->filePath, calculatedMD5);
+                if (downloadHashValid) {
+                    md5_final_hex(&downloadHash, calculatedMD5);
+                } else {
+                    calculate_md5(state->filePath, calculatedMD5);
+                }
                 
-                if (strcmp(calculatedMD5, receivedMD5Sum) == 0) {
+                if (strcmp(calculatedMD5, state->receivedMD5Sum) == 0) {
                     customPrintf("Envio que md5sum és correcte a Harley\n");
-                    sendMD5Response(globalState->workerSocket, "CHECK_OK");
+                    sendMD5Response(workerSocket, "CHECK_OK");
+                    result = DISTORTION_DONE;
                 } else {
                     customPrintf("MD5 incorrecte. Enviant CHECK_KO a Harley.");
-                    sendMD5Response(globalState->workerSocket, "CHECK_KO");
+                    sendMD5Response(workerSocket, "CHECK_KO");
                 }
                 break;
             }
 
         } else {  // Trama normal
-            Frame *request = &frame.normal;
+            Frame *request = &view.frame;
 
             if (request->type == 0x04) {
                 char fileSizeStr[20];
@@ -334,7 +482,8 @@ void *listenToHarley() {
                     customPrintf("[ERROR]: Trama 0x04 de Harley con formato inválido.");
                     continue;
                 }
-                strncpy(receivedMD5Sum, md5Sum, sizeof(receivedMD5Sum) - 1);
+                strncpy(state->receivedMD5Sum, md5Sum, sizeof(state->receivedMD5Sum) - 1);
+                state->receivedFileSize = strtoll(fileSizeStr, NULL, 10);
             }
 
             if (request->type == 0x06) { // Confirmación de MD5
@@ -342,20 +491,13 @@ void *listenToHarley() {
                     customPrintf("Harley confirma md5sum correcte\n");
                     //Comprovar si harley segueix actiu
                     char buf[1];
-                    int ret = recv(globalState->workerSocket, buf, 1, MSG_PEEK);
+                    int ret = recv(workerSocket, buf, 1, MSG_PEEK);
                     if (ret == 0) {
-                        if (!solicitarReasignacionAWorker(globalState)) {
-                            customPrintf("[ERROR]: No se pudo reasignar el Worker.");
-                            free(globalState);
-                            return NULL;
-                        }
-
-                        while (workerSocket != globalState->workerSocket) {
-                            usleep(1000);
-                            workerSocket = globalState->workerSocket;
+                        if (solicitarReasignacionAWorker(state)) {
+                            customPrintf("Harley ha caigut, es demana un nou Harley\n");
+                            result = DISTORTION_RUNNING;
                         }
-
-                        customPrintf("Nou Harley assignat\n");
+                        break;
                     }
                 } else if (strcmp(request->data, "CHECK_KO") == 0) {
                     customPrintf("[ERROR]: Harley ha reportado un error en la comprobación MD5 del archivo recibido de Fleck (CHECK_KO).");
@@ -364,171 +506,378 @@ void *listenToHarley() {
         }
     }
 
+    cerrarLectorTramas(&reader);
+
     if (fileDescriptor != -1) {
+        mapped_file_finish(&download);
         close(fileDescriptor);
-        fileDescriptor = -1;
     }
 
-    if (globalState->workerSocket == -1) {
-        free(globalState);
+    if (result != DISTORTION_RUNNING) {
+        acabarDistorsio(state, result);
     }
-
+    deixarDistorsio(state);
     return NULL;
 }
 
-void *listenToEnigma() {
-    static int fileDescriptor = -1;
+// Crèdits de la descàrrega: es tornen tan bon punt es consumeixen, encara que la pujada segueixi en curs
+static void concedirCreditsDescarrega(DistortionState *state, int workerSocket, int credits) {
+    pthread_mutex_lock(&state->workerWriteMutex);
+    enviarTramaCredit(workerSocket, credits);
+    pthread_mutex_unlock(&state->workerWriteMutex);
+}
+
+static void respondreMD5(DistortionState *state, int workerSocket, const char *status) {
+    pthread_mutex_lock(&state->workerWriteMutex);
+    sendMD5Response(workerSocket, status);
+    pthread_mutex_unlock(&state->workerWriteMutex);
+}
+
+void *listenToEnigma(void *arg) {
+    DistortionState *state = (DistortionState *)arg;
+    int workerSocket = state->workerSocket; // Sòcol propi del fil, encara que Gotham reassigni el worker
+    int fileDescriptor = -1;
+    MappedFile download;           // Projecció de fileDescriptor
     int fileComplete = 0;
-    int receivedChunks = 1;
-    int bytesReceived;
+    FrameReader reader;            // Lector amb buffer del socket del Worker
+    Md5Context downloadHash;       // MD5 incremental del fitxer distorsionat
+    int downloadHashValid = 0;     // 1 si el fitxer s'ha obert (i truncat) en aquesta recepció
+    int consumedFrames = 0;
+    off_t bytesReceived = 0;
+    int result = DISTORTION_FAILED;
+
+    // En mode STREAM l'arxiu original encara s'està enviant: el resultat va a part fins a la trama 0x16
+    int streaming = state->negotiatedStream;
+    char *outputPath = (char *)state->filePath;
+    if (streaming && asprintf(&outputPath, "%s.stream", state->filePath) == -1) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para el path del archivo.");
+        flow_control_close(&state->streamUploadFlow);
+        acabarDistorsio(state, DISTORTION_FAILED);
+        deixarDistorsio(state);
+        return NULL;
+    }
+
+    if (iniciarLectorTramas(&reader, workerSocket) != 0) {
+        customPrintf("[ERROR]: No se pudo crear el lector de tramas.");
+        if (streaming) {
+            flow_control_close(&state->streamUploadFlow);
+            free(outputPath);
+        }
+        acabarDistorsio(state, DISTORTION_FAILED);
+        deixarDistorsio(state);
+        return NULL;
+    }
 
     while (1) {
-        union {
-            Frame normal;
-            BinaryFrame binario;
-        } frame;
-
-        int is_binary = -1;
-        //customPrintf("Voy a leer de workerSocket: %d", globalState->workerSocket);
-        if (receive_any_frame(globalState->workerSocket, &frame, &is_binary) != 0) {
+        FrameView view;
+        const char *chunkData = NULL; // DATA de la trama 0x05 (clàssica o BULK)
+        uint32_t chunkLength = 0;
+        int dataFrame = 0;
+        int bulkChunk = 0;
+        int payloadInSocket = 0;      // Còpia zero: la DATA es mou del socket al fitxer amb splice
+
+        if (leerSiguienteTrama(&reader, &view) != 0) {
             customPrintf("Error recibiendo trama. Ha caigut Enigma.\n");
         
-            // Detectar socket cerrado
-            char tmp;
-            int ret = recv(globalState->workerSocket, &tmp, 1, MSG_PEEK);
-            if (ret == 0) {
-                customPrintf("Socket cerrado. Reasignando Enigma...\n");
-        
-                if (!solicitarReasignacionAWorker(globalState)) {
-                    customPrintf("[ERROR]: No se pudo reasignar el Worker.\n");
-                    free(globalState);
-                    return NULL;
+            // Detectar socket cerrado: un altre Enigma tornarà a començar la distorsió
+            if (reader.closed) {
+                customPrintf("Socket cerrado. Reasignando Enigma (%s)...\n", state->fileName);
+                if (streaming) {
+                    // El fil d'enviament no rebrà més crèdits; el resultat parcial no serveix
+                    flow_control_close(&state->streamUploadFlow);
+                    if (fileDescriptor != -1) {
+                        mapped_file_finish(&download);
+                        close(fileDescriptor);
+                        fileDescriptor = -1;
+                    }
+                    unlink(outputPath);
                 }
-
-                return NULL;
-        
-                // Esperar hasta que el nuevo socket esté listo
-                while (workerSocket != globalState->workerSocket) {
-                    usleep(1000);
-                    workerSocket = globalState->workerSocket;
+                if (solicitarReasignacionAWorker(state)) {
+                    result = DISTORTION_RUNNING;
                 }
-        
-                customPrintf("[INFO]: Reasignación completada. Continuando recepción...\n");
-                continue; // volver al bucle y seguir recibiendo
-            } else {
-                break; // error fatal o socket válido pero con error
             }
+            break;
+        } else if (view.kind == FRAME_VIEW_BINARY || view.kind == FRAME_VIEW_BULK) {  // Trama 0x05 (clàssica o BULK)
+            chunkData = view.data;
+            chunkLength = view.data_length;
+            dataFrame = 1;
+            bulkChunk = view.kind == FRAME_VIEW_BULK;
+            payloadInSocket = bulkChunk && (view.flags & BULK_FLAG_ZERO_COPY);
         }
 
         //Decidir qué hacer según el type
-        if (frame.normal.type == 0x05) {  // Trama binaria
-            BinaryFrame *binary = &frame.binario;
-
-            if (binary->data_length > DATA_SIZE) {
-                customPrintf("[ERROR]: Longitud de datos inválida en trama 0x05.");
-                continue;
-            }
-
+        if (dataFrame) {  // Trama 0x05
             if (fileDescriptor == -1) {
-                fileDescriptor = open(globalState->filePath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+                fileDescriptor = open(outputPath, O_RDWR | O_CREAT | O_TRUNC, 0666);
                 if (fileDescriptor < 0) {
                     customPrintf("[ERROR]: No se pudo abrir el archivo para escribir.");
                     continue;
                 }
+                // Mida coneguda (trama 0x04): es preassigna i es projecta. En mode STREAM no se sap fins a la 0x16.
+                mapped_file_init(&download, fileDescriptor, !streaming && state->receivedFileSize > 0 ? (size_t)state->receivedFileSize : 0, 0);
+                md5_init(&downloadHash);
+                downloadHashValid = 1;
             }
 
-            if (write(fileDescriptor, binary->data, binary->data_length) != binary->data_length) {
+            size_t chunkOffset = download.offset;
+            int stored = payloadInSocket ? recibirDatosBulkLectorEnArxiu(&reader, &download, chunkLength)
+                                         : mapped_file_write(&download, chunkData, chunkLength);
+            if (stored != 0) {
                 customPrintf("[ERROR]: Fallo al escribir datos en el archivo.");
+                mapped_file_finish(&download);
                 close(fileDescriptor);
                 fileDescriptor = -1;
                 continue;
             }
 
-            receivedChunks++;
-            statusResult = 50.0 + ((float)bytesReceived * DATA_SIZE / (float)globalState->fileSize) * 50.0;
-
-            bytesReceived += binary->data_length;
+            // MD5 incremental (la DATA de còpia zero es llegeix de la projecció o, sense, de la memòria cau del fitxer)
+            if (downloadHashValid && (uint64_t)chunkOffset == downloadHash.length) {
+                const char *written = payloadInSocket ? mapped_file_data(&download, chunkOffset, chunkLength) : chunkData;
+                if (written) {
+                    md5_update(&downloadHash, written, chunkLength);
+                } else {
+                    downloadHashValid = md5_update_fd_range(&downloadHash, fileDescriptor, (off_t)chunkOffset, chunkLength) == 0;
+                }
+            } else {
+                downloadHashValid = 0;
+            }
 
-            if (binary->data_length < DATA_SIZE) { 
+            int grant = flow_control_consume(&consumedFrames, state->negotiatedCreditWindow);
+            if (grant > 0) {
+                concedirCreditsDescarrega(state, workerSocket, grant);
+            }
+            bytesReceived += chunkLength;
+            actualitzarProgresDescarrega(state, bytesReceived);
+
+            // En mode BULK l'última trama no té per què ser curta: comptem bytes
+            // En mode STREAM el final l'indica la trama 0x16
+            int lastChunk = streaming ? 0 : bulkChunk ? (state->receivedFileSize > 0 && bytesReceived >= state->receivedFileSize) : chunkLength < DATA_SIZE;
+            if (lastChunk) { 
+                mapped_file_finish(&download);
                 close(fileDescriptor);
-                statusResult = 100.0;
                 fileDescriptor = -1;
                 logInfo("[SUCCESS]: Archivo recibido completamente.");
-                customPrintf("\n%d\n", bytesReceived);
+                customPrintf("\n%s: %lld bytes\n", state->fileName, (long long)bytesReceived);
                 fileComplete = 1;
-                pthread_mutex_lock(&distortionMutex);
-                distortionInProgress = 0;
-                pthread_cond_signal(&distortionFinished);
-                pthread_mutex_unlock(&distortionMutex);
             }
 
             if (fileComplete) {
                 char calculatedMD5[33] = {0};
-                calculate_md5(globalState->filePath, calculatedMD5);
+                if (downloadHashValid) {
+                    md5_final_hex(&downloadHash, calculatedMD5);
+                } else {
+                    calculate_md5(state->filePath, calculatedMD5);
+                }
                 
-                if (strcmp(calculatedMD5, receivedMD5Sum) == 0) {
+                if (strcmp(calculatedMD5, state->receivedMD5Sum) == 0) {
                     customPrintf("Envio md5sum correcte a Enigma\n");
-                    sendMD5Response(globalState->workerSocket, "CHECK_OK");
+                    sendMD5Response(workerSocket, "CHECK_OK");
+                    result = DISTORTION_DONE;
                 } else {
                     customPrintf("MD5 incorrecte. Enviant CHECK_KO a Enigma.\n");
-                    sendMD5Response(globalState->workerSocket, "CHECK_KO");
+                    sendMD5Response(workerSocket, "CHECK_KO");
                 }
                 break;
             }
 
+        } else if (streaming && view.frame.type == FRAME_CREDIT_TYPE) {
+            // Crèdits per a la pujada, que fa el fil d'enviament
+            flow_control_grant(&state->streamUploadFlow, atoi(view.frame.data));
+        } else if (streaming && view.frame.type == FRAME_STREAM_END_TYPE) {
+            char fileSizeStr[20];
+            char md5Sum[33];
+            if (sscanf(view.frame.data, "%19[^&]&%32s", fileSizeStr, md5Sum) != 2) {
+                customPrintf("[ERROR]: Trama 0x16 de Enigma con formato inválido.");
+                continue;
+            }
+            strncpy(state->receivedMD5Sum, md5Sum, sizeof(state->receivedMD5Sum) - 1);
+            state->receivedFileSize = strtoll(fileSizeStr, NULL, 10);
+
+            // Resultat buit: cap trama 0x05
+            if (fileDescriptor == -1) {
+                fileDescriptor = open(outputPath, O_RDWR | O_CREAT | O_TRUNC, 0666);
+                md5_init(&downloadHash);
+                downloadHashValid = fileDescriptor >= 0;
+            }
+            if (fileDescriptor != -1) {
+                mapped_file_finish(&download);
+                close(fileDescriptor);
+                fileDescriptor = -1;
+            }
+
+            char calculatedMD5[33] = {0};
+            if (downloadHashValid) {
+                md5_final_hex(&downloadHash, calculatedMD5);
+            } else {
+                calculate_md5(outputPath, calculatedMD5);
+            }
+
+            if (bytesReceived == state->receivedFileSize && strcmp(calculatedMD5, state->receivedMD5Sum) == 0 &&
+                rename(outputPath, state->filePath) == 0) {
+                logInfo("[SUCCESS]: Archivo recibido completamente.");
+                customPrintf("Envio md5sum correcte a Enigma\n");
+                respondreMD5(state, workerSocket, "CHECK_OK");
+                result = DISTORTION_DONE;
+            } else {
+                customPrintf("MD5 incorrecte. Enviant CHECK_KO a Enigma.\n");
+                unlink(outputPath);
+                respondreMD5(state, workerSocket, "CHECK_KO");
+            }
+            break;
         } else {  // Trama normal
-            if (frame.normal.type == 0x04) {
+            if (view.frame.type == 0x04) {
                 char fileSizeStr[20];
                 char md5Sum[33];
-                if (sscanf(frame.normal.data, "%19[^&]&%32s", fileSizeStr, md5Sum) != 2) {
+                if (sscanf(view.frame.data, "%19[^&]&%32s", fileSizeStr, md5Sum) != 2) {
                     customPrintf("[ERROR]: Trama 0x04 de Enigma con formato inválido.");
                     continue;
                 }
-                strncpy(receivedMD5Sum, md5Sum, sizeof(receivedMD5Sum) - 1);
+                strncpy(state->receivedMD5Sum, md5Sum, sizeof(state->receivedMD5Sum) - 1);
+                state->receivedFileSize = strtoll(fileSizeStr, NULL, 10);
             }
 
-            if (frame.normal.type == 0x06) { // Confirmación de MD5
-                if (strcmp(frame.normal.data, "CHECK_OK") == 0) {
+            if (view.frame.type == 0x06) { // Confirmación de MD5
+                if (streaming && strcmp(view.frame.data, "CHECK_OK") == 0) {
+                    // La trama 0x16 arriba just després: no cal comprovar el socket
                     customPrintf("\n[INFO]: Enigma ha confirmado correctamente el MD5 del archivo recibido (CHECK_OK).\n");
-                    //Comprovar si harley segueix actiu
+                } else if (strcmp(view.frame.data, "CHECK_OK") == 0) {
+                    customPrintf("\n[INFO]: Enigma ha confirmado correctamente el MD5 del archivo recibido (CHECK_OK).\n");
+                    //Comprovar si enigma segueix actiu
                     char buf[1];
-                    int ret = recv(globalState->workerSocket, buf, 1, MSG_PEEK);
+                    int ret = recv(workerSocket, buf, 1, MSG_PEEK);
                     if (ret == 0) {
                         customPrintf("[INFO]: Socket de Enigma cerrado tras CHECK_OK. Reasignando...\n");
-
-                        if (!solicitarReasignacionAWorker(globalState)) {
-                            customPrintf("[ERROR]: No se pudo reasignar el Worker.");
-                            free(globalState);
-                            return NULL;
-                        }
-
-                        while (workerSocket != globalState->workerSocket) {
-                            usleep(1000);
-                            workerSocket = globalState->workerSocket;
+                        if (solicitarReasignacionAWorker(state)) {
+                            result = DISTORTION_RUNNING;
                         }
-
-                        customPrintf("[INFO]: Nuevo Enigma asignado. Esperando archivo distorsionado...\n");
+                        break;
                     }
-                } else if (strcmp(frame.normal.data, "CHECK_KO") == 0) {
+                } else if (strcmp(view.frame.data, "CHECK_KO") == 0) {
                     customPrintf("[ERROR]: Enigma ha reportado un error en la comprobación MD5 del archivo recibido de Fleck (CHECK_KO).");
+                    if (streaming) {
+                        // El resultat que ha arribat és d'un arxiu corrupte
+                        if (fileDescriptor != -1) {
+                            mapped_file_finish(&download);
+                            close(fileDescriptor);
+                            fileDescriptor = -1;
+                        }
+                        unlink(outputPath);
+                        break;
+                    }
                 }
             }
         }
     }
 
+    cerrarLectorTramas(&reader);
+
     if (fileDescriptor != -1) {
+        mapped_file_finish(&download);
         close(fileDescriptor);
-        fileDescriptor = -1;
     }
-
-    if (globalState->workerSocket == -1) {
-        free(globalState);
+    if (streaming) {
+        flow_control_close(&state->streamUploadFlow); // Si la pujada encara espera crèdits, que l'abandoni
+        free(outputPath);
     }
 
+    if (result != DISTORTION_RUNNING) {
+        acabarDistorsio(state, result);
+    }
+    deixarDistorsio(state);
     return NULL;
 }
 
 
+// Envia a Gotham una petició 0x10 (DISTORT) o 0x11 (reassignació) i la posa a la cua de respostes pendents
+static int demanarWorker(DistortionState *state, uint8_t type) {
+    PendingQueue *queue = type == 0x10 ? &pendingDistort : &pendingReassign;
+
+    Frame frame = {0};
+    frame.type = type;
+    size_t maxMediaTypeLen = 9; // Longitud máxima para mediaType
+    size_t maxFileNameLen = sizeof(frame.data) - maxMediaTypeLen - 2; // Restamos 2: '&' y '\0'
+    snprintf(frame.data, sizeof(frame.data), "%.*s&%.*s",
+         (int)maxMediaTypeLen, state->mediaType, 
+         (int)maxFileNameLen, state->fileName);
+    frame.data_length = strlen(frame.data);
+    frame.timestamp = (uint32_t)time(NULL);
+    frame.checksum = calculate_checksum(frame.data, frame.data_length, 1);
+
+    pthread_mutex_lock(&gothamRequestMutex);
+    if (gothamSocket < 0 || queue->count == MAX_FILES) {
+        pthread_mutex_unlock(&gothamRequestMutex);
+        return -1;
+    }
+    queue->items[(queue->head + queue->count) % MAX_FILES] = agafarDistorsio(state);
+    queue->count++;
+    if (escribirTrama(gothamSocket, &frame) < 0) {
+        queue->count--;
+        pthread_mutex_unlock(&gothamRequestMutex);
+        deixarDistorsio(state);
+        return -1;
+    }
+    pthread_mutex_unlock(&gothamRequestMutex);
+    return 0;
+}
+
+// Distorsió a la qual va dirigida la resposta de Gotham (amb la referència que tenia a la cua)
+static DistortionState *treureDePendents(PendingQueue *queue) {
+    DistortionState *state = NULL;
+
+    pthread_mutex_lock(&gothamRequestMutex);
+    if (queue->count > 0) {
+        state = queue->items[queue->head];
+        queue->head = (queue->head + 1) % MAX_FILES;
+        queue->count--;
+    }
+    pthread_mutex_unlock(&gothamRequestMutex);
+    return state;
+}
+
+// Resposta 0x10/0x11 de Gotham: Worker per a la distorsió més antiga que l'esperava
+static void rebreWorkerAssignat(const Frame *frame) {
+    int reassignacio = frame->type == 0x11;
+    DistortionState *state = treureDePendents(reassignacio ? &pendingReassign : &pendingDistort);
+    if (!state) {
+        logWarning("[WARNING]: Respuesta de Gotham sin ninguna distorsión pendiente.");
+        return;
+    }
+
+    if (reassignacio) {
+        pthread_mutex_lock(&progressMutex);
+        state->reassigning = 0;
+        pthread_mutex_unlock(&progressMutex);
+    }
+
+    int workerPort = 0;
+    char workerIp[16] = {0};
+    if (strcmp(frame->data, "DISTORT_KO") == 0) {
+        customPrintf(reassignacio ? "[ERROR]: Gotham no pudo reasignar un Worker. Distorsión de %s cancelada.\n"
+                                  : "[ERROR]: Gotham no encontró un Worker disponible para %s.\n", state->fileName);
+    } else if (strcmp(frame->data, "MEDIA_KO") == 0) {
+        customPrintf("[ERROR]: Tipo de archivo de %s rechazado por Gotham.\n", state->fileName);
+    } else if (sscanf(frame->data, "%15[^&]&%d", workerIp, &workerPort) != 2 || strlen(workerIp) == 0 || workerPort <= 0) {
+        customPrintf("[ERROR]: Datos del Worker inválidos.");
+    } else {
+        strncpy(state->workerIp, workerIp, sizeof(state->workerIp) - 1);
+        state->workerPort = workerPort;
+        if (reassignacio) {
+            customPrintf("Connectant %s a un nou worker (%s:%d)\n", state->fileName, workerIp, workerPort);
+        }
+
+        // Cada distorsió té el seu fil: Gotham no espera la negociació amb el Worker
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, runDistortion, state) == 0) {
+            pthread_detach(thread);
+            return; // La referència de la cua passa al fil
+        }
+        customPrintf("[ERROR]: No se pudo crear el thread de la distorsión.");
+    }
+
+    acabarDistorsio(state, DISTORTION_FAILED);
+    deixarDistorsio(state);
+}
+
 void *listenToGotham(void *arg) {
     int gothamSocket = *(int *)arg;
     free(arg);
@@ -542,11 +891,12 @@ void *listenToGotham(void *arg) {
             break; // Salir del bucle si hay un error o desconexión
         }
 
-        char workerIp[16] = {0};
-        int workerPort = 0;
-
         switch (frame.type) {
             case 0x01: // Ejemplo: Trama de confirmación de conexión
+                if (strcmp(frame.data, FRAME_PROTOCOL_V2_TAG) == 0) { // Gotham accepta el protocol v2
+                    set_frame_protocol(gothamSocket, FRAME_PROTOCOL_V2);
+                    break;
+                }
                 if (frame.data_length != 0) { // DATA vacío, longitud 0
                     printColor(ANSI_COLOR_RED, "[ERROR]: Respuesta inesperada de Gotham.\n");
                     close(gothamSocket);
@@ -556,91 +906,8 @@ void *listenToGotham(void *arg) {
                 break;
 
             case 0x10:
-                if (strcmp(frame.data, "DISTORT_KO") == 0) {
-                    customPrintf("[ERROR]: Gotham no encontró un Worker disponible.");
-                    break;
-                } else if (strcmp(frame.data, "MEDIA_KO") == 0) {
-                    customPrintf("[ERROR]: Tipo de archivo rechazado por Gotham.");
-                    break;
-                }
-
-                // Conectar al Worker
-                if (sscanf(frame.data, "%15[^&]&%d", workerIp, &workerPort) != 2 || strlen(workerIp) == 0 || workerPort <= 0) {
-                    customPrintf("[ERROR]: Datos del Worker inválidos.");
-                    break;
-                }
-
-                workerSocket = connect_to_server(workerIp, workerPort);
-                if (workerSocket < 0) {
-                    customPrintf("[ERROR]: No se pudo conectar al Worker.");
-                    free(globalState);
-                    globalState = NULL;
-                    break;
-                }
-
-                globalState->workerSocket = workerSocket;
-
-                DistortRequestArgs *args;
-
-                // Enviar solicitud DISTORT FILE al Worker
-                args = sendDistortFileRequest(globalState->workerSocket, globalState->fileName, globalState->fileSize, globalState->md5, globalState->factor);
-
-                pthread_t thread;
-                if (pthread_create(&thread, NULL, sendFileChunks, (void *) args) != 0) {
-                    customPrintf("[ERROR]: No se pudo crear el thread para enviar las tramas.");
-                    free(args);
-                    return NULL;
-                }
-
-                pthread_detach(thread); // Liberar el hilo automáticamente
-
-                break;  
-            
             case 0x11:
-                if (strcmp(frame.data, "DISTORT_KO") == 0) {
-                    customPrintf("[ERROR]: Gotham no pudo reasignar un Worker. Distorsión cancelada.");
-                    break; // Fallo en la reasignación
-                } else if (strcmp(frame.data, "MEDIA_KO") == 0) {
-                    customPrintf("[ERROR]: Gotham indicó que el tipo de media es inválido.");
-                    break; // Fallo en la reasignación
-                }
-            
-                // Conectar al Worker
-                if (sscanf(frame.data, "%15[^&]&%d", workerIp, &workerPort) != 2 || strlen(workerIp) == 0 || workerPort <= 0) {
-                    customPrintf("[ERROR]: Datos del Worker inválidos.");
-                    break;
-                }
-            
-                int newWorkerSocket = connect_to_server(workerIp, workerPort);
-                if (newWorkerSocket < 0) {
-                    customPrintf("[ERROR]: No se pudo conectar al Worker.\n\n");
-                    free(globalState);
-                    globalState = NULL;
-                    break;
-                }
-            
-                customPrintf("Connectat a nou worker\n");
-                usleep(1000); //1ms d'espera
-                globalState->workerSocket = newWorkerSocket; // Actualizar el socket global del Worker
-                
-                sendDistortFileRequest(newWorkerSocket, globalState->fileName, globalState->fileSize, globalState->md5, globalState->factor);  
-                
-                //NOU FIL DE RECEPCIÓ
-                pthread_t harleyListenerThread;
-                int *socketArg = malloc(sizeof(int));
-                if (!socketArg) {
-                    customPrintf("[ERROR]: No se pudo asignar memoria para socketArg.\n");
-                    return NULL;
-                }
-
-                *socketArg = newWorkerSocket;
-                if (pthread_create(&harleyListenerThread, NULL, listenToHarley, socketArg) != 0) {
-                    perror("pthread_create");
-                    customPrintf("[ERROR]: No se pudo crear el hilo para escuchar a Harley.");
-                    return NULL;
-                }
-                pthread_detach(harleyListenerThread);
-
+                rebreWorkerAssignat(&frame);
                 break;
 
             case 0x12: // Ejemplo: Trama de desconexión
@@ -652,9 +919,9 @@ void *listenToGotham(void *arg) {
                     pthread_mutex_unlock(&heartbeatMutex);
             
                     pthread_mutex_lock(&distortionMutex);
-                    if (distortionInProgress) {
-                        logInfo("[INFO]: Esperando a que termine la distorsión en curso antes de cerrar...");
-                        while (distortionInProgress) {
+                    if (distortionsInProgress > 0) {
+                        logInfo("[INFO]: Esperando a que terminen las distorsiones en curso antes de cerrar...");
+                        while (distortionsInProgress > 0) {
                             pthread_cond_wait(&distortionFinished, &distortionMutex);
                         }
                         pthread_mutex_unlock(&distortionMutex);
@@ -667,6 +934,9 @@ void *listenToGotham(void *arg) {
                 } else {
                     lastHeartbeat = currentTime; // Actualizamos el último heartbeat válido
                     pthread_mutex_unlock(&heartbeatMutex);
+                    if (gothamSocket >= 0) {
+                        enviarTramaHeartbeat(gothamSocket); // Gotham només ens dona per vius si responem
+                    }
                 }
                 break;
 
@@ -681,81 +951,60 @@ void *listenToGotham(void *arg) {
     return NULL;
 }
 
-void calculateOnDemandProgress() {
-    pthread_mutex_lock(&progressMutex);
-
-    // Limpiar lista actual
-    fileProgressCount = 0;
-
-    // Si hay un archivo activo
-    if (strlen(distortedFileName) > 0 && statusResult >= 0 && statusResult <= 100) {
-        strncpy(fileProgressList[0].fileName, distortedFileName, sizeof(fileProgressList[0].fileName));
-        fileProgressList[0].progress = (int)statusResult;
-        fileProgressCount = 1;
-    }
-
-    pthread_mutex_unlock(&progressMutex);
-}
-
-// Función para mostrar el estado de progreso
+// Función para mostrar el estado de progreso de totes les distorsions, en viu
 void checkStatus() {
-    calculateOnDemandProgress();  // 👈 importante
+    FileProgress snapshot[MAX_FILES];
+    int count = 0;
 
     pthread_mutex_lock(&progressMutex);
+    for (int i = 0; i < distortionCount; i++) {
+        strncpy(snapshot[count].fileName, distortions[i]->fileName, sizeof(snapshot[count].fileName));
+        snapshot[count].progress = (int)distortions[i]->progress;
+        snapshot[count].result = distortions[i]->result;
+        count++;
+    }
+    pthread_mutex_unlock(&progressMutex);
 
-    if (fileProgressCount == 0) {
+    if (count == 0) {
         customPrintf("You have no ongoing or finished distorsions.");
-    } else {
-        for (int i = 0; i < fileProgressCount; i++) {
-            int completed = (int)((fileProgressList[i].progress / 100.0) * 20);
-
-            // Crear la barra dinámicamente
-            char *bar = NULL;
-            if (asprintf(&bar, "%.*s%.*s", completed, "====================", 20 - completed, "                    ") == -1) {
-                customPrintf("[ERROR]: No se pudo crear la barra de progreso.");
-                continue;
-            }
-
-            // Crear el output con asprintf
-            char *output = NULL;
-            if (asprintf(&output, "%-20s %6d%% |%s|\n",
-                        fileProgressList[i].fileName,
-                        fileProgressList[i].progress,
-                        bar) == -1) {
-                customPrintf("[ERROR]: Fallo al generar la línea de salida.");
-                free(bar);
-                continue;
-            }
-
-            write(STDOUT_FILENO, output, strlen(output));
-            free(bar);
-            free(output);
-        }
+        return;
     }
 
-    pthread_mutex_unlock(&progressMutex);
+    for (int i = 0; i < count; i++) {
+        int progress = snapshot[i].progress < 0 ? 0 : snapshot[i].progress > 100 ? 100 : snapshot[i].progress;
+        int completed = (int)((progress / 100.0) * 20);
+        customPrintf("%-20s %6d%% |%.*s%.*s|%s\n", snapshot[i].fileName, progress,
+                     completed, "====================", 20 - completed, "                    ",
+                     snapshot[i].result == DISTORTION_FAILED ? " ERROR" : "");
+    }
 }
 
+// Treu les distorsions acabades (bé o amb error); les que encara tenen fils s'alliberen quan acaben
 void clearAllFinishedProgress() {
+    DistortionState *cleared[MAX_FILES];
+    int clearedCount = 0;
+
     pthread_mutex_lock(&progressMutex);
 
-    int i = 0;
-    while (i < fileProgressCount) {
-        if (fileProgressList[i].progress == 100) {
-            // Sustituimos el actual con el último
-            fileProgressList[i] = fileProgressList[fileProgressCount - 1];
-            fileProgressCount--;
-            // No incrementamos i, porque hemos movido un nuevo elemento aquí
+    int kept = 0;
+    for (int i = 0; i < distortionCount; i++) {
+        DistortionState *state = distortions[i];
+        if (state->result == DISTORTION_RUNNING) {
+            distortions[kept++] = state;
         } else {
-            i++;
+            state->listed = 0;
+            if (--state->refs == 0) {
+                cleared[clearedCount++] = state;
+            }
         }
     }
-
-    if (fileProgressCount == 0) {
-        distortedFileName[0] = '\0';
-    }
+    distortionCount = kept;
 
     pthread_mutex_unlock(&progressMutex);
+
+    for (int i = 0; i < clearedCount; i++) {
+        alliberarDistorsio(cleared[i]);
+    }
 }
 
 void processCommandWithGotham(const char *command) {
@@ -779,9 +1028,11 @@ void processCommandWithGotham(const char *command) {
         frame.type = 0x01; // Tipo de conexión
         frame.timestamp = (uint32_t)time(NULL);
 
-        // Construir la trama con el formato <userName>&<IP>&<Port>
-        snprintf(frame.data, sizeof(frame.data), "%s&%s&%d",
-                 globalFleckConfig->user, globalFleckConfig->ipGotham, globalFleckConfig->portGotham);
+        // Construir la trama con el formato <userName>&<IP>&<Port>&V2 (Gotham antics ignoren la marca)
+        set_frame_protocol(gothamSocket, FRAME_PROTOCOL_V1);
+        snprintf(frame.data, sizeof(frame.data), "%s&%s&%d&%s",
+                 globalFleckConfig->user, globalFleckConfig->ipGotham, globalFleckConfig->portGotham,
+                 FRAME_PROTOCOL_V2_TAG);
         frame.data_length = strlen(frame.data);
         frame.checksum = calculate_checksum(frame.data, frame.data_length, 0);
 
@@ -873,7 +1124,7 @@ void processCommand(char *command, int gothamSocket) {
         if (gothamSocket == -1) {
             customPrintf("Cannot distort, you are not connected to Mr. J System");
         } else {
-            processDistortFileCommand(subCmd, extra, gothamSocket);
+            processDistortFileCommand(subCmd, extra);
         }
     } else if (strcasecmp(cmd, "CHECK") == 0 && strcasecmp(subCmd, "STATUS") == 0 && extra == NULL) {
             checkStatus();
@@ -883,114 +1134,182 @@ void processCommand(char *command, int gothamSocket) {
 }
 
 //LLancem thread per iniciar un nou fil que envïi la trama 0x05 amb longitud data 247 per parts.
+// Bloqueja fins que el Worker concedeix crèdit per a la següent trama 0x05
+static int esperarCredits(int workerSocket, int *credits) {
+    while (*credits <= 0) {
+        Frame creditFrame = {0};
+        if (leerTrama(workerSocket, &creditFrame) != 0) {
+            customPrintf("[ERROR]: No se recibieron créditos del Worker.");
+            return -1;
+        }
+
+        if (creditFrame.type == FRAME_CREDIT_TYPE) {
+            *credits += atoi(creditFrame.data);
+        } else {
+            logWarning("[WARNING]: Trama inesperada mientras se esperaban créditos.");
+        }
+    }
+
+    (*credits)--;
+    return 0;
+}
+
+// Llança el fil que rep el fitxer distorsionat del Worker (Harley o Enigma segons el tipus)
+static int escoltarResultat(DistortionState *state) {
+    pthread_t listenerThread;
+    int media = strcmp(state->mediaType, "MEDIA") == 0;
+    if (pthread_create(&listenerThread, NULL, media ? listenToHarley : listenToEnigma, agafarDistorsio(state)) != 0) {
+        customPrintf(media ? "[ERROR]: No se pudo crear el hilo para escuchar a Harley."
+                           : "[ERROR]: No se pudo crear el hilo para escuchar a Enigma.");
+        deixarDistorsio(state);
+        return -1;
+    }
+    pthread_detach(listenerThread);
+    return 0;
+}
+
 void *sendFileChunks(void *args) {
     DistortRequestArgs *requestArgs = (DistortRequestArgs *)args;
-    int workerSocket = requestArgs->workerSocket;
-    const char *filePath = requestArgs->filePath;
+    DistortionState *state = requestArgs->state;
+
+    // Resultat a la memòria cau del Worker, o l'arxiu ja hi és sencer: res a pujar
+    if (requestArgs->cached || requestArgs->offset >= requestArgs->fileSize) {
+        customPrintf(requestArgs->cached ? "\nEl Worker ja tenia el resultat de %s, no cal enviar el fitxer.\n"
+                                         : "\nEl Worker ja tenia el fitxer %s, no cal enviar-lo.\n", state->fileName);
+        state->progress = 50.0;
+        free(requestArgs);
+        if (escoltarResultat(state) != 0) {
+            acabarDistorsio(state, DISTORTION_FAILED);
+        }
+        return NULL;
+    }
+
+    int workerSocket = state->workerSocket;
     off_t fileSize = requestArgs->fileSize;
+    uint32_t bulkChunkSize = requestArgs->bulkChunkSize;
+    uint32_t creditWindow = requestArgs->creditWindow;
+    uint32_t zeroCopy = requestArgs->zeroCopy;
+    uint32_t streaming = requestArgs->stream;
+    off_t offset = requestArgs->offset;
+    int credits = (int)creditWindow; // Trames que podem enviar abans d'esperar una 0x14
     free(requestArgs); // Liberar memoria de los argumentos
 
-    int fd = open(filePath, O_RDONLY, 0666);
+    int fd = open(state->filePath, O_RDONLY, 0666);
     if (fd < 0) {
         customPrintf("[ERROR]: No se pudo abrir el archivo especificado.");
+        acabarDistorsio(state, DISTORTION_FAILED);
         return NULL;
     }
-
-    BinaryFrame frame = {0};
-    //BinaryFrame lastFrame;
-    static int reassigningInProgress = 0; // Variable para controlar la reasignación
-
-    char buffer[DATA_SIZE]; // Tamaño permitido para DATA (247 bytes)
-    ssize_t bytesRead;
-    ssize_t totalSent = 0;
-    int status = 1;
-
-    // Extraer el nombre del archivo para el progreso
-    char *fileName = strrchr(filePath, '/');
-    if (fileName == NULL) {
-        fileName = (char *)filePath; // Si no hay directorio, usar todo el path
-    } else {
-        fileName++; // Saltar el '/'
+    if (offset > 0) {
+        customPrintf("\nEl Worker ja té %lld bytes de %s, s'envia la resta.\n", (long long)offset, state->fileName);
+        lseek(fd, offset, SEEK_SET);
     }
 
-    while ((bytesRead = read(fd, buffer, sizeof(buffer))) > 0) {    
-        frame.type = 0x05;
-        frame.data_length = bytesRead;
-        memcpy(frame.data, buffer, bytesRead);
-        frame.timestamp = (uint32_t)time(NULL);
-        frame.checksum = calculate_checksum_binary(frame.data, frame.data_length, 1);
+    // Mode STREAM: el resultat arriba mentre s'envia, i el fil d'escolta ens passa els crèdits
+    if (streaming) {
+        flow_control_reset(&state->streamUploadFlow, (int)creditWindow);
+        if (escoltarResultat(state) != 0) {
+            acabarDistorsio(state, DISTORTION_FAILED);
+            close(fd);
+            return NULL;
+        }
+    }
 
-        //memcpy(&lastFrame, &frame, sizeof(BinaryFrame)); //Guardem la trama per si hi ha error al enviar-la
+    BinaryFrame frame = {0};
 
-        ssize_t sentBytes = escribirTramaBinaria(workerSocket, &frame);
-        usleep(5000); // Espera 1 ms (ajustable)
+    // Tamaño permitido para DATA: 247 bytes o la mida BULK negociada
+    size_t chunkSize = bulkChunkSize > 0 ? bulkChunkSize : DATA_SIZE;
+    char *buffer = zeroCopy ? NULL : malloc(chunkSize); // Amb còpia zero la DATA no passa per l'espai d'usuari
+    if (!zeroCopy && !buffer) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para el buffer de envío.");
+        if (!streaming) {
+            acabarDistorsio(state, DISTORTION_FAILED);
+        }
+        close(fd);
+        return NULL;
+    }
+    ssize_t bytesRead;
+    ssize_t totalSent = offset;
+    int lost = 0; // 1 si s'ha perdut el Worker: la reassignació torna a començar en un altre fil
+
+    while ((bytesRead = zeroCopy ? bulk_next_chunk_length(fd, chunkSize) : read(fd, buffer, chunkSize)) > 0) {    
+        ssize_t sentBytes;
+        if (streaming && creditWindow > 0 && flow_control_acquire(&state->streamUploadFlow) != 0) {
+            // El fil d'escolta ha perdut Enigma i en gestiona la reassignació
+            customPrintf("[ERROR]: No se recibieron créditos del Worker.");
+            break;
+        } else if (!streaming && creditWindow > 0 && esperarCredits(workerSocket, &credits) != 0) {
+            customPrintf("Conexión con el Worker de %s perdida. Intentando reasignación...\n", state->fileName);
+            lost = 1;
+            break;
+        } else if (zeroCopy) {
+            pthread_mutex_lock(&state->workerWriteMutex);
+            sentBytes = escribirTramaBulkDesdeFichero(workerSocket, fd, (uint32_t)bytesRead);
+            pthread_mutex_unlock(&state->workerWriteMutex);
+        } else if (bulkChunkSize > 0) {
+            pthread_mutex_lock(&state->workerWriteMutex);
+            sentBytes = escribirTramaBulk(workerSocket, buffer, (uint32_t)bytesRead);
+            pthread_mutex_unlock(&state->workerWriteMutex);
+        } else {
+            frame.type = 0x05;
+            frame.data_length = bytesRead;
+            memcpy(frame.data, buffer, bytesRead);
+            frame.timestamp = (uint32_t)time(NULL);
+            frame.checksum = calculate_checksum_binary(frame.data, frame.data_length, 1);
+
+            pthread_mutex_lock(&state->workerWriteMutex);
+            sentBytes = escribirTramaBinaria(workerSocket, &frame);
+            pthread_mutex_unlock(&state->workerWriteMutex);
+            if (creditWindow == 0) {
+                usleep(5000); // Worker antic: espaiat fix entre trames
+            }
+        }
 
         if (sentBytes < 0) {
-            // Se conectó a un nuevo Worker, continuar desde el offset
-            usleep(10000);  // Esperar 100ms antes de reintentar
-            totalSent -= 247; // Restar el tamaño del chunk enviado
-            lseek(fd, totalSent, SEEK_SET); // Volver al offset anterior
-    
-            if (errno == EPIPE || errno == ECONNRESET) {
-                customPrintf("Conexión con Harley perdida. Intentando reasignación...\n");
-                close(workerSocket);
-                workerSocket = -1; 
-
-                if (!reassigningInProgress) {
-                    reassigningInProgress = 1;
-                    if (!solicitarReasignacionAWorker(globalState)) {
-                        customPrintf("[ERROR]: No se pudo reasignar el Worker.");
-                        free(globalState);
-                        return NULL;
-                    }
-                }
-
-                //TODO MIRAR AQUÍ EL CODI QUE ESTÀ PASSANT
-                while (workerSocket != globalState->workerSocket) {
-                    usleep(1000); // Espera 1ms (ajustable)
-                    workerSocket = globalState->workerSocket;
-                } 
+            if (streaming || errno == EPIPE || errno == ECONNRESET) {
+                // En mode STREAM la reassignació la demana el fil d'escolta
+                customPrintf("Conexión con el Worker de %s perdida. Intentando reasignación...\n", state->fileName);
+                lost = 1;
+                break;
             }
-            
+            usleep(10000);
+            lseek(fd, totalSent, SEEK_SET); // Tornar a enviar el mateix tros
         } else {
             totalSent += bytesRead;
-            statusResult = ((float)totalSent / (float)fileSize) * 50.0;
-            status++;
+            state->progress = ((float)totalSent / (float)fileSize) * 50.0;
+        }
+        if (bulkChunkSize == 0 && creditWindow == 0) {
+            usleep(3000);
         }
-        usleep(3000);
+    }
+    free(buffer);
+    close(fd);
+
+    if (streaming) {
+        if (bytesRead == 0) {
+            customPrintf("\nFitxer %s enviat correctament\n", state->fileName);
+        }
+        return NULL;
     }
 
     // 🚨 Comprobación final
-    if (bytesRead < 0) {
+    if (lost) {
+        if (!solicitarReasignacionAWorker(state)) {
+            acabarDistorsio(state, DISTORTION_FAILED);
+        }
+    } else if (bytesRead < 0) {
         customPrintf("\n[ERROR] ❌ write() devolvió error: errno=%d (%s)", errno, strerror(errno));
-    } else if (bytesRead == 0) {
+        acabarDistorsio(state, DISTORTION_FAILED);
+    } else {
         // Terminó el fichero
-        customPrintf("\nFitxer enviat correctament\n");
+        customPrintf("\nFitxer %s enviat correctament\n", state->fileName);
 
         // Aquí lanzas de nuevo el hilo 
-        if (strcmp(globalState->mediaType, "MEDIA") == 0) {
-            pthread_t harleyListenerThread;
-            int *socketArg = malloc(sizeof(int));
-            *socketArg = workerSocket;
-            if (pthread_create(&harleyListenerThread, NULL, listenToHarley, socketArg) != 0) {
-                customPrintf("[ERROR]: No se pudo crear el hilo para escuchar a Harley.");
-                return NULL;
-            }
-            pthread_detach(harleyListenerThread);
-        } else if (strcmp(globalState->mediaType, "TEXT") == 0) {
-            pthread_t enigmaListenerThread;
-            int *socketArgEn = malloc(sizeof(int));
-            *socketArgEn = workerSocket;
-            if (pthread_create(&enigmaListenerThread, NULL, listenToEnigma, socketArgEn) != 0) {
-                customPrintf("[ERROR]: No se pudo crear el hilo para escuchar a Enigma.");
-                return NULL;
-            }
-            pthread_detach(enigmaListenerThread);
+        if (escoltarResultat(state) != 0) {
+            acabarDistorsio(state, DISTORTION_FAILED);
         }
     }
 
-    close(fd);
-
     return NULL;
 }
 
@@ -1013,111 +1332,146 @@ void sendMD5Response(int clientSocket, const char *status) {
     }
 }
 
-DistortRequestArgs* sendDistortFileRequest(int workerSocket, const char *fileName, off_t fileSize, const char *md5Sum, const char *factor) {
-    char *filePath = NULL;
-    if (asprintf(&filePath, "%s%s", FILE_PATH, fileName) == -1) {
-        customPrintf("[ERROR]: No se pudo asignar memoria para el path del archivo.");
-        return NULL;
-    }
-
+DistortRequestArgs* sendDistortFileRequest(DistortionState *state, int workerSocket) {
     if (workerSocket < 0) {
         customPrintf("[ERROR]: workerSocket no es válido. Verifica la conexión con el Worker.");
-        free(filePath);
         return NULL;
     }
 
-    // Guardar el nombre del archivo en la variable global
-    strncpy(distortedFileName, fileName, sizeof(distortedFileName) - 1);
+    // Enviar trama inicial de DISTORT FILE (0x03), demanant el mode BULK
+    TransferOptions requestedOptions = {0};
+    char optionsStr[TRANSFER_OPTIONS_SIZE];
+    requestedOptions.bulkChunkSize = clamp_bulk_chunk_size(BULK_CHUNK_DEFAULT);
+    requestedOptions.creditWindow = FLOW_CONTROL_WINDOW;
+    requestedOptions.zeroCopy = 1;
+    requestedOptions.stream = strcmp(state->mediaType, "TEXT") == 0; // Només el filtre de text és en streaming
+    requestedOptions.cached = 1; // Entenem la resposta CACHE=1 (resultat ja calculat)
+    requestedOptions.have = 1;   // Entenem la resposta HAVE=<bytes> (el Worker ja té part de l'arxiu)
+    format_transfer_options(&requestedOptions, optionsStr, sizeof(optionsStr));
 
-    // Enviar trama inicial de DISTORT FILE (0x03)
     Frame frame = {0};
-    snprintf(frame.data, sizeof(frame.data), "%s&%s&%ld&%s&%s", 
-             globalFleckConfig->user, fileName, fileSize, md5Sum, factor);
+    if (snprintf(frame.data, sizeof(frame.data), "%s&%s&%ld&%s&%s&%s", 
+                 globalFleckConfig->user, state->fileName, state->fileSize, state->md5, state->factor, optionsStr) >= (int)sizeof(frame.data)) {
+        customPrintf("[ERROR]: El nombre del archivo no cabe en la trama DISTORT FILE.");
+        return NULL;
+    }
     frame.type = 0x03;
     frame.data_length = strlen(frame.data);
     frame.timestamp = (uint32_t)time(NULL);
     frame.checksum = calculate_checksum(frame.data, frame.data_length, 1);
 
-    if (workerSocket < 0) {
-        customPrintf("[ERROR]: workerSocket no es válido. Verifica la conexión con el Worker.");
-        free(filePath);
-        return NULL;
-    }
-
     if (escribirTrama(workerSocket, &frame) < 0) {
         customPrintf("[ERROR]: Error al enviar solicitud DISTORT FILE.");
-        free(filePath);
         return NULL;
     }
 
-    // Esperar respuesta de Harley
+    // Esperar respuesta del Worker
     Frame response = {0};
     if (leerTrama(workerSocket, &response) != 0 || response.type != 0x03) {
         customPrintf("[ERROR]: No se recibió confirmación de conexión del Worker.");
-        free(filePath);
         return NULL;
     }
 
     if (strcmp(response.data, "CON_KO") == 0) {
         customPrintf("[ERROR]: Worker rechazó la conexión.");
-        free(filePath);
         return NULL;
     }
+
+    // Un Worker antic respon amb DATA buida: trames 0x05 clàssiques
+    TransferOptions acceptedOptions;
+    parse_transfer_options(response.data, &acceptedOptions);
+    state->negotiatedCreditWindow = acceptedOptions.creditWindow;
+    state->negotiatedStream = acceptedOptions.stream;
+    state->receivedFileSize = 0;
     
-    // Cierra el socket anterior para forzar que el hilo anterior salga
-    if (globalState->workerSocket != -1 && globalState->workerSocket != workerSocket) {
-        close(globalState->workerSocket);  // Esto hace que el read falle y el hilo muera
+    // Talla el socket anterior (reassignació) para forzar que el hilo anterior salga
+    pthread_mutex_lock(&progressMutex);
+    if (state->workerSocket != -1 && state->workerSocket != workerSocket) {
+        retirarSocket(state, state->workerSocket);  // Esto hace que el read falle y el hilo muera
     }
-    // Actualiza el socket en el estado global
-    globalState->workerSocket = workerSocket;
-
-    //Dos threads al mateix temps
-    pthread_mutex_lock(&distortionMutex);
-    distortionInProgress = 1; // Distorsión en curso
-    pthread_mutex_unlock(&distortionMutex);
+    state->workerSocket = workerSocket;
+    pthread_mutex_unlock(&progressMutex);
 
-    // Preparar hilo para enviar las tramas 0x05
-                
     DistortRequestArgs *args = malloc(sizeof(DistortRequestArgs));
     if (!args) {
         customPrintf("[ERROR]: No se pudo asignar memoria para los argumentos del thread.");
         return NULL;
     }
 
-    args->workerSocket = workerSocket;
-    args->filePath = filePath;
-    args->fileSize = fileSize;
+    args->state = state;
+    args->fileSize = state->fileSize;
+    args->bulkChunkSize = acceptedOptions.bulkChunkSize;
+    args->creditWindow = acceptedOptions.creditWindow;
+    args->zeroCopy = acceptedOptions.bulkChunkSize > 0 ? acceptedOptions.zeroCopy : 0;
+    args->stream = acceptedOptions.stream;
+    args->cached = acceptedOptions.cached;
+    args->offset = acceptedOptions.have < (uint64_t)state->fileSize ? (off_t)acceptedOptions.have : state->fileSize;
 
     return args;
 }
 
-int solicitarReasignacionAWorker(DistortionState *globalState) {
-    if(!globalState){
+// Fil d'una distorsió: es connecta al Worker que ha triat Gotham, hi negocia la transferència i hi puja l'arxiu
+void *runDistortion(void *arg) {
+    DistortionState *state = (DistortionState *)arg;
+
+    // El MD5 es calcula aquí i no a la comanda, perquè es puguin llançar moltes distorsions seguides
+    if (state->md5[0] == '\0') {
+        calculate_md5(state->filePath, state->md5);
+    }
+
+    int workerSocket = connect_to_server(state->workerIp, state->workerPort);
+    if (workerSocket < 0) {
+        customPrintf("[ERROR]: No se pudo conectar al Worker %s:%d para %s.\n", state->workerIp, state->workerPort, state->fileName);
+        acabarDistorsio(state, DISTORTION_FAILED);
+        deixarDistorsio(state);
+        return NULL;
+    }
+
+    DistortRequestArgs *args = sendDistortFileRequest(state, workerSocket);
+    if (!args) {
+        pthread_mutex_lock(&progressMutex);
+        if (state->workerSocket == workerSocket) {
+            state->workerSocket = -1;
+        }
+        pthread_mutex_unlock(&progressMutex);
+        close(workerSocket);
+        acabarDistorsio(state, DISTORTION_FAILED);
+        deixarDistorsio(state);
+        return NULL;
+    }
+
+    sendFileChunks(args);
+    deixarDistorsio(state);
+    return NULL;
+}
+
+int solicitarReasignacionAWorker(DistortionState *state) {
+    if (!state) {
         customPrintf("Estado de distorsión no válido.\n");
         return 0;
     }
 
-    Frame frame = {0};
-    frame.type = 0x11; // Tipo de trama para reasignar Worker
-    size_t maxMediaTypeLen = 9; // Longitud máxima para mediaType
-    size_t maxFileNameLen = sizeof(frame.data) - maxMediaTypeLen - 2; // Restamos 2: '&' y '\0'
-    snprintf(frame.data, sizeof(frame.data), "%.*s&%.*s",
-         (int)maxMediaTypeLen, globalState->mediaType, 
-         (int)maxFileNameLen, globalState->fileName);
-    frame.data[sizeof(frame.data) - 1] = '\0'; // Garantizar el final nulo
-    frame.data_length = strlen(frame.data);
-    frame.timestamp = (uint32_t)time(NULL);
-    frame.checksum = calculate_checksum(frame.data, frame.data_length, 1);
+    // El fil d'enviament i el d'escolta poden detectar la caiguda alhora: només es demana un cop
+    pthread_mutex_lock(&progressMutex);
+    int jaDemanada = state->reassigning;
+    state->reassigning = 1;
+    pthread_mutex_unlock(&progressMutex);
+    if (jaDemanada) {
+        return 1;
+    }
 
-    if (escribirTrama(gothamSocket, &frame) < 0) {
+    if (demanarWorker(state, 0x11) != 0) {
         customPrintf("[ERROR]: No se pudo enviar la solicitud de reasignación a Gotham.");
+        pthread_mutex_lock(&progressMutex);
+        state->reassigning = 0;
+        pthread_mutex_unlock(&progressMutex);
         return 0; // Fallo en la reasignación
     }
 
     return 1; // Reasignación exitosa
 }
 
-void processDistortFileCommand(const char *fileName, const char *factor, int gothamSocket) {
+void processDistortFileCommand(const char *fileName, const char *factor) {
     if (!fileName || !factor) {
         customPrintf("[ERROR]: DISTORT command requires a FileName and a Factor.");
         return;
@@ -1140,6 +1494,25 @@ void processDistortFileCommand(const char *fileName, const char *factor, int got
         return;
     }
 
+    // El resultat substitueix l'arxiu: dues distorsions del mateix arxiu alhora es trepitjarien
+    pthread_mutex_lock(&progressMutex);
+    int enCurs = 0;
+    for (int i = 0; i < distortionCount; i++) {
+        if (distortions[i]->result == DISTORTION_RUNNING && strcmp(distortions[i]->fileName, fileName) == 0) {
+            enCurs = 1;
+        }
+    }
+    int ple = distortionCount == MAX_FILES;
+    pthread_mutex_unlock(&progressMutex);
+    if (enCurs) {
+        customPrintf("[ERROR]: %s ja s'està distorsionant.\n", fileName);
+        return;
+    }
+    if (ple) {
+        customPrintf("[ERROR]: Massa distorsions. Fes CLEAR ALL per treure les acabades.\n");
+        return;
+    }
+
     // Construir el path completo del archivo
     char *filePath = NULL;
     if (asprintf(&filePath, "%s%s", FILE_PATH, fileName) == -1) {
@@ -1148,53 +1521,47 @@ void processDistortFileCommand(const char *fileName, const char *factor, int got
     }
 
     // Calcular el tamaño del archivo
-    int fd = open(filePath, O_RDONLY);
-    if (fd < 0) {
+    struct stat fileInfo;
+    if (stat(filePath, &fileInfo) != 0) {
         customPrintf("[ERROR]: No se pudo abrir el archivo especificado.");
         free(filePath);
         return;
     }
 
-    off_t fileSize = lseek(fd, 0, SEEK_END);
-    if (fileSize < 0) {
-        customPrintf("[ERROR]: No se pudo calcular el tamaño del archivo.");
-        close(fd);
-        free(filePath);
-        return;
-    }
-    close(fd);
-
-    // Calcular el MD5 del archivo
-    char md5Sum[33] = {0};
-    calculate_md5(filePath, md5Sum);
-
     // Crear e inicializar el estado de distorsión
-    globalState = malloc(sizeof(DistortionState));
-    if (!globalState) {
+    DistortionState *state = calloc(1, sizeof(DistortionState));
+    if (!state) {
         customPrintf("[ERROR]: Could not allocate memory for distortion state.");
         free(filePath);
         return;
     }
 
-    strncpy(globalState->mediaType, mediaType, sizeof(globalState->mediaType));
-    strncpy(globalState->fileName, fileName, sizeof(globalState->fileName));
-    strncpy(globalState->md5, md5Sum, sizeof(globalState->md5));
-    strncpy(globalState->factor, factor, sizeof(globalState->factor));
-    globalState->fileOffset = 0; // Comienza desde el principio
-    globalState->fileSize = fileSize;
-    globalState->filePath = filePath;
-    globalState->workerSocket = -1; // Se actualizará al conectarse al Worker
+    strncpy(state->mediaType, mediaType, sizeof(state->mediaType) - 1);
+    strncpy(state->fileName, fileName, sizeof(state->fileName) - 1);
+    strncpy(state->factor, factor, sizeof(state->factor) - 1);
+    state->fileSize = fileInfo.st_size;
+    state->filePath = filePath;
+    state->workerSocket = -1; // Se actualizará al conectarse al Worker
+    state->result = DISTORTION_RUNNING;
+    state->refs = 1;          // La de distortions[]
+    state->listed = 1;
+    flow_control_init(&state->streamUploadFlow);
+    pthread_mutex_init(&state->workerWriteMutex, NULL);
 
-    // Enviar solicitud DISTORT a Gotham
-    Frame frame = {0};
-    snprintf(frame.data, sizeof(frame.data), "%s&%s", mediaType, fileName);
-    frame.type = 0x10;
-    frame.data_length = strlen(frame.data);
-    frame.timestamp = (uint32_t)time(NULL);
-    frame.checksum = calculate_checksum(frame.data, frame.data_length, 1);
+    pthread_mutex_lock(&progressMutex);
+    distortions[distortionCount++] = state;
+    pthread_mutex_unlock(&progressMutex);
+
+    pthread_mutex_lock(&distortionMutex);
+    distortionsInProgress++;
+    pthread_mutex_unlock(&distortionMutex);
 
+    // Enviar solicitud DISTORT a Gotham
     customPrintf("\nDistorsion started!\n");
-    escribirTrama(gothamSocket, &frame);
+    if (demanarWorker(state, 0x10) != 0) {
+        customPrintf("[ERROR]: No se pudo enviar la solicitud DISTORT a Gotham.");
+        acabarDistorsio(state, DISTORTION_FAILED);
+    }
 }
 
 // Nueva función para liberar recursos asignados por Fleck
@@ -1223,9 +1590,12 @@ void releaseResources() {
         gothamSocket = -1;
     }
 
-    if (workerSocket >= 0) {
-        close(workerSocket);
-        workerSocket = -1;
+    // El procés acaba: no s'espera els fils de les distorsions
+    for (int i = 0; i < distortionCount; i++) {
+        if (distortions[i]->workerSocket >= 0) {
+            close(distortions[i]->workerSocket);
+            distortions[i]->workerSocket = -1;
+        }
     }
 }
 
@@ -1290,14 +1660,18 @@ void signalHandler(int sig) {
             gothamSocket = -1;
         }
 
-        // Desconexión de Worker
-        if (workerSocket >= 0) {
-            sendDisconnectFrameToWorker(workerSocket, globalFleckConfig->user);
-            close(workerSocket);
-            workerSocket = -1;
+        // Desconexión de los Workers de cada distorsión
+        for (int i = 0; i < distortionCount; i++) {
+            if (distortions[i]->workerSocket >= 0) {
+                sendDisconnectFrameToWorker(distortions[i]->workerSocket, globalFleckConfig->user);
+            }
         }
 
-        customPrintf("\nDesconnexió completada\n");
+        // customPrintf passa pel buffer del fil i l'anell de consola: des d'un senyal, write directe
+        static const char missatge[] = "\nDesconnexió completada\n";
+        if (write(STDOUT_FILENO, missatge, sizeof(missatge) - 1) < 0) {
+            // Sense consola no hi ha res més a fer
+        }
         // Liberar recursos asignados
         releaseResources();
         exit(0);
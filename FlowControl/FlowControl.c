@@ -0,0 +1,107 @@
+#include "FlowControl.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include "../GestorTramas/GestorTramas.h"
+
+void flow_control_init(FlowControl *fc) {
+    if (!fc) return;
+
+    fc->credits = 0;
+    fc->closed = 0;
+    pthread_mutex_init(&fc->mutex, NULL);
+    pthread_cond_init(&fc->cond, NULL);
+}
+
+// Prepara una nova transferència amb la finestra negociada
+void flow_control_reset(FlowControl *fc, int window) {
+    if (!fc) return;
+
+    pthread_mutex_lock(&fc->mutex);
+    fc->credits = window;
+    fc->closed = 0;
+    pthread_mutex_unlock(&fc->mutex);
+}
+
+// Consumeix un crèdit, esperant si cal. Retorna -1 si la connexió s'ha tancat o no arriben crèdits.
+int flow_control_acquire(FlowControl *fc) {
+    if (!fc) return -1;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += FLOW_CONTROL_TIMEOUT_SEC;
+
+    pthread_mutex_lock(&fc->mutex);
+    while (fc->credits == 0 && !fc->closed) {
+        if (pthread_cond_timedwait(&fc->cond, &fc->mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    int result = -1;
+    if (fc->credits > 0 && !fc->closed) {
+        fc->credits--;
+        result = 0;
+    }
+    pthread_mutex_unlock(&fc->mutex);
+
+    return result;
+}
+
+void flow_control_grant(FlowControl *fc, int credits) {
+    if (!fc || credits <= 0) return;
+
+    pthread_mutex_lock(&fc->mutex);
+    fc->credits += credits;
+    pthread_cond_broadcast(&fc->cond);
+    pthread_mutex_unlock(&fc->mutex);
+}
+
+// Desperta l'emissor perquè abandoni l'enviament
+void flow_control_close(FlowControl *fc) {
+    if (!fc) return;
+
+    pthread_mutex_lock(&fc->mutex);
+    fc->closed = 1;
+    pthread_cond_broadcast(&fc->cond);
+    pthread_mutex_unlock(&fc->mutex);
+}
+
+void flow_control_destroy(FlowControl *fc) {
+    if (!fc) return;
+
+    pthread_mutex_destroy(&fc->mutex);
+    pthread_cond_destroy(&fc->cond);
+}
+
+// Els crèdits es retornen en lots de mitja finestra per no enviar una trama 0x14 per cada trama de dades
+int flow_control_batch(int window) {
+    return window > 1 ? window / 2 : 1;
+}
+
+int flow_control_consume(int *consumed, int window) {
+    if (!consumed || window <= 0) return 0;
+
+    int batch = flow_control_batch(window);
+    (*consumed)++;
+    if (*consumed < batch) {
+        return 0;
+    }
+
+    *consumed -= batch;
+    return batch;
+}
+
+int enviarTramaCredit(int socket_fd, int credits) {
+    Frame frame = {0};
+    frame.type = FRAME_CREDIT_TYPE;
+    snprintf(frame.data, sizeof(frame.data), "%d", credits);
+    frame.data_length = strlen(frame.data);
+    frame.timestamp = (uint32_t)time(NULL);
+    frame.checksum = calculate_checksum(frame.data, frame.data_length, 0);
+
+    return escribirTrama(socket_fd, &frame);
+}
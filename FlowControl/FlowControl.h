@@ -0,0 +1,37 @@
+#ifndef FLOW_CONTROL_H
+#define FLOW_CONTROL_H
+
+#include <pthread.h>
+
+// Control de flux per crèdits de les transferències 0x05 (Fleck <-> Worker)
+// El receptor concedeix crèdits amb trames 0x14; cada crèdit permet enviar una trama de dades.
+#define FRAME_CREDIT_TYPE 0x14
+
+#ifndef FLOW_CONTROL_WINDOW
+#define FLOW_CONTROL_WINDOW 64        // Trames en vol abans d'esperar crèdits
+#endif
+#define FLOW_CONTROL_TIMEOUT_SEC 30   // Temps màxim esperant crèdits abans de donar l'enviament per perdut
+
+typedef struct {
+    int credits;     // Trames que encara es poden enviar
+    int closed;      // 1 si la connexió s'ha tancat i no arribaran més crèdits
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} FlowControl;
+
+// Part emissora quan els crèdits arriben per un altre fil
+void flow_control_init(FlowControl *fc);
+void flow_control_reset(FlowControl *fc, int window);
+int flow_control_acquire(FlowControl *fc);
+void flow_control_grant(FlowControl *fc, int credits);
+void flow_control_close(FlowControl *fc);
+void flow_control_destroy(FlowControl *fc);
+
+// Part receptora: quants crèdits s'han de retornar després de consumir una trama (0 si cap)
+int flow_control_batch(int window);
+int flow_control_consume(int *consumed, int window);
+
+// Trama 0x14
+int enviarTramaCredit(int socket_fd, int credits);
+
+#endif
@@ -5,11 +5,110 @@
 #include <stdlib.h>
 #include <poll.h>
 #include <stdio.h>
+#include <errno.h>
 
 #include "../DataConversion/DataConversion.h"
 #include "../Logging/Logging.h"
 #include "../FrameUtilsBinary/FrameUtilsBinary.h"
 
+// Versió de protocol negociada per a cada socket (0 = v1 per defecte)
+static unsigned char frameProtocols[FRAME_PROTOCOL_MAX_FDS];
+
+static void put_u16(char *buffer, uint16_t value) {
+    buffer[0] = (char)(value >> 8);
+    buffer[1] = (char)(value & 0xFF);
+}
+
+static void put_u32(char *buffer, uint32_t value) {
+    buffer[0] = (char)(value >> 24);
+    buffer[1] = (char)((value >> 16) & 0xFF);
+    buffer[2] = (char)((value >> 8) & 0xFF);
+    buffer[3] = (char)(value & 0xFF);
+}
+
+static uint16_t get_u16(const char *buffer) {
+    return (uint16_t)(((uint8_t)buffer[0] << 8) | (uint8_t)buffer[1]);
+}
+
+static uint32_t get_u32(const char *buffer) {
+    return ((uint32_t)(uint8_t)buffer[0] << 24) | ((uint32_t)(uint8_t)buffer[1] << 16) |
+           ((uint32_t)(uint8_t)buffer[2] << 8) | (uint32_t)(uint8_t)buffer[3];
+}
+
+void set_frame_protocol(int socket_fd, int version) {
+    if (socket_fd < 0 || socket_fd >= FRAME_PROTOCOL_MAX_FDS) return;
+    frameProtocols[socket_fd] = (version == FRAME_PROTOCOL_V2) ? FRAME_PROTOCOL_V2 : 0;
+}
+
+int get_frame_protocol(int socket_fd) {
+    if (socket_fd < 0 || socket_fd >= FRAME_PROTOCOL_MAX_FDS) return FRAME_PROTOCOL_V1;
+    return frameProtocols[socket_fd] == FRAME_PROTOCOL_V2 ? FRAME_PROTOCOL_V2 : FRAME_PROTOCOL_V1;
+}
+
+// Llegeix exactament length bytes (0 si tot correcte, -1 si error o desconnexió)
+int read_full(int fd, void *buffer, size_t length) {
+    size_t total = 0;
+    while (total < length) {
+        ssize_t bytesRead = read(fd, (char *)buffer + total, length - total);
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (bytesRead == 0) return -1;
+        total += bytesRead;
+    }
+    return 0;
+}
+
+// En sockets no bloquejants (reactor de Gotham) espera que el socket torni a acceptar dades
+static int wait_writable(int fd) {
+    struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+    int ready;
+    do {
+        ready = poll(&pfd, 1, FRAME_WRITE_TIMEOUT_MS);
+    } while (ready < 0 && errno == EINTR);
+    return ready > 0 ? 0 : -1;
+}
+
+// Escriu exactament length bytes (0 si tot correcte, -1 si error)
+int write_full(int fd, const void *buffer, size_t length) {
+    size_t total = 0;
+    while (total < length) {
+        ssize_t bytesSent = write(fd, (const char *)buffer + total, length - total);
+        if (bytesSent < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(fd) == 0) continue;
+            return -1;
+        }
+        total += bytesSent;
+    }
+    return 0;
+}
+
+// Escriu tots els segments amb writev (0 si tot correcte, -1 si error). Modifica iov si l'escriptura és parcial.
+int writev_full(int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t bytesSent = writev(fd, iov, iovcnt);
+        if (bytesSent < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(fd) == 0) continue;
+            return -1;
+        }
+
+        // Saltar els segments ja enviats i ajustar el primer pendent
+        while (iovcnt > 0 && (size_t)bytesSent >= iov->iov_len) {
+            bytesSent -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + bytesSent;
+            iov->iov_len -= bytesSent;
+        }
+    }
+    return 0;
+}
+
 // Serializa un frame en un buffer
 void serialize_frame(const Frame *frame, char *buffer) {
     if (!frame || !buffer) return;
@@ -71,30 +170,95 @@ int deserialize_frame(const char *buffer, Frame *frame) {
     return 0; // Deserialización exitosa
 }
 
+// Serialitza un frame amb la capçalera binària v2, retorna els bytes totals a enviar
+int serialize_frame_v2(const Frame *frame, char *buffer) {
+    if (!frame || !buffer) return -1;
+
+    uint16_t length = frame->data_length;
+    if (length > sizeof(frame->data) - 1) {
+        length = sizeof(frame->data) - 1;
+    }
+
+    buffer[0] = (char)frame->type;
+    put_u16(buffer + 1, length);
+    put_u16(buffer + 3, frame->checksum);
+    put_u32(buffer + 5, frame->timestamp);
+    memcpy(buffer + FRAME_V2_HEADER_SIZE, frame->data, length);
+
+    return FRAME_V2_HEADER_SIZE + length;
+}
+
+// Deserialitza la capçalera v2 (DATA es llegeix a part, amb DATA_LENGTH bytes)
+int deserialize_frame_v2_header(const char *buffer, Frame *frame) {
+    if (!buffer || !frame) return -1;
+
+    memset(frame, 0, sizeof(Frame));
+    frame->type = (uint8_t)buffer[0];
+    frame->data_length = get_u16(buffer + 1);
+    frame->checksum = get_u16(buffer + 3);
+    frame->timestamp = get_u32(buffer + 5);
+
+    if (frame->data_length > sizeof(frame->data) - 1) {
+        fprintf(stderr, "[ERROR][Deserialize] Longitud de datos excede el máximo permitido\n");
+        return -1;
+    }
+    return 0;
+}
+
 
 // Envía un frame a través de un socket
 int send_frame(int socket_fd, const Frame *frame) {
     if (!frame) return -1;
 
-    char buffer[FRAME_SIZE];
-    serialize_frame(frame, buffer);
+    if (get_frame_protocol(socket_fd) == FRAME_PROTOCOL_V2) {
+        // Capçalera + DATA en una sola crida, sense copiar DATA
+        char header[FRAME_V2_HEADER_SIZE];
+        uint16_t length = frame->data_length;
+        if (length > sizeof(frame->data) - 1) {
+            length = sizeof(frame->data) - 1;
+        }
 
-    size_t totalSent = 0;
-    while (totalSent < FRAME_SIZE) {
-        ssize_t bytesSent = write(socket_fd, buffer + totalSent, FRAME_SIZE - totalSent);
+        header[0] = (char)frame->type;
+        put_u16(header + 1, length);
+        put_u16(header + 3, frame->checksum);
+        put_u32(header + 5, frame->timestamp);
 
-        if (bytesSent < 0) {
+        struct iovec iov[2] = {
+            { header, FRAME_V2_HEADER_SIZE },
+            { (void *)frame->data, length }
+        };
+        if (writev_full(socket_fd, iov, 2) != 0) {
             perror("Error enviando el frame, ha podido caer antes otro servidor o cliente\n");
             return -1;
         }
+        return 0;
+    }
 
-        totalSent += bytesSent;
+    char buffer[FRAME_SIZE];
+    serialize_frame(frame, buffer);
+
+    if (write_full(socket_fd, buffer, FRAME_SIZE) != 0) {
+        perror("Error enviando el frame, ha podido caer antes otro servidor o cliente\n");
+        return -1;
     }
 
     return 0;
 }
 
-// Recibe un frame desde un socket
+// Completa una trama v2 de la qual ja s'ha llegit el TYPE (buffer[0])
+static int llegirRestaTramaV2(int socket_fd, char *buffer, Frame *frame) {
+    if (read_full(socket_fd, buffer + 1, FRAME_V2_HEADER_SIZE - 1) != 0 ||
+        deserialize_frame_v2_header(buffer, frame) != 0) {
+        return -1;
+    }
+    if (frame->data_length > 0 && read_full(socket_fd, frame->data, frame->data_length) != 0) {
+        return -1;
+    }
+    frame->data[frame->data_length] = '\0';
+    return 0;
+}
+
+// Recibe un frame desde un socket (detecta v1 o v2 pel primer byte)
 int receive_frame(int socket_fd, Frame *frame) {
     if (!frame) {
         fprintf(stderr, "Frame no válido (puntero NULL).\n");
@@ -102,21 +266,21 @@ int receive_frame(int socket_fd, Frame *frame) {
     }
 
     char buffer[FRAME_SIZE];
-    ssize_t totalBytesRead = 0;
-
     memset(buffer, 0, FRAME_SIZE);
 
-    while (totalBytesRead < FRAME_SIZE) {
-        ssize_t bytesRead = read(socket_fd, buffer + totalBytesRead, FRAME_SIZE - totalBytesRead);
+    errno = 0;
+    if (read_full(socket_fd, buffer, 1) != 0) {
+        if (errno != 0) perror("Error recibiendo el frame\n");
+        return -1;
+    }
 
-        if (bytesRead < 0) {
-            perror("Error recibiendo el frame\n");
-            return -1;
-        } else if (bytesRead == 0) {
-            return -1;
-        }
+    uint8_t firstByte = (uint8_t)buffer[0];
+    if (firstByte != 0x00 && firstByte <= FRAME_V2_MAX_TYPE) {
+        return llegirRestaTramaV2(socket_fd, buffer, frame);
+    }
 
-        totalBytesRead += bytesRead;
+    if (read_full(socket_fd, buffer + 1, FRAME_SIZE - 1) != 0) {
+        return -1;
     }
 
     if (buffer[0] == 0x00) {
@@ -146,11 +310,7 @@ int receive_any_frame(int socket_fd, void *frame, int *is_binary) {
 
     char buffer[FRAME_BINARY_SIZE];  // Usamos el tamaño de la trama más grande
 
-    //Llegim la trama del buffer
-    ssize_t bytesRead = read(socket_fd, buffer, FRAME_BINARY_SIZE);
-    //customPrintf("He leído de socketFD: %d, bytes leídos: %ld\n", socket_fd, bytesRead);
-
-    if (bytesRead <= 0) {
+    if (read_full(socket_fd, buffer, 1) != 0) {
         return -1;
     }
 
@@ -158,6 +318,16 @@ int receive_any_frame(int socket_fd, void *frame, int *is_binary) {
     uint8_t type = buffer[0];  // El primer byte es el tipo de trama
     *is_binary = (type == 0x05);  // Si es 0x05, es binaria; si no, es normal
 
+    // Amb v2 negociat les trames de control porten capçalera de 9 bytes; les 0x05 sempre són de mida fixa
+    if (!*is_binary && get_frame_protocol(socket_fd) == FRAME_PROTOCOL_V2) {
+        return llegirRestaTramaV2(socket_fd, buffer, (Frame *)frame);
+    }
+
+    //Llegim la resta de la trama: sense espaiat entre trames un read() pot retornar-ne només una part
+    if (read_full(socket_fd, buffer + 1, FRAME_BINARY_SIZE - 1) != 0) {
+        return -1;
+    }
+
     // 🔄 **Deserializar según el tipo**
     if (*is_binary) {
         return deserialize_frame_binary(buffer, (BinaryFrame *)frame);
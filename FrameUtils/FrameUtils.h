@@ -3,13 +3,23 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/uio.h>
 
 #define FRAME_SIZE 256
 #define DATA_MAX_SIZE (FRAME_SIZE - 9) // 256 - 1(TYPE) - 2(DATA_LENGTH) - 2(CHECKSUM) - 4(TIMESTAMP)
 #define TIMESTAMP_SIZE 64
 #define CHECKSUM_MODULO 65536
 
-#define printF(x) write(1, x, strlen(x))
+// Protocol v2: capçalera binària compacta + DATA de longitud variable
+#define FRAME_PROTOCOL_V1 1
+#define FRAME_PROTOCOL_V2 2
+#define FRAME_PROTOCOL_V2_TAG "V2"          // Marca que es negocia a les trames 0x01/0x02
+#define FRAME_V2_HEADER_SIZE 9              // 1(TYPE) + 2(DATA_LENGTH) + 2(CHECKSUM) + 4(TIMESTAMP)
+#define FRAME_V2_MAX_TYPE 0x1F              // En v1 el primer byte sempre és un dígit hexadecimal ASCII
+#define FRAME_PROTOCOL_MAX_FDS 65536
+#define FRAME_WRITE_TIMEOUT_MS 5000       // Espera màxima d'un socket no bloquejant ple abans de donar l'escriptura per fallida
+
+#include "../Logging/Logging.h" // printF
 
 // Estructura de un frame
 typedef struct {
@@ -26,6 +36,13 @@ int deserialize_frame(const char *buffer, Frame *frame);
 int send_frame(int socket_fd, const Frame *frame);
 int receive_frame(int socket_fd, Frame *frame);
 int receive_any_frame(int socket_fd, void *frame, int *is_binary);
+int serialize_frame_v2(const Frame *frame, char *buffer);
+int deserialize_frame_v2_header(const char *buffer, Frame *frame);
+void set_frame_protocol(int socket_fd, int version);
+int get_frame_protocol(int socket_fd);
+int read_full(int fd, void *buffer, size_t length);
+int write_full(int fd, const void *buffer, size_t length);
+int writev_full(int fd, struct iovec *iov, int iovcnt);
 uint16_t calculate_checksum(const char *data, size_t length, int include_null);
 void get_timestamp(char *timestamp);
 
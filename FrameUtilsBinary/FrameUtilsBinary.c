@@ -1,8 +1,15 @@
+#define _GNU_SOURCE // Necesario para splice y F_SETPIPE_SZ
+
 #include "FrameUtilsBinary.h"
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
 
 #include "../DataConversion/DataConversion.h"
 #include "../FrameUtils/FrameUtils.h"
@@ -46,21 +53,33 @@ int deserialize_frame_binary(const char *buffer, BinaryFrame *frame) {
 }
 
 
-// Envía un frame binario
+// Farciment de DATA de les trames binàries
+static const char zeroPadding[DATA_BINARY_MAX_SIZE];
+
+// Envía un frame binario: capçalera, DATA, farciment i cua amb un sol writev (mateix format que serialize_frame_binary)
 int send_frame_binary(int socket_fd, const BinaryFrame *frame) {
-    if (!frame) return -1;
+    if (!frame || frame->data_length > DATA_BINARY_MAX_SIZE) return -1;
 
-    char buffer[FRAME_BINARY_SIZE];
-    serialize_frame_binary(frame, buffer);
+    char header[3];
+    char trailer[6];
+    memcpy(header, &frame->type, sizeof(frame->type));
+    memcpy(header + 1, &frame->data_length, sizeof(frame->data_length));
+    memcpy(trailer, &frame->checksum, sizeof(frame->checksum));
+    memcpy(trailer + 2, &frame->timestamp, sizeof(frame->timestamp));
 
-    ssize_t bytesEnviados = write(socket_fd, buffer, FRAME_BINARY_SIZE);
-    
-    if (bytesEnviados < 0) {
+    struct iovec iov[4] = {
+        { header, sizeof(header) },
+        { (void *)frame->data, frame->data_length },
+        { (void *)zeroPadding, DATA_BINARY_MAX_SIZE - frame->data_length },
+        { trailer, sizeof(trailer) }
+    };
+
+    if (writev_full(socket_fd, iov, 4) != 0) {
         perror("Error enviando el frame binario");
         return -1;
     }
     
-    return bytesEnviados;  //  Devuelve el número de bytes enviados correctamente
+    return FRAME_BINARY_SIZE;  //  Devuelve el número de bytes enviados correctamente
 }
 
 // Recibe un frame binario
@@ -83,6 +102,268 @@ int receive_frame_binary(int socket_fd, BinaryFrame *frame) {
 }
 
 
+// Serialitza la capçalera d'una trama BULK (enters en ordre de xarxa)
+void serialize_bulk_header(const BulkFrameHeader *header, char *buffer) {
+    if (!header || !buffer) return;
+
+    buffer[0] = (char)header->type;
+    buffer[1] = (char)header->flags;
+    buffer[2] = (char)(header->data_length >> 24);
+    buffer[3] = (char)((header->data_length >> 16) & 0xFF);
+    buffer[4] = (char)((header->data_length >> 8) & 0xFF);
+    buffer[5] = (char)(header->data_length & 0xFF);
+    buffer[6] = (char)(header->checksum >> 8);
+    buffer[7] = (char)(header->checksum & 0xFF);
+    buffer[8] = (char)(header->timestamp >> 24);
+    buffer[9] = (char)((header->timestamp >> 16) & 0xFF);
+    buffer[10] = (char)((header->timestamp >> 8) & 0xFF);
+    buffer[11] = (char)(header->timestamp & 0xFF);
+}
+
+// Deserialitza la capçalera d'una trama BULK
+int deserialize_bulk_header(const char *buffer, BulkFrameHeader *header) {
+    if (!buffer || !header) return -1;
+
+    const uint8_t *bytes = (const uint8_t *)buffer;
+    header->type = bytes[0];
+    header->flags = bytes[1];
+    header->data_length = ((uint32_t)bytes[2] << 24) | ((uint32_t)bytes[3] << 16) |
+                          ((uint32_t)bytes[4] << 8) | (uint32_t)bytes[5];
+    header->checksum = (uint16_t)((bytes[6] << 8) | bytes[7]);
+    header->timestamp = ((uint32_t)bytes[8] << 24) | ((uint32_t)bytes[9] << 16) |
+                        ((uint32_t)bytes[10] << 8) | (uint32_t)bytes[11];
+
+    if (header->type != FRAME_BULK_TYPE || header->data_length > BULK_CHUNK_MAX) {
+        fprintf(stderr, "[ERROR][Deserialize] Capçalera BULK invàlida\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Envia una trama BULK: capçalera de 12 bytes + DATA sense farciment
+int send_frame_bulk(int socket_fd, const char *data, uint32_t length) {
+    if (!data || length > BULK_CHUNK_MAX) return -1;
+
+    BulkFrameHeader header = {0};
+    header.type = FRAME_BULK_TYPE;
+    header.data_length = length;
+    header.checksum = calculate_checksum_binary(data, length, 1);
+    header.timestamp = (uint32_t)time(NULL);
+
+    char headerBuffer[FRAME_BULK_HEADER_SIZE];
+    serialize_bulk_header(&header, headerBuffer);
+
+    struct iovec iov[2] = {
+        { headerBuffer, FRAME_BULK_HEADER_SIZE },
+        { (void *)data, length }
+    };
+    if (writev_full(socket_fd, iov, 2) != 0) {
+        perror("Error enviando el frame BULK");
+        return -1;
+    }
+
+    return (int)(FRAME_BULK_HEADER_SIZE + length);
+}
+
+// Còpia per l'espai d'usuari quan sendfile/splice no estan disponibles per a aquests descriptors
+static int copy_fd_to_fd(int in_fd, int out_fd, size_t length) {
+    char buffer[16384];
+
+    while (length > 0) {
+        size_t toRead = length < sizeof(buffer) ? length : sizeof(buffer);
+        ssize_t bytesRead = read(in_fd, buffer, toRead);
+        if (bytesRead < 0 && errno == EINTR) continue;
+        if (bytesRead <= 0) return -1;
+
+        if (write_full(out_fd, buffer, (size_t)bytesRead) != 0) return -1;
+        length -= (size_t)bytesRead;
+    }
+    return 0;
+}
+
+// Envia una trama BULK amb la DATA presa directament de la posició actual de file_fd (que avança)
+int send_frame_bulk_file(int socket_fd, int file_fd, uint32_t length) {
+    if (length > BULK_CHUNK_MAX) return -1;
+
+    BulkFrameHeader header = {0};
+    header.type = FRAME_BULK_TYPE;
+    header.flags = BULK_FLAG_ZERO_COPY;
+    header.data_length = length;
+    header.timestamp = (uint32_t)time(NULL);
+
+    char headerBuffer[FRAME_BULK_HEADER_SIZE];
+    serialize_bulk_header(&header, headerBuffer);
+
+    if (write_full(socket_fd, headerBuffer, FRAME_BULK_HEADER_SIZE) != 0) {
+        perror("Error enviando la cabecera BULK");
+        return -1;
+    }
+
+    size_t remaining = length;
+    while (remaining > 0) {
+        ssize_t sent = sendfile(socket_fd, file_fd, NULL, remaining);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EINVAL || errno == ENOSYS)) {
+            if (copy_fd_to_fd(file_fd, socket_fd, remaining) != 0) return -1;
+            break;
+        }
+        if (sent <= 0) {
+            perror("Error enviando el frame BULK con sendfile");
+            return -1;
+        }
+        remaining -= (size_t)sent;
+    }
+
+    return (int)(FRAME_BULK_HEADER_SIZE + length);
+}
+
+// Mou la DATA d'una trama BULK del socket al fitxer amb splice(2) (socket -> pipe -> fitxer)
+int receive_bulk_payload_to_file(int socket_fd, int file_fd, uint32_t length) {
+    int pipeFds[2];
+    if (pipe(pipeFds) != 0) {
+        return copy_fd_to_fd(socket_fd, file_fd, length);
+    }
+    fcntl(pipeFds[1], F_SETPIPE_SZ, BULK_PIPE_SIZE); // Si falla, es fa servir la mida per defecte
+
+    size_t remaining = length;
+    int result = 0;
+    int spliceOut = 1; // 0 si el fitxer no admet splice (p. ex. O_APPEND)
+
+    while (remaining > 0) {
+        ssize_t moved = splice(socket_fd, NULL, pipeFds[1], NULL, remaining, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (moved < 0 && errno == EINTR) continue;
+        if (moved < 0 && (errno == EINVAL || errno == ENOSYS)) {
+            result = copy_fd_to_fd(socket_fd, file_fd, remaining);
+            break;
+        }
+        if (moved <= 0) {
+            result = -1;
+            break;
+        }
+        remaining -= (size_t)moved;
+
+        size_t pending = (size_t)moved;
+        while (pending > 0 && spliceOut) {
+            ssize_t written = splice(pipeFds[0], NULL, file_fd, NULL, pending, SPLICE_F_MOVE);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) {
+                spliceOut = 0;
+                break;
+            }
+            pending -= (size_t)written;
+        }
+        if (pending > 0 && copy_fd_to_fd(pipeFds[0], file_fd, pending) != 0) {
+            result = -1;
+            break;
+        }
+    }
+
+    close(pipeFds[0]);
+    close(pipeFds[1]);
+    if (result != 0) {
+        perror("[ERROR][ReceiveFrame] Error recibiendo los datos BULK");
+    }
+    return result;
+}
+
+// Bytes de la següent trama de còpia zero: el que queda del fitxer des de la posició actual, fins a chunkSize
+ssize_t bulk_next_chunk_length(int file_fd, uint32_t chunkSize) {
+    off_t position = lseek(file_fd, 0, SEEK_CUR);
+    off_t end = lseek(file_fd, 0, SEEK_END);
+    if (position < 0 || end < 0 || lseek(file_fd, position, SEEK_SET) < 0) {
+        return -1;
+    }
+
+    off_t remaining = end - position;
+    return remaining < (off_t)chunkSize ? (ssize_t)remaining : (ssize_t)chunkSize;
+}
+
+// Llegeix la capçalera d'una trama BULK (DATA_LENGTH bytes queden pendents al socket)
+int receive_bulk_header(int socket_fd, BulkFrameHeader *header) {
+    if (!header) return -1;
+
+    char buffer[FRAME_BULK_HEADER_SIZE];
+    if (read_full(socket_fd, buffer, FRAME_BULK_HEADER_SIZE) != 0) {
+        perror("[ERROR][ReceiveFrame] Error recibiendo la cabecera BULK");
+        return -1;
+    }
+    return deserialize_bulk_header(buffer, header);
+}
+
+// Retorna el tipus de la següent trama sense consumir-la (-1 si error o desconnexió)
+int peek_frame_type(int socket_fd) {
+    uint8_t type;
+    ssize_t bytesRead = recv(socket_fd, &type, 1, MSG_PEEK);
+    if (bytesRead <= 0) {
+        return -1;
+    }
+    return type;
+}
+
+uint32_t clamp_bulk_chunk_size(uint32_t requested) {
+    if (requested == 0) return 0;
+    if (requested < BULK_CHUNK_MIN) return BULK_CHUNK_MIN;
+    if (requested > BULK_CHUNK_MAX) return BULK_CHUNK_MAX;
+    return requested;
+}
+
+// Escriu les opcions com a tokens separats per '&' (cadena buida si no n'hi ha cap)
+void format_transfer_options(const TransferOptions *options, char *buffer, size_t size) {
+    if (!buffer || size == 0) return;
+    buffer[0] = '\0';
+    if (!options) return;
+
+    size_t used = 0;
+    if (options->bulkChunkSize > 0 && used < size) {
+        used += snprintf(buffer + used, size - used, "%s%u", TRANSFER_OPTION_BULK, options->bulkChunkSize);
+    }
+    if (options->creditWindow > 0 && used < size) {
+        used += snprintf(buffer + used, size - used, "%s%s%u", used > 0 ? "&" : "", TRANSFER_OPTION_CREDIT, options->creditWindow);
+    }
+    if (options->zeroCopy && options->bulkChunkSize > 0 && used < size) {
+        used += snprintf(buffer + used, size - used, "%s%s1", used > 0 ? "&" : "", TRANSFER_OPTION_ZERO_COPY);
+    }
+    if (options->stream && used < size) {
+        used += snprintf(buffer + used, size - used, "%s%s1", used > 0 ? "&" : "", TRANSFER_OPTION_STREAM);
+    }
+    if (options->cached && used < size) {
+        used += snprintf(buffer + used, size - used, "%s%s1", used > 0 ? "&" : "", TRANSFER_OPTION_CACHE);
+    }
+    if (options->have > 0 && used < size) {
+        snprintf(buffer + used, size - used, "%s%s%llu", used > 0 ? "&" : "", TRANSFER_OPTION_HAVE, (unsigned long long)options->have);
+    }
+}
+
+// Interpreta els tokens coneguts i ignora la resta (peers més nous)
+void parse_transfer_options(const char *text, TransferOptions *options) {
+    if (!options) return;
+    memset(options, 0, sizeof(TransferOptions));
+    if (!text) return;
+
+    const char *token = text;
+    while (*token) {
+        size_t tokenLength = strcspn(token, "&");
+        if (strncmp(token, TRANSFER_OPTION_BULK, strlen(TRANSFER_OPTION_BULK)) == 0) {
+            options->bulkChunkSize = clamp_bulk_chunk_size((uint32_t)strtoul(token + strlen(TRANSFER_OPTION_BULK), NULL, 10));
+        } else if (strncmp(token, TRANSFER_OPTION_ZERO_COPY, strlen(TRANSFER_OPTION_ZERO_COPY)) == 0) {
+            options->zeroCopy = atoi(token + strlen(TRANSFER_OPTION_ZERO_COPY)) ? 1 : 0;
+        } else if (strncmp(token, TRANSFER_OPTION_STREAM, strlen(TRANSFER_OPTION_STREAM)) == 0) {
+            options->stream = atoi(token + strlen(TRANSFER_OPTION_STREAM)) ? 1 : 0;
+        } else if (strncmp(token, TRANSFER_OPTION_CACHE, strlen(TRANSFER_OPTION_CACHE)) == 0) {
+            options->cached = atoi(token + strlen(TRANSFER_OPTION_CACHE)) ? 1 : 0;
+        } else if (strncmp(token, TRANSFER_OPTION_HAVE, strlen(TRANSFER_OPTION_HAVE)) == 0) {
+            options->have = strtoull(token + strlen(TRANSFER_OPTION_HAVE), NULL, 10);
+        } else if (strncmp(token, TRANSFER_OPTION_CREDIT, strlen(TRANSFER_OPTION_CREDIT)) == 0) {
+            options->creditWindow = (uint32_t)strtoul(token + strlen(TRANSFER_OPTION_CREDIT), NULL, 10);
+            if (options->creditWindow > TRANSFER_CREDIT_MAX_WINDOW) {
+                options->creditWindow = TRANSFER_CREDIT_MAX_WINDOW;
+            }
+        }
+        token += tokenLength;
+        if (*token == '&') token++;
+    }
+}
+
 // Calcula el checksum binario
 uint16_t calculate_checksum_binary(const char *data, size_t length, int include_null) {
     uint32_t sum = 0;
@@ -3,11 +3,39 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/types.h>
 
 #define FRAME_BINARY_SIZE 256
 #define DATA_BINARY_MAX_SIZE (FRAME_BINARY_SIZE - 9) // Tamaño de datos máximo (247 bytes)
 #define CHECKSUM_BINARY_MODULO 65536
 
+// Mode BULK per a les transferències 0x05: DATA de mida negociada (64 KiB - 8 MiB)
+#define FRAME_BULK_TYPE 0x13
+#define FRAME_BULK_HEADER_SIZE 12 // 1(TYPE) + 1(FLAGS) + 4(DATA_LENGTH) + 2(CHECKSUM) + 4(TIMESTAMP)
+#define BULK_CHUNK_MIN (64 * 1024)
+#define BULK_CHUNK_MAX (8 * 1024 * 1024)
+#ifndef BULK_CHUNK_DEFAULT
+#define BULK_CHUNK_DEFAULT (1024 * 1024)
+#endif
+
+// FLAGS de la trama BULK
+#define BULK_FLAG_ZERO_COPY 0x01 // DATA enviada amb sendfile(2) sense CHECKSUM (l'MD5 final la valida)
+#define BULK_PIPE_SIZE (1024 * 1024) // Capacitat demanada per a la pipe de splice(2)
+
+// Opcions de transferència negociades a la trama 0x03 (<...>&<factor>&BULK=<bytes>&CREDIT=<trames>)
+#define TRANSFER_OPTION_BULK "BULK="
+#define TRANSFER_OPTION_CREDIT "CREDIT="
+#define TRANSFER_OPTION_ZERO_COPY "ZEROCOPY="
+#define TRANSFER_OPTION_STREAM "STREAM="
+#define TRANSFER_OPTION_CACHE "CACHE="
+#define TRANSFER_OPTION_HAVE "HAVE="
+#define TRANSFER_CREDIT_MAX_WINDOW 1024
+#define TRANSFER_OPTIONS_SIZE 64
+
+// Mode STREAM (textos): el worker retorna la sortida mentre encara rep l'arxiu i acaba amb
+// la trama 0x16 <mida>&<md5> del resultat (l'intercanvi d'MD5 passa al final)
+#define FRAME_STREAM_END_TYPE 0x16
+
 typedef struct {
     uint8_t type;
     uint16_t data_length;
@@ -16,6 +44,23 @@ typedef struct {
     char data[DATA_BINARY_MAX_SIZE];
 } BinaryFrame;
 
+typedef struct {
+    uint8_t type;
+    uint8_t flags;
+    uint32_t data_length;
+    uint16_t checksum;
+    uint32_t timestamp;
+} BulkFrameHeader;
+
+typedef struct {
+    uint32_t bulkChunkSize; // 0 = trames 0x05 clàssiques de 247 bytes
+    uint32_t creditWindow;  // 0 = sense control de flux per crèdits (trames 0x14)
+    uint32_t zeroCopy;      // 1 = trames BULK amb BULK_FLAG_ZERO_COPY (només amb bulkChunkSize > 0)
+    uint32_t stream;        // 1 = distorsió en streaming (recepció, filtre i retorn alhora)
+    uint32_t cached;        // Fleck: 1 = entén la resposta; Worker: 1 = resultat a la memòria cau (no es puja l'arxiu)
+    uint64_t have;          // Fleck: 1 = entén la resposta; Worker: bytes de l'arxiu que ja té (la pujada continua des d'aquí)
+} TransferOptions;
+
 // Funciones de serialización y deserialización
 void serialize_frame_binary(const BinaryFrame *frame, char *buffer);
 int deserialize_frame_binary(const char *buffer, BinaryFrame *frame);
@@ -25,6 +70,21 @@ int send_frame_binary(int socket_fd, const BinaryFrame *frame);
 int receive_frame_binary(int socket_fd, BinaryFrame *frame);
 int receive_any_frame(int socket_fd, void *frame, int *is_binary);
 
+// Funciones del modo BULK
+void serialize_bulk_header(const BulkFrameHeader *header, char *buffer);
+int deserialize_bulk_header(const char *buffer, BulkFrameHeader *header);
+int send_frame_bulk(int socket_fd, const char *data, uint32_t length);
+int send_frame_bulk_file(int socket_fd, int file_fd, uint32_t length);
+int receive_bulk_payload_to_file(int socket_fd, int file_fd, uint32_t length);
+ssize_t bulk_next_chunk_length(int file_fd, uint32_t chunkSize);
+int receive_bulk_header(int socket_fd, BulkFrameHeader *header);
+int peek_frame_type(int socket_fd);
+uint32_t clamp_bulk_chunk_size(uint32_t requested);
+
+// Opcions de transferència
+void format_transfer_options(const TransferOptions *options, char *buffer, size_t size);
+void parse_transfer_options(const char *text, TransferOptions *options);
+
 // Calcula el checksum para un frame binario
 uint16_t calculate_checksum_binary(const char *data, size_t length, int include_null);
 
@@ -3,6 +3,8 @@
 #include <unistd.h>
 #include <time.h>
 #include <string.h>
+#include <stdlib.h>
+#include <errno.h>
 
 #include "../DataConversion/DataConversion.h"
 
@@ -40,6 +42,17 @@ int enviarTramaError(int socket_fd) {
     return escribirTrama(socket_fd, &errorFrame);
 }
 
+// Eco del HEARTBEAT (0x12): Gotham només dona per viu el peer del qual rep trames
+int enviarTramaHeartbeat(int socket_fd) {
+    Frame heartbeatFrame = {0};
+    heartbeatFrame.type = 0x12;
+    heartbeatFrame.data_length = 0;
+    heartbeatFrame.timestamp = (uint32_t)time(NULL);
+    heartbeatFrame.checksum = calculate_checksum(heartbeatFrame.data, heartbeatFrame.data_length, 0);
+
+    return escribirTrama(socket_fd, &heartbeatFrame);
+}
+
 int leerTramaBinaria(int socket_fd, BinaryFrame *frame) {
     if (receive_frame_binary(socket_fd, frame) != 0) {
         customPrintf("[GestorTramas] Error al leer la trama binaria.");
@@ -66,4 +79,311 @@ int escribirTramaBinaria(int socket_fd, const BinaryFrame *frame) {
 
 
     return bytesEnviados;  // ✅ Devuelve el número de bytes enviados correctamente
-}
\ No newline at end of file
+}
+
+int leerTramaBulk(int socket_fd, BulkFrameHeader *header, char **buffer, uint32_t *capacity) {
+    if (receive_bulk_header(socket_fd, header) != 0) {
+        customPrintf("[GestorTramas] Error al leer la cabecera BULK.");
+        enviarTramaError(socket_fd);
+        return -1;
+    }
+
+    if (header->flags & BULK_FLAG_ZERO_COPY) {
+        return 0; // DATA pendent al socket
+    }
+
+    if (header->data_length > *capacity) {
+        char *newBuffer = realloc(*buffer, header->data_length);
+        if (!newBuffer) {
+            customPrintf("[GestorTramas] Sin memoria para la trama BULK.");
+            return -1;
+        }
+        *buffer = newBuffer;
+        *capacity = header->data_length;
+    }
+
+    if (header->data_length > 0 && read_full(socket_fd, *buffer, header->data_length) != 0) {
+        customPrintf("[GestorTramas] Error al leer los datos BULK.");
+        return -1;
+    }
+
+    uint16_t calculated_checksum = calculate_checksum_binary(*buffer, header->data_length, 1);
+    if (calculated_checksum != header->checksum) {
+        customPrintf("[GestorTramas] Checksum inválido en trama BULK.");
+        enviarTramaError(socket_fd);
+        return -1;
+    }
+    return 0;
+}
+
+int escribirTramaBulk(int socket_fd, const char *data, uint32_t length) {
+    int bytesEnviados = send_frame_bulk(socket_fd, data, length);
+
+    if (bytesEnviados < 0) {
+        customPrintf("[GestorTramas] Error al escribir la trama BULK.");
+        return -1;
+    }
+
+    return bytesEnviados;
+}
+
+int escribirTramaBulkDesdeFichero(int socket_fd, int file_fd, uint32_t length) {
+    int bytesEnviados = send_frame_bulk_file(socket_fd, file_fd, length);
+
+    if (bytesEnviados < 0) {
+        customPrintf("[GestorTramas] Error al escribir la trama BULK desde el fichero.");
+        return -1;
+    }
+
+    return bytesEnviados;
+}
+
+int recibirDatosBulkEnFichero(int socket_fd, int file_fd, uint32_t length) {
+    if (receive_bulk_payload_to_file(socket_fd, file_fd, length) != 0) {
+        customPrintf("[GestorTramas] Error al recibir los datos BULK en el fichero.");
+        return -1;
+    }
+    return 0;
+}
+
+int iniciarLectorTramas(FrameReader *reader, int socket_fd) {
+    return iniciarLectorTramasConCapacidad(reader, socket_fd, FRAME_READER_INITIAL_SIZE);
+}
+
+// Lector amb un buffer inicial més petit (p.ex. connexions de Gotham que només porten trames de control)
+int iniciarLectorTramasConCapacidad(FrameReader *reader, int socket_fd, size_t capacity) {
+    if (!reader || capacity == 0) return -1;
+
+    memset(reader, 0, sizeof(FrameReader));
+    reader->socket_fd = socket_fd;
+    reader->buffer = malloc(capacity);
+    if (!reader->buffer) {
+        return -1;
+    }
+    reader->capacity = capacity;
+    return 0;
+}
+
+void cerrarLectorTramas(FrameReader *reader) {
+    if (!reader) return;
+
+    free(reader->buffer);
+    reader->buffer = NULL;
+    reader->capacity = reader->start = reader->end = 0;
+}
+
+// Garanteix que hi ha almenys `needed` bytes pendents al buffer (0 si correcte, -1 si error o desconnexió)
+static int omplirLector(FrameReader *reader, size_t needed) {
+    if (reader->end - reader->start >= needed) {
+        return 0;
+    }
+
+    // Moure les dades pendents a l'inici i créixer si la trama no hi cap
+    if (reader->start > 0) {
+        memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    }
+    if (needed > reader->capacity) {
+        char *newBuffer = realloc(reader->buffer, needed);
+        if (!newBuffer) {
+            return -1;
+        }
+        reader->buffer = newBuffer;
+        reader->capacity = needed;
+    }
+
+    while (reader->end < needed) {
+        ssize_t bytesRead = read(reader->socket_fd, reader->buffer + reader->end, reader->capacity - reader->end);
+        if (bytesRead < 0 && errno == EINTR) continue;
+        if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            reader->pending = 1; // Les dades ja llegides es queden al buffer per al següent intent
+            return -1;
+        }
+        if (bytesRead <= 0) {
+            if (bytesRead == 0) reader->closed = 1;
+            return -1;
+        }
+        reader->end += bytesRead;
+    }
+    return 0;
+}
+
+// Mida total de la trama a partir dels primers bytes (0 si encara no n'hi ha prou per saber-ho)
+static size_t midaTrama(const FrameReader *reader) {
+    const uint8_t *bytes = (const uint8_t *)reader->buffer + reader->start;
+    size_t available = reader->end - reader->start;
+
+    if (bytes[0] == 0x05) {
+        return FRAME_BINARY_SIZE;
+    }
+    if (bytes[0] == FRAME_BULK_TYPE) {
+        if (available < FRAME_BULK_HEADER_SIZE) return 0;
+        BulkFrameHeader header;
+        if (deserialize_bulk_header((const char *)bytes, &header) != 0) return (size_t)-1;
+        // Amb còpia zero la DATA la llegeix el receptor directament del socket
+        return FRAME_BULK_HEADER_SIZE + ((header.flags & BULK_FLAG_ZERO_COPY) ? 0 : header.data_length);
+    }
+    if (bytes[0] <= FRAME_V2_MAX_TYPE) {
+        if (available < 3) return 0;
+        return FRAME_V2_HEADER_SIZE + (((size_t)bytes[1] << 8) | bytes[2]);
+    }
+    return FRAME_SIZE;
+}
+
+// Retorna la següent trama sense copiar-ne la DATA (0 si correcte, -1 si error, desconnexió o checksum invàlid)
+int leerSiguienteTrama(FrameReader *reader, FrameView *view) {
+    if (!reader || !view) return -1;
+
+    reader->pending = 0;
+    size_t frameSize = 0;
+    while (1) {
+        if (omplirLector(reader, 1) != 0) return -1;
+
+        // Byte nul solt davant d'una trama de text: es descarta
+        if (reader->buffer[reader->start] == 0x00) {
+            reader->start++;
+            continue;
+        }
+
+        frameSize = midaTrama(reader);
+        if (frameSize == (size_t)-1) {
+            customPrintf("[GestorTramas] Cabecera de trama inválida.");
+            return -1;
+        }
+        if (frameSize > 0) break;
+
+        // Encara falta la part de la capçalera que porta la longitud
+        size_t headerSize = (uint8_t)reader->buffer[reader->start] == FRAME_BULK_TYPE ? FRAME_BULK_HEADER_SIZE : 3;
+        if (omplirLector(reader, headerSize) != 0) return -1;
+    }
+
+    if (omplirLector(reader, frameSize) != 0) return -1;
+
+    const char *raw = reader->buffer + reader->start;
+    reader->start += frameSize;
+
+    memset(view, 0, sizeof(FrameView));
+    view->type = (uint8_t)raw[0];
+
+    if (view->type == 0x05) {
+        uint16_t dataLength;
+        uint16_t checksum;
+        memcpy(&dataLength, raw + 1, sizeof(dataLength));
+        memcpy(&checksum, raw + 3 + DATA_BINARY_MAX_SIZE, sizeof(checksum));
+        if (dataLength > DATA_BINARY_MAX_SIZE) {
+            customPrintf("[GestorTramas] Longitud inválida en trama binaria.");
+            return -1;
+        }
+
+        view->kind = FRAME_VIEW_BINARY;
+        view->data = raw + 3;
+        view->data_length = dataLength;
+        if (calculate_checksum_binary(view->data, view->data_length, 1) != checksum) {
+            customPrintf("[GestorTramas] Checksum inválido en trama binaria.");
+            enviarTramaError(reader->socket_fd);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (view->type == FRAME_BULK_TYPE) {
+        BulkFrameHeader header;
+        deserialize_bulk_header(raw, &header);
+
+        view->kind = FRAME_VIEW_BULK;
+        view->flags = header.flags;
+        view->data_length = header.data_length;
+        if (header.flags & BULK_FLAG_ZERO_COPY) {
+            return 0; // DATA pendent: recibirDatosBulkLector
+        }
+
+        view->data = raw + FRAME_BULK_HEADER_SIZE;
+        if (calculate_checksum_binary(view->data, view->data_length, 1) != header.checksum) {
+            customPrintf("[GestorTramas] Checksum inválido en trama BULK.");
+            enviarTramaError(reader->socket_fd);
+            return -1;
+        }
+        return 0;
+    }
+
+    view->kind = FRAME_VIEW_CONTROL;
+    if (view->type <= FRAME_V2_MAX_TYPE) {
+        if (deserialize_frame_v2_header(raw, &view->frame) != 0) return -1;
+        memcpy(view->frame.data, raw + FRAME_V2_HEADER_SIZE, view->frame.data_length);
+        view->frame.data[view->frame.data_length] = '\0';
+    } else {
+        char text[FRAME_SIZE + 1];
+        memcpy(text, raw, FRAME_SIZE);
+        text[FRAME_SIZE] = '\0';
+        if (deserialize_frame(text, &view->frame) != 0) {
+            customPrintf("[GestorTramas] Error al deserializar la trama.");
+            return -1;
+        }
+    }
+
+    view->type = view->frame.type;
+    view->data = view->frame.data;
+    view->data_length = view->frame.data_length;
+    if (calculate_checksum(view->frame.data, view->frame.data_length, 0) != view->frame.checksum) {
+        customPrintf("[GestorTramas] Checksum inválido en trama normal.");
+        enviarTramaError(reader->socket_fd);
+        return -1;
+    }
+    return 0;
+}
+
+// Mou al fitxer la DATA d'una trama BULK de còpia zero: primer el que ja és al buffer, després splice del socket
+int recibirDatosBulkLector(FrameReader *reader, int file_fd, uint32_t length) {
+    if (!reader) return -1;
+
+    size_t buffered = reader->end - reader->start;
+    if (buffered > length) {
+        buffered = length;
+    }
+
+    if (buffered > 0) {
+        if (write_full(file_fd, reader->buffer + reader->start, buffered) != 0) {
+            customPrintf("[GestorTramas] Error al escribir los datos BULK en el fichero.");
+            return -1;
+        }
+        reader->start += buffered;
+    }
+
+    if (length > buffered) {
+        return recibirDatosBulkEnFichero(reader->socket_fd, file_fd, length - (uint32_t)buffered);
+    }
+    return 0;
+}
+
+// Com recibirDatosBulkLector, però directament a la projecció de l'arxiu (si n'hi ha) i avançant-ne la posició
+int recibirDatosBulkLectorEnArxiu(FrameReader *reader, MappedFile *file, uint32_t length) {
+    if (!reader || !file) return -1;
+
+    char *dest = mapped_file_reserve(file, length);
+    if (!dest) {
+        if (file->map || (file->size > 0 && length > file->size - file->offset)) {
+            customPrintf("[GestorTramas] Datos BULK más allá del tamaño anunciado del fichero.");
+            return -1;
+        }
+        if (recibirDatosBulkLector(reader, file->fd, length) != 0) {
+            return -1;
+        }
+        mapped_file_advance(file, length);
+        return 0;
+    }
+
+    size_t buffered = reader->end - reader->start;
+    if (buffered > length) {
+        buffered = length;
+    }
+    memcpy(dest, reader->buffer + reader->start, buffered);
+    reader->start += buffered;
+
+    if (length > buffered && read_full(reader->socket_fd, dest + buffered, length - buffered) != 0) {
+        customPrintf("[GestorTramas] Error al recibir los datos BULK.");
+        return -1;
+    }
+    mapped_file_advance(file, length);
+    return 0;
+}
@@ -3,14 +3,56 @@
 
 #include "../FrameUtils/FrameUtils.h"
 #include "../FrameUtilsBinary/FrameUtilsBinary.h"
+#include "../MappedFile/MappedFile.h"
 
 // Funciones para tramas normales
 int leerTrama(int socket_fd, Frame *frame);
 int escribirTrama(int socket_fd, const Frame *frame);
 int enviarTramaError(int socket_fd);
+int enviarTramaHeartbeat(int socket_fd);
 
 // Funciones para tramas binarias
 int leerTramaBinaria(int socket_fd, BinaryFrame *frame);
 int escribirTramaBinaria(int socket_fd, const BinaryFrame *frame);
 
+// Funciones para tramas BULK (el buffer creix sota demanda fins a BULK_CHUNK_MAX)
+// Amb BULK_FLAG_ZERO_COPY la DATA queda al socket i s'ha de llegir amb recibirDatosBulkEnFichero
+int leerTramaBulk(int socket_fd, BulkFrameHeader *header, char **buffer, uint32_t *capacity);
+int escribirTramaBulk(int socket_fd, const char *data, uint32_t length);
+int escribirTramaBulkDesdeFichero(int socket_fd, int file_fd, uint32_t length);
+int recibirDatosBulkEnFichero(int socket_fd, int file_fd, uint32_t length);
+
+// Lector amb buffer: cada read() en porta tantes trames com hi hagi disponibles
+#define FRAME_READER_INITIAL_SIZE (64 * 1024)
+
+#define FRAME_VIEW_CONTROL 1 // Trama de control (v1 text o v2), copiada a view.frame
+#define FRAME_VIEW_BINARY 2  // Trama 0x05 de 256 bytes
+#define FRAME_VIEW_BULK 3    // Trama BULK (0x13)
+
+typedef struct {
+    int socket_fd;
+    char *buffer;
+    size_t capacity;
+    size_t start;   // Primer byte pendent de processar
+    size_t end;     // Final de les dades llegides del socket
+    int closed;     // 1 si el peer ha tancat la connexió
+    int pending;    // 1 si el socket és no bloquejant i encara no ha arribat la trama sencera (EAGAIN)
+} FrameReader;
+
+typedef struct {
+    int kind;
+    uint8_t type;
+    uint8_t flags;          // FLAGS de la trama BULK
+    const char *data;       // DATA dins del buffer del lector (vàlida fins a la següent lectura); NULL si BULK_FLAG_ZERO_COPY
+    uint32_t data_length;
+    Frame frame;            // Només per a FRAME_VIEW_CONTROL
+} FrameView;
+
+int iniciarLectorTramas(FrameReader *reader, int socket_fd);
+int iniciarLectorTramasConCapacidad(FrameReader *reader, int socket_fd, size_t capacity);
+void cerrarLectorTramas(FrameReader *reader);
+int leerSiguienteTrama(FrameReader *reader, FrameView *view);
+int recibirDatosBulkLector(FrameReader *reader, int file_fd, uint32_t length);
+int recibirDatosBulkLectorEnArxiu(FrameReader *reader, MappedFile *file, uint32_t length);
+
 #endif
@@ -35,441 +35,202 @@
 #include "DataConversion/DataConversion.h"
 #include "Networking/Networking.h"
 #include "Logging/Logging.h"
-#include "Semafors/semaphore_v2.h"
+#include "Reactor/Reactor.h"
+#include "Scheduler/Scheduler.h"
+#include "WorkerLoad/WorkerLoad.h"
+#include "Registry/Registry.h"
+#include "LogRing/LogRing.h"
+#include "EventLog/EventLog.h"
 
 volatile sig_atomic_t stop_server = 0; // Bandera para indicar el cierre
 
-typedef struct {
-    int server_fd_fleck;
-    int server_fd_worker;
-} ServerFds;
+// Identificadors dels sockets d'escolta del reactor
+#define LISTENER_FLECK 1
+#define LISTENER_WORKER 2
 
-static ServerFds *global_server_fds = NULL;
+static Reactor *global_reactor = NULL;
 static GothamConfig *global_config = NULL;
 
-// Representa un worker que es connecta a Gotham
-typedef struct {
-    char ip[16];    // Direcció IP del worker
-    int port;       // Port del worker
-    char type[10];  // Tipus de worker: "TEXT" o "MEDIA"
-    int socket_fd;  // Descriptor del socket associat al worker
-} WorkerInfo;
-
-// Administra una llista dinàmica de workers registrats
-typedef struct {
-    WorkerInfo *workers;        // Llista dinàmica de workers registrats
-    int workerCount;            // Nombre de workers registrats
-    int capacity;               // Capacitat actual de la llista
-    WorkerInfo *mainTextWorker; // Worker principal per a TEXT
-    WorkerInfo *mainMediaWorker;// Worker principal per a MEDIA
-    pthread_mutex_t mutex;      // Mutex per sincronitzar l'accés
-} WorkerManager;
-
-typedef struct {
-    char username[64]; // Nombre de usuario del cliente
-    char ip[16];       // Dirección IP del cliente
-    int socket_fd;     // Descriptor del socket del cliente
-} ClientInfo;
-
-typedef struct {
-    ClientInfo *clients;     // Lista dinámica de clientes
-    int clientCount;         // Número de clientes conectados
-    int capacity;            // Capacidad actual de la lista
-    pthread_mutex_t mutex;   // Mutex para sincronización
-} ClientManager;
-
 typedef struct {
     int client_fd;
     WorkerManager *workerManager;
     ClientManager *clientManager;
 } ConnectionArgs;
 
-WorkerManager *workerManager = NULL;
-ClientManager *clientManager = NULL;
-
 int arkham_pipe[2];
 int arkham_pid = -1;
-semaphore arkham_sem;
-
-WorkerManager *createWorkerManager();
-void freeWorkerManager(WorkerManager *manager);
-void *gestionarConexion(void *arg);
-void processCommandInGotham(const Frame *frame, int client_fd, WorkerManager *manager, ClientManager *clientManager);
-void registrarWorker(const char *payload, WorkerManager *manager, int client_fd);
-void asignarNuevoWorkerPrincipal(WorkerInfo *worker);
+static LogRing arkhamLog; // Línies pendents d'enviar a Arkham
+
+int gestionarTramaConexion(ReactorConnection *conn, const Frame *frame, void *context);
+void gestionarDesconexion(ReactorConnection *conn, void *context);
+void processCommandInGotham(const Frame *frame, ReactorConnection *conn, WorkerManager *manager, ClientManager *clientManager);
+void registrarWorker(const char *payload, WorkerManager *manager, ReactorConnection *conn);
+void enviarAckRegistre(ReactorConnection *conn, int useV2);
+void asignarNuevoWorkerPrincipal(WorkerManager *manager, const WorkerInfo *worker);
 int logoutWorkerBySocket(int socket_fd, WorkerManager *manager);
-WorkerInfo *buscarWorker(const char *filename, WorkerManager *manager);
+int buscarWorker(const char *filename, WorkerManager *manager, WorkerInfo *targetWorker);
+void actualizarCargaWorker(const char *payload, WorkerManager *manager, int client_fd);
 void handleDisconnectFrame(const Frame *frame, int client_fd, WorkerManager *manager, ClientManager *clientManager);
-ClientManager *createClientManager();
 void reasignarWorkersPrincipales(WorkerManager *manager);
-void freeClientManager(ClientManager *manager);
-void addClient(ClientManager *manager, const char *username, const char *ip, int socket_fd);
-void removeClientBySocket(ClientManager *manager, int socket_fd);
-void listClients(ClientManager *manager);
 void handleSigint(int sig);
 void alliberarMemoria(GothamConfig *gothamConfig);
 void logEvent(const char *msg);
-
-void *enviarHeartbeat(void *arg) {
-    ConnectionArgs *args = (ConnectionArgs *)arg;
-    WorkerManager *workerManager = args->workerManager;
-    ClientManager *clientManager = args->clientManager;
-
-    while (!stop_server) {
-        Frame heartbeat = {0};
-        heartbeat.type = 0x12; // Tipo HEARTBEAT
-        heartbeat.data_length = 0;
-        heartbeat.timestamp = (uint32_t)time(NULL);
-
-        // Depuración para asegurar acceso correcto
-        if (!clientManager) {
-            customPrintf("[ERROR]: ClientManager es NULL en el hilo de HEARTBEAT.");
-        } else {
-            pthread_mutex_lock(&clientManager->mutex);
-            for (int i = 0; i < clientManager->clientCount; i++) {
-                int clientSocket = clientManager->clients[i].socket_fd;
-                if (escribirTrama(clientSocket, &heartbeat) < 0) {
-                    customPrintf("[ERROR]: Error enviando HEARTBEAT a cliente.");
-                }
-            }
-            pthread_mutex_unlock(&clientManager->mutex);
-        }
-
-        if (!workerManager) {
-            customPrintf("[ERROR]: WorkerManager es NULL en el hilo de HEARTBEAT.");
-        } else {
-            pthread_mutex_lock(&workerManager->mutex);
-            for (int i = 0; i < workerManager->workerCount; i++) {
-                WorkerInfo *worker = &workerManager->workers[i];
-                if (escribirTrama(worker->socket_fd, &heartbeat) < 0) {
-                    customPrintf("[ERROR]: Error enviando HEARTBEAT a worker.");
-                    // Cerrar socket y eliminar worker
-                    shutdown(worker->socket_fd, SHUT_RDWR);
-                    close(worker->socket_fd);
-                    logoutWorkerBySocket(worker->socket_fd, workerManager);
-                    i--;  // Ajustar índice tras eliminar worker
-                }
-            }
-            pthread_mutex_unlock(&workerManager->mutex);
-        }
-
-        sleep(1); // Esperar antes del siguiente HEARTBEAT
-    }
-
-    free(args);
-    return NULL;
-}
-
-// Crea un nou gestor de clients
-ClientManager *createClientManager() {
-    ClientManager *manager = malloc(sizeof(ClientManager));
-    if (!manager) {
-        perror("Error al inicializar ClientManager");
-        exit(EXIT_FAILURE);
-    }
-
-    manager->capacity = 10;
-    manager->clientCount = 0;
-    manager->clients = calloc(manager->capacity, sizeof(ClientInfo));
-    if (!manager->clients) {
-        perror("Error al inicializar la lista de clientes");
-        free(manager);
-        exit(EXIT_FAILURE);
-    }
-
-    if (pthread_mutex_init(&manager->mutex, NULL) != 0) {
-        perror("Error al inicializar el mutex de ClientManager");
-        free(manager->clients);
-        free(manager);
-        exit(EXIT_FAILURE);
-    }
-
-    return manager;
-}
-
-void freeClientManager(ClientManager *manager) {
-    if (manager) {
-        if (manager->clients) {
-            free(manager->clients); // Liberar la lista dinámica de clientes
-        }
-        pthread_mutex_destroy(&manager->mutex); // Destruir el mutex
-        free(manager); // Liberar la estructura principal
-        customPrintf("[DEBUG]: ClientManager liberado correctamente.");
-    }
-}
-
-// Añade un cliente a la lista dinámica
-void addClient(ClientManager *manager, const char *username, const char *ip, int socket_fd) {
-    pthread_mutex_lock(&manager->mutex);
-
-    // Verificar si el cliente ya está registrado
-    for (int i = 0; i < manager->clientCount; i++) {
-        if (strcmp(manager->clients[i].username, username) == 0) {
-            strncpy(manager->clients[i].ip, ip, sizeof(manager->clients[i].ip) - 1);
-            manager->clients[i].socket_fd = socket_fd;
-            customPrintf("\n[INFO]: Cliente existente actualizado.\n");
-            pthread_mutex_unlock(&manager->mutex);
-            return;
-        }
-    }
-
-    // Ampliar la capacidad si es necesario
-    if (manager->clientCount == manager->capacity) {
-        manager->capacity *= 2;
-        ClientInfo *new_clients = realloc(manager->clients, manager->capacity * sizeof(ClientInfo));
-        if (!new_clients) {
-            customPrintf("[ERROR]: Error al ampliar la capacidad de clientes.");
-            pthread_mutex_unlock(&manager->mutex);
-            return;
-        }
-        manager->clients = new_clients;
-    }
-
-    //Añadir un nuevo cliente
-    ClientInfo *client = &manager->clients[manager->clientCount++];
-    strncpy(client->username, username, sizeof(client->username) - 1);
-    strncpy(client->ip, ip, sizeof(client->ip) - 1);
-    client->socket_fd = socket_fd;
-
-    pthread_mutex_unlock(&manager->mutex);
+void logWorkerEvent(int type, const char *workerType, const char *ip, int port, uint64_t bytes, uint32_t durationMs);
+
+static void mostrarWorker(const WorkerInfo *worker, int index, void *arg) {
+    (void)arg;
+    char *log_message;
+    asprintf(&log_message, "\nWorker %d: Tipus: %s, IP: %s,Port: %d\n",
+                index + 1, worker->type, worker->ip, worker->port);
+    printF(log_message);
+    free(log_message);
 }
 
-
-// Elimina un cliente de la lista por su socket
-void removeClientBySocket(ClientManager *manager, int socket_fd) {
-    pthread_mutex_lock(&manager->mutex);
-
-    for (int i = 0; i < manager->clientCount; i++) {
-        if (manager->clients[i].socket_fd == socket_fd) {
-            // Mueve el último cliente al lugar del eliminado
-            if (i != manager->clientCount - 1) {
-                manager->clients[i] = manager->clients[manager->clientCount - 1];
-            }
-            manager->clientCount--;
-            customPrintf("[INFO]: Cliente eliminado de la lista.");
-            break;
-        }
-    }
-
-    pthread_mutex_unlock(&manager->mutex);
-}
-
-// Lista los clientes conectados
-void listClients(ClientManager *manager) {
-    pthread_mutex_lock(&manager->mutex);
-
-    if (manager->clientCount == 0) {
-        customPrintf("No hay clientes conectados.");
-    } else {
-        customPrintf("\nLista de clientes conectados: \n");
-        for (int i = 0; i < manager->clientCount; i++) {
-            ClientInfo *client = &manager->clients[i];
-            customPrintf("\nCliente %d: Usuario: %s, IP: %s, Socket: %d\n",
-                     i + 1, client->username, client->ip, client->socket_fd);
-        }
-    }
-
-    pthread_mutex_unlock(&manager->mutex);
+void listarWorkers(WorkerManager *manager) {
+    recorrerWorkers(manager, mostrarWorker, NULL);
 }
 
-// Crea un nou gestor de workers
-WorkerManager *createWorkerManager() {
-    WorkerManager *manager = malloc(sizeof(WorkerManager));
-    if (!manager) {
-        perror("Error al inicializar WorkerManager");
-        exit(EXIT_FAILURE);
-    }
-
-    manager->capacity = 10;
-    manager->workerCount = 0;
-    manager->workers = calloc(manager->capacity, sizeof(WorkerInfo));
-    if (!manager->workers) {
-        perror("Error al inicializar la lista de workers");
-        free(manager);
-        exit(EXIT_FAILURE);
-    }
-
-    if (pthread_mutex_init(&manager->mutex, NULL) != 0) {
-        perror("Error al inicializar el mutex de WorkerManager");
-        free(manager->workers);
-        free(manager);
-        exit(EXIT_FAILURE);
+// Envia l'ACK de registre (0x02) i, si el worker suporta v2, canvia el protocol del socket
+void enviarAckRegistre(ReactorConnection *conn, int useV2) {
+    Frame response = {0};
+    response.type = 0x02;
+    if (useV2) {
+        strncpy(response.data, FRAME_PROTOCOL_V2_TAG, sizeof(response.data) - 1);
     }
+    response.data_length = strlen(response.data);
+    response.timestamp = (uint32_t)time(NULL);
+    response.checksum = calculate_checksum(response.data, response.data_length, 1);
+    reactor_send_frame(conn, &response);
 
-    manager->mainTextWorker = NULL;
-    manager->mainMediaWorker = NULL;
-
-    return manager;
-}
-
-void listarWorkers(WorkerManager *manager) {
-    pthread_mutex_lock(&manager->mutex); // Asegura acceso seguro a la lista dinámica
-
-    for (int i = 0; i < manager->workerCount; i++) {
-        WorkerInfo *worker = &manager->workers[i];
-        char *log_message;
-        asprintf(&log_message, "\nWorker %d: Tipus: %s, IP: %s,Port: %d\n",
-                    i + 1, worker->type, worker->ip, worker->port);
-        printF(log_message);
-        free(log_message);
+    if (useV2) {
+        set_frame_protocol(conn->fd, FRAME_PROTOCOL_V2);
     }
-
-    pthread_mutex_unlock(&manager->mutex);
 }
 
-void registrarWorker(const char *payload, WorkerManager *manager, int client_fd) {
+void registrarWorker(const char *payload, WorkerManager *manager, ReactorConnection *conn) {
     if (!manager || !payload) {
         customPrintf("[ERROR]: Parámetros inválidos en registrarWorker.");
         return;
     }
 
-    char type[10] = {0}, ip[16] = {0};
+    char type[10] = {0}, ip[16] = {0}, protocolTag[4] = {0};
     int port = 0;
 
-    if (sscanf(payload, "%9[^&]&%15[^&]&%d", type, ip, &port) != 3) {
+    int registerFields = sscanf(payload, "%9[^&]&%15[^&]&%d&%3s", type, ip, &port, protocolTag);
+    if (registerFields < 3) {
         customPrintf("[ERROR]: Payload inválido (esperado TYPE&IP&PORT).");
         Frame response = {0};
         response.type = 0x02;
         strncpy(response.data, "CON_KO", sizeof(response.data) - 1);
         response.data_length = strlen(response.data);
         response.checksum = calculate_checksum(response.data, response.data_length, 1);
-        escribirTrama(client_fd, &response);
+        reactor_send_frame(conn, &response);
         return;
     }
 
-    pthread_mutex_lock(&manager->mutex);
+    int workerUsesV2 = (registerFields == 4 && strcmp(protocolTag, FRAME_PROTOCOL_V2_TAG) == 0);
 
-    //Verificar si el worker ya está registrado
-    for (int i = 0; i < manager->workerCount; i++) {
-        if (strcmp(manager->workers[i].ip, ip) == 0 && manager->workers[i].port == port) {
-            logWarning("[WARNING]: Worker ya registrado. Actualizando socket...");
-            manager->workers[i].socket_fd = client_fd;  // 🔄 **Actualizar socket en vez de duplicar**
-            pthread_mutex_unlock(&manager->mutex);
-            
-            // Responder con éxito sin volver a añadirlo
-            Frame response = {0};
-            response.type = 0x02;
-            response.data_length = 0;
-            response.checksum = calculate_checksum(response.data, response.data_length, 1);
-            escribirTrama(client_fd, &response);
-            return;
-        }
+    // Si (IP, port) ja hi és només s'actualitza el socket, sense duplicar-lo
+    int registro = altaWorker(manager, type, ip, port, conn->fd, NULL);
+    if (registro < 0) {
+        customPrintf("[ERROR]: Fallo al ampliar la capacidad de WorkerManager.");
+        return;
     }
 
-    // Ampliar capacidad si es necesario
-    if (manager->workerCount == manager->capacity) {
-        customPrintf("[DEBUG]: Ampliando capacidad del WorkerManager...");
-        int new_capacity = manager->capacity *= 2;
-        WorkerInfo *temp = realloc(manager->workers, new_capacity * sizeof(WorkerInfo));
-        if (!temp) {
-            customPrintf("[ERROR]: Fallo al ampliar la capacidad de WorkerManager.");
-            pthread_mutex_unlock(&manager->mutex);
-            return;
+    if (registro == WORKER_REGISTRO_ACTUALIZADO) {
+        logWarning("[WARNING]: Worker ya registrado. Actualizando socket...");
+    } else {
+        char *logLine = NULL;
+        asprintf(&logLine, "Worker connected: %s - IP: %s, Port: %d", type, ip, port);
+        if (logLine) {
+            logEvent(logLine);
+            free(logLine);
         }
-        manager->workers = temp;
-        manager->capacity = new_capacity;
-    }
+        logWorkerEvent(EVENT_WORKER_CONNECT, type, ip, port, 0, 0);
 
-    // Registrar nuevo worker
-    WorkerInfo *worker = &manager->workers[manager->workerCount++];
-    char *logLine = NULL;
-    asprintf(&logLine, "Worker connected: %s - IP: %s, Port: %d", type, ip, port);
-    if (logLine) {
-        logEvent(logLine);
-        free(logLine);
-    }
-    memset(worker, 0, sizeof(WorkerInfo));
-    strncpy(worker->type, type, sizeof(worker->type) - 1);
-    strncpy(worker->ip, ip, sizeof(worker->ip) - 1);
-    worker->port = port;
-    worker->socket_fd = client_fd;
-
-    // Asignar como principal si es el primero de su tipo
-    if (strcasecmp(type, "TEXT") == 0 && manager->mainTextWorker == NULL) {
-        manager->mainTextWorker = worker;
-    } else if (strcasecmp(type, "MEDIA") == 0 && manager->mainMediaWorker == NULL) {
-        manager->mainMediaWorker = worker;
-    }
-
-    //Mensajeún el tipo
-    if (strcasecmp(type, "TEXT") == 0) {
-        customPrintf("\nNew Enigma  personalizado segworker connected - ready to distort!\n");
-    } else if (strcasecmp(type, "MEDIA") == 0) {
-        customPrintf("\nNew Harley worker connected - ready to distort!\n");
+        //Mensajeún el tipo
+        if (strcasecmp(type, "TEXT") == 0) {
+            customPrintf("\nNew Enigma  personalizado segworker connected - ready to distort!\n");
+        } else if (strcasecmp(type, "MEDIA") == 0) {
+            customPrintf("\nNew Harley worker connected - ready to distort!\n");
+        }
     }
 
-    pthread_mutex_unlock(&manager->mutex);
-
     // Enviar ACK
-    Frame response = {0};
-    response.type = 0x02;
-    response.data_length = 0;
-    response.checksum = calculate_checksum(response.data, response.data_length, 1);
-    escribirTrama(client_fd, &response);
+    enviarAckRegistre(conn, workerUsesV2);
 }
 
-WorkerInfo *buscarWorker(const char *filename, WorkerManager *manager) {
-    if (!filename || !manager) {
+// Escull el worker del tipus de l'arxiu amb menys càrrega segons la política configurada (0 si n'hi ha)
+int buscarWorker(const char *filename, WorkerManager *manager, WorkerInfo *targetWorker) {
+    if (!filename || !manager || !targetWorker) {
         customPrintf("[ERROR]: Nombre de archivo o manager inválido.\n");
-        return NULL;
+        return -1;
     }
 
     char *extension = strrchr(filename, '.');
     if (!extension) {
         customPrintf("[ERROR]: No se pudo determinar la extensión del archivo.\n");
-        return NULL;
+        return -1;
     }
 
-    pthread_mutex_lock(&manager->mutex);
-
-    WorkerInfo *targetWorker = NULL;
-
+    const char *workerType = NULL;
     if (strcasecmp(extension, ".txt") == 0) {
-        if (manager->mainTextWorker && manager->mainTextWorker->ip[0] != '\0') {
-            targetWorker = manager->mainTextWorker;
-        } else {
-            customPrintf("[ERROR]: No hay un Worker principal asignado para archivos de texto.\n");
-        }
+        workerType = "TEXT";
     } else if (strcasecmp(extension, ".wav") == 0 || strcasecmp(extension, ".png") == 0 || strcasecmp(extension, ".jpg") == 0) {
-        if (manager->mainMediaWorker && manager->mainMediaWorker->ip[0] != '\0') {
-            targetWorker = manager->mainMediaWorker;
-
-        } else {
-            customPrintf("[ERROR]: No hay un Worker principal asignado para archivos multimedia.\n");
-        }
+        workerType = "MEDIA";
     } else {
         customPrintf("[ERROR]: Extensión no reconocida.\n");
+        return -1;
     }
 
-    if (!targetWorker) {
+    if (elegirWorker(manager, workerType, targetWorker) != 0) {
         customPrintf("[ERROR]: No hay workers disponibles para el tipo de archivo.\n");
-        pthread_mutex_unlock(&manager->mutex);
-        return NULL;
+        return -1;
     }
 
-    // Validar los campos del Worker antes de usarlo
-    if (targetWorker->ip[0] == '\0' || targetWorker->port <= 0) {
-        customPrintf("[ERROR]: Worker tiene datos inválidos.\n");
-        pthread_mutex_unlock(&manager->mutex);
-        return NULL;
-    }
+    char log_message[256];
+    snprintf(log_message, sizeof(log_message), "Worker trobat -> IP: %s, Port: %d (càrrega: %d feines)\n",
+             targetWorker->ip, targetWorker->port, targetWorker->activeJobs + targetWorker->assignedSinceReport - 1);
+    printF(log_message);
 
-    if (targetWorker) {
-        char log_message[256];
-        snprintf(log_message, sizeof(log_message), "Worker trobat -> IP: %s, Port: %d\n",
-                 targetWorker->ip, targetWorker->port);
-        printF(log_message);
-    } else {
-        customPrintf("[ERROR]: No hay workers disponibles para el tipo de archivo.\n");
+    return 0;
+}
+
+// Trama 0x15: el worker informa de les feines actives i els bytes en vol
+void actualizarCargaWorker(const char *payload, WorkerManager *manager, int client_fd) {
+    int activeJobs = 0;
+    unsigned long long bytesInFlight = 0, doneBytes = 0;
+    unsigned doneMs = 0;
+    int fields = payload ? sscanf(payload, "%d&%llu&%llu&%u", &activeJobs, &bytesInFlight, &doneBytes, &doneMs) : 0;
+    if (fields < 2 || activeJobs < 0) {
+        customPrintf("[ERROR]: Formato inválido en el informe de carga del Worker.");
+        return;
     }
 
-    pthread_mutex_unlock(&manager->mutex);
-    return targetWorker;
+    actualizarCargaPorSocket(manager, client_fd, activeJobs, bytesInFlight);
+
+    // L'informe que tanca una distorsió porta també els seus bytes i la durada al worker
+    WorkerInfo worker;
+    if (fields == 4 && buscarWorkerPorSocket(manager, client_fd, &worker) == 0) {
+        logWorkerEvent(EVENT_DISTORT_DONE, worker.type, worker.ip, worker.port, doneBytes, doneMs);
+    }
 }
 
-void asignarNuevoWorkerPrincipal(WorkerInfo *worker) {
-    if (!worker) {
-        customPrintf("[ERROR]: Worker no válido para asignar como principal.");
+typedef struct {
+    WorkerInfo worker;
+    WorkerManager *manager;
+} AsignacionPrincipal;
+
+// S'executa al fil del bucle que atén el worker: la trama 0x08 passa per la cua de sortida de la connexió
+static void enviarTramaPrincipal(ReactorConnection *conn, void *arg) {
+    AsignacionPrincipal *assignment = (AsignacionPrincipal *)arg;
+
+    // Mentre la feina esperava, el socket es pot haver tancat i reutilitzat en una altra connexió
+    WorkerInfo current;
+    if (!conn || buscarWorkerPorSocket(assignment->manager, conn->fd, &current) != 0 ||
+        current.port != assignment->worker.port || strcmp(current.ip, assignment->worker.ip) != 0) {
+        customPrintf("[ERROR]: El Worker principal ya no está conectado, no se le envía la trama 0x08.");
+        free(assignment);
         return;
     }
 
@@ -479,164 +240,106 @@ void asignarNuevoWorkerPrincipal(WorkerInfo *worker) {
     frame.timestamp = (uint32_t)time(NULL);
     frame.checksum = calculate_checksum(frame.data, frame.data_length, 1);
 
+    if (reactor_send_frame(conn, &frame) == 0) {
+        logSuccess("[SUCCESS]: Trama 0x08 enviada correctamente al Worker principal.\n");
+    } else {
+        customPrintf("[ERROR]: Error enviando la trama 0x08 al Worker principal.");
+    }
+    free(assignment);
+}
+
+void asignarNuevoWorkerPrincipal(WorkerManager *manager, const WorkerInfo *worker) {
+    if (!worker) {
+        customPrintf("[ERROR]: Worker no válido para asignar como principal.");
+        return;
+    }
+
     char *logLine = NULL;
     asprintf(&logLine, "New main worker assigned: %s - IP: %s, Port: %d", worker->type, worker->ip, worker->port);
     if (logLine) {
         logEvent(logLine);
         free(logLine);
     }
-    if (escribirTrama(worker->socket_fd, &frame) == 0) {
-        logSuccess("[SUCCESS]: Trama 0x08 enviada correctamente al Worker principal.\n");
-    } else {
+    logWorkerEvent(EVENT_MAIN_ASSIGNED, worker->type, worker->ip, worker->port, 0, 0);
+
+    // El socket pot ser d'un altre bucle del reactor: només aquell hi escriu
+    AsignacionPrincipal *assignment = malloc(sizeof(AsignacionPrincipal));
+    if (!assignment) {
+        customPrintf("[ERROR]: Error enviando la trama 0x08 al Worker principal.");
+        return;
+    }
+    assignment->worker = *worker;
+    assignment->manager = manager;
+    if (!global_reactor || reactor_post(global_reactor, worker->socket_fd, enviarTramaPrincipal, assignment) != 0) {
         customPrintf("[ERROR]: Error enviando la trama 0x08 al Worker principal.");
+        free(assignment);
     }
 }
 
+// El socket el tanca el reactor quan acaba la connexió
 int logoutWorkerBySocket(int socket_fd, WorkerManager *manager) {
-    pthread_mutex_lock(&manager->mutex);
-
-    int found = 0;
-    for (int i = 0; i < manager->workerCount; i++) {
-        if (manager->workers[i].socket_fd == socket_fd) {
-            found = 1;
-
-            close(manager->workers[i].socket_fd);
-            manager->workers[i].socket_fd = -1;
-
-            // Si es principal, reasignar
-            if (manager->mainTextWorker == &manager->workers[i]) {
-                manager->mainTextWorker = NULL;
-            }
-            if (manager->mainMediaWorker == &manager->workers[i]) {
-                manager->mainMediaWorker = NULL;
-            }
-
-            // Reemplaza el worker eliminado por el último de la lista
-            if (i != manager->workerCount - 1) {
-                manager->workers[i] = manager->workers[manager->workerCount - 1];
-            }
-            manager->workerCount--;
-            break;
-        }
-    }
-
-    pthread_mutex_unlock(&manager->mutex);
-    if (found) {
-        reasignarWorkersPrincipales(manager);
+    if (bajaWorkerPorSocket(manager, socket_fd, NULL, NULL) != 0) {
+        return -1;
     }
 
-    return found ? 0 : -1;
+    // Si era principal, reasignar
+    reasignarWorkersPrincipales(manager);
+    return 0;
 }
 
 void reasignarWorkersPrincipales(WorkerManager *manager) {
-    if (!manager || !manager->workers) {
+    if (!manager) {
         customPrintf("[ERROR]: WorkerManager o la lista de Workers es NULL.");
         return;
     }
 
-    pthread_mutex_lock(&manager->mutex);
-
-    for (int i = 0; i < manager->workerCount; i++) {
-        if (manager->mainTextWorker == NULL && strcasecmp(manager->workers[i].type, "TEXT") == 0) {
-            manager->mainTextWorker = &manager->workers[i];
-            asignarNuevoWorkerPrincipal(manager->mainTextWorker);
-        }
-        if (manager->mainMediaWorker == NULL && strcasecmp(manager->workers[i].type, "MEDIA") == 0) {
-            manager->mainMediaWorker = &manager->workers[i];
-            asignarNuevoWorkerPrincipal(manager->mainMediaWorker);
-        }
-    }
-
-    pthread_mutex_unlock(&manager->mutex);
-}
-
-// Allibera la memòria utilitzada pel WorkerManager
-void freeWorkerManager(WorkerManager *manager) {
-    if (manager) {
-        if (manager->workers) {
-            free(manager->workers); // Liberar la lista dinámica de workers
-        }
-        pthread_mutex_destroy(&manager->mutex); // Destruir el mutex
-        free(manager); // Liberar la estructura principal
-        customPrintf("[DEBUG]: WorkerManager liberado correctamente.");
+    // Es trien amb el registre bloquejat però la trama 0x08 s'envia fora
+    WorkerInfo newMains[2];
+    int count = elegirWorkersPrincipales(manager, newMains, 2);
+    for (int i = 0; i < count; i++) {
+        asignarNuevoWorkerPrincipal(manager, &newMains[i]);
     }
 }
 
-// Gestiona la connexió amb un client
-void *gestionarConexion(void *arg) {
-    ConnectionArgs *args = (ConnectionArgs *)arg;
-    int client_fd = args->client_fd;
-    WorkerManager *workerManager = args->workerManager;
-    ClientManager *clientManager = args->clientManager;
-
-    // Liberamos args inmediatamente después de guardar los datos relevantes
-    free(args);
-    args = NULL; // Asegurarnos de que no sea usado accidentalmente
+// Trama de control rebuda pel reactor (retorna -1 quan la connexió s'ha de tancar)
+int gestionarTramaConexion(ReactorConnection *conn, const Frame *frame, void *context) {
+    ConnectionArgs *args = (ConnectionArgs *)context;
 
-    if (!workerManager || !clientManager) {
-        customPrintf("[ERROR]: WorkerManager o ClientManager NULL en gestionarConexion.");
-        close(client_fd);
-        return NULL;
+    if (frame->type == 0x07) { // Trama de desconexión explícita del cliente
+        customPrintf("\nHe rebut trama de desconnexió.\n");
+        handleDisconnectFrame(frame, conn->fd, args->workerManager, args->clientManager);
+        return -1;
     }
 
-    Frame frame;
-    int disconnectHandled = 0;
+    // Procesar el frame recibido
+    processCommandInGotham(frame, conn, args->workerManager, args->clientManager);
 
-    // Manejo de frames inicial
-    if (leerTrama(client_fd, &frame) != 0) {
-        customPrintf("[ERROR]: Error al recibir el primer frame del cliente.");
-        close(client_fd);
-        return NULL;
+    // Clients (0x01) i workers (0x02) registrats reben HEARTBEAT des del mateix fil del reactor
+    if (frame->type == 0x01 || frame->type == 0x02) {
+        reactor_enable_heartbeat(conn);
     }
+    return 0;
+}
 
-    processCommandInGotham(&frame, client_fd, workerManager, clientManager);
-
-    // Bucle principal para manejar los frames del cliente
-    while (!stop_server) { // Verifica la bandera global para el cierre del servidor
-        if (leerTrama(client_fd, &frame) != 0) {
-            customPrintf("\n[INFO]: Cliente o Worker desconectado.\n");
-            
-            // Determinar si es Worker o Cliente y eliminarlo
-            pthread_mutex_lock(&workerManager->mutex);
-            int esWorker = 0;
-            for (int i = 0; i < workerManager->workerCount; i++) {
-                if (workerManager->workers[i].socket_fd == client_fd) {
-                    esWorker = 1;
-                    break;
-                }
-            }
-            pthread_mutex_unlock(&workerManager->mutex);
-
-            if (esWorker) {
-                logoutWorkerBySocket(client_fd, workerManager);
-            } else {
-                removeClientBySocket(clientManager, client_fd);
-            }
+// El peer ha tancat la connexió sense trama 0x07: eliminar-lo com a Worker o Cliente
+void gestionarDesconexion(ReactorConnection *conn, void *context) {
+    ConnectionArgs *args = (ConnectionArgs *)context;
+    WorkerManager *workerManager = args->workerManager;
+    ClientManager *clientManager = args->clientManager;
+    int client_fd = conn->fd;
 
-            close(client_fd);
-            return NULL;
-        }
-        if (frame.type == 0x07) { // Trama de desconexión explícita del cliente
-            customPrintf("\nHe rebut trama de desconnexió.\n");
-            handleDisconnectFrame(&frame, client_fd, workerManager, clientManager);
-            disconnectHandled = 1;
-            break;
-        }
+    customPrintf("\n[INFO]: Cliente o Worker desconectado.\n");
 
-        // Procesar el frame recibido
-        processCommandInGotham(&frame, client_fd, workerManager, clientManager);
-    }
+    // Determinar si es Worker o Cliente y eliminarlo
+    WorkerInfo worker;
+    int esWorker = (buscarWorkerPorSocket(workerManager, client_fd, &worker) == 0);
 
-    // Si el servidor está en proceso de cierre, gestionar recursos del cliente
-    if (stop_server && !disconnectHandled) {
-        customPrintf("\n[INFO]: Finalizando conexión por cierre del servidor.\n");
-        removeClientBySocket(clientManager, client_fd);
-    } else if (!disconnectHandled) {
+    if (esWorker) {
+        logWorkerEvent(EVENT_WORKER_DISCONNECT, worker.type, worker.ip, worker.port, 0, 0);
+        logoutWorkerBySocket(client_fd, workerManager);
+    } else {
         removeClientBySocket(clientManager, client_fd);
     }
-
-    close(client_fd);
-    return NULL;
 }
 
 // Processa un frame rebut
@@ -645,15 +348,16 @@ void *gestionarConexion(void *arg) {
 * Identifica el tipus de comanda i executa les accions corresponents.
 * @Paràmetres:
 *   in: frame = el frame rebut del client.
-*   in: client_fd = descriptor del client que ha enviat la comanda.
+*   in: conn = connexió del reactor per on ha arribat la comanda (i per on surten les respostes).
 *   in: manager = punter al WorkerManager.
 * @Retorn: ----
 ************************************************/
-void processCommandInGotham(const Frame *frame, int client_fd, WorkerManager *manager, ClientManager *clientManager) {
-    if (!frame) {
+void processCommandInGotham(const Frame *frame, ReactorConnection *conn, WorkerManager *manager, ClientManager *clientManager) {
+    if (!frame || !conn) {
         customPrintf("El frame rebut és NULL.");
         return;
     }
+    int client_fd = conn->fd;
 
     // Estructura per preparar la resposta
     Frame response = {0};
@@ -662,20 +366,37 @@ void processCommandInGotham(const Frame *frame, int client_fd, WorkerManager *ma
     switch (frame->type) {
         case 0x01: // CONNECT
             // Parsear los datos de la conexión (nombre de usuario, IP y puerto)
-            char username[64] = {0}, ip[16] = {0};
+            char username[64] = {0}, ip[16] = {0}, protocolTag[4] = {0};
             int port = 0;
 
-            if (sscanf(frame->data, "%63[^&]&%15[^&]&%d", username, ip, &port) != 3) {
+            int connectFields = sscanf(frame->data, "%63[^&]&%15[^&]&%d&%3s", username, ip, &port, protocolTag);
+            if (connectFields < 3) {
                 customPrintf("[ERROR]: Formato de datos de conexión inválido.");
                 response.type = 0x01;
                 strncpy(response.data, "CON_KO", sizeof(response.data) - 1);
                 response.data_length = strlen(response.data);
                 response.checksum = calculate_checksum(response.data, response.data_length, 0);
-                escribirTrama(client_fd, &response);
+                reactor_send_frame(conn, &response);
                 break;
             }
 
-            // Registrar al cliente en el ClientManager
+            // Enviar respuesta de éxito (en v1; si el Fleck suporta v2 ho confirmem a DATA)
+            int clientUsesV2 = (connectFields == 4 && strcmp(protocolTag, FRAME_PROTOCOL_V2_TAG) == 0);
+            response.type = 0x01;
+            if (clientUsesV2) {
+                strncpy(response.data, FRAME_PROTOCOL_V2_TAG, sizeof(response.data) - 1);
+            } else {
+                response.data[0] = '\0'; // Configurar datos como vacío
+            }
+            response.data_length = strlen(response.data);
+            response.checksum = calculate_checksum(response.data, response.data_length, 0);
+            reactor_send_frame(conn, &response);
+
+            if (clientUsesV2) {
+                set_frame_protocol(client_fd, FRAME_PROTOCOL_V2);
+            }
+
+            // Registrar al cliente en el ClientManager (després del canvi de protocol pels HEARTBEAT)
             addClient(clientManager, username, ip, client_fd);
 
             char *formattedName = strdup(username);
@@ -696,25 +417,16 @@ void processCommandInGotham(const Frame *frame, int client_fd, WorkerManager *ma
             asprintf(&log_message, "\nNew user connected: %s.\n\n", username);
             customPrintf(log_message);
             free(log_message); // Liberar memoria asignada por asprintf
-
-            // Enviar respuesta de éxito
-            response.type = 0x01;
-            response.data[0] = '\0'; // Configurar datos como vacío
-            response.data_length = 0; // Longitud de datos = 0
-            response.checksum = calculate_checksum(response.data, response.data_length, 0);
-            escribirTrama(client_fd, &response);
             break;
 
         case 0x02: // REGISTER
-            registrarWorker(frame->data, manager, client_fd);
+            registrarWorker(frame->data, manager, conn);
             listarWorkers(manager);
             break;
 
         case 0x07:
             // Llamamos a la función centralizada para manejar desconexión
             handleDisconnectFrame(frame, client_fd, manager, clientManager);
-
-            close(client_fd);
             break;
 
         case 0x10: // DISTORT
@@ -728,7 +440,7 @@ void processCommandInGotham(const Frame *frame, int client_fd, WorkerManager *ma
                 strncpy(response.data, "MEDIA_KO", sizeof(response.data) - 1);
                 response.data_length = strlen(response.data);
                 response.checksum = calculate_checksum(response.data, response.data_length, 0);
-                escribirTrama(client_fd, &response);
+                reactor_send_frame(conn, &response);
                 break;
             }
 
@@ -743,28 +455,29 @@ void processCommandInGotham(const Frame *frame, int client_fd, WorkerManager *ma
                 strncpy(response.data, "MEDIA_KO", sizeof(response.data) - 1);
                 response.data_length = strlen(response.data);
                 response.checksum = calculate_checksum(response.data, response.data_length, 0);
-                escribirTrama(client_fd, &response);
+                reactor_send_frame(conn, &response);
                 break;
             }
 
             // Buscar worker adecuado
-            WorkerInfo *targetWorker = buscarWorker(fileName, manager);           
-            if (!targetWorker) {
+            WorkerInfo targetWorker;
+            if (buscarWorker(fileName, manager, &targetWorker) != 0) {
                 customPrintf("[ERROR]: No se encontró un worker para el archivo especificado.\n");
-                //handleWorkerFailure(mediaType, manager, client_fd);
+                // Fleck aparella cada resposta 0x10 amb la petició més antiga: sempre se n'hi envia una
+                response.type = 0x10;
+                strncpy(response.data, "DISTORT_KO", sizeof(response.data) - 1);
+                response.data_length = strlen(response.data);
+                response.checksum = calculate_checksum(response.data, response.data_length, 0);
+                reactor_send_frame(conn, &response);
                 break;
             }
 
             //Obtener el nombre del cliente según su socket
             char clientName[64] = "Unknown";
-            pthread_mutex_lock(&clientManager->mutex);
-            for (int i = 0; i < clientManager->clientCount; i++) {
-                if (clientManager->clients[i].socket_fd == client_fd) {
-                    strncpy(clientName, clientManager->clients[i].username, sizeof(clientName) - 1);
-                    break;
-                }
+            ClientInfo requester;
+            if (buscarClientePorSocket(clientManager, client_fd, &requester) == 0) {
+                strncpy(clientName, requester.username, sizeof(clientName) - 1);
             }
-            pthread_mutex_unlock(&clientManager->mutex);
 
             char *logLine = NULL;
             asprintf(&logLine, "Client %s requested distortion of file: %s", clientName, fileName);
@@ -782,12 +495,14 @@ void processCommandInGotham(const Frame *frame, int client_fd, WorkerManager *ma
                             clientName, clientName);
             }
 
+            logWorkerEvent(EVENT_DISTORT_ROUTED, targetWorker.type, targetWorker.ip, targetWorker.port, 0, 0);
+
             // Preparar respuesta con la información del Worker
-            snprintf(response.data, sizeof(response.data), "%s&%d", targetWorker->ip, targetWorker->port);
+            snprintf(response.data, sizeof(response.data), "%s&%d", targetWorker.ip, targetWorker.port);
             response.type = 0x10;
             response.data_length = strlen(response.data);
             response.checksum = calculate_checksum(response.data, response.data_length, 0);
-            escribirTrama(client_fd, &response);
+            reactor_send_frame(conn, &response);
             break;
 
         case 0x11: //REASINGAR WORKER
@@ -802,7 +517,7 @@ void processCommandInGotham(const Frame *frame, int client_fd, WorkerManager *ma
                 strncpy(response.data, "MEDIA_KO", sizeof(response.data) - 1);
                 response.data_length = strlen(response.data);
                 response.checksum = calculate_checksum(response.data, response.data_length, 0);
-                escribirTrama(client_fd, &response);
+                reactor_send_frame(conn, &response);
                 break;
             }
 
@@ -819,37 +534,46 @@ void processCommandInGotham(const Frame *frame, int client_fd, WorkerManager *ma
                 strncpy(response.data, "MEDIA_KO", sizeof(response.data) - 1);
                 response.data_length = strlen(response.data);
                 response.checksum = calculate_checksum(response.data, response.data_length, 0);
-                escribirTrama(client_fd, &response);
+                reactor_send_frame(conn, &response);
                 break;
             }
 
             // Buscar un Worker disponible
-            WorkerInfo *targetWorkerCaiguda = buscarWorker(fileName0x11, manager);
-            if (!targetWorkerCaiguda) {
+            WorkerInfo targetWorkerCaiguda;
+            if (buscarWorker(fileName0x11, manager, &targetWorkerCaiguda) != 0) {
                 customPrintf("[ERROR]: No hay Workers disponibles para el tipo especificado.\n");
                 response.type = 0x11;
                 strncpy(response.data, "DISTORT_KO", sizeof(response.data) - 1);
                 response.data_length = strlen(response.data);
                 response.checksum = calculate_checksum(response.data, response.data_length, 0);
-                escribirTrama(client_fd, &response);
+                reactor_send_frame(conn, &response);
                 break;
             }
 
+            logWorkerEvent(EVENT_DISTORT_REASSIGNED, targetWorkerCaiguda.type, targetWorkerCaiguda.ip, targetWorkerCaiguda.port, 0, 0);
+
             // Responder con la información del Worker
             char workerInfo0x11[DATA_MAX_SIZE] = {0};
-            snprintf(workerInfo0x11, sizeof(workerInfo0x11), "%s&%d", targetWorkerCaiguda->ip, targetWorkerCaiguda->port);
+            snprintf(workerInfo0x11, sizeof(workerInfo0x11), "%s&%d", targetWorkerCaiguda.ip, targetWorkerCaiguda.port);
             response.type = 0x11;
             strncpy(response.data, workerInfo0x11, sizeof(response.data) - 1);
             response.data_length = strlen(response.data);
             response.checksum = calculate_checksum(response.data, response.data_length, 0);
 
             customPrintf("\nEnviando información del Worker reasignado...\n");
-            escribirTrama(client_fd, &response);
+            reactor_send_frame(conn, &response);
+            break;
+
+        case FRAME_LOAD_TYPE: // Informe de càrrega del worker (sense resposta)
+            actualizarCargaWorker(frame->data, manager, client_fd);
             break;
 
         default: // Comanda desconeguda
             customPrintf("Comanda desconeguda rebuda.\n");
-            enviarTramaError(client_fd);
+            response.type = 0x09;
+            response.data_length = 0;
+            response.checksum = calculate_checksum(response.data, response.data_length, 0);
+            reactor_send_frame(conn, &response);
             break;
     }
 }
@@ -860,78 +584,35 @@ void handleDisconnectFrame(const Frame *frame, int client_fd, WorkerManager *man
         return;
     }
 
-    int isWorker = 0;
-    int isClient = 0;
-    WorkerInfo *disconnectedWorker = NULL; 
-
-    // Verificar si es un Worker
-    pthread_mutex_lock(&manager->mutex);
-    for (int i = 0; i < manager->workerCount; i++) {
-        if (manager->workers[i].socket_fd == client_fd) {
-            isWorker = 1;
-            break;
-        }
-    }
-    pthread_mutex_unlock(&manager->mutex);
-
-    // Verificar si es un Cliente
-    pthread_mutex_lock(&clientManager->mutex);
-    if (!isWorker) {
-        for (int i = 0; i < clientManager->clientCount; i++) {
-            if (clientManager->clients[i].socket_fd == client_fd) {
-                isClient = 1;
-                break;
-            }
-        }
-    }
-    pthread_mutex_unlock(&clientManager->mutex);
-
-    if (isWorker) {
-        pthread_mutex_lock(&manager->mutex);
-        for (int i = 0; i < manager->workerCount; i++) {
-            if (manager->workers[i].socket_fd == client_fd) {
-                disconnectedWorker = &manager->workers[i];
-                break;
-            }
-        }
-        pthread_mutex_unlock(&manager->mutex);
-    } 
+    WorkerInfo disconnectedWorker;
+    ClientInfo disconnectedClient;
 
-    if (disconnectedWorker) {
+    if (buscarWorkerPorSocket(manager, client_fd, &disconnectedWorker) == 0) {
             char *logLine = NULL;
             asprintf(&logLine, "Worker disconnected: %s - IP: %s, Port: %d",
-                    disconnectedWorker->type, disconnectedWorker->ip, disconnectedWorker->port);
+                    disconnectedWorker.type, disconnectedWorker.ip, disconnectedWorker.port);
             if (logLine) {
                 logEvent(logLine);
                 free(logLine);
             }
-            close(client_fd);  // Cerrar el socket antes de eliminar el Worker
-            int wasMain = (manager->mainTextWorker == disconnectedWorker || manager->mainMediaWorker == disconnectedWorker);
+            logWorkerEvent(EVENT_WORKER_DISCONNECT, disconnectedWorker.type, disconnectedWorker.ip, disconnectedWorker.port, 0, 0);
+            int wasMain = esWorkerPrincipal(manager, client_fd);
+            // logoutWorkerBySocket ja reassigna els principals un cop el worker és fora del registre
             if (logoutWorkerBySocket(client_fd, manager) == 0) {
                 customPrintf("\nWorker desconectado correctamente.\n");
                 if (wasMain) {
                     customPrintf("\nReasignando nuevo Worker principal...\n");
-                    reasignarWorkersPrincipales(manager);
                 }
             }
-        } else if (isClient) {
+        } else if (buscarClientePorSocket(clientManager, client_fd, &disconnectedClient) == 0) {
             char *clientName = NULL;
-
-            pthread_mutex_lock(&clientManager->mutex);
-            for (int i = 0; i < clientManager->clientCount; i++) {
-                if (clientManager->clients[i].socket_fd == client_fd) {
-                    asprintf(&clientName, "Client disconnected: %s", clientManager->clients[i].username);
-                    break;
-                }
-            }
-            pthread_mutex_unlock(&clientManager->mutex);
+            asprintf(&clientName, "Client disconnected: %s", disconnectedClient.username);
 
             if (clientName) {
                 logEvent(clientName);
                 free(clientName);
             }
 
-            close(client_fd);
             removeClientBySocket(clientManager, client_fd);
         } else {
             logWarning("[WARNING]: Socket no corresponde a un Worker ni a un Cliente.\n");
@@ -944,68 +625,40 @@ void alliberarMemoria(GothamConfig *gothamConfig) {
     free(gothamConfig);
 }
 
+static void tancarSocketWorker(const WorkerInfo *worker, int index, void *arg) {
+    (void)index;
+    (void)arg;
+    close(worker->socket_fd);
+}
+
+static void tancarSocketClient(const ClientInfo *client, void *arg) {
+    (void)arg;
+    shutdown(client->socket_fd, SHUT_RDWR);
+    close(client->socket_fd);
+}
+
+// Només marca el tancament: main atura el reactor, buida l'anell cap a Arkham i allibera la resta
 void handleSigint(int sig) {
     (void)sig; // Ignorar el valor de la señal
     stop_server = 1;
 
-    SEM_destructor(&arkham_sem);
-    close(arkham_pipe[1]); // asegúrate de cerrar el lado de escritura
-
-    // Liberar los recursos de WorkerManager
-    if (workerManager) {
-        pthread_mutex_lock(&workerManager->mutex);
-        for (int i = 0; i < workerManager->workerCount; i++) {
-            WorkerInfo *worker = &workerManager->workers[i];
-            close(worker->socket_fd); // Cerrar el socket del worker
-        }
-        pthread_mutex_unlock(&workerManager->mutex);
-        freeWorkerManager(workerManager); // Liberar el WorkerManager
-        workerManager = NULL;
+    if (global_reactor) {
+        reactor_stop(global_reactor); // Els bucles surten en el proper tomb d'epoll_wait
     }
-
-    // Liberar los recursos de ClientManager
-    if (clientManager) {
-        pthread_mutex_lock(&clientManager->mutex);
-        for (int i = 0; i < clientManager->clientCount; i++) {
-            shutdown(clientManager->clients[i].socket_fd, SHUT_RDWR);
-            close(clientManager->clients[i].socket_fd); // Cerrar el socket del cliente
-        }
-        pthread_mutex_unlock(&clientManager->mutex);
-        freeClientManager(clientManager); // Liberar el ClientManager
-        clientManager = NULL;
-    }
-
-    // Cerrar los descriptores de archivo globales
-    if (global_server_fds) {
-        if (global_server_fds->server_fd_fleck >= 0) {
-            close(global_server_fds->server_fd_fleck);
-            global_server_fds->server_fd_fleck = -1;
-        }
-        if (global_server_fds->server_fd_worker >= 0) {
-            close(global_server_fds->server_fd_worker);
-            global_server_fds->server_fd_worker = -1;
-        }
-    }
-
-    // Liberar la configuración global
-    if (global_config) {
-        if (global_config->ipFleck) free(global_config->ipFleck);
-        if (global_config->ipHarEni) free(global_config->ipHarEni);
-        free(global_config);
-        global_config = NULL;
-    }
-
-    customPrintf("Sistema tancat correctament.\n");
-    exit(EXIT_SUCCESS);
 }
 
 
-//Loggear eventos de Arkham
+//Loggear eventos de Arkham: la línia va a l'anell i el fil d'escriptura l'envia per lots
 void logEvent(const char *msg) {
-    SEM_wait(&arkham_sem);
-    write(arkham_pipe[1], msg, strlen(msg));
-    write(arkham_pipe[1], "\n", 1);  // Asegura fin de línea
-    SEM_signal(&arkham_sem);
+    log_ring_push(&arkhamLog, msg);
+}
+
+// Esdeveniment estructurat: viatja per la mateixa pipe i Arkham el desa al registre binari
+void logWorkerEvent(int type, const char *workerType, const char *ip, int port, uint64_t bytes, uint32_t durationMs) {
+    char line[128];
+    if (event_log_format(line, sizeof(line), type, workerType, ip, port, bytes, durationMs) == 0) {
+        log_ring_push(&arkhamLog, line);
+    }
 }
 
 // Funció principal del servidor Gotham
@@ -1028,20 +681,25 @@ int main(int argc, char *argv[]) {
 
     readConfigFileGeneric(argv[1], config, CONFIG_GOTHAM);
 
-    ServerFds server_fds;
-    global_server_fds = &server_fds; // Asignar el puntero global
+    // Reactor epoll: un fil per core atén totes les connexions de Fleck i dels workers
+    static Reactor reactor;
+    ConnectionArgs reactorArgs = {0};
+    reactorArgs.client_fd = -1;
+    global_reactor = &reactor; // Asignar el puntero global
 
     signal(SIGINT, handleSigint);
     signal(SIGPIPE, SIG_IGN);
 
-    server_fds.server_fd_fleck = startServer(config->ipFleck, config->portFleck);
-    server_fds.server_fd_worker = startServer(config->ipHarEni, config->portHarEni);
-
-    if (server_fds.server_fd_fleck < 0 || server_fds.server_fd_worker < 0) {
+    int reactorOk = reactor_init(&reactor, 0, REACTOR_REUSEPORT, gestionarTramaConexion, gestionarDesconexion, &reactorArgs) == 0;
+    if (!reactorOk ||
+        reactor_listen(&reactor, config->ipFleck, config->portFleck, LISTENER_FLECK) != 0 ||
+        reactor_listen(&reactor, config->ipHarEni, config->portHarEni, LISTENER_WORKER) != 0) {
         customPrintf("Error al iniciar los servidores.\n");
         //FER TOTS ELS FREES
-        if (server_fds.server_fd_fleck >= 0) close(server_fds.server_fd_fleck);
-        if (server_fds.server_fd_worker >= 0) close(server_fds.server_fd_worker);
+        if (reactorOk) {
+            reactor_join(&reactor);
+        }
+        global_reactor = NULL;
 
         if (clientManager) {
             freeClientManager(clientManager);
@@ -1067,21 +725,12 @@ int main(int argc, char *argv[]) {
         customPrintf("[ERROR]: No se pudo inicializar WorkerManager o ClientManager.");
         exit(EXIT_FAILURE);
     }
+    reactorArgs.workerManager = manager;
+    reactorArgs.clientManager = clientManager;
 
-    // Crear el hilo de HEARTBEAT
-    ConnectionArgs *heartbeatArgs = malloc(sizeof(ConnectionArgs));
-    heartbeatArgs->workerManager = manager;
-    heartbeatArgs->clientManager = clientManager;
-    heartbeatArgs->client_fd = -1; // No lo usaremos en este caso
-
-    pthread_t heartbeatThread;
-    if (pthread_create(&heartbeatThread, NULL, enviarHeartbeat, heartbeatArgs) != 0) {
-        customPrintf("[ERROR]: No se pudo crear el hilo de HEARTBEAT.");
-        free(heartbeatArgs); // Liberar en caso de error
-        exit(EXIT_FAILURE);
-    } else {
-        pthread_detach(heartbeatThread);         
-    }
+    // HEARTBEAT (0x12): els envia cada bucle del reactor amb la seva roda de temporitzadors
+    reactor_set_heartbeat(&reactor, 0x12);
+    customPrintf("\n[INFO]: Política de repartiment de workers: %s.\n", scheduler_policy_name(SCHEDULER_POLICY));
 
     if (pipe(arkham_pipe) == -1) {
         perror("pipe");
@@ -1103,115 +752,44 @@ int main(int argc, char *argv[]) {
 
     close(arkham_pipe[0]); // Cierra lectura en Gotham
 
-    // Inicialización del semáforo (solo en Gotham)
-    key_t key = ftok("Gotham.c", 'A');
-    if (key == -1) {
-        perror("ftok");
-        exit(EXIT_FAILURE);
-    }
-    if (SEM_constructor_with_name(&arkham_sem, key) < 0) {
-        write(STDERR_FILENO, "Error creando semáforo\n", 24);
+    // Només el fil d'escriptura de l'anell escriu a la pipe: no cal cap semàfor
+    if (log_ring_start(&arkhamLog, arkham_pipe[1], LOG_RING_CAPACITY) != 0) {
+        customPrintf("[ERROR]: No se pudo iniciar el registro hacia Arkham.");
         exit(EXIT_FAILURE);
     }
 
-    if (SEM_init(&arkham_sem, 1) < 0) {
-        write(STDERR_FILENO, "Error inicializando semáforo\n", 30);
+    // Bucle principal: els fils del reactor accepten i processen les connexions fins al cierre
+    if (reactor_start(&reactor) != 0) {
+        customPrintf("[ERROR]: No se pudo iniciar el reactor.");
         exit(EXIT_FAILURE);
     }
+    customPrintf("\n[INFO]: Reactor iniciado con %d hilos.\n", reactor.loopCount);
+    reactor_join(&reactor);
+    global_reactor = NULL;
 
-
-    // Bucle principal de aceptación de conexiones
-    while (!stop_server) {
-        fd_set read_fds;
-        FD_ZERO(&read_fds);
-        FD_SET(server_fds.server_fd_fleck, &read_fds);
-        FD_SET(server_fds.server_fd_worker, &read_fds);
-
-        int max_fd = (server_fds.server_fd_fleck > server_fds.server_fd_worker) ?
-                        server_fds.server_fd_fleck : server_fds.server_fd_worker;
-
-        int activity = select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-        if (activity < 0) {
-            if (stop_server) break;
-            perror("[ERROR]: Error en select");
-            break;
-        }
-
-        // Manejo de conexiones de Fleck (clientes)
-        if (FD_ISSET(server_fds.server_fd_fleck, &read_fds)) {
-            int client_fd = accept_connection(server_fds.server_fd_fleck);
-            if (client_fd >= 0) {
-                pthread_t thread;
-                ConnectionArgs *args = malloc(sizeof(ConnectionArgs));
-                if (!args) {
-                    customPrintf("[ERROR]: Error asignando memoria para los argumentos del hilo.");
-                    close(client_fd);
-                    continue;
-                }
-                args->client_fd = client_fd;
-                args->workerManager = manager;
-                args->clientManager = clientManager;
-
-                if (pthread_create(&thread, NULL, gestionarConexion, args) != 0) {
-                    perror("[ERROR]: Fallo al crear hilo para Fleck");
-                    free(args);
-                    close(client_fd);
-                } else {
-                    pthread_detach(thread); // Liberar recursos del thread automáticamente
-                }
-            }
-        }
-
-        // Manejo de conexiones de Harley/Enigma (workers)
-        if (FD_ISSET(server_fds.server_fd_worker, &read_fds)) {
-            int client_fd = accept_connection(server_fds.server_fd_worker);
-            if (client_fd >= 0) {
-                pthread_t thread;
-                ConnectionArgs *args = malloc(sizeof(ConnectionArgs));
-                if (!args) {
-                    customPrintf("[ERROR]: Error asignando memoria para los argumentos del hilo.");
-                    close(client_fd);
-                    continue;
-                }
-                args->client_fd = client_fd;
-                args->workerManager = manager;
-                args->clientManager = clientManager;
-
-                if (pthread_create(&thread, NULL, gestionarConexion, args) != 0) {
-                    perror("[ERROR]: Fallo al crear hilo para Harley/Enigma");
-                    free(args);
-                    close(client_fd);
-                } else {
-                    pthread_detach(thread);
-                }
-            }
-        }
-    }
+    // Amb els bucles aturats, l'anell es buida cap a Arkham una sola vegada
+    log_ring_stop(&arkhamLog);
+    close(arkham_pipe[1]); // asegúrate de cerrar el lado de escritura
 
     // Antes de salir, libera todo explícitamente
     if (manager) {
+        recorrerWorkers(manager, tancarSocketWorker, NULL); // Cerrar el socket de cada worker
         freeWorkerManager(manager);
         manager = NULL;
     }
     if (clientManager) {
+        recorrerClientes(clientManager, tancarSocketClient, NULL); // Cerrar el socket de cada cliente
         freeClientManager(clientManager);
         clientManager = NULL;
     }
     if (config) {
-        free(config);
+        alliberarMemoria(config);
         config = NULL;
+        global_config = NULL;
     }
-
-    close(server_fds.server_fd_fleck);
-    close(server_fds.server_fd_worker);
-    close(arkham_pipe[1]); // asegúrate de cerrar el lado de escritura
-
-    // Esperar a que el hilo HEARTBEAT termine
-    SEM_destructor(&arkham_sem);
-    close(arkham_pipe[1]);
+    customPrintf("\nServidor Gotham cerrado correctamente.\n");
+    log_console_flush(); // L'anell de consola també fa servir un fd que es tanca a continuació
     for (int fd = 3; fd < 1024; ++fd) close(fd);
 
-    customPrintf("\nServidor Gotham cerrado correctamente.\n");
-    
     return EXIT_SUCCESS;
 }
\ No newline at end of file
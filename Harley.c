@@ -19,23 +19,34 @@
 #include "DataConversion/DataConversion.h"
 #include "FrameUtils/FrameUtils.h"
 #include "FrameUtilsBinary/FrameUtilsBinary.h"
+#include "FlowControl/FlowControl.h"
+#include "WorkerLoad/WorkerLoad.h"
+#include "TimerWheel/TimerWheel.h"
 #include "Logging/Logging.h"
 #include "MD5SUM/md5Sum.h"
 #include "File_transfer/file_transfer.h"
 #include "Compression/so_compression.h"
 #include "HarleyCompression/compression_handler.h"
+#include "HarleyCompression/compression_pool.h"
 #include "HarleySync/HarleySync.h"
+#include "WorkerJobs/WorkerJobs.h"
+#include "ResultCache/ResultCache.h"
 
 #define HARLEY_PATH_FILES "harley_directory/"
 #define HARLEY_TYPE "MEDIA"
 
 void *handleFleckFrames(void *arg);
 void processReceivedFrame(int gothamSocket, const Frame *response);
-void processBinaryFrameFromFleck(BinaryFrame *binaryFrame, size_t expectedFileSize, size_t *currentFileSize, int clientSocket);
-void enviaTramaArxiuDistorsionat(int clientSocket, const char *fileSizeCompressed, const char *compressedMD5, const char *compressedFilePath, size_t offset);
+// data == NULL: la DATA (còpia zero) encara és al lector/socket i es mou directament al fitxer
+void processBinaryFrameFromFleck(WorkerJob *job, const char *data, size_t dataLength, FrameReader *reader);
+// job == NULL: reenviament d'una distorsió recuperada sense connexió de Fleck associada
+void enviaTramaArxiuDistorsionat(WorkerJob *job, int clientSocket, const char *fileName, const char *userName, const char *factor, const char *originalMD5, const char *fileSizeCompressed, const char *compressedMD5, const char *compressedFilePath, size_t offset, uint32_t bulkChunkSize, uint32_t creditWindow, uint32_t zeroCopy);
 void send_frame_with_error(int clientSocket, const char *errorMessage);
-void send_frame_with_ok(int clientSocket);
+void send_frame_with_ok(int clientSocket, const char *acceptedOptions);
 void sendMD5Response(int clientSocket, const char *status);
+static int servirDesDeCache(WorkerJob *job, TransferOptions *options);
+static off_t prepararRecepcio(WorkerJob *job, const char *filePath, int offerHave);
+static void completarRecepcio(WorkerJob *job);
 
 HarleyConfig *globalharleyConfig = NULL;
 SharedMemory harleySharedMemory; //LINKEDLIST PER TENIR ARRAY AMB DESCÀRREGUES
@@ -44,9 +55,13 @@ SharedMemory harleySharedMemory; //LINKEDLIST PER TENIR ARRAY AMB DESCÀRREGUES
 int gothamSocket = -1;
 float resultStatus;
 
-int lastFleckSocket = -1;
+WorkerJobTable harleyJobs; // Distorsions en curs, una per connexió de Fleck
+ResultCache harleyCache;   // Mitjans ja comprimits, per (MD5, factor, tipus)
+CompressionPool harleyCompressionPool; // Fils que comprimeixen els arxius rebuts
 
 volatile sig_atomic_t stop = 0;
+volatile sig_atomic_t sigintRebut = 0; // El posa signalHandler; el fil principal fa el tancament
+static int fleckListenSocket = -1;     // Socket d'escolta de Fleck (el senyal el talla per despertar l'accept)
 
 // Variable para almacenar el último tiempo de recepción del HEARTBEAT
 volatile time_t lastHeartbeat = 0;
@@ -71,14 +86,29 @@ typedef struct {
     off_t fileSize;
     char *compressedPath; // Ruta del archivo comprimido
     size_t offset; //Byte per continuar l'enviament
+    uint32_t bulkChunkSize; // 0 = trames 0x05 de 247 bytes
+    uint32_t creditWindow;  // 0 = sense crèdits (espaiat fix per a Flecks antics)
+    uint32_t zeroCopy;      // 1 = DATA enviada amb sendfile(2)
+    WorkerJob *job;         // Feina de la connexió (amb referència pròpia) o NULL
+    char fileName[256];
     char userName[64];
+    char originalMD5[33];
+    char factor[20];
 } SendCompressedFileArgs;
 
-char receivedFileName[256] = {0}; // Nombre del archivo recibido
-char receivedUserName[64] = {0};
-int tempFileDescriptor = -1;      // Descriptor del archivo temporal
-char expectedMD5[33];
-char receivedFactor[20];
+// Compressió encuada d'una distorsió rebuda (la CompressionTask ha d'anar primer)
+typedef struct {
+    CompressionTask task;
+    WorkerJob *job;               // Amb referència pròpia fins que s'ha encetat l'enviament
+    size_t receivedBytes;
+    char fileName[256];
+    char userName[64];
+    char expectedMD5[33];
+    char factor[20];
+    uint32_t bulkChunkSize;
+    uint32_t creditWindow;
+    uint32_t zeroCopy;
+} DistortionTask;
 
 void sendDisconnectFrameToGotham(const char *mediaType)
 {
@@ -105,62 +135,74 @@ void sendDisconnectFrameToGotham(const char *mediaType)
     }
 }
 
-// Función para manejar señales como SIGINT
+// SIGINT: dins del senyal només es marca el tancament i es desperta el fil principal, que fa tancarHarley
 void signalHandler(int sig) {
-    static int already_exiting = 0; // Variable estática para evitar múltiples señales
-
-    if (sig == SIGINT) {
-        if (already_exiting) {
-            return; // Si ya se está ejecutando, ignorar la segunda señal
-        }
-        already_exiting = 1;
-
-        customPrintf("\nDisconnecting, sending current file to another Harley worker.\n");
-
-        if (lastFleckSocket >= 0) {
-            shutdown(lastFleckSocket, SHUT_RDWR); // Cierra lectura y escritura
-            close(lastFleckSocket);
-            lastFleckSocket = -1;
-        }
-        
-        stop = 1;
+    if (sig != SIGINT || sigintRebut) {
+        return; // Si ya se está cerrando, ignorar la segunda señal
+    }
+    sigintRebut = 1;
+    worker_jobs_request_stop(&harleyJobs); // worker_jobs_acquire deixa d'esperar plaça
+    if (fleckListenSocket >= 0) {
+        shutdown(fleckListenSocket, SHUT_RDWR); // L'accept del fil principal torna amb error
+    }
+}
 
-        sendDisconnectFrameToGotham(HARLEY_TYPE);
+// Tancament ordenat des del fil principal (aquí ja es pot imprimir i agafar mutex)
+static void tancarHarley(void) {
+    customPrintf("\nDisconnecting, sending current file to another Harley worker.\n");
+
+    CompressionPoolStats compressionStats;
+    compression_pool_get_stats(&harleyCompressionPool, &compressionStats);
+    customPrintf("Compressions: %llu fetes, cua màxima %d, espera mitjana %llu ms (màx %llu ms), %llu cops la cua plena.\n",
+                 (unsigned long long)compressionStats.completed, compressionStats.maxQueued,
+                 (unsigned long long)(compressionStats.completed ? compressionStats.totalWaitMs / compressionStats.completed : 0),
+                 (unsigned long long)compressionStats.maxWaitMs, (unsigned long long)compressionStats.blockedSubmits);
+
+    ResultCacheStats cacheStats;
+    result_cache_get_stats(&harleyCache, &cacheStats);
+    customPrintf("Caché de resultats: %llu encerts, %llu fallades, %d entrades (%llu bytes), %llu desallotjades, %llu pujades estalviades.\n",
+                 (unsigned long long)cacheStats.hits, (unsigned long long)cacheStats.misses, cacheStats.entries,
+                 (unsigned long long)cacheStats.bytes, (unsigned long long)cacheStats.evictions,
+                 (unsigned long long)cacheStats.sourceHits);
+
+    // Talla les connexions de Fleck en curs (lectura i escriptura) i, quan els fils les han deixat,
+    // tanca els arxius que s'estaven rebent
+    if (worker_jobs_wait_idle(&harleyJobs, WORKER_JOBS_STOP_TIMEOUT_MS) != 0) {
+        logWarning("[WARNING]: Alguna distorsión no ha terminado a tiempo; se cierra igualmente.");
+    }
+    worker_jobs_close_all(&harleyJobs);
+    
+    stop = 1;
 
-        if (gothamSocket > 0) {
-            close(gothamSocket);
-            gothamSocket = -1;
-        }
+    sendDisconnectFrameToGotham(HARLEY_TYPE);
 
-        if (tempFileDescriptor >= 0) {
-            close(tempFileDescriptor);
-            tempFileDescriptor = -1;
-        }
+    if (gothamSocket > 0) {
+        close(gothamSocket);
+        gothamSocket = -1;
+    }
 
-        if (globalharleyConfig) {
-            free(globalharleyConfig->workerType);
-            free(globalharleyConfig->ipFleck);
-            free(globalharleyConfig->ipGotham);
-            free(globalharleyConfig);
-            globalharleyConfig = NULL;
-        }
+    if (globalharleyConfig) {
+        free(globalharleyConfig->workerType);
+        free(globalharleyConfig->ipFleck);
+        free(globalharleyConfig->ipGotham);
+        free(globalharleyConfig);
+        globalharleyConfig = NULL;
+    }
 
-        // Cerrar todos los descriptores de archivo abiertos
-        //int maxFD = getdtablesize(); 
-        //for (int fd = 3; fd < maxFD; fd++) {
-           //close(fd);
-        //}
-        
-         //Alliberar memoria compartida
-         if (harleySharedMemory.shmaddr != (void*) -1) {
-            shmdt(harleySharedMemory.shmaddr); //Desconecta el segmento de memoria compartida ubicado en la dirección especificada del espacio de direcciones del proceso que realiza la llamada
-            shmctl(harleySharedMemory.shmid, IPC_RMID, NULL); //Destruye realmente la zona de memoria compartida
-        }
+    // Cerrar todos los descriptores de archivo abiertos
+    //int maxFD = getdtablesize(); 
+    //for (int fd = 3; fd < maxFD; fd++) {
+       //close(fd);
+    //}
+    
+     //Alliberar memoria compartida
+     if (harleySharedMemory.shmaddr != (void*) -1) {
+        shmdt(harleySharedMemory.shmaddr); //Desconecta el segmento de memoria compartida ubicado en la dirección especificada del espacio de direcciones del proceso que realiza la llamada
+        shmctl(harleySharedMemory.shmid, IPC_RMID, NULL); //Destruye realmente la zona de memoria compartida
+    }
 
-        if (harleySharedMemory.sem.shmid >= 0) {
-            SEM_destructor(&(harleySharedMemory.sem));
-        }      
-        exit(0);
+    if (harleySharedMemory.sem.shmid >= 0) {
+        SEM_destructor(&(harleySharedMemory.sem));
     }
 }
 
@@ -186,161 +228,256 @@ void *handleGothamFrames(void *arg)
     pthread_exit(NULL);
 }
 
+// Una recepció pendent es pot reprendre si cap feina d'aquest worker no té el mateix arxiu
+static int reclamarPendent(const HarleyDistortionEntry *entry, void *arg) {
+    return worker_job_claim(&harleyJobs, (WorkerJob *)arg, entry->fileName) == 0;
+}
+
 void *handleFleckFrames(void *arg){
-    int clientSocket = *(int *)arg;
-    free(arg);
+    WorkerJob *job = (WorkerJob *)arg;
+    int clientSocket = job->clientSocket;
 
-    size_t expectedFileSize = 0;   // Tamaño esperado del archivo (de la trama 0x03)
-    size_t currentFileSize = 0;    // Tamaño recibido hasta el momento
+    FrameReader reader;            // Lector amb buffer del socket de Fleck
+    int consumedFrames = 0;        // Trames de dades pendents de retornar com a crèdit
 
-    //Buscar si hi ha distorsions pending
+    //Buscar si hi ha distorsions pending (d'un Harley caigut: les de les feines actives d'aquest no compten)
     HarleyDistortionEntry recoveredDistortion;
-    HarleyDistortionState *state = (HarleyDistortionState *) harleySharedMemory.shmaddr;
-    int found = 0;
-
-    for (int i = 0; i < state->count; i++) {
-        if (state->distortions[i].status == STATUS_PENDING) {
-            recoveredDistortion = state->distortions[i];
-            found = 1;
-            break;
-        }
-    }
+    int found = claim_harley_pending_distortion(&harleySharedMemory, reclamarPendent, job, &recoveredDistortion) == 0;
 
     if (found) {
-        expectedFileSize = recoveredDistortion.currentByte; // Tamaño que ya se ha recibido
-        strncpy(receivedFileName, recoveredDistortion.fileName, sizeof(receivedFileName) - 1);
-        strncpy(expectedMD5, recoveredDistortion.md5Sum, sizeof(expectedMD5) - 1);
-        snprintf(receivedFactor, sizeof(receivedFactor), "%d", recoveredDistortion.factor);
+        job->expectedFileSize = recoveredDistortion.currentByte; // Tamaño que ya se ha recibido
+        strncpy(job->userName, recoveredDistortion.userName, sizeof(job->userName) - 1);
+        strncpy(job->expectedMD5, recoveredDistortion.md5Sum, sizeof(job->expectedMD5) - 1);
+        snprintf(job->factor, sizeof(job->factor), "%d", recoveredDistortion.factor);
 
         char *finalFilePath;
-        if (asprintf(&finalFilePath, "%s%s", HARLEY_PATH_FILES, receivedFileName) == -1) {
+        if (asprintf(&finalFilePath, "%s%s", HARLEY_PATH_FILES, job->fileName) == -1) {
             customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
+            worker_job_release(&harleyJobs, job);
             return NULL;
         }
 
-        tempFileDescriptor = open(finalFilePath, O_WRONLY | O_CREAT, 0666);
+        job->tempFileDescriptor = open(finalFilePath, O_RDWR | O_CREAT, 0666);
 
-        if (tempFileDescriptor < 0) {
+        if (job->tempFileDescriptor < 0) {
             customPrintf("[ERROR]: No se pudo abrir el archivo para continuar la recepción.");
             free(finalFilePath);
+            worker_job_release(&harleyJobs, job);
             return NULL;
         }
 
-        // Posicionarse exactamente donde se quedó la recepción
-        if (lseek(tempFileDescriptor, expectedFileSize, SEEK_SET) < 0) {
+        // Posicionarse exactamente donde se quedó la recepción (mida final desconeguda: sense projecció)
+        if (mapped_file_init(&job->receiveFile, job->tempFileDescriptor, 0, job->expectedFileSize) != 0) {
             customPrintf("[ERROR]: No se pudo posicionar en el offset de continuación.");
-            close(tempFileDescriptor);
-            tempFileDescriptor = -1;
             free(finalFilePath);
+            worker_job_release(&harleyJobs, job);
             return NULL;
         }
+
+        // Reprendre l'MD5 parcial guardat; si no quadra amb els bytes rebuts, es recalcula del fitxer
+        if (recoveredDistortion.hashState.length == recoveredDistortion.currentByte) {
+            job->receivedHash = recoveredDistortion.hashState;
+            job->receivedHashValid = 1;
+        } else {
+            md5_init(&job->receivedHash);
+            job->receivedHashValid = md5_update_fd_range(&job->receivedHash, job->tempFileDescriptor, 0, recoveredDistortion.currentByte) == 0;
+        }
+        checkpoint_start(&job->receiveCheckpoint, recoveredDistortion.currentByte);
+        free(finalFilePath);
     }
 
-    while (1) {
-        uint8_t type; //Llegir només primer byte
-        ssize_t bytesRead = recv(clientSocket, &type, 1, MSG_PEEK);
+    if (iniciarLectorTramas(&reader, clientSocket) != 0) {
+        customPrintf("[ERROR]: No se pudo crear el lector de tramas.");
+        worker_job_release(&harleyJobs, job);
+        return NULL;
+    }
 
-        if (bytesRead <= 0) {
-            customPrintf("\nFleck s'ha desconnectat\n");
-            close(clientSocket);
-            return NULL;
+    uint64_t loadBytes = 0; // Bytes d'aquesta distorsió comptats a l'informe de càrrega
+    uint64_t loadStartMs = 0;
+
+    while (1) {
+        FrameView view;
+        if (leerSiguienteTrama(&reader, &view) != 0) {
+            if (reader.closed) {
+                customPrintf("\nFleck s'ha desconnectat\n");
+                flow_control_close(&job->downloadFlow);
+                if (loadBytes > 0) {
+                    worker_load_end(loadBytes);
+                }
+                cerrarLectorTramas(&reader);
+                worker_job_release(&harleyJobs, job); // El socket el tanca l'última referència
+                return NULL;
+            }
+            customPrintf("[ERROR]: Error al recibir trama de Fleck.");
+            break;
         }
-        
-        // Procesar trama binaria 0x05
-        if (type == 0x05) {
-            BinaryFrame binaryFrame;
-            if (leerTramaBinaria(clientSocket, &binaryFrame) == 0) {
-                processBinaryFrameFromFleck(&binaryFrame, expectedFileSize, &currentFileSize, clientSocket);
-            } else {
-                customPrintf("[ERROR]: Error al recibir trama binaria.");
-                break;
+
+        // Procesar trama 0x05 (clàssica o BULK)
+        if (view.kind == FRAME_VIEW_BINARY || view.kind == FRAME_VIEW_BULK) {
+            int grant = flow_control_consume(&consumedFrames, job->creditWindow);
+            if (grant > 0) {
+                enviarTramaCredit(clientSocket, grant);
             }
+            processBinaryFrameFromFleck(job, view.data, view.data_length, &reader);
         } else { // Procesar tramas no binarias
-            Frame request;
-            if (leerTrama(clientSocket, &request) == 0) {
-                // Procesar trama 0x03
-                if (request.type == 0x03) {
-                    char userName[64], fileName[256], fileSizeStr[20], md5Sum[33], factor[20];
-                    if (sscanf(request.data, "%63[^&]&%255[^&]&%19[^&]&%32[^&]&%19s",
-                            userName, fileName, fileSizeStr, md5Sum, factor) != 5) {
-                        customPrintf("[ERROR]: Formato inválido en solicitud DISTORT FILE.");
-                        send_frame_with_error(clientSocket, "CON_KO");
-                        break;
-                    }
-                    
-                    // Mostrar mensajes personalizados
-                    char *logMessage = NULL;
-                    asprintf(&logMessage, "\nNew user connected: %s.\n\n", userName);
-                    customPrintf(logMessage);
-                    free(logMessage);
-
-                    asprintf(&logMessage, "New request - %s wants to distort some media, with factor %s.", userName, factor);
-                    customPrintf(logMessage);
-                    free(logMessage);
-
-                    //Guardar variables
-                    strncpy(receivedFileName, fileName, sizeof(receivedFileName) - 1);
-                    strncpy(expectedMD5, md5Sum, sizeof(expectedMD5) - 1);
-                    strncpy(receivedFactor, factor, sizeof(receivedFactor) - 1);
-                    strncpy(receivedUserName, userName, sizeof(receivedUserName) - 1);
-
-                    // Validar tamaño del archivo
-                    expectedFileSize = strtoull(fileSizeStr, NULL, 10);
-                    
-                    if (expectedFileSize == 0) {
-                        customPrintf("[ERROR]: Tamaño del archivo inválido.");
-                        send_frame_with_error(clientSocket, "CON_KO");
-                        break;
-                    }
-                    char *finalFilePath;
-                    if (asprintf(&finalFilePath, "%s%s", HARLEY_PATH_FILES, receivedFileName) == -1) {
-                        customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
-                        break;
-                    }
+            Frame request = view.frame;
+            // Procesar trama 0x03
+            if (request.type == 0x03) {
+                char userName[64], fileName[256], fileSizeStr[20], md5Sum[33], factor[20];
+                char requestedOptions[TRANSFER_OPTIONS_SIZE] = {0};
+                if (sscanf(request.data, "%63[^&]&%255[^&]&%19[^&]&%32[^&]&%19[^&]&%63s",
+                        userName, fileName, fileSizeStr, md5Sum, factor, requestedOptions) < 5) {
+                    customPrintf("[ERROR]: Formato inválido en solicitud DISTORT FILE.");
+                    send_frame_with_error(clientSocket, "CON_KO");
+                    break;
+                }
+                
+                // Mostrar mensajes personalizados
+                char *logMessage = NULL;
+                asprintf(&logMessage, "\nNew user connected: %s.\n\n", userName);
+                customPrintf(logMessage);
+                free(logMessage);
+
+                asprintf(&logMessage, "New request - %s wants to distort some media, with factor %s.", userName, factor);
+                customPrintf(logMessage);
+                free(logMessage);
+
+                // L'arxiu es desa a HARLEY_PATH_FILES pel nom: no es pot rebre en dues connexions alhora
+                if (worker_job_claim(&harleyJobs, job, fileName) != 0) {
+                    logWarning("[WARNING]: Ya se está distorsionando este archivo en otra conexión.");
+                    send_frame_with_error(clientSocket, "CON_KO");
+                    break;
+                }
+
+                //Guardar variables
+                strncpy(job->userName, userName, sizeof(job->userName) - 1);
+                strncpy(job->expectedMD5, md5Sum, sizeof(job->expectedMD5) - 1);
+                strncpy(job->factor, factor, sizeof(job->factor) - 1);
+                job->distortionLogged = 0;
+                if (job->tempFileDescriptor >= 0) {
+                    mapped_file_finish(&job->receiveFile);
+                    close(job->tempFileDescriptor); // Recepció recuperada que Fleck ha reiniciat
+                    job->tempFileDescriptor = -1;
+                }
 
-                    tempFileDescriptor = open(finalFilePath, O_WRONLY | O_CREAT | O_APPEND, 0666);
+                // Validar tamaño del archivo
+                job->expectedFileSize = strtoull(fileSizeStr, NULL, 10);
+                
+                if (job->expectedFileSize == 0) {
+                    customPrintf("[ERROR]: Tamaño del archivo inválido.");
+                    send_frame_with_error(clientSocket, "CON_KO");
+                    break;
+                }
 
-                    if (tempFileDescriptor < 0) {
-                        customPrintf("[ERROR]: No se pudo abrir el archivo para continuar la recepción.");
-                        free(finalFilePath);
-                        break;
+                // Acceptar les opcions de transferència sol·licitades (Fleck antic: cap)
+                TransferOptions transferOptions;
+                char acceptedOptions[TRANSFER_OPTIONS_SIZE];
+                parse_transfer_options(requestedOptions, &transferOptions);
+                transferOptions.stream = 0; // La compressió de mitjans necessita l'arxiu sencer
+
+                // Mitjà ja comprimit amb aquest factor: no cal ni rebre'l
+                if (transferOptions.cached && servirDesDeCache(job, &transferOptions) == 0) {
+                    if (loadBytes > 0) {
+                        worker_load_end(loadBytes);
+                        loadBytes = 0;
                     }
+                    continue;
+                }
+                transferOptions.cached = 0;
+
+                char *finalFilePath;
+                if (asprintf(&finalFilePath, "%s%s", HARLEY_PATH_FILES, job->fileName) == -1) {
+                    customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
+                    break;
+                }
+
+                // Fleck antic no entén HAVE: l'arxiu es rep sencer de nou
+                off_t have = prepararRecepcio(job, finalFilePath, transferOptions.have > 0);
+                free(finalFilePath);
+                if (have < 0) {
+                    customPrintf("[ERROR]: No se pudo abrir el archivo para continuar la recepción.");
+                    break;
+                }
+                transferOptions.have = (uint64_t)have;
 
-                    save_harley_distortion_state(&harleySharedMemory, receivedFileName, 0, atoi(receivedFactor), expectedMD5, clientSocket, STATUS_PENDING, receivedUserName);
+                // Preassigna l'arxiu sencer i el projecta: cada trama 0x05 s'hi copia directament
+                if (mapped_file_init(&job->receiveFile, job->tempFileDescriptor, job->expectedFileSize, (size_t)have) != 0) {
+                    customPrintf("[ERROR]: No se pudo preparar el archivo para la recepción.");
+                    break;
+                }
+
+                save_harley_distortion_state(&harleySharedMemory, job->fileName, (size_t)have, atoi(job->factor), job->expectedMD5, clientSocket, STATUS_PENDING, job->userName);
+                save_harley_receive_progress(&harleySharedMemory, job->fileName, job->userName, (size_t)have, &job->receivedHash);
+                checkpoint_start(&job->receiveCheckpoint, (uint64_t)have);
 
-                    send_frame_with_ok(clientSocket);
+                format_transfer_options(&transferOptions, acceptedOptions, sizeof(acceptedOptions));
+                job->bulkChunkSize = transferOptions.bulkChunkSize;
+                job->creditWindow = transferOptions.creditWindow;
+                job->zeroCopy = transferOptions.bulkChunkSize > 0 ? transferOptions.zeroCopy : 0;
+                consumedFrames = 0;
+
+                send_frame_with_ok(clientSocket, acceptedOptions);
+                if (have > 0) {
+                    customPrintf("[INFO]: Ya se tienen %lld de %zu bytes del archivo; Fleck solo envía el resto.\n", (long long)have, job->expectedFileSize);
+                }
+                if ((size_t)have == job->expectedFileSize) {
+                    completarRecepcio(job); // No arribarà cap trama de dades
                 }
-                else if (request.type == 0x06) {
-                    // Procesar respuesta MD5 recibida desde Fleck
-                    if (strcmp(request.data, "CHECK_OK") == 0) {
-                        customPrintf("\nFleck confirma md5sum correcte.\n");
-                        remove_completed_distortions(&harleySharedMemory); // Limpieza tras éxito
-                    } else if (strcmp(request.data, "CHECK_KO") == 0) {
-                        customPrintf("[ERROR]: Fleck ha reportado un error en la comprobación MD5 del archivo comprimido (CHECK_KO).");
-                        // Opcionalmente, gestionar retransmisión o error aquí.
-                    } else {
-                        logWarning("[WARNING]: Fleck ha enviado una respuesta MD5 desconocida.");
+
+                // Informar Gotham de la nova feina perquè reparteixi les següents
+                if (loadBytes > 0) {
+                    worker_load_end(loadBytes);
+                }
+                loadBytes = job->expectedFileSize;
+                loadStartMs = timer_wheel_now_ms();
+                worker_load_begin(loadBytes);
+            }
+            else if (request.type == FRAME_CREDIT_TYPE) {
+                // Fleck ha consumit trames del fitxer distorsionat
+                flow_control_grant(&job->downloadFlow, atoi(request.data));
+            }
+            else if (request.type == 0x06) {
+                // Procesar respuesta MD5 recibida desde Fleck
+                if (strcmp(request.data, "CHECK_OK") == 0) {
+                    customPrintf("\nFleck confirma md5sum correcte.\n");
+                    remove_completed_distortions(&harleySharedMemory); // Limpieza tras éxito
+                    if (loadBytes > 0) {
+                        worker_load_done(loadBytes, (uint32_t)(timer_wheel_now_ms() - loadStartMs));
+                        loadBytes = 0;
                     }
+                } else if (strcmp(request.data, "CHECK_KO") == 0) {
+                    customPrintf("[ERROR]: Fleck ha reportado un error en la comprobación MD5 del archivo comprimido (CHECK_KO).");
+                    // Opcionalmente, gestionar retransmisión o error aquí.
+                } else {
+                    logWarning("[WARNING]: Fleck ha enviado una respuesta MD5 desconocida.");
                 }
-            }  else {
-                logWarning("[WARNING]: Error al recibir trama estándar.");
-                break;
             }
         }
     }
 
+    flow_control_close(&job->downloadFlow);
+    if (loadBytes > 0) {
+        worker_load_end(loadBytes);
+    }
+    cerrarLectorTramas(&reader);
+    worker_job_release(&harleyJobs, job);
     return NULL;
 }
 
-// Función para enviar el archivo comprimido en tramas binarias
-void *sendCompressedFileToFleck(void *args) {
-    SendCompressedFileArgs *sendArgs = (SendCompressedFileArgs *)args;
+// Envia l'arxiu comprimit en trames binàries (allibera sendArgs)
+static void enviarArxiuComprimit(SendCompressedFileArgs *sendArgs) {
+    WorkerJob *job = sendArgs->job;
     int clientSocket = sendArgs->clientSocket;
     size_t offset = sendArgs->offset;
+    uint32_t bulkChunkSize = sendArgs->bulkChunkSize;
+    uint32_t creditWindow = sendArgs->creditWindow;
+    uint32_t zeroCopy = sendArgs->zeroCopy;
 
-    char userName[64];
-    strncpy(userName, sendArgs->userName, sizeof(userName) - 1);
-    userName[sizeof(userName) - 1] = '\0'; // por seguridad
+    char userName[64], fileName[256], originalMD5[33], factor[20];
+    snprintf(userName, sizeof(userName), "%s", sendArgs->userName);
+    snprintf(fileName, sizeof(fileName), "%s", sendArgs->fileName);
+    snprintf(originalMD5, sizeof(originalMD5), "%s", sendArgs->originalMD5);
+    snprintf(factor, sizeof(factor), "%s", sendArgs->factor);
 
 
     // Duplicar filePath antes de liberar sendArgs
@@ -348,7 +485,7 @@ void *sendCompressedFileToFleck(void *args) {
     if (!filePath) {
         customPrintf("[ERROR]: No se pudo duplicar filePath.");
         free(sendArgs);
-        return NULL;
+        return;
     }
 
     free(sendArgs); // Liberar memoria de los argumentos
@@ -356,14 +493,14 @@ void *sendCompressedFileToFleck(void *args) {
     if (access(filePath, F_OK) != 0) {
         customPrintf("[ERROR]: El archivo comprimido no existe. Verifica el proceso de compresión.");
         free(filePath);
-        return NULL;
+        return;
     }
 
     int fd = open(filePath, O_RDONLY, 0666);
     if (fd < 0) {
         customPrintf("[ERROR]: No se pudo abrir el archivo comprimido.");
         free(filePath);
-        return NULL;
+        return;
     }
 
     off_t fileSize = lseek(fd, 0, SEEK_END);
@@ -371,7 +508,7 @@ void *sendCompressedFileToFleck(void *args) {
         customPrintf("[ERROR]: El archivo comprimido está vacío o no se pudo calcular su tamaño.");
         close(fd);
         free(filePath);
-        return NULL;
+        return;
     }
 
     //Saltar al punto donde lo dejó el anterior Harley
@@ -379,41 +516,81 @@ void *sendCompressedFileToFleck(void *args) {
         customPrintf("[ERROR]: No se pudo posicionar en el archivo comprimido.");
         close(fd);
         free(filePath);
-        return NULL;
+        return;
     }
 
     BinaryFrame frame = {0};
 
-    char buffer[247]; 
+    size_t chunkSize = bulkChunkSize > 0 ? bulkChunkSize : DATA_BINARY_MAX_SIZE;
+    char *buffer = zeroCopy ? NULL : malloc(chunkSize); // Amb còpia zero la DATA no passa per l'espai d'usuari
+    if (!zeroCopy && !buffer) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para el buffer de envío.");
+        close(fd);
+        free(filePath);
+        return;
+    }
     ssize_t bytesRead;
 
     int bytesAcum = offset;
+    Checkpoint sendCheckpoint; // L'offset de represa es desa per lots, no a cada trama
+    checkpoint_start(&sendCheckpoint, (uint64_t)bytesAcum);
     int alreadyPrinted = 0;
 
-    while ((bytesRead = read(fd, buffer, sizeof(buffer))) > 0) {
+    while ((bytesRead = zeroCopy ? bulk_next_chunk_length(fd, chunkSize) : read(fd, buffer, chunkSize)) > 0) {
         if (!alreadyPrinted) {
             customPrintf("\nSending distorted file to %s.\n", userName);
             alreadyPrinted = 1;
         }
         
-        frame.type = 0x05;
-        frame.data_length = bytesRead;
-        memcpy(frame.data, buffer, bytesRead);
-        frame.timestamp = (uint32_t)time(NULL);
-        frame.checksum = calculate_checksum_binary(frame.data, frame.data_length, 1);
+        // Esperar que Fleck tingui espai per a una altra trama
+        if (creditWindow > 0 && job && flow_control_acquire(&job->downloadFlow) != 0) {
+            customPrintf("[ERROR]: Fleck no ha concedit crèdits per continuar l'enviament.");
+            free(buffer);
+            close(fd);
+            free(filePath);
+            return;
+        }
+
+        int bytesSent;
+        if (zeroCopy) {
+            bytesSent = escribirTramaBulkDesdeFichero(clientSocket, fd, (uint32_t)bytesRead);
+        } else if (bulkChunkSize > 0) {
+            bytesSent = escribirTramaBulk(clientSocket, buffer, (uint32_t)bytesRead);
+        } else {
+            frame.type = 0x05;
+            frame.data_length = bytesRead;
+            memcpy(frame.data, buffer, bytesRead);
+            frame.timestamp = (uint32_t)time(NULL);
+            frame.checksum = calculate_checksum_binary(frame.data, frame.data_length, 1);
 
-        if (escribirTramaBinaria(clientSocket, &frame) < 0) { //AQUÍ ENVIO A FLECK
+            bytesSent = escribirTramaBinaria(clientSocket, &frame); //AQUÍ ENVIO A FLECK
+        }
+
+        if (bytesSent < 0) {
             customPrintf("[ERROR]: Fallo al enviar trama 0x05.");
+            free(buffer);
             close(fd);
             free(filePath);
-            return NULL;
+            return;
         }
 
         bytesAcum += bytesRead;
-        save_harley_distortion_state(&harleySharedMemory, receivedFileName, bytesAcum, atoi(receivedFactor),
-                                    expectedMD5, clientSocket, STATUS_DONE, receivedUserName);
+        if (checkpoint_due(&sendCheckpoint, (uint64_t)bytesAcum)) {
+            save_harley_distortion_state(&harleySharedMemory, fileName, bytesAcum, atoi(factor),
+                                        originalMD5, clientSocket, STATUS_DONE, userName);
+            checkpoint_saved(&sendCheckpoint, (uint64_t)bytesAcum);
+        }
 
-        usleep(10000);
+        // Amb BULK o crèdits no cal espaiar les trames (Flecks antics sí que ho necessiten)
+        if (bulkChunkSize == 0 && creditWindow == 0) {
+            usleep(10000);
+        }
+    }
+    free(buffer);
+
+    if ((uint64_t)bytesAcum != sendCheckpoint.saved) {
+        save_harley_distortion_state(&harleySharedMemory, fileName, bytesAcum, atoi(factor),
+                                    originalMD5, clientSocket, STATUS_DONE, userName);
     }
 
     if (bytesRead < 0) {
@@ -424,6 +601,15 @@ void *sendCompressedFileToFleck(void *args) {
 
     close(fd);
     free(filePath); // Liberar filePath al final
+}
+
+// Fil d'enviament: en acabar deixa la referència a la feina (l'última tanca el socket de Fleck)
+void *sendCompressedFileToFleck(void *args) {
+    SendCompressedFileArgs *sendArgs = (SendCompressedFileArgs *)args;
+    WorkerJob *job = sendArgs->job;
+
+    enviarArxiuComprimit(sendArgs);
+    worker_job_release(&harleyJobs, job);
     return NULL;
 }
 
@@ -443,7 +629,7 @@ void send_frame_with_error(int clientSocket, const char *errorMessage){
     }
 }
 
-void send_frame_with_ok(int clientSocket){
+void send_frame_with_ok(int clientSocket, const char *acceptedOptions){
     if (clientSocket < 0) {
         customPrintf("[ERROR][Harley] ❌ El socket de Fleck no es válido.");
         close(clientSocket);
@@ -452,7 +638,8 @@ void send_frame_with_ok(int clientSocket){
 
     Frame okFrame = {0};
     okFrame.type = 0x03;
-    okFrame.data_length = 0;
+    strncpy(okFrame.data, acceptedOptions ? acceptedOptions : "", sizeof(okFrame.data) - 1);
+    okFrame.data_length = strlen(okFrame.data);
     okFrame.timestamp = (uint32_t)time(NULL);
     okFrame.checksum = calculate_checksum(okFrame.data, okFrame.data_length, 0);
 
@@ -463,138 +650,291 @@ void send_frame_with_ok(int clientSocket){
     }
 }
 
-void processBinaryFrameFromFleck(BinaryFrame *binaryFrame, size_t expectedFileSize, size_t *currentFileSize, int clientSocket) {
-    if (!binaryFrame) {
-        customPrintf("[ERROR]: BinaryFrame recibido nulo.");
-        return;
+// Obre l'arxiu de recepció i retorna els bytes que ja en tenim (HAVE), o -1.
+// Amb offerHave es reaprofita l'original desat a la memòria cau o una recepció interrompuda del mateix contingut;
+// si no, l'arxiu es comença de zero (abans s'hi afegia al final d'un arxiu anterior amb el mateix nom).
+static off_t prepararRecepcio(WorkerJob *job, const char *filePath, int offerHave) {
+    off_t have = 0;
+    int fromSource = 0;
+    size_t progress = 0;
+    Md5Context hashState;
+    md5_init(&hashState);
+
+    if (offerHave) {
+        char sourceMD5[33];
+        off_t sourceSize = 0;
+        if (result_cache_lookup(&harleyCache, job->expectedMD5, RESULT_CACHE_SOURCE, result_cache_type(job->fileName),
+                                filePath, sourceMD5, &sourceSize) == 0 && (size_t)sourceSize == job->expectedFileSize) {
+            have = sourceSize;
+            fromSource = 1;
+        } else if (find_harley_receive_progress(&harleySharedMemory, job->fileName, job->expectedMD5, &progress, &hashState) == 0 &&
+                   progress <= job->expectedFileSize) {
+            have = (off_t)progress;
+        }
     }
 
-    if (tempFileDescriptor < 0) {
-        customPrintf("[ERROR]: No hay un archivo temporal abierto para escribir.");
+    // Sense O_APPEND: splice(2) no hi pot escriure. S'escriu a partir de 'have'.
+    job->tempFileDescriptor = open(filePath, O_RDWR | O_CREAT | (have == 0 ? O_TRUNC : 0), 0666);
+    if (job->tempFileDescriptor < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (have > 0 && (fstat(job->tempFileDescriptor, &st) != 0 || st.st_size < have)) {
+        have = 0; // L'arxiu ja no conserva els bytes anotats: es rep sencer
+        fromSource = 0;
+    }
+    // Descarta el que s'hagués escrit després de l'últim progrés anotat
+    if (ftruncate(job->tempFileDescriptor, have) != 0 || lseek(job->tempFileDescriptor, have, SEEK_SET) < 0) {
+        close(job->tempFileDescriptor);
+        job->tempFileDescriptor = -1;
+        return -1;
+    }
+
+    md5_init(&job->receivedHash);
+    if (fromSource) {
+        job->receivedHashValid = 0; // La còpia es comprova rellegint-la
+    } else if (hashState.length == (uint64_t)have) {
+        job->receivedHash = hashState;
+        job->receivedHashValid = 1;
+    } else {
+        job->receivedHashValid = md5_update_fd_range(&job->receivedHash, job->tempFileDescriptor, 0, (size_t)have) == 0;
+    }
+    job->currentFileSize = (size_t)have;
+    return have;
+}
+
+// Trama 0x03 amb el resultat a la memòria cau: es respon amb CACHE=1 i s'envia sense esperar l'arxiu
+static int servirDesDeCache(WorkerJob *job, TransferOptions *options) {
+    char *finalFilePath;
+    if (asprintf(&finalFilePath, "%s%s", HARLEY_PATH_FILES, job->fileName) == -1) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
+        return -1;
+    }
+
+    char resultMD5[33] = {0};
+    off_t resultSize = 0;
+    if (result_cache_lookup(&harleyCache, job->expectedMD5, atoi(job->factor), result_cache_type(job->fileName),
+                            finalFilePath, resultMD5, &resultSize) != 0) {
+        free(finalFilePath);
+        return -1;
+    }
+
+    char acceptedOptions[TRANSFER_OPTIONS_SIZE];
+    format_transfer_options(options, acceptedOptions, sizeof(acceptedOptions));
+    job->bulkChunkSize = options->bulkChunkSize;
+    job->creditWindow = options->creditWindow;
+    job->zeroCopy = options->bulkChunkSize > 0 ? options->zeroCopy : 0;
+    send_frame_with_ok(job->clientSocket, acceptedOptions);
+    customPrintf("[INFO]: Resultado en caché: se envía sin recibir el archivo.\n");
+
+    char fileSizeStr[20];
+    snprintf(fileSizeStr, sizeof(fileSizeStr), "%lld", (long long)resultSize);
+    save_harley_distortion_state(&harleySharedMemory, job->fileName, 0, atoi(job->factor), resultMD5, job->clientSocket, STATUS_DONE, job->userName);
+    enviaTramaArxiuDistorsionat(job, job->clientSocket, job->fileName, job->userName, job->factor, job->expectedMD5, fileSizeStr, resultMD5,
+                                finalFilePath, 0, job->bulkChunkSize, job->creditWindow, job->zeroCopy);
+    free(finalFilePath);
+    return 0;
+}
+
+// Comprova l'arxiu comprimit, en calcula l'MD5 i la mida i n'encarrega l'enviament a Fleck
+static void enviarResultatCompressio(DistortionTask *distortion, int clientSocket) {
+    CompressionTask *task = &distortion->task;
+
+    if (task->result != 0) {
+        customPrintf("[ERROR]: Fallo en la compresión del archivo.");
         return;
     }
 
-    static int distortionLogged = 0;
-    if (!distortionLogged) {
-        customPrintf("\nDistorting...\n");
-        distortionLogged = 1;
+    // Crear la ruta del archivo comprimido dinámicamente
+    char *compressedFilePath = task->filePath;
+
+    // Validar que el archivo comprimido existe
+    if (access(compressedFilePath, F_OK) != 0) {
+        customPrintf("[ERROR]: El archivo comprimido no se creó correctamente.");
+        unlink(task->filePath);
+        return;
     }
 
-    // Escribir los datos en el archivo temporal
-    ssize_t writtenBytes = write(tempFileDescriptor, binaryFrame->data, binaryFrame->data_length);
-    if (writtenBytes == 0) {
-        customPrintf("[ERROR]: Error al escribir en el archivo temporal.");
-        close(tempFileDescriptor);
-        tempFileDescriptor = -1;
+    // Calcular el MD5 del archivo comprimido
+    char compressedMD5[33] = {0};
+    calculate_md5(compressedFilePath, compressedMD5);
+
+    if (strcmp(compressedMD5, "ERROR") == 0) {
+        customPrintf("[ERROR]: No se pudo calcular el MD5 del archivo comprimido.");
+        unlink(compressedFilePath); // Eliminar el archivo comprimido
         return;
     }
 
-    lseek(tempFileDescriptor, 0, SEEK_SET);
-    *currentFileSize = lseek(tempFileDescriptor, 0, SEEK_END);
-    save_harley_distortion_state(&harleySharedMemory, receivedFileName, *currentFileSize, atoi(receivedFactor), expectedMD5, clientSocket, STATUS_PENDING, receivedUserName);
+    // Calcular el tamaño del archivo comprimido
+    int fd_media_compressed = open(compressedFilePath, O_RDONLY);
+    if (fd_media_compressed < 0) {
+        customPrintf("[ERROR]: No se pudo abrir el archivo especificado.");
+        return;
+    }
 
-    // Verificar si se recibió el archivo completo
-    if (*currentFileSize == expectedFileSize) {
-        distortionLogged = 0;
-        save_harley_distortion_state(&harleySharedMemory, receivedFileName, *currentFileSize, atoi(receivedFactor), expectedMD5, clientSocket, STATUS_IN_PROGRESS, receivedUserName);
+    off_t fileSizeCompressed = lseek(fd_media_compressed, 0, SEEK_END);
+    if (fileSizeCompressed < 0) {
+        customPrintf("[ERROR]: No se pudo calcular el tamaño del archivo.");
+        close(fd_media_compressed);
+        return;
+    }
+    close(fd_media_compressed);
 
-        // Cerrar el archivo temporal
-        close(tempFileDescriptor);
-        tempFileDescriptor = -1;
+    // Convertir tamaño del archivo a string
+    char *fileSizeStrCompressed = NULL;
+    if (asprintf(&fileSizeStrCompressed, "%ld", fileSizeCompressed) == -1) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para el tamaño del archivo.");
+        return;
+    }
 
-        char *finalFilePath;
-        if (asprintf(&finalFilePath, "%s%s", HARLEY_PATH_FILES, receivedFileName) == -1) {
-            customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
-            return;
-        }
+    // Guardar estado como `STATUS_DONE` porque la compresión ha finalizado y está listo para enviarse
+    save_harley_distortion_state(&harleySharedMemory, distortion->fileName, distortion->receivedBytes, atoi(distortion->factor), compressedMD5, clientSocket, STATUS_DONE, distortion->userName);
 
-        char calculatedMD5[33] = {0};
-        calculate_md5(finalFilePath, calculatedMD5);
+    // Enviar la trama del archivo distorsionado
+    enviaTramaArxiuDistorsionat(distortion->job, clientSocket, distortion->fileName, distortion->userName, distortion->factor, distortion->expectedMD5,
+                                fileSizeStrCompressed, compressedMD5, compressedFilePath, 0, distortion->bulkChunkSize, distortion->creditWindow, distortion->zeroCopy);
+    remove_completed_distortions(&harleySharedMemory);            
+    result_cache_store(&harleyCache, distortion->expectedMD5, atoi(distortion->factor), result_cache_type(distortion->fileName),
+                       compressedFilePath, compressedMD5);
+    
+    free(fileSizeStrCompressed);
+}
 
-        if (strcmp(calculatedMD5, "ERROR") == 0) {
-            customPrintf("[ERROR]: No se pudo calcular el MD5 del archivo recibido.");
-            send_frame_with_error(clientSocket, "CHECK_KO");
-            unlink(finalFilePath); // Eliminar el archivo en caso de error
-            free(finalFilePath);
-            return;
-        }
+// S'executa al fil de compressió quan la tasca acaba
+static void completarDistorsio(CompressionTask *task) {
+    DistortionTask *distortion = (DistortionTask *)task;
+    int clientSocket = distortion->job->clientSocket;
 
-        if (strcmp(expectedMD5, calculatedMD5) == 0) {
-            sendMD5Response(clientSocket, "CHECK_OK");
-            
-            save_harley_distortion_state(&harleySharedMemory, receivedFileName, *currentFileSize, atoi(receivedFactor), expectedMD5, clientSocket, STATUS_IN_PROGRESS, receivedUserName);
-            
-            // Procesar la compresión
-            int result = process_compression(finalFilePath, atoi(receivedFactor));
-            if (result != 0) {
-                customPrintf("[ERROR]: Fallo en la compresión del archivo.");
-                free(finalFilePath);
-                return;
-            }
+    enviarResultatCompressio(distortion, clientSocket);
 
-            // Crear la ruta del archivo comprimido dinámicamente
-            char *compressedFilePath = finalFilePath;
+    worker_job_release(&harleyJobs, distortion->job);
+    free(task->filePath);
+    free(distortion);
+}
 
-            // Validar que el archivo comprimido existe
-            if (access(compressedFilePath, F_OK) != 0) {
-                customPrintf("[ERROR]: El archivo comprimido no se creó correctamente.");
-                unlink(finalFilePath);
-                free(finalFilePath);
-                return;
-            }
+// Arxiu rebut sencer (o ja present, HAVE): comprova l'MD5 i, si quadra, el distorsiona
+static void completarRecepcio(WorkerJob *job) {
+    int clientSocket = job->clientSocket;
 
-            // Calcular el MD5 del archivo comprimido
-            char compressedMD5[33] = {0};
-            calculate_md5(compressedFilePath, compressedMD5);
+    job->distortionLogged = 0;
+    save_harley_distortion_state(&harleySharedMemory, job->fileName, job->currentFileSize, atoi(job->factor), job->expectedMD5, clientSocket, STATUS_IN_PROGRESS, job->userName);
 
-            if (strcmp(compressedMD5, "ERROR") == 0) {
-                customPrintf("[ERROR]: No se pudo calcular el MD5 del archivo comprimido.");
-                unlink(compressedFilePath); // Eliminar el archivo comprimido
-                free(finalFilePath);
-                return;
-            }
+    // Cerrar el archivo temporal
+    mapped_file_finish(&job->receiveFile);
+    close(job->tempFileDescriptor);
+    job->tempFileDescriptor = -1;
 
-            // Calcular el tamaño del archivo comprimido
-            int fd_media_compressed = open(compressedFilePath, O_RDONLY);
-            if (fd_media_compressed < 0) {
-                customPrintf("[ERROR]: No se pudo abrir el archivo especificado.");
-                free(finalFilePath);
-                return;
-            }
+    char *finalFilePath;
+    if (asprintf(&finalFilePath, "%s%s", HARLEY_PATH_FILES, job->fileName) == -1) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para el filePath.");
+        return;
+    }
 
-            off_t fileSizeCompressed = lseek(fd_media_compressed, 0, SEEK_END);
-            if (fileSizeCompressed < 0) {
-                customPrintf("[ERROR]: No se pudo calcular el tamaño del archivo.");
-                close(fd_media_compressed);
-                free(finalFilePath);
-                return;
-            }
-            close(fd_media_compressed);
+    // El veredicte surt de l'MD5 incremental; només es torna a llegir l'arxiu si no és vàlid
+    char calculatedMD5[33] = {0};
+    if (job->receivedHashValid && job->receivedHash.length == job->currentFileSize) {
+        md5_final_hex(&job->receivedHash, calculatedMD5);
+    } else {
+        calculate_md5(finalFilePath, calculatedMD5);
+    }
+    job->receivedHashValid = 0;
 
-            // Convertir tamaño del archivo a string
-            char *fileSizeStrCompressed = NULL;
-            if (asprintf(&fileSizeStrCompressed, "%ld", fileSizeCompressed) == -1) {
-                customPrintf("[ERROR]: No se pudo asignar memoria para el tamaño del archivo.");
-                free(finalFilePath);
-                return;
-            }
+    if (strcmp(calculatedMD5, "ERROR") == 0) {
+        customPrintf("[ERROR]: No se pudo calcular el MD5 del archivo recibido.");
+        send_frame_with_error(clientSocket, "CHECK_KO");
+        unlink(finalFilePath); // Eliminar el archivo en caso de error
+        free(finalFilePath);
+        return;
+    }
 
-            // Guardar estado como `STATUS_DONE` porque la compresión ha finalizado y está listo para enviarse
-            save_harley_distortion_state(&harleySharedMemory, receivedFileName, *currentFileSize, atoi(receivedFactor), compressedMD5, clientSocket, STATUS_DONE, receivedUserName);
+    if (strcmp(job->expectedMD5, calculatedMD5) == 0) {
+        sendMD5Response(clientSocket, "CHECK_OK");
 
-            // Enviar la trama del archivo distorsionado
-            enviaTramaArxiuDistorsionat(clientSocket, fileSizeStrCompressed, compressedMD5, compressedFilePath, 0);
-            remove_completed_distortions(&harleySharedMemory);            
-            
-            // Liberar memoria dinámica asignada
+        // L'original es desa abans de comprimir-lo al seu lloc: una altra distorsió no l'haurà de tornar a pujar
+        result_cache_store(&harleyCache, job->expectedMD5, RESULT_CACHE_SOURCE, result_cache_type(job->fileName), finalFilePath, job->expectedMD5);
+        
+        save_harley_distortion_state(&harleySharedMemory, job->fileName, job->currentFileSize, atoi(job->factor), job->expectedMD5, clientSocket, STATUS_IN_PROGRESS, job->userName);
+        
+        // Comprimir al pool: aquest fil torna a llegir el socket de Fleck mentrestant
+        DistortionTask *distortion = calloc(1, sizeof(DistortionTask));
+        if (!distortion) {
+            customPrintf("[ERROR]: No se pudo asignar memoria para la tarea de compresión.");
             free(finalFilePath);
-            free(fileSizeStrCompressed);
+            return;
+        }
+        distortion->task.filePath = finalFilePath; // La tasca se la queda
+        distortion->task.factor = atoi(job->factor);
+        distortion->task.onDone = completarDistorsio;
+        distortion->job = job;
+        distortion->receivedBytes = job->currentFileSize;
+        strncpy(distortion->fileName, job->fileName, sizeof(distortion->fileName) - 1);
+        strncpy(distortion->userName, job->userName, sizeof(distortion->userName) - 1);
+        strncpy(distortion->expectedMD5, job->expectedMD5, sizeof(distortion->expectedMD5) - 1);
+        strncpy(distortion->factor, job->factor, sizeof(distortion->factor) - 1);
+        distortion->bulkChunkSize = job->bulkChunkSize;
+        distortion->creditWindow = job->creditWindow;
+        distortion->zeroCopy = job->zeroCopy;
+
+        worker_job_retain(&harleyJobs, job); // La connexió ha de seguir oberta fins a enviar el resultat
+        compression_pool_submit(&harleyCompressionPool, &distortion->task);
+    } else {
+        customPrintf("[ERROR]: El MD5 no coincide. Archivo recibido está corrupto.");
+        sendMD5Response(clientSocket, "CHECK_KO");
+        unlink(finalFilePath); // Eliminar el archivo en caso de error
+        free(finalFilePath);
+    }
+}
+
+void processBinaryFrameFromFleck(WorkerJob *job, const char *data, size_t dataLength, FrameReader *reader) {
+    int clientSocket = job->clientSocket;
+
+    if (job->tempFileDescriptor < 0) {
+        customPrintf("[ERROR]: No hay un archivo temporal abierto para escribir.");
+        return;
+    }
+
+    if (!job->distortionLogged) {
+        customPrintf("\nDistorting...\n");
+        job->distortionLogged = 1;
+    }
+
+    // Copiar les dades a la projecció de l'arxiu (preassignat a la trama 0x03): la posició es porta en memòria
+    size_t chunkOffset = job->receiveFile.offset;
+    int stored = data ? mapped_file_write(&job->receiveFile, data, dataLength)
+                      : recibirDatosBulkLectorEnArxiu(reader, &job->receiveFile, dataLength);
+    if (stored != 0) {
+        customPrintf("[ERROR]: Error al escribir en el archivo temporal.");
+        mapped_file_finish(&job->receiveFile);
+        close(job->tempFileDescriptor);
+        job->tempFileDescriptor = -1;
+        return;
+    }
+
+    // MD5 incremental: de la DATA en memòria o de la projecció; sense projecció, rellegint la memòria cau del fitxer
+    if (job->receivedHashValid && (uint64_t)chunkOffset == job->receivedHash.length) {
+        const char *written = data ? data : mapped_file_data(&job->receiveFile, chunkOffset, dataLength);
+        if (written) {
+            md5_update(&job->receivedHash, written, dataLength);
         } else {
-            customPrintf("[ERROR]: El MD5 no coincide. Archivo recibido está corrupto.");
-            sendMD5Response(clientSocket, "CHECK_KO");
-            unlink(finalFilePath); // Eliminar el archivo en caso de error
-            free(finalFilePath);
+            job->receivedHashValid = md5_update_fd_range(&job->receivedHash, job->tempFileDescriptor, (off_t)chunkOffset, dataLength) == 0;
         }
+    } else {
+        job->receivedHashValid = 0;
+    }
+
+    // El progrés (offset i MD5 parcial junts) només es desa a la memòria compartida per lots
+    job->currentFileSize = job->receiveFile.offset;
+    if (checkpoint_due(&job->receiveCheckpoint, job->currentFileSize)) {
+        if (save_harley_receive_progress(&harleySharedMemory, job->fileName, job->userName, job->currentFileSize, &job->receivedHash) != 0) {
+            save_harley_distortion_state(&harleySharedMemory, job->fileName, job->currentFileSize, atoi(job->factor), job->expectedMD5, clientSocket, STATUS_PENDING, job->userName);
+        }
+        checkpoint_saved(&job->receiveCheckpoint, job->currentFileSize);
+    }
+
+    // Verificar si se recibió el archivo completo
+    if (job->currentFileSize == job->expectedFileSize) {
+        completarRecepcio(job);
     }
 }
 
@@ -615,7 +955,7 @@ void sendMD5Response(int clientSocket, const char *status) {
 }
 
 // Función para enviar la trama del archivo distorsionado
-void enviaTramaArxiuDistorsionat(int clientSocket, const char *fileSizeCompressed, const char *compressedMD5, const char *compressedFilePath, size_t offset) {
+void enviaTramaArxiuDistorsionat(WorkerJob *job, int clientSocket, const char *fileName, const char *userName, const char *factor, const char *originalMD5, const char *fileSizeCompressed, const char *compressedMD5, const char *compressedFilePath, size_t offset, uint32_t bulkChunkSize, uint32_t creditWindow, uint32_t zeroCopy) {
     Frame frame = {0};
     frame.type = 0x04;
     snprintf(frame.data, sizeof(frame.data), "%s&%s", fileSizeCompressed, compressedMD5);
@@ -639,12 +979,24 @@ void enviaTramaArxiuDistorsionat(int clientSocket, const char *fileSizeCompresse
     args->filePath = strdup(compressedFilePath);  // Duplicar la ruta
     args->fileSize = strtoull(fileSizeCompressed, NULL, 10);
     args->offset = offset;  
-    strncpy(args->userName, receivedUserName, sizeof(args->userName) - 1);
+    args->bulkChunkSize = bulkChunkSize;
+    args->creditWindow = creditWindow;
+    args->zeroCopy = zeroCopy;
+    args->job = job;
+    snprintf(args->fileName, sizeof(args->fileName), "%s", fileName);
+    snprintf(args->userName, sizeof(args->userName), "%s", userName ? userName : "");
+    snprintf(args->originalMD5, sizeof(args->originalMD5), "%s", originalMD5);
+    snprintf(args->factor, sizeof(args->factor), "%s", factor);
+    if (job) {
+        flow_control_reset(&job->downloadFlow, creditWindow);
+        worker_job_retain(&harleyJobs, job); // El fil d'enviament manté viva la connexió
+    }
 
     // Crear un hilo para enviar el archivo comprimido
     pthread_t sendThread;
     if (pthread_create(&sendThread, NULL, sendCompressedFileToFleck, args) != 0) {
         customPrintf("[ERROR]: No se pudo crear el hilo para enviar el archivo comprimido.");
+        worker_job_release(&harleyJobs, job);
         free(args->filePath);
         free(args);
         return;
@@ -699,7 +1051,7 @@ void *resume_distortion(void *arg) {
         }        
     
         // Reiniciar la compresión desde el archivo original
-        int result = process_compression(filePath, args->factor);
+        int result = compression_pool_run(&harleyCompressionPool, filePath, args->factor);
         if (result != 0) {
             customPrintf("[ERROR]: Fallo en la compresión al reanudar distorsión.");
             free(filePath);
@@ -754,7 +1106,10 @@ void *resume_distortion(void *arg) {
             return NULL;
         }
 
-        enviaTramaArxiuDistorsionat(args->clientSocket, fileSizeStrCompressed, compressedMD5, filePath, args->offset);
+        char factorStr[20];
+        snprintf(factorStr, sizeof(factorStr), "%d", args->factor);
+        enviaTramaArxiuDistorsionat(NULL, args->clientSocket, args->fileName, args->userName, factorStr, args->md5Sum,
+                                    fileSizeStrCompressed, compressedMD5, filePath, args->offset, 0, 0, 0);
     }
     
     free(filePath);
@@ -800,6 +1155,7 @@ void processReceivedFrame(int gothamSocket, const Frame *response){
         pthread_mutex_lock(&heartbeatMutex); // Proteger acceso a la variable compartida
         lastHeartbeat = time(NULL);          // Actualizar el tiempo del último HEARTBEAT recibido
         pthread_mutex_unlock(&heartbeatMutex);
+        enviarTramaHeartbeat(gothamSocket);  // Sense resposta Gotham el dona per caigut
         break;
 
     default:
@@ -843,7 +1199,7 @@ int main(int argc, char *argv[]){
         return 1;
     }
 
-    if (init_shared_memory(&harleySharedMemory, 1234, sizeof(HarleyDistortionState)) < 0) {
+    if (init_harley_shared_memory(&harleySharedMemory) < 0) {
         customPrintf("[ERROR] ❌ No se pudo inicializar la memoria compartida.\n");
         return 1;
     }
@@ -857,10 +1213,11 @@ int main(int argc, char *argv[]){
         return 1;
     }
 
-    // Registro en Gotham
+    // Registro en Gotham: <type>&<IP>&<Port>&V2 per negociar el protocol binari
+    set_frame_protocol(gothamSocket, FRAME_PROTOCOL_V1);
     Frame frame = {.type = 0x02, .timestamp = time(NULL)};
-    snprintf(frame.data, sizeof(frame.data), "%s&%s&%d",
-             harleyConfig->workerType, harleyConfig->ipFleck, harleyConfig->portFleck);
+    snprintf(frame.data, sizeof(frame.data), "%s&%s&%d&%s",
+             harleyConfig->workerType, harleyConfig->ipFleck, harleyConfig->portFleck, FRAME_PROTOCOL_V2_TAG);
     frame.data_length = strlen(frame.data);
     frame.checksum = calculate_checksum(frame.data, frame.data_length, 1);
 
@@ -882,7 +1239,10 @@ int main(int argc, char *argv[]){
         return 1;
     }
 
-    if (response.type == 0x02 && response.data_length == 0){
+    if (response.type == 0x02 && (response.data_length == 0 || strcmp(response.data, FRAME_PROTOCOL_V2_TAG) == 0)){
+        if (response.data_length != 0) {
+            set_frame_protocol(gothamSocket, FRAME_PROTOCOL_V2);
+        }
         customPrintf("\nConnected to Mr. J System, ready to listen to Fleck petitions\n\n");
         customPrintf("Waiting for connections...\n");
     }
@@ -909,6 +1269,9 @@ int main(int argc, char *argv[]){
     }
     pthread_detach(gothamThread);
 
+    // Informes de càrrega (0x15) cap a Gotham per al repartiment de peticions
+    worker_load_init(&gothamSocket);
+
     int fleckSocket = startServer(harleyConfig->ipFleck, harleyConfig->portFleck);
     if (fleckSocket < 0){
         printColor(ANSI_COLOR_RED, "[ERROR]: No se pudo iniciar el servidor local de Harley.");
@@ -916,21 +1279,49 @@ int main(int argc, char *argv[]){
         return 1;
     }
 
-    // Bucle para manejar conexiones de Fleck
-    while (1) {
+    // Distorsions simultànies: com a molt una per entrada de recuperació de la memòria compartida
+    if (worker_jobs_init(&harleyJobs, WORKER_MAX_JOBS, MAX_DISTORTIONS) != 0) {
+        close(fleckSocket);
+        free(harleyConfig);
+        return 1;
+    }
+    if (compression_pool_init(&harleyCompressionPool, COMPRESSION_POOL_THREADS, COMPRESSION_QUEUE_SIZE) != 0) {
+        close(fleckSocket);
+        free(harleyConfig);
+        return 1;
+    }
+    customPrintf("Distorsions simultànies: %d, fils de compressió: %d\n", harleyJobs.capacity, harleyCompressionPool.threadCount);
+    result_cache_init(&harleyCache, HARLEY_PATH_FILES, RESULT_CACHE_MAX_BYTES);
+
+    // Bucle para manejar conexiones de Fleck (fins que arriba SIGINT)
+    fleckListenSocket = fleckSocket;
+    while (!sigintRebut) {
+        // Amb la taula plena no s'accepten més connexions fins que n'acabi una
+        WorkerJob *job = worker_jobs_acquire(&harleyJobs);
+        if (!job) {
+            break; // Tancament demanat mentre s'esperava plaça
+        }
         int clientSocket = accept_connection(fleckSocket);
-        lastFleckSocket = clientSocket;
 
         if (clientSocket < 0) {
+            worker_job_release(&harleyJobs, job);
+            if (sigintRebut) {
+                break; // El senyal ha tallat el socket d'escolta
+            }
             customPrintf("[ERROR]: No se pudo aceptar la conexión del Fleck.");
             continue;
         }
+        job->clientSocket = clientSocket;
 
         HarleyDistortionEntry recoveredDistortions[MAX_DISTORTIONS];
         int distortionCount = 0;
 
         if (load_harley_distortion_state(&harleySharedMemory, recoveredDistortions, &distortionCount) == 0) {
             for (int i = 0; i < distortionCount; i++) {  
+                // Les que aquest mateix Harley té en curs no s'han de reprendre
+                if (worker_jobs_is_active(&harleyJobs, recoveredDistortions[i].fileName)) {
+                    continue;
+                }
                 ResumeArgs *args = malloc(sizeof(ResumeArgs));
                 strncpy(args->fileName, recoveredDistortions[i].fileName, sizeof(args->fileName));
                 strncpy(args->md5Sum, recoveredDistortions[i].md5Sum, sizeof(args->md5Sum));
@@ -947,30 +1338,19 @@ int main(int argc, char *argv[]){
             }
         }
 
-        if (clientSocket >= 0) {
-            pthread_t fleckThread;
-            int *socketArg = malloc(sizeof(int));
-            if (!socketArg) {
-                customPrintf("[ERROR]: No se pudo asignar memoria para el socket del cliente.");
-                close(clientSocket); // Cierra el socket si hay un error
-                continue;
-            }
-            *socketArg = clientSocket;
-
-            if (pthread_create(&fleckThread, NULL, handleFleckFrames, socketArg) != 0) {
-                customPrintf("[ERROR]: No se pudo crear el hilo para manejar el cliente.");
-                close(clientSocket); // Cierra el socket si hay un error
-                free(socketArg);
-                continue;
-            }
-
-            pthread_detach(fleckThread);
+        pthread_t fleckThread;
+        if (pthread_create(&fleckThread, NULL, handleFleckFrames, job) != 0) {
+            customPrintf("[ERROR]: No se pudo crear el hilo para manejar el cliente.");
+            worker_job_release(&harleyJobs, job); // Cierra el socket si hay un error
+            continue;
         }
+
+        pthread_detach(fleckThread);
     }
 
     // Limpieza y cierre
+    tancarHarley();
+    fleckListenSocket = -1;
     close(fleckSocket);
-    close(gothamSocket);
-    free(harleyConfig);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "compression_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "compression_handler.h"
+#include "../DataConversion/DataConversion.h"
+#include "../Logging/Logging.h"
+
+static uint64_t msDesDe(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t ms = (int64_t)(now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+    return ms > 0 ? (uint64_t)ms : 0;
+}
+
+static void *fil_compressio(void *arg) {
+    CompressionPool *pool = (CompressionPool *)arg;
+
+    while (1) {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->count == 0) {
+            pthread_cond_wait(&pool->notEmpty, &pool->mutex);
+        }
+
+        CompressionTask *task = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+
+        uint64_t waitMs = msDesDe(&task->enqueuedAt);
+        __atomic_store_n(&pool->stats.queued, pool->count, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&pool->stats.running, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&pool->stats.totalWaitMs, waitMs, __ATOMIC_RELAXED);
+        if (waitMs > pool->stats.maxWaitMs) __atomic_store_n(&pool->stats.maxWaitMs, waitMs, __ATOMIC_RELAXED);
+        pthread_cond_signal(&pool->notFull);
+        pthread_mutex_unlock(&pool->mutex);
+
+        task->result = process_compression(task->filePath, task->factor);
+
+        pthread_mutex_lock(&pool->mutex);
+        __atomic_fetch_sub(&pool->stats.running, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&pool->stats.completed, 1, __ATOMIC_RELAXED);
+        customPrintf("[INFO]: Compressió acabada (%llu ms a la cua, %d en cua, %d en curs).\n",
+                     (unsigned long long)waitMs, pool->stats.queued, pool->stats.running);
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (task->onDone) {
+            task->onDone(task);
+        } else {
+            pthread_mutex_lock(&pool->mutex);
+            task->done = 1;
+            pthread_cond_broadcast(&pool->taskDone);
+            pthread_mutex_unlock(&pool->mutex);
+        }
+    }
+
+    return NULL;
+}
+
+// Engega threads fils de compressió (0 = un per core) amb una cua de queueSize tasques
+int compression_pool_init(CompressionPool *pool, int threads, int queueSize) {
+    if (!pool || queueSize <= 0) return -1;
+
+    int count = threads;
+    if (count <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        count = cores > 0 ? (int)cores : 1;
+    }
+
+    memset(pool, 0, sizeof(*pool));
+    pool->queue = calloc(queueSize, sizeof(CompressionTask *));
+    pool->threads = calloc(count, sizeof(pthread_t));
+    if (!pool->queue || !pool->threads) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para la cola de compresión.");
+        free(pool->queue);
+        free(pool->threads);
+        return -1;
+    }
+    pool->capacity = queueSize;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->notEmpty, NULL);
+    pthread_cond_init(&pool->notFull, NULL);
+    pthread_cond_init(&pool->taskDone, NULL);
+
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&pool->threads[i], NULL, fil_compressio, pool) != 0) {
+            customPrintf("[ERROR]: No se pudo crear un hilo de compresión.");
+            break;
+        }
+        pthread_detach(pool->threads[i]);
+        pool->threadCount++;
+    }
+
+    return pool->threadCount > 0 ? 0 : -1;
+}
+
+// Encua la tasca; amb la cua plena espera que un fil en tregui una
+int compression_pool_submit(CompressionPool *pool, CompressionTask *task) {
+    if (!pool || !task || !task->filePath) return -1;
+
+    task->done = 0;
+    task->result = -1;
+    clock_gettime(CLOCK_MONOTONIC, &task->enqueuedAt);
+
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->count == pool->capacity) {
+        __atomic_fetch_add(&pool->stats.blockedSubmits, 1, __ATOMIC_RELAXED);
+        logWarning("[WARNING]: Cola de compresión llena, esperando un hueco.");
+        while (pool->count == pool->capacity) {
+            pthread_cond_wait(&pool->notFull, &pool->mutex);
+        }
+    }
+
+    pool->queue[(pool->head + pool->count) % pool->capacity] = task;
+    pool->count++;
+    __atomic_store_n(&pool->stats.queued, pool->count, __ATOMIC_RELAXED);
+    if (pool->count > pool->stats.maxQueued) __atomic_store_n(&pool->stats.maxQueued, pool->count, __ATOMIC_RELAXED);
+    pthread_cond_signal(&pool->notEmpty);
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+// Comprimeix al pool i espera el resultat (per a fils que no atenen cap socket)
+int compression_pool_run(CompressionPool *pool, const char *filePath, int factor) {
+    CompressionTask task = {0};
+    task.filePath = (char *)filePath;
+    task.factor = factor;
+
+    if (compression_pool_submit(pool, &task) != 0) return -1;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!task.done) {
+        pthread_cond_wait(&pool->taskDone, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return task.result;
+}
+
+// Sense el mutex: es crida des del handler de SIGINT, que pot haver interromput un fil que el té
+void compression_pool_get_stats(CompressionPool *pool, CompressionPoolStats *out) {
+    if (!pool || !out) return;
+
+    out->queued = __atomic_load_n(&pool->stats.queued, __ATOMIC_RELAXED);
+    out->maxQueued = __atomic_load_n(&pool->stats.maxQueued, __ATOMIC_RELAXED);
+    out->running = __atomic_load_n(&pool->stats.running, __ATOMIC_RELAXED);
+    out->completed = __atomic_load_n(&pool->stats.completed, __ATOMIC_RELAXED);
+    out->blockedSubmits = __atomic_load_n(&pool->stats.blockedSubmits, __ATOMIC_RELAXED);
+    out->totalWaitMs = __atomic_load_n(&pool->stats.totalWaitMs, __ATOMIC_RELAXED);
+    out->maxWaitMs = __atomic_load_n(&pool->stats.maxWaitMs, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,62 @@
+#ifndef COMPRESSION_POOL_H
+#define COMPRESSION_POOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+// Fils de compressió. 0 = un per core.
+#ifndef COMPRESSION_POOL_THREADS
+#define COMPRESSION_POOL_THREADS 0
+#endif
+
+// Arxius pujats que poden esperar compressió; amb la cua plena qui encua s'espera (contrapressió)
+#ifndef COMPRESSION_QUEUE_SIZE
+#define COMPRESSION_QUEUE_SIZE 16
+#endif
+
+typedef struct CompressionTask CompressionTask;
+
+// S'executa al fil de compressió en acabar; la tasca és del qui l'ha encuada (l'ha d'alliberar)
+typedef void (*CompressionDoneFn)(CompressionTask *task);
+
+struct CompressionTask {
+    char *filePath;               // Arxiu a comprimir (es comprimeix sobre si mateix)
+    int factor;
+    int result;                   // Retorn de process_compression
+    CompressionDoneFn onDone;     // NULL: el qui encua espera el resultat (compression_pool_run)
+    void *context;
+    struct timespec enqueuedAt;
+    int done;
+};
+
+typedef struct {
+    int queued;                   // Profunditat actual de la cua
+    int maxQueued;
+    int running;                  // Compressions en curs
+    uint64_t completed;
+    uint64_t blockedSubmits;      // Vegades que la cua era plena en encuar
+    uint64_t totalWaitMs;         // Temps a la cua acumulat
+    uint64_t maxWaitMs;
+} CompressionPoolStats;
+
+typedef struct {
+    CompressionTask **queue;      // Cua circular acotada (molts productors, molts consumidors)
+    int capacity;
+    int head;
+    int count;
+    pthread_t *threads;
+    int threadCount;
+    CompressionPoolStats stats;   // S'escriu amb el mutex i __atomic; es llegeix sense el mutex
+    pthread_mutex_t mutex;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    pthread_cond_t taskDone;
+} CompressionPool;
+
+int compression_pool_init(CompressionPool *pool, int threads, int queueSize);
+int compression_pool_submit(CompressionPool *pool, CompressionTask *task);
+int compression_pool_run(CompressionPool *pool, const char *filePath, int factor);
+void compression_pool_get_stats(CompressionPool *pool, CompressionPoolStats *out);
+
+#endif // COMPRESSION_POOL_H
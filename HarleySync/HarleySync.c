@@ -1,137 +1,46 @@
 #include "HarleySync.h"
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
 #include "../Shared_Memory/Shared_memory.h"
 #include "../DataConversion/DataConversion.h"
 
-
-// Inicializa la memoria compartida para Harley
-int init_shared_memory(SharedMemory *sm, key_t key, size_t size) {
-    if (!sm) return -1;
-
-    sm->shmid = shmget(key, size, IPC_CREAT | 0666);
-    if (sm->shmid < 0) {
-        perror("Error creando memoria compartida");
-        return -1;
-    }
-
-    sm->shmaddr = shmat(sm->shmid, NULL, 0);
-    if (sm->shmaddr == (void *)-1) {
-        perror("Error asociando memoria compartida");
-        return -1;
-    }
-
-    if (SEM_constructor_with_name(&sm->sem, key) < 0) {
-        perror("Error creando semáforo");
-        return -1;
-    }
-    if (SEM_init(&sm->sem, 1) < 0) {
-        perror("Error inicializando semáforo");
-        return -1;
-    }
-
-    return 0;
+// Distorsions de Harley: s'identifiquen per arxiu i usuari
+int init_harley_shared_memory(SharedMemory *sm) {
+    return distortion_table_attach(sm, HARLEY_SHARED_MEMORY_KEY);
 }
 
 // Guarda el estado exacto de la distorsión en curso
 int save_harley_distortion_state(SharedMemory *sm, const char *fileName, size_t currentByte, 
     int factor, const char *md5Sum, int fleckSocketFD, int status, const char *userName) {
-    
-    if (!sm || !sm->shmaddr) {
-        customPrintf("[ERROR] ❌ Memoria compartida no inicializada antes de guardar estado.\n");
-        return -1;
-    }
-
-    lock_shared_memory(sm);
-    HarleyDistortionState *state = (HarleyDistortionState *)sm->shmaddr;
-
-    int found = 0;
-
-    for (int i = 0; i < state->count; i++) {
-        if (strcmp(state->distortions[i].fileName, fileName) == 0 && strcmp(state->distortions[i].userName, userName) == 0) {
-            //Actualizar distorsión existente
-            state->distortions[i].currentByte = currentByte;
-            state->distortions[i].factor = factor;
-            strncpy(state->distortions[i].md5Sum, md5Sum, sizeof(state->distortions[i].md5Sum));
-            state->distortions[i].fleckSocketFD = fleckSocketFD;
-            state->distortions[i].status = status; //Se asigna el estado correctamente
-            found = 1;
-            break;  //No necesitamos seguir buscando
-        }
-    }
+    return distortion_table_save(sm, fileName, userName, currentByte, factor, md5Sum, fleckSocketFD, status);
+}
 
-    // 📌 Si no se encontró la distorsión, la agregamos
-    if (!found) {
-        if (state->count < MAX_DISTORTIONS) {
-            strncpy(state->distortions[state->count].fileName, fileName, sizeof(state->distortions[state->count].fileName) - 1);
-            strncpy(state->distortions[state->count].md5Sum, md5Sum, sizeof(state->distortions[state->count].md5Sum));
-            strncpy(state->distortions[state->count].userName, userName, sizeof(state->distortions[state->count].userName));
-            state->distortions[state->count].currentByte = currentByte;
-            state->distortions[state->count].factor = factor;
-            state->distortions[state->count].fleckSocketFD = fleckSocketFD;
-            state->distortions[state->count].status = status; // Se asigna el estado correctamente
+// Actualitza la posició de recepció i l'MD5 parcial d'una distorsió ja registrada
+int save_harley_receive_progress(SharedMemory *sm, const char *fileName, const char *userName, size_t currentByte, const Md5Context *hashState) {
+    return distortion_table_save_progress(sm, fileName, userName, currentByte, hashState);
+}
 
-            state->count++;
-        } else {
-            customPrintf("[ERROR] ❌ No se pueden agregar más distorsiones, memoria llena.\n");
-        }
+// Busca la recepció pendent d'aquest arxiu amb el mateix MD5 (qualsevol usuari: el contingut és el mateix)
+int find_harley_receive_progress(SharedMemory *sm, const char *fileName, const char *md5Sum, size_t *currentByte, Md5Context *hashState) {
+    HarleyDistortionEntry entry;
+    if (!currentByte || !hashState || distortion_table_find_pending(sm, fileName, md5Sum, &entry) != 0) {
+        return -1;
     }
-
-    unlock_shared_memory(sm);
+    *currentByte = entry.currentByte;
+    *hashState = entry.hashState;
     return 0;
 }
 
+// Primera recepció interrompuda que el worker pot reprendre
+int claim_harley_pending_distortion(SharedMemory *sm, int (*claim)(const HarleyDistortionEntry *entry, void *arg), void *arg, HarleyDistortionEntry *entry) {
+    return distortion_table_claim_pending(sm, claim, arg, entry);
+}
 
 // Recupera el estado de la distorsión en caso de caída
 int load_harley_distortion_state(SharedMemory *sm, HarleyDistortionEntry *entries, int *count) {
-    if (!sm || !sm->shmaddr) {
-        customPrintf("[ERROR] Memoria compartida no inicializada antes de recuperar estado.\n");
-        return -1;
-    }
-
-    lock_shared_memory(sm);
-    HarleyDistortionState *state = (HarleyDistortionState *)sm->shmaddr;
-
-    *count = 0;
-    for (int i = 0; i < state->count; i++) {
-        if (state->distortions[i].status == STATUS_IN_PROGRESS || 
-            state->distortions[i].status == STATUS_DONE || 
-            state->distortions[i].status == STATUS_PENDING) {
-
-            entries[*count] = state->distortions[i]; 
-            (*count)++;
-        }
-    }
-
-    unlock_shared_memory(sm);
-    return (*count > 0) ? 0 : -1;
+    return distortion_table_load(sm, entries, count);
 }
 
 // Elimina todas las distorsiones con STATUS_DONE de la memoria compartida
 int remove_completed_distortions(SharedMemory *sm) {
-    if (!sm || !sm->shmaddr) {
-        customPrintf("[ERROR] ❌ Memoria compartida no inicializada antes de eliminar distorsiones completadas.\n");
-        return -1;
-    }
-
-    lock_shared_memory(sm);
-    HarleyDistortionState *state = (HarleyDistortionState *)sm->shmaddr;
-
-    int newCount = 0;
-    for (int i = 0; i < state->count; i++) {
-        if (state->distortions[i].status != STATUS_DONE) {
-            state->distortions[newCount] = state->distortions[i]; // Mover solo los que no estén completados
-            newCount++;
-        }
-    }
-
-    state->count = newCount; // Actualizar el número de distorsiones activas
-
-    unlock_shared_memory(sm);
-    return 0;
+    return distortion_table_remove_done(sm);
 }
-
-
@@ -0,0 +1,220 @@
+#include "LogRing.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+
+#include "../FrameUtils/FrameUtils.h"
+
+#define RING_MASK(ring) ((ring)->capacity - 1)
+
+static int registreLlest(LogRing *ring, uint64_t position) {
+    return __atomic_load_n(&ring->records[position & RING_MASK(ring)].seq, __ATOMIC_ACQUIRE) == position + 1;
+}
+
+// Escriu d'un cop tots els registres consecutius ja publicats i torna les cel·les als productors
+static int buidarLot(LogRing *ring) {
+    struct iovec iov[LOG_RING_BATCH];
+    uint64_t first = ring->tail;
+    int count = 0;
+
+    while (count < LOG_RING_BATCH && registreLlest(ring, first + count)) {
+        LogRecord *record = &ring->records[(first + count) & RING_MASK(ring)];
+        iov[count].iov_base = record->text;
+        iov[count].iov_len = record->length;
+        count++;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    writev_full(ring->fd, iov, count); // Si el destí ha caigut no hi ha on escriure: es continua buidant
+
+    for (int i = 0; i < count; i++) {
+        __atomic_store_n(&ring->records[(first + i) & RING_MASK(ring)].seq, first + i + ring->capacity, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&ring->tail, first + count, __ATOMIC_RELEASE); // log_ring_flush ho mira des d'altres fils
+    return count;
+}
+
+static void *fillEscriptura(void *arg) {
+    LogRing *ring = (LogRing *)arg;
+
+    // Els senyals els atenen els altres fils (el d'aturada espera aquest)
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    for (;;) {
+        if (buidarLot(ring) > 0) {
+            continue;
+        }
+        if (__atomic_load_n(&ring->stopping, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        // Avisar que es dorm i tornar-ho a mirar: un productor que vegi sleeping escriu a wakeFd
+        __atomic_store_n(&ring->sleeping, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (registreLlest(ring, ring->tail) || __atomic_load_n(&ring->stopping, __ATOMIC_SEQ_CST)) {
+            __atomic_store_n(&ring->sleeping, 0, __ATOMIC_SEQ_CST);
+            continue;
+        }
+        uint64_t tokens;
+        if (read(ring->wakeFd, &tokens, sizeof(tokens)) < 0) {
+            __atomic_store_n(&ring->sleeping, 0, __ATOMIC_SEQ_CST);
+        }
+    }
+    return NULL;
+}
+
+static void despertar(LogRing *ring) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST); // El registre publicat es veu abans de mirar sleeping
+    if (__atomic_load_n(&ring->sleeping, __ATOMIC_RELAXED) && __atomic_exchange_n(&ring->sleeping, 0, __ATOMIC_SEQ_CST)) {
+        uint64_t one = 1;
+        if (write(ring->wakeFd, &one, sizeof(one)) < 0) {
+            // Sense eventfd el fil es quedaria adormit: no hi ha res més a fer
+        }
+    }
+}
+
+int log_ring_start(LogRing *ring, int fd, uint64_t capacity) {
+    memset(ring, 0, sizeof(*ring));
+    if (capacity < LOG_RING_SPAN || (capacity & (capacity - 1)) != 0) {
+        return -1;
+    }
+    ring->fd = fd;
+    ring->capacity = capacity;
+    ring->records = malloc(sizeof(LogRecord) * capacity);
+    if (!ring->records) {
+        return -1;
+    }
+    for (uint64_t i = 0; i < capacity; i++) {
+        ring->records[i].seq = i;
+    }
+
+    ring->wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (ring->wakeFd < 0) {
+        free(ring->records);
+        ring->records = NULL;
+        return -1;
+    }
+    if (pthread_create(&ring->flusher, NULL, fillEscriptura, ring) != 0) {
+        close(ring->wakeFd);
+        free(ring->records);
+        ring->records = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Reserva count posicions consecutives. Les cel·les s'alliberen en ordre, així que si
+// l'última és lliure ho són totes. Si l'anell és ple el productor cedeix la CPU fins que hi ha lloc
+static uint64_t reservar(LogRing *ring, uint64_t count) {
+    uint64_t position = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    for (;;) {
+        LogRecord *last = &ring->records[(position + count - 1) & RING_MASK(ring)];
+        int64_t diff = (int64_t)(__atomic_load_n(&last->seq, __ATOMIC_ACQUIRE) - (position + count - 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->head, &position, position + count, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                return position;
+            }
+        } else if (diff < 0) {
+            __atomic_add_fetch(&ring->fullWaits, 1, __ATOMIC_RELAXED);
+            despertar(ring);
+            sched_yield();
+            position = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        } else {
+            position = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Afegeix una línia. Mai no es perd: si l'anell és ple (Arkham no dona l'abast) s'espera que hi hagi lloc
+void log_ring_push(LogRing *ring, const char *message) {
+    if (!ring || !ring->records || !message) {
+        return;
+    }
+
+    uint64_t position = reservar(ring, 1);
+    LogRecord *record = &ring->records[position & RING_MASK(ring)];
+
+    size_t length = strnlen(message, LOG_RING_RECORD_SIZE - 1);
+    memcpy(record->text, message, length);
+    for (size_t i = 0; i < length; i++) {
+        if (record->text[i] == '\n') {
+            record->text[i] = ' '; // Una línia per registre, com espera Arkham
+        }
+    }
+    record->text[length] = '\n';
+    record->length = (uint32_t)length + 1;
+    __atomic_store_n(&record->seq, position + 1, __ATOMIC_RELEASE);
+
+    despertar(ring);
+}
+
+// Afegeix bytes tal qual, sense tocar els salts de línia. Un text de fins a LOG_RING_SPAN registres
+// ocupa posicions consecutives i surt sencer encara que altres fils escriguin alhora
+void log_ring_write(LogRing *ring, const char *data, size_t length) {
+    if (!ring || !ring->records || !data) {
+        return;
+    }
+
+    while (length > 0) {
+        uint64_t count = (length + LOG_RING_RECORD_SIZE - 1) / LOG_RING_RECORD_SIZE;
+        if (count > LOG_RING_SPAN) {
+            count = LOG_RING_SPAN;
+        }
+        uint64_t position = reservar(ring, count);
+
+        for (uint64_t i = 0; i < count; i++) {
+            LogRecord *record = &ring->records[(position + i) & RING_MASK(ring)];
+            size_t chunk = length < LOG_RING_RECORD_SIZE ? length : LOG_RING_RECORD_SIZE;
+            memcpy(record->text, data, chunk);
+            record->length = (uint32_t)chunk;
+            __atomic_store_n(&record->seq, position + i + 1, __ATOMIC_RELEASE);
+            data += chunk;
+            length -= chunk;
+        }
+        despertar(ring);
+    }
+}
+
+// Espera que el fil d'escriptura hagi escrit tot el que s'havia publicat en cridar-la.
+// Retorna -1 si passa timeoutMs (p. ex. un fil que ha reservat i no publicarà mai)
+int log_ring_flush(LogRing *ring, int timeoutMs) {
+    if (!ring || !ring->records) {
+        return 0;
+    }
+
+    uint64_t target = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    struct timespec pause = {0, 1000000};
+    for (int waited = 0; __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) < target; waited++) {
+        if (waited >= timeoutMs) {
+            return -1;
+        }
+        despertar(ring);
+        nanosleep(&pause, NULL);
+    }
+    return 0;
+}
+
+// Escriu el que ja s'ha publicat i atura el fil (no tanca fd)
+void log_ring_stop(LogRing *ring) {
+    if (!ring || !ring->records) {
+        return;
+    }
+    __atomic_store_n(&ring->stopping, 1, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ring->sleeping, 1, __ATOMIC_SEQ_CST);
+    despertar(ring);
+    pthread_join(ring->flusher, NULL);
+
+    close(ring->wakeFd);
+    free(ring->records);
+    ring->records = NULL;
+}
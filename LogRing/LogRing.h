@@ -0,0 +1,46 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Registres de l'anell d'Arkham abans que els productors hagin d'esperar el fil d'escriptura (potència de 2)
+#ifndef LOG_RING_CAPACITY
+#define LOG_RING_CAPACITY 4096
+#endif
+
+#define LOG_RING_RECORD_SIZE 512  // Línia més llarga (amb el salt de línia); la resta es talla
+#define LOG_RING_BATCH 256        // Registres màxims per writev
+#define LOG_RING_SPAN 64          // Registres consecutius màxims d'un sol log_ring_write
+
+// Un registre de l'anell. seq diu de qui és la cel·la: == posició, lliure per al productor d'aquesta
+// posició; == posició + 1, escrita i pendent del fil d'escriptura (cua MPSC de Vyukov).
+typedef struct {
+    uint64_t seq;
+    uint32_t length;
+    char text[LOG_RING_RECORD_SIZE];
+} LogRecord;
+
+// Anell de logs: qualsevol fil hi afegeix línies sense bloquejos ni crides al sistema,
+// i un sol fil les buida per lots cap a fd (la pipe d'Arkham, la consola) amb writev.
+typedef struct {
+    LogRecord *records;
+    uint64_t capacity;      // Potència de 2
+    uint64_t head;          // Següent posició per als productors (atòmica)
+    uint64_t tail;          // Següent posició per escriure (l'escriu només el fil d'escriptura)
+    int fd;
+    int wakeFd;             // eventfd per despertar el fil quan dorm
+    int sleeping;           // 1 mentre el fil espera a wakeFd
+    int stopping;
+    uint64_t fullWaits;     // Cops que un productor ha trobat l'anell ple
+    pthread_t flusher;
+} LogRing;
+
+int log_ring_start(LogRing *ring, int fd, uint64_t capacity);
+void log_ring_push(LogRing *ring, const char *message);
+void log_ring_write(LogRing *ring, const char *data, size_t length);
+int log_ring_flush(LogRing *ring, int timeoutMs);
+void log_ring_stop(LogRing *ring);
+
+#endif
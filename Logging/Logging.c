@@ -1,17 +1,156 @@
 #include "Logging.h"
 
+#include <pthread.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include "../FrameUtils/FrameUtils.h"
+#include "../LogRing/LogRing.h"
+
+int log_runtime_level = LOG_LEVEL_DEBUG;
+
+static LogRing consoleRing;
+static pthread_once_t consoleOnce = PTHREAD_ONCE_INIT;
+static int consoleAsync = 0; // 0: write directe (sense fil o en un fill de fork)
+
+// Buffer de format de cada fil: cap missatge normal no passa per malloc
+static __thread char lineBuffer[LOG_LINE_SIZE];
+
+// Nivell inicial des de l'entorn, abans que main escrigui res
+__attribute__((constructor)) static void llegirNivell(void) {
+    const char *level = getenv("LOG_LEVEL");
+    if (!level) {
+        return;
+    }
+    if (strcasecmp(level, "debug") == 0) {
+        log_runtime_level = LOG_LEVEL_DEBUG;
+    } else if (strcasecmp(level, "info") == 0) {
+        log_runtime_level = LOG_LEVEL_INFO;
+    } else if (strcasecmp(level, "warning") == 0) {
+        log_runtime_level = LOG_LEVEL_WARNING;
+    } else if (strcasecmp(level, "error") == 0) {
+        log_runtime_level = LOG_LEVEL_ERROR;
+    }
+}
+
+void log_set_level(int level) {
+    __atomic_store_n(&log_runtime_level, level, __ATOMIC_RELAXED);
+}
+
+// Nivell segons l'etiqueta del format, saltant els salts de línia del principi
+int log_level_of(const char *format) {
+    while (*format == '\n') {
+        format++;
+    }
+    if (*format != '[') {
+        return LOG_LEVEL_OUTPUT;
+    }
+    if (strncmp(format, "[ERROR", 6) == 0) {
+        return LOG_LEVEL_ERROR;
+    }
+    if (strncmp(format, "[WARNING", 8) == 0) {
+        return LOG_LEVEL_WARNING;
+    }
+    if (strncmp(format, "[INFO", 5) == 0 || strncmp(format, "[SUCCESS", 8) == 0) {
+        return LOG_LEVEL_INFO;
+    }
+    if (strncmp(format, "[DEBUG", 6) == 0) {
+        return LOG_LEVEL_DEBUG;
+    }
+    return LOG_LEVEL_OUTPUT;
+}
+
+// Un fill de fork no té el fil d'escriptura: escriu directament
+static void despresFork(void) {
+    consoleAsync = 0;
+}
+
+static void iniciarConsola(void) {
+    if (log_ring_start(&consoleRing, STDOUT_FILENO, LOG_CONSOLE_CAPACITY) != 0) {
+        return; // Sense anell es continua amb write directe
+    }
+    atexit(log_console_flush);
+    pthread_atfork(NULL, NULL, despresFork);
+    __atomic_store_n(&consoleAsync, 1, __ATOMIC_RELEASE);
+}
+
+void log_console_write(const char *text, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    pthread_once(&consoleOnce, iniciarConsola);
+    if (__atomic_load_n(&consoleAsync, __ATOMIC_ACQUIRE)) {
+        log_ring_write(&consoleRing, text, length);
+    } else {
+        write_full(STDOUT_FILENO, text, length);
+    }
+}
+
+void log_console_vprintf(const char *format, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int size = vsnprintf(lineBuffer, sizeof(lineBuffer), format, args);
+    if (size < 0) {
+        va_end(copy);
+        return;
+    }
+    if ((size_t)size < sizeof(lineBuffer)) {
+        log_console_write(lineBuffer, (size_t)size);
+        va_end(copy);
+        return;
+    }
+
+    // Missatge més llarg que el buffer del fil: cas rar, es formata en memòria dinàmica
+    char *buffer = malloc((size_t)size + 1);
+    if (buffer) {
+        vsnprintf(buffer, (size_t)size + 1, format, copy);
+        log_console_write(buffer, (size_t)size);
+        free(buffer);
+    }
+    va_end(copy);
+}
+
+void log_console_printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_console_vprintf(format, args);
+    va_end(args);
+}
+
+// Treu el que hi hagi a l'anell (atexit). Si algun fil no acaba de publicar, no s'espera més de 200 ms
+void log_console_flush(void) {
+    if (__atomic_load_n(&consoleAsync, __ATOMIC_ACQUIRE)) {
+        log_ring_flush(&consoleRing, 200);
+    }
+}
+
+static void logAmbNivell(int level, const char *prefix, const char *msg) {
+    if (!log_enabled(level)) {
+        return;
+    }
+    int size = snprintf(lineBuffer, sizeof(lineBuffer), "%s" RESET "%s\n", prefix, msg);
+    if (size < 0) {
+        return;
+    }
+    if ((size_t)size >= sizeof(lineBuffer)) {
+        size = sizeof(lineBuffer) - 1; // Es talla: mai no passa per malloc
+        lineBuffer[size - 1] = '\n';
+    }
+    log_console_write(lineBuffer, (size_t)size);
+}
+
 void logInfo(const char *msg) {
-    printf(CYAN "[INFO]: " RESET "%s\n", msg);
+    logAmbNivell(LOG_LEVEL_INFO, CYAN "[INFO]: ", msg);
 }
 
 void logWarning(const char *msg) {
-    printf(YELLOW "[WARNING]: " RESET "%s\n", msg);
+    logAmbNivell(LOG_LEVEL_WARNING, YELLOW "[WARNING]: ", msg);
 }
 
 void logError(const char *msg) {
-    printf(RED "[ERROR]: " RESET "%s\n", msg);
+    logAmbNivell(LOG_LEVEL_ERROR, RED "[ERROR]: ", msg);
 }
 
 void logSuccess(const char *msg) {
-    printf(GREEN "[SUCCESS]: " RESET "%s\n", msg);
+    logAmbNivell(LOG_LEVEL_INFO, GREEN "[SUCCESS]: ", msg);
 }
@@ -1,6 +1,7 @@
 #ifndef LOGGING_H
 #define LOGGING_H
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <unistd.h>  // Para write()
 #include <string.h>  // Para strlen()
@@ -13,8 +14,72 @@
 #define CYAN        "\033[36m"
 #define BOLD        "\033[1m"
 
-// Macro para imprimir directamente
-#define printF(x) write(1, x, strlen(x))
+// Nivells de severitat. Els missatges de customPrintf prenen el nivell de l'etiqueta
+// inicial ([DEBUG], [INFO], [WARNING], [ERROR]); el text sense etiqueta sempre surt
+#define LOG_LEVEL_DEBUG     0
+#define LOG_LEVEL_INFO      1
+#define LOG_LEVEL_WARNING   2
+#define LOG_LEVEL_ERROR     3
+#define LOG_LEVEL_OUTPUT    4
+
+// Nivell mínim compilat: el que quedi per sota es descarta sense formatar-lo
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// Mida del buffer de format de cada fil; els missatges més llargs són l'únic cas que reserva memòria
+#ifndef LOG_LINE_SIZE
+#define LOG_LINE_SIZE 4096
+#endif
+
+// Registres de 512 bytes de l'anell de consola (potència de 2)
+#ifndef LOG_CONSOLE_CAPACITY
+#define LOG_CONSOLE_CAPACITY 1024
+#endif
+
+// Macro para imprimir directamente (passa per la mateixa cua que customPrintf per no desordenar-se)
+#define printF(x) log_console_write((x), strlen(x))
+
+extern int log_runtime_level;
+
+// Nivell mínim en temps d'execució: LOG_LEVEL=debug|info|warning|error o log_set_level()
+static inline int log_enabled(int level) {
+    return level >= LOG_MIN_LEVEL && level >= log_runtime_level;
+}
+
+void log_set_level(int level);
+int log_level_of(const char *format);
+
+// Sortida per consola: el text es copia a un anell i un fil el treu per lots amb writev
+void log_console_write(const char *text, size_t length);
+void log_console_vprintf(const char *format, va_list args);
+void log_console_flush(void);
+void log_console_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+// Missatges amb nivell fix: per sota de LOG_MIN_LEVEL el compilador en treu la crida (el format es comprova igualment)
+#if LOG_MIN_LEVEL > LOG_LEVEL_DEBUG
+#define LOG_DEBUGF(...) do { if (0) log_console_printf(__VA_ARGS__); } while (0)
+#else
+#define LOG_DEBUGF(...) do { if (log_enabled(LOG_LEVEL_DEBUG)) log_console_printf(__VA_ARGS__); } while (0)
+#endif
+
+#if LOG_MIN_LEVEL > LOG_LEVEL_INFO
+#define LOG_INFOF(...) do { if (0) log_console_printf(__VA_ARGS__); } while (0)
+#else
+#define LOG_INFOF(...) do { if (log_enabled(LOG_LEVEL_INFO)) log_console_printf(__VA_ARGS__); } while (0)
+#endif
+
+#if LOG_MIN_LEVEL > LOG_LEVEL_WARNING
+#define LOG_WARNINGF(...) do { if (0) log_console_printf(__VA_ARGS__); } while (0)
+#else
+#define LOG_WARNINGF(...) do { if (log_enabled(LOG_LEVEL_WARNING)) log_console_printf(__VA_ARGS__); } while (0)
+#endif
+
+#if LOG_MIN_LEVEL > LOG_LEVEL_ERROR
+#define LOG_ERRORF(...) do { if (0) log_console_printf(__VA_ARGS__); } while (0)
+#else
+#define LOG_ERRORF(...) do { if (log_enabled(LOG_LEVEL_ERROR)) log_console_printf(__VA_ARGS__); } while (0)
+#endif
 
 // Funciones para loggear mensajes
 void logInfo(const char *msg);
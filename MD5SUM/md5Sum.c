@@ -1,52 +1,256 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
-#include <sys/wait.h>
+#include <errno.h>
 #include <stdio.h>
 #include "md5Sum.h"
 
+// Funcions i rotacions de cada ronda (RFC 1321)
+#define MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+#define MD5_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define MD5_STEP(f, a, b, c, d, x, t, s) \
+    do { (a) += f((b), (c), (d)) + (x) + (t); (a) = MD5_ROTL((a), (s)) + (b); } while (0)
+
+// Paraula little-endian; memcpy evita accessos desalineats i el compilador ho redueix a una càrrega
+static inline uint32_t llegirParaula(const unsigned char *p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint32_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+#else
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+#endif
+}
+
+// Processa blocks blocs de 64 bytes directament des de data
+static void processarBlocs(uint32_t state[4], const unsigned char *data, size_t blocks) {
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+
+    while (blocks--) {
+        uint32_t x[16];
+        for (int i = 0; i < 16; i++) {
+            x[i] = llegirParaula(data + i * 4);
+        }
+        uint32_t aa = a, bb = b, cc = c, dd = d;
+
+        MD5_STEP(MD5_F, a, b, c, d, x[0], 0xd76aa478, 7);
+        MD5_STEP(MD5_F, d, a, b, c, x[1], 0xe8c7b756, 12);
+        MD5_STEP(MD5_F, c, d, a, b, x[2], 0x242070db, 17);
+        MD5_STEP(MD5_F, b, c, d, a, x[3], 0xc1bdceee, 22);
+        MD5_STEP(MD5_F, a, b, c, d, x[4], 0xf57c0faf, 7);
+        MD5_STEP(MD5_F, d, a, b, c, x[5], 0x4787c62a, 12);
+        MD5_STEP(MD5_F, c, d, a, b, x[6], 0xa8304613, 17);
+        MD5_STEP(MD5_F, b, c, d, a, x[7], 0xfd469501, 22);
+        MD5_STEP(MD5_F, a, b, c, d, x[8], 0x698098d8, 7);
+        MD5_STEP(MD5_F, d, a, b, c, x[9], 0x8b44f7af, 12);
+        MD5_STEP(MD5_F, c, d, a, b, x[10], 0xffff5bb1, 17);
+        MD5_STEP(MD5_F, b, c, d, a, x[11], 0x895cd7be, 22);
+        MD5_STEP(MD5_F, a, b, c, d, x[12], 0x6b901122, 7);
+        MD5_STEP(MD5_F, d, a, b, c, x[13], 0xfd987193, 12);
+        MD5_STEP(MD5_F, c, d, a, b, x[14], 0xa679438e, 17);
+        MD5_STEP(MD5_F, b, c, d, a, x[15], 0x49b40821, 22);
+
+        MD5_STEP(MD5_G, a, b, c, d, x[1], 0xf61e2562, 5);
+        MD5_STEP(MD5_G, d, a, b, c, x[6], 0xc040b340, 9);
+        MD5_STEP(MD5_G, c, d, a, b, x[11], 0x265e5a51, 14);
+        MD5_STEP(MD5_G, b, c, d, a, x[0], 0xe9b6c7aa, 20);
+        MD5_STEP(MD5_G, a, b, c, d, x[5], 0xd62f105d, 5);
+        MD5_STEP(MD5_G, d, a, b, c, x[10], 0x02441453, 9);
+        MD5_STEP(MD5_G, c, d, a, b, x[15], 0xd8a1e681, 14);
+        MD5_STEP(MD5_G, b, c, d, a, x[4], 0xe7d3fbc8, 20);
+        MD5_STEP(MD5_G, a, b, c, d, x[9], 0x21e1cde6, 5);
+        MD5_STEP(MD5_G, d, a, b, c, x[14], 0xc33707d6, 9);
+        MD5_STEP(MD5_G, c, d, a, b, x[3], 0xf4d50d87, 14);
+        MD5_STEP(MD5_G, b, c, d, a, x[8], 0x455a14ed, 20);
+        MD5_STEP(MD5_G, a, b, c, d, x[13], 0xa9e3e905, 5);
+        MD5_STEP(MD5_G, d, a, b, c, x[2], 0xfcefa3f8, 9);
+        MD5_STEP(MD5_G, c, d, a, b, x[7], 0x676f02d9, 14);
+        MD5_STEP(MD5_G, b, c, d, a, x[12], 0x8d2a4c8a, 20);
+
+        MD5_STEP(MD5_H, a, b, c, d, x[5], 0xfffa3942, 4);
+        MD5_STEP(MD5_H, d, a, b, c, x[8], 0x8771f681, 11);
+        MD5_STEP(MD5_H, c, d, a, b, x[11], 0x6d9d6122, 16);
+        MD5_STEP(MD5_H, b, c, d, a, x[14], 0xfde5380c, 23);
+        MD5_STEP(MD5_H, a, b, c, d, x[1], 0xa4beea44, 4);
+        MD5_STEP(MD5_H, d, a, b, c, x[4], 0x4bdecfa9, 11);
+        MD5_STEP(MD5_H, c, d, a, b, x[7], 0xf6bb4b60, 16);
+        MD5_STEP(MD5_H, b, c, d, a, x[10], 0xbebfbc70, 23);
+        MD5_STEP(MD5_H, a, b, c, d, x[13], 0x289b7ec6, 4);
+        MD5_STEP(MD5_H, d, a, b, c, x[0], 0xeaa127fa, 11);
+        MD5_STEP(MD5_H, c, d, a, b, x[3], 0xd4ef3085, 16);
+        MD5_STEP(MD5_H, b, c, d, a, x[6], 0x04881d05, 23);
+        MD5_STEP(MD5_H, a, b, c, d, x[9], 0xd9d4d039, 4);
+        MD5_STEP(MD5_H, d, a, b, c, x[12], 0xe6db99e5, 11);
+        MD5_STEP(MD5_H, c, d, a, b, x[15], 0x1fa27cf8, 16);
+        MD5_STEP(MD5_H, b, c, d, a, x[2], 0xc4ac5665, 23);
+
+        MD5_STEP(MD5_I, a, b, c, d, x[0], 0xf4292244, 6);
+        MD5_STEP(MD5_I, d, a, b, c, x[7], 0x432aff97, 10);
+        MD5_STEP(MD5_I, c, d, a, b, x[14], 0xab9423a7, 15);
+        MD5_STEP(MD5_I, b, c, d, a, x[5], 0xfc93a039, 21);
+        MD5_STEP(MD5_I, a, b, c, d, x[12], 0x655b59c3, 6);
+        MD5_STEP(MD5_I, d, a, b, c, x[3], 0x8f0ccc92, 10);
+        MD5_STEP(MD5_I, c, d, a, b, x[10], 0xffeff47d, 15);
+        MD5_STEP(MD5_I, b, c, d, a, x[1], 0x85845dd1, 21);
+        MD5_STEP(MD5_I, a, b, c, d, x[8], 0x6fa87e4f, 6);
+        MD5_STEP(MD5_I, d, a, b, c, x[15], 0xfe2ce6e0, 10);
+        MD5_STEP(MD5_I, c, d, a, b, x[6], 0xa3014314, 15);
+        MD5_STEP(MD5_I, b, c, d, a, x[13], 0x4e0811a1, 21);
+        MD5_STEP(MD5_I, a, b, c, d, x[4], 0xf7537e82, 6);
+        MD5_STEP(MD5_I, d, a, b, c, x[11], 0xbd3af235, 10);
+        MD5_STEP(MD5_I, c, d, a, b, x[2], 0x2ad7d2bb, 15);
+        MD5_STEP(MD5_I, b, c, d, a, x[9], 0xeb86d391, 21);
+
+        a += aa;
+        b += bb;
+        c += cc;
+        d += dd;
+        data += 64;
+    }
+
+    state[0] = a;
+    state[1] = b;
+    state[2] = c;
+    state[3] = d;
+}
+
+void md5_init(Md5Context *context) {
+    context->state[0] = 0x67452301;
+    context->state[1] = 0xefcdab89;
+    context->state[2] = 0x98badcfe;
+    context->state[3] = 0x10325476;
+    context->length = 0;
+    context->bufferLength = 0;
+}
+
+void md5_update(Md5Context *context, const void *data, size_t length) {
+    const unsigned char *input = (const unsigned char *)data;
+    context->length += length;
+
+    // Primer s'acaba el bloc pendent
+    if (context->bufferLength > 0) {
+        size_t needed = 64 - context->bufferLength;
+        size_t chunk = length < needed ? length : needed;
+        memcpy(context->buffer + context->bufferLength, input, chunk);
+        context->bufferLength += chunk;
+        input += chunk;
+        length -= chunk;
+        if (context->bufferLength < 64) return;
+        processarBlocs(context->state, context->buffer, 1);
+        context->bufferLength = 0;
+    }
+
+    // Els blocs sencers es processen sense copiar-los
+    size_t blocks = length / 64;
+    if (blocks > 0) {
+        processarBlocs(context->state, input, blocks);
+        input += blocks * 64;
+        length -= blocks * 64;
+    }
+
+    if (length > 0) {
+        memcpy(context->buffer, input, length);
+        context->bufferLength = length;
+    }
+}
+
+void md5_final(Md5Context *context, unsigned char digest[MD5_DIGEST_SIZE]) {
+    uint64_t bits = context->length * 8;
+
+    // Farciment: 0x80, zeros fins a 56 mod 64 i la longitud en bits (little-endian)
+    context->buffer[context->bufferLength++] = 0x80;
+    if (context->bufferLength > 56) {
+        memset(context->buffer + context->bufferLength, 0, 64 - context->bufferLength);
+        processarBlocs(context->state, context->buffer, 1);
+        context->bufferLength = 0;
+    }
+    memset(context->buffer + context->bufferLength, 0, 56 - context->bufferLength);
+    for (int i = 0; i < 8; i++) {
+        context->buffer[56 + i] = (unsigned char)(bits >> (8 * i));
+    }
+    processarBlocs(context->state, context->buffer, 1);
+
+    for (int i = 0; i < 4; i++) {
+        digest[i * 4] = (unsigned char)context->state[i];
+        digest[i * 4 + 1] = (unsigned char)(context->state[i] >> 8);
+        digest[i * 4 + 2] = (unsigned char)(context->state[i] >> 16);
+        digest[i * 4 + 3] = (unsigned char)(context->state[i] >> 24);
+    }
+}
+
+void md5_final_hex(Md5Context *context, char hex[MD5_HEX_SIZE]) {
+    static const char digits[] = "0123456789abcdef";
+    unsigned char digest[MD5_DIGEST_SIZE];
+
+    md5_final(context, digest);
+    for (int i = 0; i < MD5_DIGEST_SIZE; i++) {
+        hex[i * 2] = digits[digest[i] >> 4];
+        hex[i * 2 + 1] = digits[digest[i] & 0x0f];
+    }
+    hex[MD5_HEX_SIZE - 1] = '\0';
+}
+
+int md5_buffer(const void *data, size_t length, char hex[MD5_HEX_SIZE]) {
+    Md5Context context;
+    md5_init(&context);
+    md5_update(&context, data, length);
+    md5_final_hex(&context, hex);
+    return 0;
+}
+
+// Llegeix l'fd des de la posició actual fins al final
+int md5_fd(int fd, char hex[MD5_HEX_SIZE]) {
+    unsigned char buffer[MD5_READ_BUFFER];
+    Md5Context context;
+    md5_init(&context);
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    while (1) {
+        ssize_t bytesRead = read(fd, buffer, sizeof(buffer));
+        if (bytesRead == 0) break;
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        md5_update(&context, buffer, (size_t)bytesRead);
+    }
+
+    md5_final_hex(&context, hex);
+    return 0;
+}
+
+// Afegeix al context length bytes del fitxer a partir d'offset, sense moure la posició de l'fd
+// (per a dades que han arribat directament al fitxer, que encara són a la memòria cau de pàgines)
+int md5_update_fd_range(Md5Context *context, int fd, off_t offset, size_t length) {
+    unsigned char buffer[MD5_READ_BUFFER];
+
+    while (length > 0) {
+        size_t chunk = length < sizeof(buffer) ? length : sizeof(buffer);
+        ssize_t bytesRead = pread(fd, buffer, chunk, offset);
+        if (bytesRead < 0 && errno == EINTR) continue;
+        if (bytesRead <= 0) return -1;
+        md5_update(context, buffer, (size_t)bytesRead);
+        offset += bytesRead;
+        length -= (size_t)bytesRead;
+    }
+    return 0;
+}
+
 void calculate_md5(const char *filePath, char *md5Sum) {
-    int pipe_fd[2];
-    if (pipe(pipe_fd) == -1) {
-        write(STDERR_FILENO, "Error creando pipe para MD5\n", 29);
+    int fd = open(filePath, O_RDONLY);
+    if (fd < 0) {
+        write(STDERR_FILENO, "Error abriendo el archivo para MD5\n", 35);
         strcpy(md5Sum, "ERROR");
         return;
     }
 
-    pid_t pid = fork();
-    if (pid == 0) {
-        // Proceso hijo: ejecuta md5sum y redirige la salida al pipe
-        close(pipe_fd[0]); // Cerrar extremo de lectura
-        dup2(pipe_fd[1], STDOUT_FILENO);
-        close(pipe_fd[1]); // Cerrar el descriptor duplicado
-        execlp("md5sum", "md5sum", filePath, NULL);
-        write(STDERR_FILENO, "Error ejecutando md5sum\n", 24);
-        _exit(1); // Salida con error si execlp falla
-    } else if (pid > 0) {
-        // Proceso padre: lee la salida de md5sum desde el pipe
-        close(pipe_fd[1]); // Cerrar extremo de escritura
-        char buffer[64] = {0};
-        ssize_t bytesRead = read(pipe_fd[0], buffer, sizeof(buffer) - 1);
-        close(pipe_fd[0]); // Cerrar el extremo de lectura
-
-        if (bytesRead > 0) {
-            buffer[bytesRead] = '\0'; // Asegurar nulo-terminado
-            if (sscanf(buffer, "%32s", md5Sum) != 1) {
-                write(STDERR_FILENO, "Error procesando salida de md5sum\n", 34);
-                strcpy(md5Sum, "ERROR");
-            }
-        } else {
-            write(STDERR_FILENO, "Error leyendo salida de md5sum\n", 31);
-            strcpy(md5Sum, "ERROR");
-        }
-
-        wait(NULL); // Esperar a que el proceso hijo termine
-    } else {
-        // Error al crear el proceso hijo
-        write(STDERR_FILENO, "Error creando proceso hijo para MD5\n", 36);
+    if (md5_fd(fd, md5Sum) != 0) {
+        write(STDERR_FILENO, "Error leyendo el archivo para MD5\n", 34);
         strcpy(md5Sum, "ERROR");
-        close(pipe_fd[0]);
-        close(pipe_fd[1]);
     }
+    close(fd);
 }
-
@@ -1,6 +1,32 @@
-#ifndef MDSUM_H
+#ifndef MD5SUM_H
 #define MD5SUM_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define MD5_DIGEST_SIZE 16
+#define MD5_HEX_SIZE 33          // 32 dígits hexadecimals + '\0'
+#define MD5_READ_BUFFER 65536    // Bloc de lectura per calcular l'MD5 d'un fd
+
+// MD5 en el mateix procés (RFC 1321), incremental: init -> update (tantes vegades com calgui) -> final
+typedef struct {
+    uint32_t state[4];
+    uint64_t length;             // Bytes processats
+    unsigned char buffer[64];    // Bloc incomplet pendent
+    size_t bufferLength;
+} Md5Context;
+
+void md5_init(Md5Context *context);
+void md5_update(Md5Context *context, const void *data, size_t length);
+void md5_final(Md5Context *context, unsigned char digest[MD5_DIGEST_SIZE]);
+void md5_final_hex(Md5Context *context, char hex[MD5_HEX_SIZE]);
+
+int md5_buffer(const void *data, size_t length, char hex[MD5_HEX_SIZE]);
+int md5_fd(int fd, char hex[MD5_HEX_SIZE]);
+int md5_update_fd_range(Md5Context *context, int fd, off_t offset, size_t length);
+
+// Deixa "ERROR" a md5sum si no es pot llegir el fitxer
 void calculate_md5(const char *filePath, char *md5sum);
 
-#endif // MD5_UTILS_H
+#endif // MD5SUM_H
@@ -0,0 +1,91 @@
+#define _GNU_SOURCE // fallocate
+
+#include "MappedFile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../FrameUtils/FrameUtils.h"
+
+// Reserva els blocs d'un cop. Només si el sistema de fitxers no ho admet n'hi ha prou de fixar-ne
+// la mida: amb el disc ple (ENOSPC) un fitxer buit projectat faria SIGBUS en copiar-hi
+static int reservarBlocs(int fd, size_t size) {
+    if (fallocate(fd, 0, 0, (off_t)size) == 0) {
+        return 0;
+    }
+    if (errno != EOPNOTSUPP && errno != ENOSYS) {
+        return -1; // Es continua amb write, que sí que retorna l'error
+    }
+    return ftruncate(fd, (off_t)size);
+}
+
+// Prepara fd per rebre'l a partir d'offset (els bytes anteriors ja hi són)
+int mapped_file_init(MappedFile *file, int fd, size_t size, size_t offset) {
+    if (!file || fd < 0 || (size > 0 && offset > size)) return -1;
+
+    file->fd = fd;
+    file->map = NULL;
+    file->size = size;
+    file->offset = offset;
+
+    if (size > 0 && reservarBlocs(fd, size) == 0) {
+        void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, size, MADV_SEQUENTIAL);
+            file->map = map;
+        }
+    }
+
+    // Sense projecció s'escriu a continuació: la posició ha de ser la dels bytes ja escrits
+    if (!file->map && lseek(fd, (off_t)offset, SEEK_SET) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int mapped_file_write(MappedFile *file, const void *data, size_t length) {
+    if (!file || (file->size > 0 && length > file->size - file->offset)) return -1;
+
+    if (file->map) {
+        memcpy(file->map + file->offset, data, length);
+    } else if (write_full(file->fd, data, length) != 0) {
+        return -1;
+    }
+    file->offset += length;
+    return 0;
+}
+
+// On escriure els pròxims length bytes directament (NULL: sense projecció o massa dades); després, mapped_file_advance
+char *mapped_file_reserve(MappedFile *file, size_t length) {
+    if (!file || !file->map || length > file->size - file->offset) return NULL;
+    return file->map + file->offset;
+}
+
+void mapped_file_advance(MappedFile *file, size_t length) {
+    if (file) file->offset += length;
+}
+
+// Bytes ja escrits, llegits de la projecció (NULL: sense projecció)
+const char *mapped_file_data(const MappedFile *file, size_t offset, size_t length) {
+    if (!file || !file->map || offset > file->offset || length > file->offset - offset) return NULL;
+    return file->map + offset;
+}
+
+// Desfà la projecció; una recepció a mitges deixa l'arxiu amb la mida dels bytes rebuts
+int mapped_file_finish(MappedFile *file) {
+    if (!file) return -1;
+
+    int result = 0;
+    if (file->map) {
+        munmap(file->map, file->size);
+        file->map = NULL;
+    }
+    if (file->size > 0 && file->offset < file->size && ftruncate(file->fd, (off_t)file->offset) != 0) {
+        result = -1;
+    }
+    file->size = 0;
+    return result;
+}
@@ -0,0 +1,22 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+
+// Arxiu que es rep sencer amb mida coneguda: es preassigna i es projecta a memòria, i cada tros
+// s'hi copia directament (sense write/lseek per trama). Sense mida, o si mmap falla, s'escriu a continuació.
+typedef struct {
+    int fd;          // No és propietat de l'estructura
+    char *map;       // NULL: sense projecció
+    size_t size;     // Mida final de l'arxiu (0 = desconeguda)
+    size_t offset;   // Bytes ja escrits
+} MappedFile;
+
+int mapped_file_init(MappedFile *file, int fd, size_t size, size_t offset);
+int mapped_file_write(MappedFile *file, const void *data, size_t length);
+char *mapped_file_reserve(MappedFile *file, size_t length);
+void mapped_file_advance(MappedFile *file, size_t length);
+const char *mapped_file_data(const MappedFile *file, size_t offset, size_t length);
+int mapped_file_finish(MappedFile *file);
+
+#endif
@@ -2,9 +2,11 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <arpa/inet.h>
 #include <stdlib.h>
 #include "Networking.h"
+#include "../FrameUtils/FrameUtils.h"
 
 // Conecta a un servidor
 int connect_to_server(const char *ip, int port) {
@@ -36,16 +38,26 @@ int connect_to_server(const char *ip, int port) {
         return -1;
     }
 
+    set_frame_protocol(sockfd, FRAME_PROTOCOL_V1); // Un fd reutilitzat no hereta el v2 d'una connexió anterior
     return sockfd;
 }
 
-// Inicia un servidor
-int startServer(const char *ip, int port) {
+// Crea el socket d'escolta; amb reusePort diversos sockets poden compartir IP i port (SO_REUSEPORT)
+static int crearSocketServidor(const char *ip, int port, int reusePort) {
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) {
         perror("[ERROR]: Error creando socket");
         return -1;
     }
+
+    if (reusePort) {
+        int enable = 1;
+        if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0) {
+            perror("[ERROR]: Error activando SO_REUSEPORT");
+            close(server_fd);
+            return -1;
+        }
+    }
     
     struct sockaddr_in server_addr = {0};
     server_addr.sin_family = AF_INET;
@@ -64,7 +76,7 @@ int startServer(const char *ip, int port) {
         return -1;
     }
 
-    if (listen(server_fd, 5) < 0) {
+    if (listen(server_fd, SERVER_BACKLOG) < 0) {
         perror("[ERROR]: Error en listen");
         close(server_fd);
         return -1;
@@ -73,6 +85,16 @@ int startServer(const char *ip, int port) {
     return server_fd;
 }
 
+// Inicia un servidor
+int startServer(const char *ip, int port) {
+    return crearSocketServidor(ip, port, 0);
+}
+
+// Inicia un servidor que comparteix el port amb altres sockets del mateix procés (un per fil)
+int startServerReusePort(const char *ip, int port) {
+    return crearSocketServidor(ip, port, 1);
+}
+
 
 // Acepta una conexión
 int accept_connection(int server_fd) {
@@ -81,6 +103,9 @@ int accept_connection(int server_fd) {
 
     int client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &client_len);
     if (client_fd < 0) {
+        if (errno == EINVAL) {
+            return -1; // Socket d'escolta tallat amb shutdown(): el procés s'està tancant
+        }
         printF("Error al aceptar la conexión\n");
         return -1;
     }
@@ -88,5 +113,6 @@ int accept_connection(int server_fd) {
     //char *client_ip = inet_ntoa(client_addr.sin_addr);
     //int client_port = client_addr.sin_port;
 
+    set_frame_protocol(client_fd, FRAME_PROTOCOL_V1);
     return client_fd;
 }
@@ -7,12 +7,16 @@
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
 
-#define printF(x) write(1, x, strlen(x))
+#include "../Logging/Logging.h" // printF
+
+#define SERVER_BACKLOG SOMAXCONN // Connexions pendents d'acceptar a la cua del kernel
 
 // Funciones relacionadas con el manejo de servidores y conexiones
 int connect_to_server(const char *ip, int port);
 int startServer(const char *ip, int port);
+int startServerReusePort(const char *ip, int port);
 int accept_connection(int server_fd);
 
 #endif // NETWORKING_H
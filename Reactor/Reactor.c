@@ -0,0 +1,513 @@
+#define _GNU_SOURCE
+
+#include "Reactor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include "../Networking/Networking.h"
+#include "../Logging/Logging.h"
+#include "../DataConversion/DataConversion.h"
+
+static int posarNoBloquejant(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// epoll i bústia d'un bucle (0 si tot correcte)
+static int iniciarBucle(ReactorLoop *loop, Reactor *reactor) {
+    loop->reactor = reactor;
+    timer_wheel_init(&loop->timers);
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        perror("[ERROR]: Error creando epoll");
+        return -1;
+    }
+
+    loop->mailboxKind = REACTOR_KIND_MAILBOX;
+    loop->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    event.data.ptr = &loop->mailboxKind;
+    if (loop->wakeFd < 0 || epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wakeFd, &event) < 0) {
+        perror("[ERROR]: Error creando la bústia del reactor");
+        if (loop->wakeFd >= 0) close(loop->wakeFd);
+        close(loop->epoll_fd);
+        return -1;
+    }
+    pthread_mutex_init(&loop->mailboxMutex, NULL);
+    return 0;
+}
+
+// Les feines que ja no s'executaran es lliuren sense connexió perquè alliberin el seu argument
+static void tancarBucle(ReactorLoop *loop) {
+    ReactorMessage *message = loop->mailboxHead;
+    while (message) {
+        ReactorMessage *next = message->next;
+        message->task(NULL, message->arg);
+        free(message);
+        message = next;
+    }
+    loop->mailboxHead = loop->mailboxTail = NULL;
+    pthread_mutex_destroy(&loop->mailboxMutex);
+    close(loop->wakeFd);
+    close(loop->epoll_fd);
+}
+
+int reactor_init(Reactor *reactor, int loopCount, int reusePort,
+                 ReactorFrameHandler onFrame, ReactorDisconnectHandler onDisconnect, void *context) {
+    if (!reactor || !onFrame) return -1;
+
+    memset(reactor, 0, sizeof(Reactor));
+
+    // 0 = un fil per core disponible
+    if (loopCount <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        loopCount = cores > 0 ? (int)cores : 1;
+    }
+    if (loopCount > REACTOR_MAX_LOOPS) {
+        loopCount = REACTOR_MAX_LOOPS;
+    }
+
+    reactor->reusePort = reusePort;
+    reactor->onFrame = onFrame;
+    reactor->onDisconnect = onDisconnect;
+    reactor->context = context;
+
+    for (int i = 0; i < loopCount; i++) {
+        if (iniciarBucle(&reactor->loops[i], reactor) != 0) {
+            for (int j = 0; j < i; j++) tancarBucle(&reactor->loops[j]);
+            return -1;
+        }
+        reactor->loopCount++;
+    }
+    return 0;
+}
+
+static int afegirListener(Reactor *reactor, int fd, int tag, int loopIndex) {
+    if (reactor->listenerCount >= REACTOR_MAX_LISTENERS * REACTOR_MAX_LOOPS || posarNoBloquejant(fd) < 0) {
+        return -1;
+    }
+
+    ReactorListener *listener = &reactor->listeners[reactor->listenerCount++];
+    listener->kind = REACTOR_KIND_LISTENER;
+    listener->fd = fd;
+    listener->tag = tag;
+
+    // Listener propi d'un fil (SO_REUSEPORT) o compartit per tots; EPOLLEXCLUSIVE evita despertar-los tots
+    for (int i = 0; i < reactor->loopCount; i++) {
+        if (loopIndex >= 0 && i != loopIndex) continue;
+
+        struct epoll_event event = {0};
+        event.events = EPOLLIN | (loopIndex < 0 ? EPOLLEXCLUSIVE : 0);
+        event.data.ptr = listener;
+        if (epoll_ctl(reactor->loops[i].epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            perror("[ERROR]: Error registrando el socket de escucha en epoll");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Obre el port d'escolta; amb reusePort cada fil en té un de propi i el kernel reparteix les connexions
+int reactor_listen(Reactor *reactor, const char *ip, int port, int tag) {
+    if (!reactor || !ip) return -1;
+
+    if (!reactor->reusePort) {
+        int fd = startServer(ip, port);
+        if (fd < 0) return -1;
+        if (afegirListener(reactor, fd, tag, -1) != 0) {
+            close(fd);
+            return -1;
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < reactor->loopCount; i++) {
+        int fd = startServerReusePort(ip, port);
+        if (fd < 0) return -1;
+        if (afegirListener(reactor, fd, tag, i) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void tancarConnexio(ReactorLoop *loop, ReactorConnection *conn, int notify) {
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        loop->connections = conn->next;
+    }
+    if (conn->next) conn->next->prev = conn->prev;
+    timer_wheel_cancel(&loop->timers, &conn->heartbeatTimer);
+    timer_wheel_cancel(&loop->timers, &conn->livenessTimer);
+    if (notify && loop->reactor->onDisconnect) {
+        loop->reactor->onDisconnect(conn, loop->reactor->context);
+    }
+    cerrarLectorTramas(&conn->reader);
+    // Abans de tancar: un cop tancat, el número es pot reutilitzar en un altre bucle
+    __atomic_store_n(&loop->reactor->owners[conn->fd], NULL, __ATOMIC_RELEASE);
+    set_frame_protocol(conn->fd, FRAME_PROTOCOL_V1); // El proper accept pot rebre aquest mateix fd
+    close(conn->fd);
+    free(conn->output);
+    free(conn);
+}
+
+// Activa o desactiva l'avís d'EPOLLOUT mentre queda sortida per enviar
+static void esperarEscriptura(ReactorConnection *conn, int enable) {
+    if (conn->waitingWritable == enable) return;
+
+    struct epoll_event event = {0};
+    event.events = EPOLLIN | EPOLLRDHUP | (enable ? EPOLLOUT : 0);
+    event.data.ptr = conn;
+    epoll_ctl(conn->loop->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    conn->waitingWritable = enable;
+}
+
+// Envia sense bloquejar el que queda de la sortida. Si el socket falla, el tanca perquè el reactor el netegi.
+static void buidarSortida(ReactorConnection *conn) {
+    while (conn->outputOffset < conn->outputLength) {
+        ssize_t bytesSent = send(conn->fd, conn->output + conn->outputOffset,
+                                 conn->outputLength - conn->outputOffset, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (bytesSent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                esperarEscriptura(conn, 1);
+                return;
+            }
+            customPrintf("[ERROR]: Error enviando tramas (socket %d).", conn->fd);
+            conn->outputOffset = conn->outputLength = 0;
+            shutdown(conn->fd, SHUT_RDWR);
+            return;
+        }
+        conn->outputOffset += bytesSent;
+    }
+
+    conn->outputOffset = conn->outputLength = 0;
+    esperarEscriptura(conn, 0);
+}
+
+// Afegeix bytes al final de la sortida (-1 si el peer fa tanta estona que no llegeix que se supera el màxim)
+static int afegirSortida(ReactorConnection *conn, const char *data, size_t length) {
+    if (conn->outputLength + length > conn->outputCapacity) {
+        // Primer es recupera l'espai ja enviat i, si no n'hi ha prou, es fa créixer
+        if (conn->outputOffset > 0) {
+            memmove(conn->output, conn->output + conn->outputOffset, conn->outputLength - conn->outputOffset);
+            conn->outputLength -= conn->outputOffset;
+            conn->outputOffset = 0;
+        }
+
+        size_t capacity = conn->outputCapacity ? conn->outputCapacity : REACTOR_OUTPUT_SIZE;
+        while (capacity < conn->outputLength + length) {
+            capacity *= 2;
+        }
+        if (capacity > REACTOR_OUTPUT_MAX) return -1;
+        if (capacity != conn->outputCapacity) {
+            char *output = realloc(conn->output, capacity);
+            if (!output) return -1;
+            conn->output = output;
+            conn->outputCapacity = capacity;
+        }
+    }
+    memcpy(conn->output + conn->outputLength, data, length);
+    conn->outputLength += length;
+    return 0;
+}
+
+// Encua la trama (en el protocol negociat pel socket) i n'envia tot el que el socket accepti.
+// Només des del fil del bucle de la connexió (p.ex. a onFrame): mai no bloqueja el bucle.
+int reactor_send_frame(ReactorConnection *conn, const Frame *frame) {
+    if (!conn || !frame) return -1;
+
+    char buffer[FRAME_SIZE];
+    size_t length = FRAME_SIZE;
+    if (get_frame_protocol(conn->fd) == FRAME_PROTOCOL_V2) {
+        length = (size_t)serialize_frame_v2(frame, buffer);
+    } else {
+        serialize_frame(frame, buffer);
+    }
+
+    if (afegirSortida(conn, buffer, length) != 0) {
+        customPrintf("[ERROR]: El peer del socket %d no lee sus tramas, se da por caído.", conn->fd);
+        shutdown(conn->fd, SHUT_RDWR); // El bucle rep EOF i fa la neteja habitual
+        return -1;
+    }
+    buidarSortida(conn);
+    return 0;
+}
+
+static void enviarHeartbeatConnexio(TimerEntry *entry, void *arg) {
+    ReactorConnection *conn = (ReactorConnection *)arg;
+    timer_wheel_schedule(&conn->loop->timers, entry, REACTOR_HEARTBEAT_INTERVAL_MS);
+
+    // Amb sortida pendent no s'hi afegeixen més HEARTBEAT: ho decidirà el termini de vida
+    if (conn->outputOffset < conn->outputLength) return;
+
+    Frame heartbeat = {0};
+    heartbeat.type = conn->loop->reactor->heartbeatType;
+    heartbeat.data_length = 0;
+    heartbeat.timestamp = (uint32_t)time(NULL);
+    reactor_send_frame(conn, &heartbeat);
+}
+
+static void venceLiveness(TimerEntry *entry, void *arg) {
+    (void)entry;
+    ReactorConnection *conn = (ReactorConnection *)arg;
+
+    customPrintf("[ERROR]: El peer del socket %d no responde, se da por caído.", conn->fd);
+    shutdown(conn->fd, SHUT_RDWR); // El bucle rep EOF i fa la neteja habitual
+}
+
+void reactor_set_heartbeat(Reactor *reactor, uint8_t frameType) {
+    if (reactor) reactor->heartbeatType = frameType;
+}
+
+// Comença a enviar HEARTBEAT a la connexió (cridar des del fil del bucle, p.ex. a onFrame)
+void reactor_enable_heartbeat(ReactorConnection *conn) {
+    if (!conn || conn->heartbeat || conn->loop->reactor->heartbeatType == 0) return;
+
+    conn->heartbeat = 1;
+
+    // Desfasament segons el socket perquè els enviaments es reparteixin per tot l'interval
+    uint64_t phase = ((uint64_t)conn->fd * 2654435761u) % REACTOR_HEARTBEAT_INTERVAL_MS;
+    timer_wheel_schedule(&conn->loop->timers, &conn->heartbeatTimer, phase);
+    timer_wheel_schedule(&conn->loop->timers, &conn->livenessTimer, REACTOR_LIVENESS_TIMEOUT_MS);
+}
+
+static void acceptarConnexions(ReactorLoop *loop, ReactorListener *listener) {
+    while (1) {
+        int fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("[ERROR]: Error al aceptar la conexión");
+            }
+            return;
+        }
+        if (fd >= REACTOR_MAX_FDS) {
+            customPrintf("[ERROR]: Demasiadas conexiones abiertas (socket %d).", fd);
+            close(fd);
+            continue;
+        }
+
+        ReactorConnection *conn = malloc(sizeof(ReactorConnection));
+        if (!conn || iniciarLectorTramasConCapacidad(&conn->reader, fd, REACTOR_READER_SIZE) != 0) {
+            customPrintf("[ERROR]: Error asignando memoria para la conexión.");
+            free(conn);
+            close(fd);
+            continue;
+        }
+        conn->kind = REACTOR_KIND_CONNECTION;
+        conn->fd = fd;
+        conn->tag = listener->tag;
+        conn->loop = loop;
+        conn->heartbeat = 0;
+        conn->output = NULL;
+        conn->outputOffset = conn->outputLength = conn->outputCapacity = 0;
+        conn->waitingWritable = 0;
+        timer_entry_init(&conn->heartbeatTimer, enviarHeartbeatConnexio, conn);
+        timer_entry_init(&conn->livenessTimer, venceLiveness, conn);
+
+        // Cada connexió comença en v1 fins que es negocia v2 amb 0x01/0x02
+        set_frame_protocol(fd, FRAME_PROTOCOL_V1);
+
+        struct epoll_event event = {0};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.ptr = conn;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            perror("[ERROR]: Error registrando la conexión en epoll");
+            cerrarLectorTramas(&conn->reader);
+            free(conn);
+            close(fd);
+            continue;
+        }
+
+        conn->prev = NULL;
+        conn->next = loop->connections;
+        if (loop->connections) loop->connections->prev = conn;
+        loop->connections = conn;
+        __atomic_store_n(&loop->reactor->owners[fd], loop, __ATOMIC_RELEASE);
+    }
+}
+
+// Deixa una feina per a la connexió del socket fd al bucle que l'atén (des de qualsevol fil).
+// Retorna -1 si el socket no és de cap connexió oberta: llavors la feina no s'executarà.
+int reactor_post(Reactor *reactor, int fd, ReactorTask task, void *arg) {
+    if (!reactor || !task || fd < 0 || fd >= REACTOR_MAX_FDS) return -1;
+
+    ReactorLoop *loop = __atomic_load_n(&reactor->owners[fd], __ATOMIC_ACQUIRE);
+    if (!loop) return -1;
+
+    ReactorMessage *message = malloc(sizeof(ReactorMessage));
+    if (!message) return -1;
+    message->fd = fd;
+    message->task = task;
+    message->arg = arg;
+    message->next = NULL;
+
+    pthread_mutex_lock(&loop->mailboxMutex);
+    if (loop->mailboxTail) {
+        loop->mailboxTail->next = message;
+    } else {
+        loop->mailboxHead = message;
+    }
+    loop->mailboxTail = message;
+    pthread_mutex_unlock(&loop->mailboxMutex);
+
+    uint64_t wake = 1;
+    if (write(loop->wakeFd, &wake, sizeof(wake)) < 0 && errno != EAGAIN) {
+        perror("[ERROR]: Error despertando el bucle del reactor");
+    }
+    return 0;
+}
+
+// Executa les feines de la bústia. Si el socket ja s'ha tancat (o ara és d'un altre bucle), sense connexió.
+static void atendreBustia(ReactorLoop *loop) {
+    uint64_t count;
+    while (read(loop->wakeFd, &count, sizeof(count)) < 0 && errno == EINTR) {
+    }
+
+    pthread_mutex_lock(&loop->mailboxMutex);
+    ReactorMessage *message = loop->mailboxHead;
+    loop->mailboxHead = loop->mailboxTail = NULL;
+    pthread_mutex_unlock(&loop->mailboxMutex);
+
+    while (message) {
+        ReactorMessage *next = message->next;
+        ReactorConnection *conn = loop->connections;
+        while (conn && conn->fd != message->fd) {
+            conn = conn->next;
+        }
+        message->task(conn, message->arg);
+        free(message);
+        message = next;
+    }
+}
+
+// Processa totes les trames completes disponibles. Retorna 0 si la connexió continua oberta.
+static int llegirConnexio(ReactorLoop *loop, ReactorConnection *conn) {
+    Reactor *reactor = loop->reactor;
+
+    while (1) {
+        FrameView view;
+        if (leerSiguienteTrama(&conn->reader, &view) != 0) {
+            if (conn->reader.pending) {
+                return 0; // Trama incompleta: esperar més dades
+            }
+            tancarConnexio(loop, conn, 1);
+            return -1;
+        }
+
+        if (view.kind != FRAME_VIEW_CONTROL) {
+            customPrintf("[ERROR]: Trama de datos inesperada en una conexión de control.");
+            tancarConnexio(loop, conn, 1);
+            return -1;
+        }
+
+        // Només les dades rebudes demostren que el peer és viu (el que s'hi envia no diu res)
+        if (conn->heartbeat) {
+            timer_wheel_schedule(&loop->timers, &conn->livenessTimer, REACTOR_LIVENESS_TIMEOUT_MS);
+        }
+        if (reactor->heartbeatType != 0 && view.frame.type == reactor->heartbeatType) {
+            continue; // Eco del HEARTBEAT: ja ha servit per al termini de vida
+        }
+
+        if (reactor->onFrame(conn, &view.frame, reactor->context) != 0) {
+            tancarConnexio(loop, conn, 0);
+            return -1;
+        }
+    }
+}
+
+static void *bucleReactor(void *arg) {
+    ReactorLoop *loop = (ReactorLoop *)arg;
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+
+    while (!loop->reactor->stop) {
+        int timeout = timer_wheel_next_timeout(&loop->timers, REACTOR_WAIT_MS);
+        int ready = epoll_wait(loop->epoll_fd, events, REACTOR_MAX_EVENTS, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            perror("[ERROR]: Error en epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            int kind = *(int *)events[i].data.ptr;
+            if (kind == REACTOR_KIND_LISTENER) {
+                acceptarConnexions(loop, (ReactorListener *)events[i].data.ptr);
+                continue;
+            }
+            if (kind == REACTOR_KIND_MAILBOX) {
+                atendreBustia(loop);
+                continue;
+            }
+
+            ReactorConnection *conn = (ReactorConnection *)events[i].data.ptr;
+            if (events[i].events & EPOLLOUT) {
+                buidarSortida(conn);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                llegirConnexio(loop, conn);
+            }
+        }
+
+        // Només es processen els temporitzadors vençuts (HEARTBEAT i terminis de vida)
+        timer_wheel_advance(&loop->timers);
+    }
+    return NULL;
+}
+
+int reactor_start(Reactor *reactor) {
+    if (!reactor) return -1;
+
+    for (int i = 0; i < reactor->loopCount; i++) {
+        if (pthread_create(&reactor->loops[i].thread, NULL, bucleReactor, &reactor->loops[i]) != 0) {
+            perror("[ERROR]: Fallo al crear hilo del reactor");
+            reactor->stop = 1;
+            for (int j = 0; j < i; j++) pthread_join(reactor->loops[j].thread, NULL);
+            return -1;
+        }
+    }
+    reactor->started = 1;
+    return 0;
+}
+
+void reactor_stop(Reactor *reactor) {
+    if (reactor) reactor->stop = 1;
+}
+
+// Espera que acabin tots els fils (si s'han iniciat) i allibera els epoll i les bústies
+void reactor_join(Reactor *reactor) {
+    if (!reactor) return;
+
+    for (int i = 0; i < reactor->loopCount; i++) {
+        if (reactor->started) pthread_join(reactor->loops[i].thread, NULL);
+        tancarBucle(&reactor->loops[i]);
+    }
+    reactor->loopCount = 0;
+    reactor_close_listeners(reactor);
+}
+
+void reactor_close_listeners(Reactor *reactor) {
+    if (!reactor) return;
+
+    for (int i = 0; i < reactor->listenerCount; i++) {
+        if (reactor->listeners[i].fd >= 0) {
+            close(reactor->listeners[i].fd);
+            reactor->listeners[i].fd = -1;
+        }
+    }
+}
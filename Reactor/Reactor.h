@@ -0,0 +1,119 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <pthread.h>
+
+#include "../GestorTramas/GestorTramas.h"
+#include "../TimerWheel/TimerWheel.h"
+
+// Reactor epoll: un nombre fix de fils de bucle d'esdeveniments (un per core) atén totes les connexions.
+// Cada connexió té el seu lector de trames no bloquejant i sempre l'atén el mateix fil.
+#define REACTOR_MAX_LOOPS 64
+#define REACTOR_MAX_LISTENERS 8
+#define REACTOR_MAX_EVENTS 128
+#define REACTOR_WAIT_MS 500               // Cada quant es revisa si s'ha d'aturar el bucle
+#define REACTOR_READER_SIZE 4096          // Buffer inicial per connexió (trames de control de 256 bytes)
+#define REACTOR_OUTPUT_SIZE 1024          // Sortida inicial per connexió (creix si el peer no llegeix)
+#define REACTOR_OUTPUT_MAX 65536          // Sortida pendent a partir de la qual el peer es dona per mort
+
+// HEARTBEAT: cada connexió activada en rep un per interval, repartits dins l'interval segons el socket.
+// Si no s'hi pot escriure (ni rebre res) abans del termini de vida, es dona el peer per mort.
+#define REACTOR_HEARTBEAT_INTERVAL_MS 1000
+#define REACTOR_LIVENESS_TIMEOUT_MS 3000
+
+#define REACTOR_MAX_FDS 65536             // Sockets que poden rebre trames d'un altre fil (reactor_post)
+
+// Què hi ha darrere de cada entrada d'epoll (primer camp de cada estructura)
+#define REACTOR_KIND_CONNECTION 0
+#define REACTOR_KIND_LISTENER 1
+#define REACTOR_KIND_MAILBOX 2
+
+#ifndef REACTOR_REUSEPORT
+#define REACTOR_REUSEPORT 0               // 1 = un socket d'escolta per fil amb SO_REUSEPORT
+#endif
+
+typedef struct ReactorLoop ReactorLoop;
+typedef struct ReactorConnection ReactorConnection;
+
+struct ReactorConnection {
+    int kind;         // REACTOR_KIND_CONNECTION
+    int fd;
+    int tag;          // Identificador del socket d'escolta que l'ha acceptada
+    FrameReader reader;
+    ReactorLoop *loop;
+    int heartbeat;               // 1 si rep HEARTBEAT periòdics
+    TimerEntry heartbeatTimer;   // Pròxim enviament de HEARTBEAT
+    TimerEntry livenessTimer;    // Termini per donar el peer per mort (es reprograma amb cada trama rebuda)
+    char *output;                // Trames encara no acceptades pel socket (s'envien amb EPOLLOUT)
+    size_t outputOffset;
+    size_t outputLength;
+    size_t outputCapacity;
+    int waitingWritable;         // 1 si EPOLLOUT està activat
+    ReactorConnection *prev;     // Connexions obertes del bucle (només les toca el seu fil)
+    ReactorConnection *next;
+};
+
+typedef struct {
+    int kind;         // REACTOR_KIND_LISTENER
+    int fd;
+    int tag;
+} ReactorListener;
+
+// Feina per a la connexió d'un socket, executada al fil del bucle que l'atén (conn = NULL si ja s'ha tancat)
+typedef void (*ReactorTask)(ReactorConnection *conn, void *arg);
+
+typedef struct ReactorMessage {
+    int fd;
+    ReactorTask task;
+    void *arg;
+    struct ReactorMessage *next;
+} ReactorMessage;
+
+// Trama de control rebuda. Retorna 0 per continuar o -1 si la connexió ja s'ha gestionat i s'ha de tancar.
+typedef int (*ReactorFrameHandler)(ReactorConnection *conn, const Frame *frame, void *context);
+// El peer s'ha desconnectat o la trama era invàlida (el reactor tanca el socket després)
+typedef void (*ReactorDisconnectHandler)(ReactorConnection *conn, void *context);
+
+typedef struct Reactor Reactor;
+
+struct ReactorLoop {
+    int epoll_fd;
+    pthread_t thread;
+    Reactor *reactor;
+    TimerWheel timers;  // Només la toca el fil del bucle: sense mutex
+    ReactorConnection *connections;
+    int mailboxKind;    // REACTOR_KIND_MAILBOX: entrada d'epoll de wakeFd
+    int wakeFd;         // eventfd que desperta el bucle quan algú li deixa feina a la bústia
+    pthread_mutex_t mailboxMutex;
+    ReactorMessage *mailboxHead;
+    ReactorMessage *mailboxTail;
+};
+
+struct Reactor {
+    ReactorLoop loops[REACTOR_MAX_LOOPS];
+    int loopCount;
+    ReactorListener listeners[REACTOR_MAX_LISTENERS * REACTOR_MAX_LOOPS];
+    int listenerCount;
+    int reusePort;
+    int started;      // 1 si els fils del bucle estan en marxa
+    volatile int stop;
+    ReactorFrameHandler onFrame;
+    ReactorDisconnectHandler onDisconnect;
+    void *context;
+    uint8_t heartbeatType;  // Tipus de la trama HEARTBEAT (0 = desactivat)
+    ReactorLoop *owners[REACTOR_MAX_FDS]; // Bucle que atén cada socket obert (NULL si cap)
+};
+
+int reactor_init(Reactor *reactor, int loopCount, int reusePort,
+                 ReactorFrameHandler onFrame, ReactorDisconnectHandler onDisconnect, void *context);
+int reactor_listen(Reactor *reactor, const char *ip, int port, int tag);
+int reactor_start(Reactor *reactor);
+void reactor_stop(Reactor *reactor);
+void reactor_join(Reactor *reactor);
+void reactor_close_listeners(Reactor *reactor);
+void reactor_set_heartbeat(Reactor *reactor, uint8_t frameType);
+void reactor_enable_heartbeat(ReactorConnection *conn);
+int reactor_send_frame(ReactorConnection *conn, const Frame *frame);
+int reactor_post(Reactor *reactor, int fd, ReactorTask task, void *arg);
+
+#endif
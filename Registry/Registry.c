@@ -0,0 +1,512 @@
+#include "Registry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "../DataConversion/DataConversion.h"
+#include "../Logging/Logging.h"
+
+#define CLIENT_BUCKET_MASK (REGISTRY_CLIENT_BUCKETS - 1)
+#define WORKER_BUCKET_MASK (REGISTRY_WORKER_BUCKETS - 1)
+#define FRANJA(bucket) ((bucket) % REGISTRY_STRIPES)
+
+// FNV-1a
+static uint32_t hashCadena(const char *text) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static unsigned cubetaSocket(int socket_fd, unsigned mask) {
+    return (unsigned)socket_fd & mask;
+}
+
+static unsigned cubetaDireccion(const char *ip, int port) {
+    return (hashCadena(ip) ^ ((uint32_t)port * 2654435761u)) & WORKER_BUCKET_MASK;
+}
+
+/* ---------------------------------------------------------------- Clients */
+
+ClientManager *createClientManager() {
+    ClientManager *manager = calloc(1, sizeof(ClientManager));
+    if (!manager) {
+        perror("Error al inicializar ClientManager");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < REGISTRY_STRIPES; i++) {
+        if (pthread_mutex_init(&manager->socketStripes[i], NULL) != 0 ||
+            pthread_mutex_init(&manager->nameStripes[i], NULL) != 0) {
+            perror("Error al inicializar el mutex de ClientManager");
+            free(manager);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return manager;
+}
+
+void freeClientManager(ClientManager *manager) {
+    if (manager) {
+        for (int i = 0; i < REGISTRY_CLIENT_BUCKETS; i++) {
+            ClientEntry *entry = manager->bySocket[i];
+            while (entry) {
+                ClientEntry *next = entry->nextBySocket;
+                free(entry);
+                entry = next;
+            }
+        }
+        for (int i = 0; i < REGISTRY_STRIPES; i++) {
+            pthread_mutex_destroy(&manager->socketStripes[i]);
+            pthread_mutex_destroy(&manager->nameStripes[i]);
+        }
+        free(manager); // Liberar la estructura principal
+        LOG_DEBUGF("[DEBUG]: ClientManager liberado correctamente.");
+    }
+}
+
+// Bloqueja dues franges de socket sempre en el mateix ordre (o una sola si coincideixen)
+static void bloquearFranjasSocket(ClientManager *manager, unsigned a, unsigned b) {
+    unsigned first = FRANJA(a) < FRANJA(b) ? FRANJA(a) : FRANJA(b);
+    unsigned second = FRANJA(a) < FRANJA(b) ? FRANJA(b) : FRANJA(a);
+    pthread_mutex_lock(&manager->socketStripes[first]);
+    if (second != first) pthread_mutex_lock(&manager->socketStripes[second]);
+}
+
+static void desbloquearFranjasSocket(ClientManager *manager, unsigned a, unsigned b) {
+    pthread_mutex_unlock(&manager->socketStripes[FRANJA(a)]);
+    if (FRANJA(b) != FRANJA(a)) pthread_mutex_unlock(&manager->socketStripes[FRANJA(b)]);
+}
+
+static void treureClientePorSocket(ClientManager *manager, unsigned bucket, ClientEntry *entry) {
+    ClientEntry **link = &manager->bySocket[bucket];
+    while (*link && *link != entry) link = &(*link)->nextBySocket;
+    if (*link) *link = entry->nextBySocket;
+    entry->nextBySocket = NULL;
+}
+
+static void treureClientePorNombre(ClientManager *manager, unsigned bucket, ClientEntry *entry) {
+    ClientEntry **link = &manager->byName[bucket];
+    while (*link && *link != entry) link = &(*link)->nextByName;
+    if (*link) *link = entry->nextByName;
+    entry->nextByName = NULL;
+}
+
+static ClientEntry *trobarClientePorSocket(ClientManager *manager, unsigned bucket, int socket_fd) {
+    for (ClientEntry *entry = manager->bySocket[bucket]; entry; entry = entry->nextBySocket) {
+        if (entry->info.socket_fd == socket_fd) return entry;
+    }
+    return NULL;
+}
+
+// Añade un cliente (o actualiza el socket si el usuario ya estaba registrado)
+void addClient(ClientManager *manager, const char *username, const char *ip, int socket_fd) {
+    unsigned nameBucket = hashCadena(username) & CLIENT_BUCKET_MASK;
+    unsigned socketBucket = cubetaSocket(socket_fd, CLIENT_BUCKET_MASK);
+
+    pthread_mutex_lock(&manager->nameStripes[FRANJA(nameBucket)]);
+
+    for (ClientEntry *entry = manager->byName[nameBucket]; entry; entry = entry->nextByName) {
+        if (strcmp(entry->info.username, username) == 0) {
+            unsigned oldBucket = cubetaSocket(entry->info.socket_fd, CLIENT_BUCKET_MASK);
+            bloquearFranjasSocket(manager, oldBucket, socketBucket);
+            treureClientePorSocket(manager, oldBucket, entry);
+            strncpy(entry->info.ip, ip, sizeof(entry->info.ip) - 1);
+            entry->info.socket_fd = socket_fd;
+            entry->nextBySocket = manager->bySocket[socketBucket];
+            manager->bySocket[socketBucket] = entry;
+            desbloquearFranjasSocket(manager, oldBucket, socketBucket);
+
+            customPrintf("\n[INFO]: Cliente existente actualizado.\n");
+            pthread_mutex_unlock(&manager->nameStripes[FRANJA(nameBucket)]);
+            return;
+        }
+    }
+
+    //Añadir un nuevo cliente
+    ClientEntry *entry = calloc(1, sizeof(ClientEntry));
+    if (!entry) {
+        customPrintf("[ERROR]: Error al ampliar la capacidad de clientes.");
+        pthread_mutex_unlock(&manager->nameStripes[FRANJA(nameBucket)]);
+        return;
+    }
+    strncpy(entry->info.username, username, sizeof(entry->info.username) - 1);
+    strncpy(entry->info.ip, ip, sizeof(entry->info.ip) - 1);
+    entry->info.socket_fd = socket_fd;
+
+    entry->nextByName = manager->byName[nameBucket];
+    manager->byName[nameBucket] = entry;
+
+    pthread_mutex_lock(&manager->socketStripes[FRANJA(socketBucket)]);
+    entry->nextBySocket = manager->bySocket[socketBucket];
+    manager->bySocket[socketBucket] = entry;
+    pthread_mutex_unlock(&manager->socketStripes[FRANJA(socketBucket)]);
+
+    __atomic_add_fetch(&manager->clientCount, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&manager->nameStripes[FRANJA(nameBucket)]);
+}
+
+// Elimina un cliente por su socket
+void removeClientBySocket(ClientManager *manager, int socket_fd) {
+    unsigned socketBucket = cubetaSocket(socket_fd, CLIENT_BUCKET_MASK);
+    char username[64];
+
+    // Primer es busca el nom: l'ordre de bloqueig és franja de nom -> franja de socket
+    pthread_mutex_lock(&manager->socketStripes[FRANJA(socketBucket)]);
+    ClientEntry *entry = trobarClientePorSocket(manager, socketBucket, socket_fd);
+    if (!entry) {
+        pthread_mutex_unlock(&manager->socketStripes[FRANJA(socketBucket)]);
+        return;
+    }
+    strncpy(username, entry->info.username, sizeof(username));
+    pthread_mutex_unlock(&manager->socketStripes[FRANJA(socketBucket)]);
+
+    unsigned nameBucket = hashCadena(username) & CLIENT_BUCKET_MASK;
+    pthread_mutex_lock(&manager->nameStripes[FRANJA(nameBucket)]);
+    pthread_mutex_lock(&manager->socketStripes[FRANJA(socketBucket)]);
+
+    // Pot haver canviat entremig (reconnexió del mateix usuari): es torna a comprovar
+    entry = trobarClientePorSocket(manager, socketBucket, socket_fd);
+    if (entry && strcmp(entry->info.username, username) == 0) {
+        treureClientePorSocket(manager, socketBucket, entry);
+        treureClientePorNombre(manager, nameBucket, entry);
+        __atomic_sub_fetch(&manager->clientCount, 1, __ATOMIC_RELAXED);
+    } else {
+        entry = NULL;
+    }
+
+    pthread_mutex_unlock(&manager->socketStripes[FRANJA(socketBucket)]);
+    pthread_mutex_unlock(&manager->nameStripes[FRANJA(nameBucket)]);
+
+    if (entry) {
+        free(entry);
+        customPrintf("[INFO]: Cliente eliminado de la lista.");
+    }
+}
+
+// Copia les dades del client del socket (0 si existeix, -1 si no)
+int buscarClientePorSocket(ClientManager *manager, int socket_fd, ClientInfo *client) {
+    if (!manager) return -1;
+
+    unsigned socketBucket = cubetaSocket(socket_fd, CLIENT_BUCKET_MASK);
+    pthread_mutex_lock(&manager->socketStripes[FRANJA(socketBucket)]);
+    ClientEntry *entry = trobarClientePorSocket(manager, socketBucket, socket_fd);
+    if (entry && client) {
+        *client = entry->info;
+    }
+    pthread_mutex_unlock(&manager->socketStripes[FRANJA(socketBucket)]);
+
+    return entry ? 0 : -1;
+}
+
+// Recorre tots els clients, franja a franja (mai amb tot el registre bloquejat)
+void recorrerClientes(ClientManager *manager, void (*callback)(const ClientInfo *client, void *arg), void *arg) {
+    if (!manager || !callback) return;
+
+    for (int stripe = 0; stripe < REGISTRY_STRIPES; stripe++) {
+        pthread_mutex_lock(&manager->socketStripes[stripe]);
+        for (int bucket = stripe; bucket < REGISTRY_CLIENT_BUCKETS; bucket += REGISTRY_STRIPES) {
+            for (ClientEntry *entry = manager->bySocket[bucket]; entry; entry = entry->nextBySocket) {
+                callback(&entry->info, arg);
+            }
+        }
+        pthread_mutex_unlock(&manager->socketStripes[stripe]);
+    }
+}
+
+static void mostrarCliente(const ClientInfo *client, void *arg) {
+    int *index = (int *)arg;
+    (*index)++;
+    customPrintf("\nCliente %d: Usuario: %s, IP: %s, Socket: %d\n",
+                 *index, client->username, client->ip, client->socket_fd);
+}
+
+// Lista los clientes conectados
+void listClients(ClientManager *manager) {
+    if (__atomic_load_n(&manager->clientCount, __ATOMIC_RELAXED) == 0) {
+        customPrintf("No hay clientes conectados.");
+        return;
+    }
+
+    int index = 0;
+    customPrintf("\nLista de clientes conectados: \n");
+    recorrerClientes(manager, mostrarCliente, &index);
+}
+
+/* ---------------------------------------------------------------- Workers */
+
+WorkerManager *createWorkerManager() {
+    WorkerManager *manager = calloc(1, sizeof(WorkerManager));
+    if (!manager) {
+        perror("Error al inicializar WorkerManager");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pthread_rwlock_init(&manager->lock, NULL) != 0) {
+        perror("Error al inicializar el mutex de WorkerManager");
+        free(manager);
+        exit(EXIT_FAILURE);
+    }
+
+    manager->scheduler = scheduler_get_policy(SCHEDULER_POLICY);
+    return manager;
+}
+
+// Allibera la memòria utilitzada pel WorkerManager
+void freeWorkerManager(WorkerManager *manager) {
+    if (manager) {
+        WorkerEntry *entry = manager->first;
+        while (entry) {
+            WorkerEntry *next = entry->next;
+            free(entry);
+            entry = next;
+        }
+        pthread_rwlock_destroy(&manager->lock);
+        free(manager); // Liberar la estructura principal
+        LOG_DEBUGF("[DEBUG]: WorkerManager liberado correctamente.");
+    }
+}
+
+// Còpia coherent d'un worker: la càrrega es pot actualitzar amb només el bloqueig de lectura
+static void copiarWorker(const WorkerEntry *entry, WorkerInfo *worker) {
+    *worker = entry->info;
+    worker->activeJobs = __atomic_load_n(&entry->info.activeJobs, __ATOMIC_RELAXED);
+    worker->bytesInFlight = __atomic_load_n(&entry->info.bytesInFlight, __ATOMIC_RELAXED);
+    worker->assignedSinceReport = __atomic_load_n(&entry->info.assignedSinceReport, __ATOMIC_RELAXED);
+}
+
+static WorkerEntry *trobarWorkerPorSocket(WorkerManager *manager, int socket_fd) {
+    for (WorkerEntry *entry = manager->bySocket[cubetaSocket(socket_fd, WORKER_BUCKET_MASK)]; entry; entry = entry->nextBySocket) {
+        if (entry->info.socket_fd == socket_fd) return entry;
+    }
+    return NULL;
+}
+
+static void treureWorkerPorSocket(WorkerManager *manager, WorkerEntry *entry) {
+    WorkerEntry **link = &manager->bySocket[cubetaSocket(entry->info.socket_fd, WORKER_BUCKET_MASK)];
+    while (*link && *link != entry) link = &(*link)->nextBySocket;
+    if (*link) *link = entry->nextBySocket;
+    entry->nextBySocket = NULL;
+}
+
+static void afegirWorkerPorSocket(WorkerManager *manager, WorkerEntry *entry) {
+    unsigned bucket = cubetaSocket(entry->info.socket_fd, WORKER_BUCKET_MASK);
+    entry->nextBySocket = manager->bySocket[bucket];
+    manager->bySocket[bucket] = entry;
+}
+
+static int esPrincipal(const WorkerManager *manager, const WorkerEntry *entry) {
+    return manager->mainTextWorker == entry || manager->mainMediaWorker == entry;
+}
+
+// Registra el worker o, si (IP, port) ja hi era, n'actualitza el socket
+int altaWorker(WorkerManager *manager, const char *type, const char *ip, int port, int socket_fd, int *isMain) {
+    if (!manager || !type || !ip) return -1;
+
+    unsigned addressBucket = cubetaDireccion(ip, port);
+    pthread_rwlock_wrlock(&manager->lock);
+
+    for (WorkerEntry *entry = manager->byAddress[addressBucket]; entry; entry = entry->nextByAddress) {
+        if (strcmp(entry->info.ip, ip) == 0 && entry->info.port == port) {
+            treureWorkerPorSocket(manager, entry);
+            entry->info.socket_fd = socket_fd;
+            afegirWorkerPorSocket(manager, entry);
+            if (isMain) *isMain = esPrincipal(manager, entry);
+            pthread_rwlock_unlock(&manager->lock);
+            return WORKER_REGISTRO_ACTUALIZADO;
+        }
+    }
+
+    WorkerEntry *entry = calloc(1, sizeof(WorkerEntry));
+    if (!entry) {
+        pthread_rwlock_unlock(&manager->lock);
+        return -1;
+    }
+    strncpy(entry->info.type, type, sizeof(entry->info.type) - 1);
+    strncpy(entry->info.ip, ip, sizeof(entry->info.ip) - 1);
+    entry->info.port = port;
+    entry->info.socket_fd = socket_fd;
+
+    afegirWorkerPorSocket(manager, entry);
+    entry->nextByAddress = manager->byAddress[addressBucket];
+    manager->byAddress[addressBucket] = entry;
+
+    entry->prev = manager->last;
+    if (manager->last) manager->last->next = entry;
+    else manager->first = entry;
+    manager->last = entry;
+    manager->workerCount++;
+
+    // Asignar como principal si es el primero de su tipo
+    if (strcasecmp(type, "TEXT") == 0 && manager->mainTextWorker == NULL) {
+        manager->mainTextWorker = entry;
+    } else if (strcasecmp(type, "MEDIA") == 0 && manager->mainMediaWorker == NULL) {
+        manager->mainMediaWorker = entry;
+    }
+    if (isMain) *isMain = esPrincipal(manager, entry);
+
+    pthread_rwlock_unlock(&manager->lock);
+    return WORKER_REGISTRO_NUEVO;
+}
+
+// Dona de baixa el worker del socket; en retorna una còpia i si era principal (0 si existia, -1 si no)
+int bajaWorkerPorSocket(WorkerManager *manager, int socket_fd, WorkerInfo *worker, int *wasMain) {
+    if (!manager) return -1;
+
+    pthread_rwlock_wrlock(&manager->lock);
+    WorkerEntry *entry = trobarWorkerPorSocket(manager, socket_fd);
+    if (!entry) {
+        pthread_rwlock_unlock(&manager->lock);
+        return -1;
+    }
+
+    treureWorkerPorSocket(manager, entry);
+
+    WorkerEntry **link = &manager->byAddress[cubetaDireccion(entry->info.ip, entry->info.port)];
+    while (*link && *link != entry) link = &(*link)->nextByAddress;
+    if (*link) *link = entry->nextByAddress;
+
+    if (entry->prev) entry->prev->next = entry->next;
+    else manager->first = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else manager->last = entry->prev;
+    manager->workerCount--;
+
+    if (wasMain) *wasMain = esPrincipal(manager, entry);
+    if (manager->mainTextWorker == entry) manager->mainTextWorker = NULL;
+    if (manager->mainMediaWorker == entry) manager->mainMediaWorker = NULL;
+    if (worker) copiarWorker(entry, worker);
+
+    pthread_rwlock_unlock(&manager->lock);
+    free(entry);
+    return 0;
+}
+
+int buscarWorkerPorSocket(WorkerManager *manager, int socket_fd, WorkerInfo *worker) {
+    if (!manager) return -1;
+
+    pthread_rwlock_rdlock(&manager->lock);
+    WorkerEntry *entry = trobarWorkerPorSocket(manager, socket_fd);
+    if (entry && worker) {
+        copiarWorker(entry, worker);
+    }
+    pthread_rwlock_unlock(&manager->lock);
+
+    return entry ? 0 : -1;
+}
+
+int esWorkerPrincipal(WorkerManager *manager, int socket_fd) {
+    if (!manager) return 0;
+
+    pthread_rwlock_rdlock(&manager->lock);
+    WorkerEntry *entry = trobarWorkerPorSocket(manager, socket_fd);
+    int isMain = entry && esPrincipal(manager, entry);
+    pthread_rwlock_unlock(&manager->lock);
+
+    return isMain;
+}
+
+// Escull amb la política configurada un worker del tipus i en compta l'assignació (0 si n'hi ha, -1 si no)
+int elegirWorker(WorkerManager *manager, const char *type, WorkerInfo *worker) {
+    static __thread unsigned int schedulerSeed = 0;
+    if (!manager || !type) return -1;
+    if (schedulerSeed == 0) {
+        schedulerSeed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)&schedulerSeed;
+    }
+
+    pthread_rwlock_rdlock(&manager->lock);
+
+    int capacity = manager->workerCount > 0 ? manager->workerCount : 1;
+    WorkerEntry **candidates = malloc(sizeof(WorkerEntry *) * capacity);
+    SchedulerLoad *loads = malloc(sizeof(SchedulerLoad) * capacity);
+    if (!candidates || !loads) {
+        pthread_rwlock_unlock(&manager->lock);
+        free(candidates);
+        free(loads);
+        return -1;
+    }
+
+    // Candidats: tots els workers vàlids del tipus, amb la càrrega reportada més la ja assignada
+    int candidateCount = 0;
+    for (WorkerEntry *entry = manager->first; entry; entry = entry->next) {
+        if (strcasecmp(entry->info.type, type) != 0 || entry->info.ip[0] == '\0' ||
+            entry->info.port <= 0 || entry->info.socket_fd < 0) {
+            continue;
+        }
+
+        WorkerInfo load;
+        copiarWorker(entry, &load);
+        uint64_t averageBytes = load.activeJobs > 0 ? load.bytesInFlight / load.activeJobs : SCHEDULER_DEFAULT_JOB_BYTES;
+        candidates[candidateCount] = entry;
+        loads[candidateCount].outstanding = load.activeJobs + load.assignedSinceReport;
+        loads[candidateCount].bytesInFlight = load.bytesInFlight + (uint64_t)load.assignedSinceReport * averageBytes;
+        candidateCount++;
+    }
+
+    int chosen = manager->scheduler(loads, candidateCount, &schedulerSeed);
+    if (chosen >= 0) {
+        __atomic_add_fetch(&candidates[chosen]->info.assignedSinceReport, 1, __ATOMIC_RELAXED);
+        if (worker) copiarWorker(candidates[chosen], worker);
+    }
+
+    pthread_rwlock_unlock(&manager->lock);
+    free(candidates);
+    free(loads);
+    return chosen >= 0 ? 0 : -1;
+}
+
+// Informe 0x15: només cal el bloqueig de lectura, la càrrega és atòmica
+int actualizarCargaPorSocket(WorkerManager *manager, int socket_fd, int activeJobs, uint64_t bytesInFlight) {
+    if (!manager) return -1;
+
+    pthread_rwlock_rdlock(&manager->lock);
+    WorkerEntry *entry = trobarWorkerPorSocket(manager, socket_fd);
+    if (entry) {
+        __atomic_store_n(&entry->info.activeJobs, activeJobs, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->info.bytesInFlight, bytesInFlight, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->info.assignedSinceReport, 0, __ATOMIC_RELAXED);
+    }
+    pthread_rwlock_unlock(&manager->lock);
+
+    return entry ? 0 : -1;
+}
+
+// Assigna principal als tipus que no en tenen; retorna quants n'ha triat (copiats a newMains)
+int elegirWorkersPrincipales(WorkerManager *manager, WorkerInfo *newMains, int maxMains) {
+    if (!manager) return 0;
+
+    int count = 0;
+    pthread_rwlock_wrlock(&manager->lock);
+    for (WorkerEntry *entry = manager->first; entry && count < maxMains; entry = entry->next) {
+        if (manager->mainTextWorker == NULL && strcasecmp(entry->info.type, "TEXT") == 0) {
+            manager->mainTextWorker = entry;
+            copiarWorker(entry, &newMains[count++]);
+        } else if (manager->mainMediaWorker == NULL && strcasecmp(entry->info.type, "MEDIA") == 0) {
+            manager->mainMediaWorker = entry;
+            copiarWorker(entry, &newMains[count++]);
+        }
+    }
+    pthread_rwlock_unlock(&manager->lock);
+
+    return count;
+}
+
+// Recorre els workers en ordre de registre amb el bloqueig de lectura
+void recorrerWorkers(WorkerManager *manager, void (*callback)(const WorkerInfo *worker, int index, void *arg), void *arg) {
+    if (!manager || !callback) return;
+
+    pthread_rwlock_rdlock(&manager->lock);
+    int index = 0;
+    for (WorkerEntry *entry = manager->first; entry; entry = entry->next) {
+        WorkerInfo worker;
+        copiarWorker(entry, &worker);
+        callback(&worker, index++, arg);
+    }
+    pthread_rwlock_unlock(&manager->lock);
+}
@@ -0,0 +1,94 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "../Scheduler/Scheduler.h"
+
+// Registres de Gotham indexats per hash: clients per socket i per usuari, workers per socket i per (IP, port).
+// Les consultes copien les dades a l'estructura del cridant: cap punter intern surt del registre.
+
+// Clients: moltes connexions, taules repartides en franges amb un mutex cadascuna
+#define REGISTRY_CLIENT_BUCKETS (1 << 14)
+#define REGISTRY_STRIPES 64
+
+// Workers: pocs i sobretot consultes, una taula amb rwlock i càrrega atòmica
+#define REGISTRY_WORKER_BUCKETS 256
+
+#define WORKER_REGISTRO_NUEVO 1
+#define WORKER_REGISTRO_ACTUALIZADO 2
+
+// Representa un worker que es connecta a Gotham
+typedef struct {
+    char ip[16];    // Direcció IP del worker
+    int port;       // Port del worker
+    char type[10];  // Tipus de worker: "TEXT" o "MEDIA"
+    int socket_fd;  // Descriptor del socket associat al worker
+    int activeJobs;          // Feines actives segons l'últim informe 0x15
+    uint64_t bytesInFlight;  // Bytes en curs segons l'últim informe 0x15
+    int assignedSinceReport; // Peticions assignades per Gotham després de l'últim informe
+} WorkerInfo;
+
+typedef struct {
+    char username[64]; // Nombre de usuario del cliente
+    char ip[16];       // Dirección IP del cliente
+    int socket_fd;     // Descriptor del socket del cliente
+} ClientInfo;
+
+typedef struct ClientEntry {
+    ClientInfo info;
+    struct ClientEntry *nextBySocket;
+    struct ClientEntry *nextByName;
+} ClientEntry;
+
+typedef struct {
+    ClientEntry *bySocket[REGISTRY_CLIENT_BUCKETS];
+    ClientEntry *byName[REGISTRY_CLIENT_BUCKETS];
+    pthread_mutex_t socketStripes[REGISTRY_STRIPES]; // Protegeixen les cubetes bySocket (cubeta % franges)
+    pthread_mutex_t nameStripes[REGISTRY_STRIPES];   // Protegeixen les cubetes byName; s'agafen abans que les de socket
+    int clientCount;                                 // Atòmic
+} ClientManager;
+
+typedef struct WorkerEntry {
+    WorkerInfo info;
+    struct WorkerEntry *nextBySocket;
+    struct WorkerEntry *nextByAddress;
+    struct WorkerEntry *prev;  // Llista en ordre de registre (per llistar i triar)
+    struct WorkerEntry *next;
+} WorkerEntry;
+
+typedef struct {
+    WorkerEntry *bySocket[REGISTRY_WORKER_BUCKETS];
+    WorkerEntry *byAddress[REGISTRY_WORKER_BUCKETS];
+    WorkerEntry *first;
+    WorkerEntry *last;
+    int workerCount;
+    WorkerEntry *mainTextWorker;  // Worker principal per a TEXT
+    WorkerEntry *mainMediaWorker; // Worker principal per a MEDIA
+    SchedulerPolicy scheduler;    // Política de repartiment de peticions DISTORT
+    pthread_rwlock_t lock;        // Escriptura només per altes, baixes i canvis de principal
+} WorkerManager;
+
+// Clients
+ClientManager *createClientManager();
+void freeClientManager(ClientManager *manager);
+void addClient(ClientManager *manager, const char *username, const char *ip, int socket_fd);
+void removeClientBySocket(ClientManager *manager, int socket_fd);
+int buscarClientePorSocket(ClientManager *manager, int socket_fd, ClientInfo *client);
+void listClients(ClientManager *manager);
+void recorrerClientes(ClientManager *manager, void (*callback)(const ClientInfo *client, void *arg), void *arg);
+
+// Workers
+WorkerManager *createWorkerManager();
+void freeWorkerManager(WorkerManager *manager);
+int altaWorker(WorkerManager *manager, const char *type, const char *ip, int port, int socket_fd, int *isMain);
+int bajaWorkerPorSocket(WorkerManager *manager, int socket_fd, WorkerInfo *worker, int *wasMain);
+int buscarWorkerPorSocket(WorkerManager *manager, int socket_fd, WorkerInfo *worker);
+int esWorkerPrincipal(WorkerManager *manager, int socket_fd);
+int elegirWorker(WorkerManager *manager, const char *type, WorkerInfo *worker);
+int actualizarCargaPorSocket(WorkerManager *manager, int socket_fd, int activeJobs, uint64_t bytesInFlight);
+int elegirWorkersPrincipales(WorkerManager *manager, WorkerInfo *newMains, int maxMains);
+void recorrerWorkers(WorkerManager *manager, void (*callback)(const WorkerInfo *worker, int index, void *arg), void *arg);
+
+#endif
@@ -0,0 +1,310 @@
+#define _GNU_SOURCE // copy_file_range
+
+#include "ResultCache.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../DataConversion/DataConversion.h"
+#include "../FrameUtils/FrameUtils.h"
+#include "../Logging/Logging.h"
+#include "../MD5SUM/md5Sum.h"
+
+// Clau (i nom d'arxiu) d'un resultat o, amb RESULT_CACHE_SOURCE, de l'original; -1 si els camps no són vàlids per a un nom d'arxiu
+static int formarClau(const char *md5, int factor, const char *type, char key[RESULT_CACHE_KEY_SIZE]) {
+    if (!md5 || strlen(md5) != 32 || factor < 0 || !type || !*type) return -1;
+    for (const char *c = type; *c; c++) {
+        if (!isalnum((unsigned char)*c)) return -1;
+    }
+    int length = snprintf(key, RESULT_CACHE_KEY_SIZE, "%s_%d_%s", md5, factor, type);
+    return length > 0 && length < RESULT_CACHE_KEY_SIZE ? 0 : -1;
+}
+
+static int rutaEntrada(const ResultCache *cache, const char *key, char *path, size_t size) {
+    int length = snprintf(path, size, "%s%s", cache->dir, key);
+    return length > 0 && (size_t)length < size ? 0 : -1;
+}
+
+// Copia l'arxiu obert src a destPath (primer a un temporal únic i després rename: mai queda a mitges)
+static int copiarArxiu(int src, const char *destPath) {
+    char tempPath[512];
+    if (snprintf(tempPath, sizeof(tempPath), "%s.tmp.XXXXXX", destPath) >= (int)sizeof(tempPath)) return -1;
+
+    int dst = mkstemp(tempPath);
+    if (dst < 0) return -1;
+    fchmod(dst, 0666);
+
+    int result = 0;
+    off_t offset = 0;
+    while (1) {
+        ssize_t copied = copy_file_range(src, &offset, dst, NULL, 1 << 30, 0);
+        if (copied == 0) break;
+        if (copied > 0) continue;
+        if (errno == EINTR) continue;
+        if (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP) {
+            result = -1;
+            break;
+        }
+
+        // Sense copy_file_range: còpia per blocs a partir d'on s'ha quedat
+        char buffer[65536];
+        ssize_t bytesRead;
+        while ((bytesRead = pread(src, buffer, sizeof(buffer), offset)) > 0) {
+            if (write_full(dst, buffer, (size_t)bytesRead) != 0) {
+                bytesRead = -1;
+                break;
+            }
+            offset += bytesRead;
+        }
+        result = bytesRead < 0 ? -1 : 0;
+        break;
+    }
+
+    if (close(dst) != 0) result = -1;
+    if (result == 0 && rename(tempPath, destPath) != 0) result = -1;
+    if (result != 0) unlink(tempPath);
+    return result;
+}
+
+static ResultCacheEntry *buscarEntrada(ResultCache *cache, const char *key) {
+    for (int i = 0; i < RESULT_CACHE_MAX_ENTRIES; i++) {
+        if (cache->entries[i].inUse && strcmp(cache->entries[i].key, key) == 0) {
+            return &cache->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void eliminarEntrada(ResultCache *cache, ResultCacheEntry *entry) {
+    char path[512];
+    if (rutaEntrada(cache, entry->key, path, sizeof(path)) == 0) {
+        unlink(path);
+    }
+    __atomic_fetch_sub(&cache->stats.bytes, (uint64_t)entry->size, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&cache->stats.entries, 1, __ATOMIC_RELAXED);
+    entry->inUse = 0;
+}
+
+// Treu les entrades menys usades fins que n'hi cap una altra de size bytes
+static void ferLloc(ResultCache *cache, off_t size) {
+    while (cache->stats.entries > 0 &&
+           (cache->stats.bytes + (uint64_t)size > cache->maxBytes || cache->stats.entries >= RESULT_CACHE_MAX_ENTRIES)) {
+        ResultCacheEntry *oldest = NULL;
+        for (int i = 0; i < RESULT_CACHE_MAX_ENTRIES; i++) {
+            if (cache->entries[i].inUse && (!oldest || cache->entries[i].lastUsed < oldest->lastUsed)) {
+                oldest = &cache->entries[i];
+            }
+        }
+        eliminarEntrada(cache, oldest);
+        __atomic_fetch_add(&cache->stats.evictions, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static ResultCacheEntry *entradaLliure(ResultCache *cache) {
+    for (int i = 0; i < RESULT_CACHE_MAX_ENTRIES; i++) {
+        if (!cache->entries[i].inUse) return &cache->entries[i];
+    }
+    return NULL;
+}
+
+// Recupera l'índex dels resultats que ja hi havia al disc (l'ordre LRU surt de la data de modificació)
+static void carregarDirectori(ResultCache *cache) {
+    DIR *dir = opendir(cache->dir);
+    if (!dir) return;
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+
+        char path[512];
+        if (rutaEntrada(cache, ent->d_name, path, sizeof(path)) != 0) continue;
+
+        if (strstr(ent->d_name, ".tmp.")) {
+            unlink(path); // Còpia que no va acabar
+            continue;
+        }
+
+        char md5[33], type[16];
+        int factor;
+        char key[RESULT_CACHE_KEY_SIZE];
+        struct stat st;
+        if (sscanf(ent->d_name, "%32[0-9a-f]_%d_%15s", md5, &factor, type) != 3 ||
+            formarClau(md5, factor, type, key) != 0 || strcmp(key, ent->d_name) != 0 ||
+            stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+
+        ResultCacheEntry *entry = entradaLliure(cache);
+        if (!entry || cache->stats.bytes + (uint64_t)st.st_size > cache->maxBytes) {
+            unlink(path);
+            continue;
+        }
+
+        calculate_md5(path, entry->resultMD5);
+        if (strcmp(entry->resultMD5, "ERROR") == 0) continue;
+
+        snprintf(entry->key, sizeof(entry->key), "%s", key);
+        entry->size = st.st_size;
+        entry->lastUsed = (uint64_t)st.st_mtime;
+        entry->inUse = 1;
+        __atomic_fetch_add(&cache->stats.bytes, (uint64_t)st.st_size, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&cache->stats.entries, 1, __ATOMIC_RELAXED);
+        if (entry->lastUsed > cache->clock) cache->clock = entry->lastUsed;
+    }
+    closedir(dir);
+}
+
+// Memòria cau a <workerDir>cache/ amb un pressupost de maxBytes (0 = desactivada)
+int result_cache_init(ResultCache *cache, const char *workerDir, uint64_t maxBytes) {
+    if (!cache || !workerDir) return -1;
+
+    memset(cache, 0, sizeof(ResultCache));
+    pthread_mutex_init(&cache->mutex, NULL);
+    if (maxBytes == 0) return 0;
+
+    if (snprintf(cache->dir, sizeof(cache->dir), "%s%s", workerDir, RESULT_CACHE_DIR) >= (int)sizeof(cache->dir) ||
+        (mkdir(cache->dir, 0777) != 0 && errno != EEXIST)) {
+        logWarning("[WARNING]: No se pudo crear el directorio de la caché de resultados; queda desactivada.");
+        return -1;
+    }
+
+    cache->maxBytes = maxBytes;
+    cache->clock = (uint64_t)time(NULL);
+    carregarDirectori(cache);
+    return 0;
+}
+
+static void mostrarEncerts(const ResultCache *cache, const char *result) {
+    uint64_t total = cache->stats.hits + cache->stats.misses;
+    customPrintf("[INFO]: Caché de resultados: %s (%llu aciertos de %llu, %llu%%).\n", result,
+                 (unsigned long long)cache->stats.hits, (unsigned long long)total,
+                 (unsigned long long)(total ? cache->stats.hits * 100 / total : 0));
+}
+
+// Si el resultat hi és, el copia a destPath i en retorna l'MD5 i la mida (0); -1 si no hi és
+int result_cache_lookup(ResultCache *cache, const char *md5, int factor, const char *type,
+                        const char *destPath, char resultMD5[33], off_t *size) {
+    char key[RESULT_CACHE_KEY_SIZE];
+    if (!cache || cache->maxBytes == 0 || !destPath || formarClau(md5, factor, type, key) != 0) return -1;
+
+    char path[512];
+    pthread_mutex_lock(&cache->mutex);
+    ResultCacheEntry *entry = buscarEntrada(cache, key);
+    int src = -1;
+    if (entry && rutaEntrada(cache, key, path, sizeof(path)) == 0) {
+        src = open(path, O_RDONLY); // Oberta, l'arxiu sobreviu encara que un altre fil el tregui
+    }
+    if (src < 0) {
+        if (entry) eliminarEntrada(cache, entry);
+        if (factor != RESULT_CACHE_SOURCE) {
+            __atomic_fetch_add(&cache->stats.misses, 1, __ATOMIC_RELAXED);
+            mostrarEncerts(cache, "fallo");
+        }
+        pthread_mutex_unlock(&cache->mutex);
+        return -1;
+    }
+
+    entry->lastUsed = ++cache->clock;
+    if (factor == RESULT_CACHE_SOURCE) {
+        __atomic_fetch_add(&cache->stats.sourceHits, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&cache->stats.hits, 1, __ATOMIC_RELAXED);
+        mostrarEncerts(cache, "acierto");
+    }
+    snprintf(resultMD5, 33, "%s", entry->resultMD5);
+    *size = entry->size;
+    pthread_mutex_unlock(&cache->mutex);
+
+    utimensat(AT_FDCWD, path, NULL, 0); // Ordre LRU per a la pròxima arrencada
+    int result = copiarArxiu(src, destPath);
+    close(src);
+    if (result != 0) {
+        customPrintf("[ERROR]: No se pudo copiar el resultado de la caché.");
+    }
+    return result;
+}
+
+// Desa una còpia de resultPath; si no hi cap, treu primer els resultats menys usats
+int result_cache_store(ResultCache *cache, const char *md5, int factor, const char *type,
+                       const char *resultPath, const char *resultMD5) {
+    if (!cache || cache->maxBytes == 0 || !resultPath) return -1;
+
+    int src = open(resultPath, O_RDONLY);
+    if (src < 0) return -1;
+    int result = result_cache_store_fd(cache, md5, factor, type, src, resultMD5);
+    close(src);
+    return result;
+}
+
+// Com result_cache_store, per a un arxiu ja obert (sencer, des de l'inici; no el tanca)
+int result_cache_store_fd(ResultCache *cache, const char *md5, int factor, const char *type,
+                          int src, const char *resultMD5) {
+    char key[RESULT_CACHE_KEY_SIZE];
+    if (!cache || cache->maxBytes == 0 || src < 0 || !resultMD5 ||
+        formarClau(md5, factor, type, key) != 0) return -1;
+
+    // La mateixa clau dona el mateix contingut: n'hi ha prou de refrescar-ne l'ús
+    pthread_mutex_lock(&cache->mutex);
+    ResultCacheEntry *existing = buscarEntrada(cache, key);
+    if (existing) existing->lastUsed = ++cache->clock;
+    pthread_mutex_unlock(&cache->mutex);
+    if (existing) return 0;
+
+    struct stat st;
+    if (fstat(src, &st) != 0 || (uint64_t)st.st_size > cache->maxBytes) {
+        return -1;
+    }
+
+    char path[512];
+    if (rutaEntrada(cache, key, path, sizeof(path)) != 0 || copiarArxiu(src, path) != 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    ResultCacheEntry *entry = buscarEntrada(cache, key);
+    if (entry) {
+        // Una altra connexió l'ha calculat alhora: l'arxiu ja és el nou
+        __atomic_fetch_sub(&cache->stats.bytes, (uint64_t)entry->size, __ATOMIC_RELAXED);
+        __atomic_fetch_sub(&cache->stats.entries, 1, __ATOMIC_RELAXED);
+        entry->inUse = 0;
+    }
+    ferLloc(cache, st.st_size);
+    entry = entradaLliure(cache);
+    snprintf(entry->key, sizeof(entry->key), "%s", key);
+    snprintf(entry->resultMD5, sizeof(entry->resultMD5), "%s", resultMD5);
+    entry->size = st.st_size;
+    entry->lastUsed = ++cache->clock;
+    entry->inUse = 1;
+    __atomic_fetch_add(&cache->stats.bytes, (uint64_t)st.st_size, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cache->stats.entries, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cache->stats.stores, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&cache->mutex);
+    return 0;
+}
+
+// Sense el mutex: es crida des del handler de SIGINT, que pot haver interromput un fil que el té
+void result_cache_get_stats(ResultCache *cache, ResultCacheStats *out) {
+    if (!cache || !out) return;
+
+    out->hits = __atomic_load_n(&cache->stats.hits, __ATOMIC_RELAXED);
+    out->misses = __atomic_load_n(&cache->stats.misses, __ATOMIC_RELAXED);
+    out->stores = __atomic_load_n(&cache->stats.stores, __ATOMIC_RELAXED);
+    out->evictions = __atomic_load_n(&cache->stats.evictions, __ATOMIC_RELAXED);
+    out->sourceHits = __atomic_load_n(&cache->stats.sourceHits, __ATOMIC_RELAXED);
+    out->bytes = __atomic_load_n(&cache->stats.bytes, __ATOMIC_RELAXED);
+    out->entries = __atomic_load_n(&cache->stats.entries, __ATOMIC_RELAXED);
+}
+
+// Tipus de la clau: l'extensió (la compressió de Harley depèn del format)
+const char *result_cache_type(const char *fileName) {
+    const char *extension = fileName ? strrchr(fileName, '.') : NULL;
+    return extension && extension[1] ? extension + 1 : "";
+}
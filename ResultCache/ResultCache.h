@@ -0,0 +1,59 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Memòria cau en disc dels resultats de distorsió, indexada per (MD5 de l'original, factor, tipus).
+// Pressupost en bytes; 0 = desactivada.
+#ifndef RESULT_CACHE_MAX_BYTES
+#define RESULT_CACHE_MAX_BYTES (256ULL * 1024 * 1024)
+#endif
+
+#ifndef RESULT_CACHE_MAX_ENTRIES
+#define RESULT_CACHE_MAX_ENTRIES 128
+#endif
+
+#define RESULT_CACHE_DIR "cache/"   // Dins del directori del worker
+#define RESULT_CACHE_KEY_SIZE 64
+#define RESULT_CACHE_SOURCE 0       // "Factor" de l'arxiu original rebut (deduplicació de pujades)
+
+typedef struct {
+    char key[RESULT_CACHE_KEY_SIZE]; // <md5>_<factor>_<tipus>, també nom de l'arxiu
+    char resultMD5[33];
+    off_t size;
+    uint64_t lastUsed;               // Rellotge de l'LRU
+    int inUse;
+} ResultCacheEntry;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+    uint64_t sourceHits;             // Pujades estalviades amb l'original desat
+    uint64_t bytes;                  // Ocupació actual
+    int entries;
+} ResultCacheStats;
+
+typedef struct {
+    char dir[256];
+    uint64_t maxBytes;
+    ResultCacheEntry entries[RESULT_CACHE_MAX_ENTRIES];
+    uint64_t clock;
+    ResultCacheStats stats;          // S'escriu amb el mutex i __atomic; es llegeix sense el mutex
+    pthread_mutex_t mutex;
+} ResultCache;
+
+int result_cache_init(ResultCache *cache, const char *workerDir, uint64_t maxBytes);
+int result_cache_lookup(ResultCache *cache, const char *md5, int factor, const char *type,
+                        const char *destPath, char resultMD5[33], off_t *size);
+int result_cache_store(ResultCache *cache, const char *md5, int factor, const char *type,
+                       const char *resultPath, const char *resultMD5);
+int result_cache_store_fd(ResultCache *cache, const char *md5, int factor, const char *type,
+                          int src, const char *resultMD5);
+void result_cache_get_stats(ResultCache *cache, ResultCacheStats *out);
+const char *result_cache_type(const char *fileName);
+
+#endif
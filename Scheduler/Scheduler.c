@@ -0,0 +1,74 @@
+#include "Scheduler.h"
+
+#include <stdlib.h>
+
+// Compara dues càrregues: primer peticions pendents, després bytes en vol
+static int menysCarregat(const SchedulerLoad *a, const SchedulerLoad *b) {
+    if (a->outstanding != b->outstanding) {
+        return a->outstanding < b->outstanding;
+    }
+    return a->bytesInFlight < b->bytesInFlight;
+}
+
+int scheduler_least_outstanding(const SchedulerLoad *loads, int count, unsigned int *seed) {
+    (void)seed;
+    if (!loads || count <= 0) return -1;
+
+    int best = 0;
+    for (int i = 1; i < count; i++) {
+        if (menysCarregat(&loads[i], &loads[best])) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+int scheduler_power_of_two(const SchedulerLoad *loads, int count, unsigned int *seed) {
+    if (!loads || count <= 0 || !seed) return -1;
+    if (count == 1) return 0;
+
+    // Dos candidats diferents a l'atzar: cost O(1) i gairebé tan equilibrat com mirar-los tots
+    int first = rand_r(seed) % count;
+    int second = rand_r(seed) % (count - 1);
+    if (second >= first) second++;
+
+    return menysCarregat(&loads[second], &loads[first]) ? second : first;
+}
+
+int scheduler_weighted_bytes(const SchedulerLoad *loads, int count, unsigned int *seed) {
+    (void)seed;
+    if (!loads || count <= 0) return -1;
+
+    int best = 0;
+    for (int i = 1; i < count; i++) {
+        if (loads[i].bytesInFlight < loads[best].bytesInFlight ||
+            (loads[i].bytesInFlight == loads[best].bytesInFlight && loads[i].outstanding < loads[best].outstanding)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+SchedulerPolicy scheduler_get_policy(int policy) {
+    switch (policy) {
+        case SCHEDULER_POWER_OF_TWO:
+            return scheduler_power_of_two;
+        case SCHEDULER_WEIGHTED_BYTES:
+            return scheduler_weighted_bytes;
+        case SCHEDULER_LEAST_OUTSTANDING:
+        default:
+            return scheduler_least_outstanding;
+    }
+}
+
+const char *scheduler_policy_name(int policy) {
+    switch (policy) {
+        case SCHEDULER_POWER_OF_TWO:
+            return "power-of-two";
+        case SCHEDULER_WEIGHTED_BYTES:
+            return "weighted-bytes";
+        case SCHEDULER_LEAST_OUTSTANDING:
+        default:
+            return "least-outstanding";
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// Polítiques de repartiment de peticions DISTORT (0x10/0x11) entre els workers d'un mateix tipus
+#define SCHEDULER_LEAST_OUTSTANDING 0 // Menys peticions pendents (reportades + assignades des de l'últim informe)
+#define SCHEDULER_POWER_OF_TWO 1      // Dos candidats a l'atzar, el menys carregat dels dos
+#define SCHEDULER_WEIGHTED_BYTES 2    // Menys bytes en vol
+
+#ifndef SCHEDULER_POLICY
+#define SCHEDULER_POLICY SCHEDULER_LEAST_OUTSTANDING
+#endif
+
+// Bytes que s'atribueixen a una petició assignada de la qual encara no hi ha informe de càrrega
+#define SCHEDULER_DEFAULT_JOB_BYTES (1024 * 1024)
+
+typedef struct {
+    int outstanding;         // Feines actives + assignades pendents d'arribar al worker
+    uint64_t bytesInFlight;  // Bytes que el worker té en curs (estimats per a les assignades)
+} SchedulerLoad;
+
+// Retorna l'índex del candidat escollit (-1 si no n'hi ha cap)
+typedef int (*SchedulerPolicy)(const SchedulerLoad *loads, int count, unsigned int *seed);
+
+int scheduler_least_outstanding(const SchedulerLoad *loads, int count, unsigned int *seed);
+int scheduler_power_of_two(const SchedulerLoad *loads, int count, unsigned int *seed);
+int scheduler_weighted_bytes(const SchedulerLoad *loads, int count, unsigned int *seed);
+
+SchedulerPolicy scheduler_get_policy(int policy);
+const char *scheduler_policy_name(int policy);
+
+#endif
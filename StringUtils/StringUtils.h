@@ -22,12 +22,12 @@
 #define ANSI_COLOR_WHITE  "\033[1;37m"
 
 /***********************************************
-* @Finalitat: Escriu la cadena de text 'x' a la sortida estàndard (file descriptor 1).
+* @Finalitat: printF (Logging.h) escriu la cadena de text 'x' a la sortida estàndard a través de la cua de consola.
 * @Paràmetres:
 *   in: x = cadena de text a imprimir.
 * @Retorn: ----
 ************************************************/
-#define printF(x) write(1, x, strlen(x))
+#include "../Logging/Logging.h" // printF
 
 char *trim(char *str);
 void removeChar(char *string, char charToRemove);
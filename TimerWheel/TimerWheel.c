@@ -0,0 +1,190 @@
+#include "TimerWheel.h"
+
+#include <stddef.h>
+#include <time.h>
+
+#define ROOT_MASK (TIMER_WHEEL_ROOT_SIZE - 1)
+#define LEVEL_MASK (TIMER_WHEEL_LEVEL_SIZE - 1)
+#define LEVEL_SHIFT(n) (TIMER_WHEEL_ROOT_BITS + (n) * TIMER_WHEEL_LEVEL_BITS)
+#define MAX_DELAY_TICKS ((1ULL << LEVEL_SHIFT(TIMER_WHEEL_LEVELS)) - 1)
+
+uint64_t timer_wheel_now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+static void llistaBuida(TimerEntry *head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static void llistaAfegir(TimerEntry *head, TimerEntry *entry) {
+    entry->prev = head->prev;
+    entry->next = head;
+    head->prev->next = entry;
+    head->prev = entry;
+}
+
+static void llistaTreure(TimerEntry *entry) {
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    entry->next = entry->prev = NULL;
+}
+
+// Mou tots els elements de from a to (to ha d'estar buida)
+static void llistaMoure(TimerEntry *from, TimerEntry *to) {
+    if (from->next == from) {
+        llistaBuida(to);
+        return;
+    }
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    llistaBuida(from);
+}
+
+void timer_wheel_init(TimerWheel *wheel) {
+    if (!wheel) return;
+
+    for (int i = 0; i < TIMER_WHEEL_ROOT_SIZE; i++) {
+        llistaBuida(&wheel->root[i]);
+    }
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int i = 0; i < TIMER_WHEEL_LEVEL_SIZE; i++) {
+            llistaBuida(&wheel->levels[level][i]);
+        }
+    }
+    wheel->currentTick = 0;
+    wheel->startMs = timer_wheel_now_ms();
+    wheel->count = 0;
+}
+
+void timer_entry_init(TimerEntry *entry, TimerCallback callback, void *arg) {
+    if (!entry) return;
+
+    entry->next = entry->prev = NULL;
+    entry->expires = 0;
+    entry->callback = callback;
+    entry->arg = arg;
+}
+
+int timer_entry_active(const TimerEntry *entry) {
+    return entry && entry->next != NULL;
+}
+
+// Col·loca l'entrada a la ranura que li toca segons quant falta perquè venci
+static void colocar(TimerWheel *wheel, TimerEntry *entry) {
+    uint64_t expires = entry->expires;
+    uint64_t delta = expires > wheel->currentTick ? expires - wheel->currentTick : 0;
+    TimerEntry *head;
+
+    if (delta < TIMER_WHEEL_ROOT_SIZE) {
+        // Ja vençut: a la ranura actual perquè surti al pròxim avanç
+        if (expires < wheel->currentTick) expires = wheel->currentTick;
+        head = &wheel->root[expires & ROOT_MASK];
+    } else {
+        int level = 0;
+        while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << LEVEL_SHIFT(level + 1))) {
+            level++;
+        }
+        head = &wheel->levels[level][(expires >> LEVEL_SHIFT(level)) & LEVEL_MASK];
+    }
+    llistaAfegir(head, entry);
+}
+
+void timer_wheel_schedule(TimerWheel *wheel, TimerEntry *entry, uint64_t delayMs) {
+    if (!wheel || !entry) return;
+
+    timer_wheel_cancel(wheel, entry);
+
+    // Tic en què venç, arrodonit cap amunt perquè mai no surti abans d'hora
+    uint64_t nowTick = (timer_wheel_now_ms() - wheel->startMs) / TIMER_WHEEL_TICK_MS;
+    uint64_t ticks = (delayMs + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+    if (ticks > MAX_DELAY_TICKS) ticks = MAX_DELAY_TICKS;
+    if (nowTick < wheel->currentTick) nowTick = wheel->currentTick;
+
+    entry->expires = nowTick + ticks;
+    colocar(wheel, entry);
+    wheel->count++;
+}
+
+void timer_wheel_cancel(TimerWheel *wheel, TimerEntry *entry) {
+    if (!wheel || !timer_entry_active(entry)) return;
+
+    llistaTreure(entry);
+    wheel->count--;
+}
+
+// Redistribueix una ranura d'un nivell superior cap als nivells inferiors; retorna l'índex de la ranura
+static int cascada(TimerWheel *wheel, int level) {
+    int index = (int)((wheel->currentTick >> LEVEL_SHIFT(level)) & LEVEL_MASK);
+    TimerEntry pending;
+    llistaMoure(&wheel->levels[level][index], &pending);
+
+    while (pending.next != &pending) {
+        TimerEntry *entry = pending.next;
+        llistaTreure(entry);
+        colocar(wheel, entry);
+    }
+    return index;
+}
+
+// Executa els temporitzadors vençuts fins ara. Retorna quants n'han sortit.
+int timer_wheel_advance(TimerWheel *wheel) {
+    if (!wheel) return 0;
+
+    uint64_t targetTick = (timer_wheel_now_ms() - wheel->startMs) / TIMER_WHEEL_TICK_MS;
+    int fired = 0;
+
+    while (wheel->currentTick <= targetTick) {
+        int index = (int)(wheel->currentTick & ROOT_MASK);
+
+        // En completar una volta de l'arrel es baixa la següent ranura de cada nivell
+        if (index == 0) {
+            for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+                if (cascada(wheel, level) != 0) break;
+            }
+        }
+
+        TimerEntry expired;
+        llistaMoure(&wheel->root[index], &expired);
+        wheel->currentTick++;
+
+        // Es treu cada entrada abans de cridar-la: la callback pot reprogramar-la o cancel·lar-ne d'altres
+        while (expired.next != &expired) {
+            TimerEntry *entry = expired.next;
+            llistaTreure(entry);
+            wheel->count--;
+            fired++;
+            if (entry->callback) {
+                entry->callback(entry, entry->arg);
+            }
+        }
+    }
+    return fired;
+}
+
+// Mil·lisegons fins al pròxim tic amb feina (com a molt maxMs; -1 si no hi ha res programat i maxMs < 0)
+int timer_wheel_next_timeout(const TimerWheel *wheel, int maxMs) {
+    if (!wheel || wheel->count == 0) return maxMs;
+
+    // Fins a la propera ranura ocupada de l'arrel o, si no n'hi ha cap, fins a la pròxima cascada
+    // (el tic amb índex 0 ja en fa una, per això llavors no cal esperar)
+    uint64_t untilCascade = (TIMER_WHEEL_ROOT_SIZE - (wheel->currentTick & ROOT_MASK)) & ROOT_MASK;
+    uint64_t ticks = untilCascade;
+    for (uint64_t i = 0; i < untilCascade; i++) {
+        const TimerEntry *head = &wheel->root[(wheel->currentTick + i) & ROOT_MASK];
+        if (head->next != head) {
+            ticks = i;
+            break;
+        }
+    }
+
+    uint64_t targetMs = wheel->startMs + (wheel->currentTick + ticks) * TIMER_WHEEL_TICK_MS;
+    uint64_t nowMs = timer_wheel_now_ms();
+    int timeout = targetMs > nowMs ? (int)(targetMs - nowMs) : 0;
+    if (maxMs >= 0 && timeout > maxMs) timeout = maxMs;
+    return timeout;
+}
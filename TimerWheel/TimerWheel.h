@@ -0,0 +1,46 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+// Roda de temporitzadors jeràrquica (com els timers clàssics del kernel):
+// el primer nivell té 256 ranures d'un tic i els següents 64 ranures cadascun, de 256, 16384... tics.
+// Afegir i cancel·lar és O(1) i cada avanç només toca els temporitzadors que vencen.
+#define TIMER_WHEEL_TICK_MS 10
+#define TIMER_WHEEL_ROOT_BITS 8
+#define TIMER_WHEEL_LEVEL_BITS 6
+#define TIMER_WHEEL_ROOT_SIZE (1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_LEVEL_SIZE (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_LEVELS 3  // Nivells per sobre de l'arrel (abast de 2^26 tics)
+
+typedef struct TimerEntry TimerEntry;
+typedef void (*TimerCallback)(TimerEntry *entry, void *arg);
+
+struct TimerEntry {
+    TimerEntry *next;
+    TimerEntry *prev;
+    uint64_t expires;       // Tic absolut en què venç
+    TimerCallback callback;
+    void *arg;
+};
+
+typedef struct {
+    TimerEntry root[TIMER_WHEEL_ROOT_SIZE];                     // Capçaleres (sentinelles) de les llistes
+    TimerEntry levels[TIMER_WHEEL_LEVELS][TIMER_WHEEL_LEVEL_SIZE];
+    uint64_t currentTick;   // Següent tic a processar
+    uint64_t startMs;       // Instant (ms monotònics) del tic 0
+    int count;              // Temporitzadors programats
+} TimerWheel;
+
+uint64_t timer_wheel_now_ms(void);
+
+void timer_wheel_init(TimerWheel *wheel);
+void timer_entry_init(TimerEntry *entry, TimerCallback callback, void *arg);
+int timer_entry_active(const TimerEntry *entry);
+
+void timer_wheel_schedule(TimerWheel *wheel, TimerEntry *entry, uint64_t delayMs);
+void timer_wheel_cancel(TimerWheel *wheel, TimerEntry *entry);
+int timer_wheel_advance(TimerWheel *wheel);
+int timer_wheel_next_timeout(const TimerWheel *wheel, int maxMs);
+
+#endif
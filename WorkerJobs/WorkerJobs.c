@@ -0,0 +1,207 @@
+#include "WorkerJobs.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "../DataConversion/DataConversion.h"
+
+// Prepara la taula amb maxJobs places (0 = una per core), com a molt limit
+int worker_jobs_init(WorkerJobTable *table, int maxJobs, int limit) {
+    if (!table) return -1;
+
+    int capacity = maxJobs;
+    if (capacity <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        capacity = cores > 0 ? (int)cores : 1;
+    }
+    if (limit > 0 && capacity > limit) capacity = limit;
+
+    table->jobs = calloc(capacity, sizeof(WorkerJob));
+    if (!table->jobs) {
+        customPrintf("[ERROR]: No se pudo asignar memoria para la tabla de distorsiones.");
+        return -1;
+    }
+
+    for (int i = 0; i < capacity; i++) {
+        table->jobs[i].clientSocket = -1;
+        table->jobs[i].tempFileDescriptor = -1;
+        flow_control_init(&table->jobs[i].downloadFlow);
+    }
+    table->capacity = capacity;
+    table->active = 0;
+    table->stopping = 0;
+    pthread_mutex_init(&table->mutex, NULL);
+    pthread_cond_init(&table->released, NULL);
+    return 0;
+}
+
+// Reserva una plaça; si totes estan ocupades espera que se n'alliberi una (NULL si el worker es tanca)
+WorkerJob *worker_jobs_acquire(WorkerJobTable *table) {
+    if (!table || !table->jobs) return NULL;
+
+    pthread_mutex_lock(&table->mutex);
+    // Un senyal no pot fer pthread_cond_signal: l'espera es talla a trossos per veure stopping
+    while (table->active == table->capacity && !table->stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += WORKER_JOBS_STOP_POLL_MS * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&table->released, &table->mutex, &deadline);
+    }
+    if (table->stopping) {
+        pthread_mutex_unlock(&table->mutex);
+        return NULL;
+    }
+
+    WorkerJob *job = NULL;
+    for (int i = 0; i < table->capacity; i++) {
+        if (!table->jobs[i].inUse) {
+            job = &table->jobs[i];
+            break;
+        }
+    }
+
+    // El FlowControl (últim camp) es conserva: mutex i condició ja inicialitzats
+    memset(job, 0, offsetof(WorkerJob, downloadFlow));
+    flow_control_reset(&job->downloadFlow, 0);
+    job->inUse = 1;
+    job->refs = 1;
+    job->clientSocket = -1;
+    job->tempFileDescriptor = -1;
+    table->active++;
+    pthread_mutex_unlock(&table->mutex);
+
+    return job;
+}
+
+void worker_job_retain(WorkerJobTable *table, WorkerJob *job) {
+    if (!table || !job) return;
+
+    pthread_mutex_lock(&table->mutex);
+    job->refs++;
+    pthread_mutex_unlock(&table->mutex);
+}
+
+// Deixa la feina; l'última referència tanca el socket i l'arxiu i allibera la plaça
+void worker_job_release(WorkerJobTable *table, WorkerJob *job) {
+    if (!table || !job) return;
+
+    pthread_mutex_lock(&table->mutex);
+    if (--job->refs > 0) {
+        pthread_mutex_unlock(&table->mutex);
+        return;
+    }
+
+    if (job->tempFileDescriptor >= 0) {
+        mapped_file_finish(&job->receiveFile);
+        close(job->tempFileDescriptor);
+        job->tempFileDescriptor = -1;
+    }
+    if (job->clientSocket >= 0) {
+        close(job->clientSocket);
+        job->clientSocket = -1;
+    }
+    job->fileName[0] = '\0';
+    job->userName[0] = '\0';
+    job->inUse = 0;
+    table->active--;
+    pthread_cond_signal(&table->released);
+    pthread_mutex_unlock(&table->mutex);
+}
+
+static int mateixArxiu(const WorkerJob *job, const char *fileName) {
+    return job->inUse && strcmp(job->fileName, fileName) == 0;
+}
+
+// Assigna l'arxiu a la feina si cap altra feina activa l'està tractant (el worker el desa pel nom)
+int worker_job_claim(WorkerJobTable *table, WorkerJob *job, const char *fileName) {
+    if (!table || !job || !fileName) return -1;
+
+    pthread_mutex_lock(&table->mutex);
+    for (int i = 0; i < table->capacity; i++) {
+        if (&table->jobs[i] != job && mateixArxiu(&table->jobs[i], fileName)) {
+            pthread_mutex_unlock(&table->mutex);
+            return -1;
+        }
+    }
+    strncpy(job->fileName, fileName, sizeof(job->fileName) - 1);
+    pthread_mutex_unlock(&table->mutex);
+    return 0;
+}
+
+int worker_jobs_is_active(WorkerJobTable *table, const char *fileName) {
+    if (!table || !fileName) return 0;
+
+    int active = 0;
+    pthread_mutex_lock(&table->mutex);
+    for (int i = 0; i < table->capacity && !active; i++) {
+        active = mateixArxiu(&table->jobs[i], fileName);
+    }
+    pthread_mutex_unlock(&table->mutex);
+    return active;
+}
+
+// Demana el tancament: worker_jobs_acquire deixa de reservar places. Només escriu un sig_atomic_t,
+// així que es pot cridar des d'un gestor de senyal
+void worker_jobs_request_stop(WorkerJobTable *table) {
+    if (table) table->stopping = 1;
+}
+
+// En tancar el worker: talla les connexions de Fleck en curs i espera que els fils deixin les feines.
+// Retorna -1 si en passar timeoutMs encara n'hi ha alguna d'activa.
+int worker_jobs_wait_idle(WorkerJobTable *table, int timeoutMs) {
+    if (!table || !table->jobs) return 0;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+
+    pthread_mutex_lock(&table->mutex);
+    // Amb el mutex, cap socket no es pot tancar (ni reutilitzar) mentre se'n fa shutdown
+    for (int i = 0; i < table->capacity; i++) {
+        WorkerJob *job = &table->jobs[i];
+        if (job->inUse && job->clientSocket >= 0) {
+            shutdown(job->clientSocket, SHUT_RDWR);
+        }
+    }
+    while (table->active > 0) {
+        if (pthread_cond_timedwait(&table->released, &table->mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    int idle = table->active == 0;
+    pthread_mutex_unlock(&table->mutex);
+
+    return idle ? 0 : -1;
+}
+
+// Després de worker_jobs_wait_idle: el que quedi és d'algun fil que no ha acabat a temps.
+// Se'n tallen els sockets i es tanquen els arxius (la projecció es manté fins a l'exit)
+void worker_jobs_close_all(WorkerJobTable *table) {
+    if (!table || !table->jobs) return;
+
+    pthread_mutex_lock(&table->mutex);
+    for (int i = 0; i < table->capacity; i++) {
+        WorkerJob *job = &table->jobs[i];
+        if (!job->inUse) continue;
+
+        if (job->clientSocket >= 0) {
+            shutdown(job->clientSocket, SHUT_RDWR);
+        }
+        if (job->tempFileDescriptor >= 0) {
+            close(job->tempFileDescriptor);
+            job->tempFileDescriptor = -1;
+        }
+    }
+    pthread_mutex_unlock(&table->mutex);
+}
@@ -0,0 +1,74 @@
+#ifndef WORKER_JOBS_H
+#define WORKER_JOBS_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../Checkpoint/Checkpoint.h"
+#include "../FlowControl/FlowControl.h"
+#include "../MappedFile/MappedFile.h"
+#include "../MD5SUM/md5Sum.h"
+
+// Distorsions que un worker (Harley/Enigma) atén alhora. 0 = una per core.
+// Mai més que les entrades de recuperació de la memòria compartida (el límit el passa el worker).
+#ifndef WORKER_MAX_JOBS
+#define WORKER_MAX_JOBS 0
+#endif
+
+// Cada quant worker_jobs_acquire mira si s'ha demanat el tancament mentre espera plaça
+#ifndef WORKER_JOBS_STOP_POLL_MS
+#define WORKER_JOBS_STOP_POLL_MS 100
+#endif
+
+// Temps màxim que el tancament espera que els fils de les distorsions deixin les seves feines
+#ifndef WORKER_JOBS_STOP_TIMEOUT_MS
+#define WORKER_JOBS_STOP_TIMEOUT_MS 2000
+#endif
+
+// Context d'una distorsió: el que abans eren variables globals del worker.
+// Una connexió de Fleck = una feina; el fil de recepció i el d'enviament hi tenen una referència cadascun.
+typedef struct {
+    int inUse;
+    int refs;
+    int clientSocket;             // Es tanca quan s'allibera l'última referència
+    char fileName[256];
+    char userName[64];
+    char expectedMD5[33];
+    char factor[20];
+    int tempFileDescriptor;       // Arxiu que s'està rebent
+    MappedFile receiveFile;       // Projecció de tempFileDescriptor on es copien les dades rebudes
+    size_t expectedFileSize;
+    size_t currentFileSize;
+    Md5Context receivedHash;      // MD5 incremental de l'arxiu que s'està rebent
+    int receivedHashValid;        // 0 si cal recalcular-lo del fitxer en acabar
+    Checkpoint receiveCheckpoint; // Progrés de la recepció desat per última vegada a la memòria compartida
+    int distortionLogged;
+    uint32_t bulkChunkSize;       // Mida BULK negociada a la trama 0x03
+    uint32_t creditWindow;        // Finestra de crèdits negociada a la trama 0x03
+    uint32_t zeroCopy;            // 1 si Fleck accepta trames BULK de còpia zero
+    void *stream;                 // Estat del mode STREAM del worker (NULL: distorsió clàssica)
+    FlowControl downloadFlow;     // Crèdits que Fleck concedeix per a l'enviament del fitxer distorsionat
+} WorkerJob;
+
+typedef struct {
+    WorkerJob *jobs;
+    int capacity;
+    int active;
+    pthread_mutex_t mutex;
+    pthread_cond_t released;
+    volatile sig_atomic_t stopping; // El posa worker_jobs_request_stop (també des d'un senyal)
+} WorkerJobTable;
+
+int worker_jobs_init(WorkerJobTable *table, int maxJobs, int limit);
+WorkerJob *worker_jobs_acquire(WorkerJobTable *table);
+void worker_job_retain(WorkerJobTable *table, WorkerJob *job);
+void worker_job_release(WorkerJobTable *table, WorkerJob *job);
+int worker_job_claim(WorkerJobTable *table, WorkerJob *job, const char *fileName);
+int worker_jobs_is_active(WorkerJobTable *table, const char *fileName);
+void worker_jobs_request_stop(WorkerJobTable *table);
+int worker_jobs_wait_idle(WorkerJobTable *table, int timeoutMs);
+void worker_jobs_close_all(WorkerJobTable *table);
+
+#endif
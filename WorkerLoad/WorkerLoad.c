@@ -0,0 +1,79 @@
+#include "WorkerLoad.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../GestorTramas/GestorTramas.h"
+
+static pthread_mutex_t loadMutex = PTHREAD_MUTEX_INITIALIZER;
+static int *loadGothamSocket = NULL;   // Punter al socket global del worker (pot canviar a -1 en tancar)
+static int activeJobs = 0;
+static uint64_t bytesInFlight = 0;
+
+void worker_load_init(int *gothamSocket) {
+    pthread_mutex_lock(&loadMutex);
+    loadGothamSocket = gothamSocket;
+    activeJobs = 0;
+    bytesInFlight = 0;
+    pthread_mutex_unlock(&loadMutex);
+}
+
+// Cal cridar-la amb loadMutex agafat: així els informes surten en ordre. done: distorsió acabada (o NULL)
+static void enviarInformeAmb(const char *done) {
+    if (!loadGothamSocket || *loadGothamSocket < 0 ||
+        get_frame_protocol(*loadGothamSocket) != FRAME_PROTOCOL_V2) {
+        return;
+    }
+
+    Frame frame = {0};
+    frame.type = FRAME_LOAD_TYPE;
+    snprintf(frame.data, sizeof(frame.data), "%d&%llu%s", activeJobs, (unsigned long long)bytesInFlight, done ? done : "");
+    frame.data_length = strlen(frame.data);
+    frame.timestamp = (uint32_t)time(NULL);
+    frame.checksum = calculate_checksum(frame.data, frame.data_length, 0);
+
+    escribirTrama(*loadGothamSocket, &frame);
+}
+
+static void enviarInforme(void) {
+    enviarInformeAmb(NULL);
+}
+
+// Nova distorsió acceptada
+void worker_load_begin(uint64_t bytes) {
+    pthread_mutex_lock(&loadMutex);
+    activeJobs++;
+    bytesInFlight += bytes;
+    enviarInforme();
+    pthread_mutex_unlock(&loadMutex);
+}
+
+// Distorsió acabada o connexió amb Fleck perduda
+void worker_load_end(uint64_t bytes) {
+    pthread_mutex_lock(&loadMutex);
+    if (activeJobs > 0) activeJobs--;
+    bytesInFlight = bytesInFlight > bytes ? bytesInFlight - bytes : 0;
+    enviarInforme();
+    pthread_mutex_unlock(&loadMutex);
+}
+
+// Distorsió completada (Fleck ha confirmat l'MD5): com worker_load_end, però Gotham en registra bytes i durada
+void worker_load_done(uint64_t bytes, uint32_t durationMs) {
+    char done[48];
+    snprintf(done, sizeof(done), "&%llu&%u", (unsigned long long)bytes, durationMs);
+
+    pthread_mutex_lock(&loadMutex);
+    if (activeJobs > 0) activeJobs--;
+    bytesInFlight = bytesInFlight > bytes ? bytesInFlight - bytes : 0;
+    enviarInformeAmb(done);
+    pthread_mutex_unlock(&loadMutex);
+}
+
+// Reenvia l'estat actual (p.ex. just després de registrar-se)
+void worker_load_report(void) {
+    pthread_mutex_lock(&loadMutex);
+    enviarInforme();
+    pthread_mutex_unlock(&loadMutex);
+}
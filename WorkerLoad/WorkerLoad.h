@@ -0,0 +1,17 @@
+#ifndef WORKER_LOAD_H
+#define WORKER_LOAD_H
+
+#include <stdint.h>
+
+// Informe de càrrega worker -> Gotham: DATA = <feines actives>&<bytes en vol>[&<bytes>&<ms>]
+// Els dos últims camps només hi són quan l'informe tanca una distorsió (Gotham antic els ignora).
+// Només s'envia si Gotham ha negociat el protocol v2 (un Gotham antic no coneix la trama).
+#define FRAME_LOAD_TYPE 0x15
+
+void worker_load_init(int *gothamSocket);
+void worker_load_begin(uint64_t bytes);
+void worker_load_end(uint64_t bytes);
+void worker_load_done(uint64_t bytes, uint32_t durationMs);
+void worker_load_report(void);
+
+#endif